@@ -0,0 +1,46 @@
+#include <gtest/gtest.h>
+
+#include "thorin/world.h"
+#include "thorin/analyses/induction.h"
+#include "thorin/analyses/scope.h"
+
+using namespace thorin;
+
+/// <tt>for (i = init; i cmp bound; i += step)</tt> over 32-bit integers; returns the function and the loop header.
+static std::pair<Lam*, Lam*> counted_loop(World& w, ICmp cmp, u64 init, u64 step, const Def* bound) {
+    auto M = w.type_mem();
+    auto I32 = w.type_int_width(32);
+    auto f = w.nom_lam(w.cn({M, I32, w.cn(M)}), w.dbg("f"));
+    auto [mem, n, ret] = f->vars<3>();
+    f->make_external();
+
+    auto head = w.nom_lam(w.cn({M, I32}), w.dbg("head"));
+    auto body = w.nom_lam(w.cn(M), w.dbg("body"));
+    auto exit = w.nom_lam(w.cn(M), w.dbg("exit"));
+    auto [m, i] = head->vars<2>();
+    f->app(head, {mem, w.lit_int_width(32, init)});
+    head->branch(w.op(cmp, i, bound ? bound : n), body, exit, m);
+    body->app(head, {body->var(), w.op(Wrap::add, WMode::none, i, w.lit_int_width(32, step))});
+    exit->app(ret, exit->var());
+    return {f, head};
+}
+
+static std::optional<u64> trip_count(ICmp cmp, u64 init, u64 step, std::optional<u64> bound) {
+    World w;
+    auto [f, head] = counted_loop(w, cmp, init, step, bound ? w.lit_int_width(32, *bound) : nullptr);
+    Scope scope(f);
+    InductionVars ivs(scope);
+    EXPECT_TRUE(ivs.basic(head->var(2, 1)) != nullptr);
+    return ivs.trip_count(head);
+}
+
+TEST(InductionVars, TripCount) {
+    EXPECT_TRUE(trip_count(ICmp::ul,  0, 1, 100) == 100);
+    EXPECT_TRUE(trip_count(ICmp::ul,  5, 3,  20) == 5);
+    EXPECT_TRUE(trip_count(ICmp::ule, 0, 2,  10) == 6);
+    EXPECT_TRUE(trip_count(ICmp::ul, 20, 1,  10) == 0);
+    EXPECT_TRUE(trip_count(ICmp::sle, u64(-4) & 0xffffffff, 2, 4) == 5);
+    EXPECT_TRUE(trip_count(ICmp::ne,  0, 4,  12) == 3);
+    EXPECT_FALSE(trip_count(ICmp::ne, 0, 4,  10)); // never hits the bound
+    EXPECT_FALSE(trip_count(ICmp::ul, 0, 1, std::nullopt));
+}
@@ -0,0 +1,805 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#ifdef LLVM_SUPPORT
+#include <llvm/IR/CFG.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/IntrinsicInst.h>
+#include <llvm/IR/Verifier.h>
+#endif
+
+#include "thorin/world.h"
+#include "thorin/be/c.h"
+#ifdef LLVM_SUPPORT
+#include "thorin/be/llvm/cpu.h"
+#include "thorin/be/llvm/jit.h"
+#include "thorin/be/llvm/object_cache.h"
+#endif
+
+using namespace thorin;
+
+/// A function with a chain of @p n diamonds whose joins each take a phi from both of their predecessors.
+static Lam* diamonds(World& w, size_t n) {
+    auto M = w.type_mem();
+    auto I32 = w.type_int_width(32);
+    auto f = w.nom_lam(w.cn({M, I32, w.cn({M, I32})}), w.dbg("diamonds"));
+    auto [mem, x, ret] = f->vars<3>();
+    f->make_external();
+
+    Lam* curr = f;
+    const Def* a = x;
+    for (size_t i = 0; i != n; ++i) {
+        auto join = w.nom_lam(w.cn({M, I32}), w.dbg("join"));
+        auto t    = w.nom_lam(w.cn(M), w.dbg("t"));
+        auto e    = w.nom_lam(w.cn(M), w.dbg("e"));
+        auto b = w.op(Wrap::mul, WMode::none, a, w.lit_int_width(32, i + 3));
+        b = w.op(Wrap::add, WMode::none, b, x);
+        curr->branch(w.op(ICmp::ul, b, x), t, e, mem);
+        t->app(join, {t->var(), b});
+        e->app(join, {e->var(), w.op(Wrap::sub, WMode::none, b, a)});
+        curr = join;
+        mem = join->var(0_u64);
+        a   = join->var(1_u64);
+    }
+    curr->app(ret, {mem, a});
+    return f;
+}
+
+// The C backend doesn't need LLVM: each join becomes a label and its phi an assignment before the goto.
+TEST(CodeGen, C) {
+    World w;
+    diamonds(w, 4);
+
+    std::ostringstream os;
+    emit_c(w, {}, os, Lang::C99, false);
+    auto c = os.str();
+
+    EXPECT_NE(c.find("uint32_t diamonds(uint32_t"), std::string::npos);
+    EXPECT_NE(c.find("goto "), std::string::npos);
+    EXPECT_EQ(c.find("static uint32_t diamonds"), std::string::npos);
+}
+
+// Lifted ops on small arrays become the lane-wise operators of vector types - or a loop over the lanes in plain C99.
+TEST(CodeGen, CVectors) {
+    World w;
+    auto M = w.type_mem();
+    auto F32 = w.type_real(32);
+    auto V = w.arr(4, F32);
+    auto f = w.nom_lam(w.cn({M, w.type_ptr(V), w.cn(M)}), w.dbg("square"));
+    auto [mem, ptr, ret] = f->vars<3>();
+    f->make_external();
+
+    auto [m, v] = w.op_load(mem, ptr)->projs<2>();
+    auto lift = w.app(w.ax_lift(), {w.lit_nat_1(), w.lit_nat(4)});
+    lift = w.app(lift, {w.lit_nat(2), w.tuple({F32, F32}), w.lit_nat_1(), F32, w.fn(ROp::mul, w.lit_nat(RMode::none), w.lit_nat(32))});
+    f->app(ret, w.op_store(m, ptr, w.app(lift, {v, v})));
+
+    std::ostringstream simd, scalar;
+    emit_c(w, {}, simd,   Lang::C99, false, true);
+    emit_c(w, {}, scalar, Lang::C99, false, false);
+
+    EXPECT_NE(simd.str().find("vector_size(16)"), std::string::npos);
+    EXPECT_EQ(simd.str().find("for ("), std::string::npos);
+    EXPECT_EQ(scalar.str().find("vector_size"), std::string::npos);
+    EXPECT_NE(scalar.str().find("for ("), std::string::npos);
+}
+
+/// Number of occurrences of @p what in @p str from @p pos on.
+static size_t count(const std::string& str, const std::string& what, size_t pos = 0) {
+    size_t res = 0;
+    for (auto i = str.find(what, pos); i != std::string::npos; i = str.find(what, i + 1)) ++res;
+    return res;
+}
+
+/// The <tt>#pragma HLS</tt> directives at the start of each <tt>for (;;)</tt> in @p c - there must not be any other loop directives.
+static std::vector<std::vector<std::string>> hls_loops(const std::string& c) {
+    std::vector<std::vector<std::string>> res;
+    std::istringstream is(c);
+    bool in_head = false;
+    for (std::string line; std::getline(is, line);) {
+        line.erase(0, line.find_first_not_of(' '));
+        bool pragma = line.rfind("#pragma HLS ", 0) == 0;
+        if (line == "for (;;) {") {
+            res.emplace_back();
+            in_head = true;
+        } else if (pragma && in_head) {
+            res.back().emplace_back(line.substr(12));
+        } else {
+            in_head = false;
+            for (auto directive : {"PIPELINE", "UNROLL", "LOOP_TRIPCOUNT"})
+                EXPECT_FALSE(pragma && line.find(directive) != std::string::npos);
+        }
+    }
+    return res;
+}
+
+// The recurrence on the float accumulator bounds the initiation interval of the pipeline by the latency of the addition.
+TEST(CodeGen, HLSPragmas) {
+    World w;
+    auto M = w.type_mem();
+    auto F32 = w.type_real(32);
+    auto I32 = w.type_int_width(32);
+    auto f = w.nom_lam(w.cn({M, w.type_ptr(w.arr_unsafe(F32)), w.cn({M, F32})}), w.dbg("reduce"));
+    auto [mem, ptr, ret] = f->vars<3>();
+    f->make_external();
+
+    auto head = w.nom_lam(w.cn({M, I32, F32}), w.dbg("head"));
+    auto body = w.nom_lam(w.cn(M), w.dbg("body"));
+    auto exit = w.nom_lam(w.cn(M), w.dbg("exit"));
+    auto [m, i, acc] = head->vars<3>();
+    f->app(head, {mem, w.lit_int_width(32, 0), w.lit_real(32, 0.0)});
+    head->branch(w.op(ICmp::ul, i, w.lit_int_width(32, 100)), body, exit, m);
+    auto [m2, x] = w.op_load(body->var(), w.op_lea_unsafe(ptr, i))->projs<2>();
+    body->app(head, {m2, w.op(Wrap::add, WMode::none, i, w.lit_int_width(32, 1)), w.op(ROp::add, RMode::none, acc, x)});
+    exit->app(ret, {exit->var(), acc});
+
+    Cont2Config config;
+    config.emplace(f, std::make_unique<HLSKernelConfig>(HLSKernelConfig::Var2Size{{ptr, 100}}));
+    std::ostringstream os;
+    emit_c(w, config, os, Lang::HLS, false);
+    auto c = os.str();
+
+    auto loops = hls_loops(c);
+    ASSERT_EQ(loops.size(), size_t(1));
+    EXPECT_EQ(loops[0], (std::vector<std::string>{"PIPELINE II=4", "LOOP_TRIPCOUNT min=100 max=100"}));
+    EXPECT_NE(c.find("[100])"), std::string::npos);
+}
+
+// Nested loops become nested C loops - each with its directives - and the vars of loop blocks remain visible after the loops.
+TEST(CodeGen, HLSLoops) {
+    World w;
+    auto M = w.type_mem();
+    auto F32 = w.type_real(32);
+    auto I32 = w.type_int_width(32);
+    auto f = w.nom_lam(w.cn({M, w.type_ptr(w.arr_unsafe(F32)), w.type_ptr(w.arr_unsafe(F32)), w.cn({M, I32})}), w.dbg("rows"));
+    auto [mem, in, out, ret] = f->vars<4>();
+    f->make_external();
+
+    // for (i = 0; i < 100; ++i) { acc = 0; for (j = 0; j < 4; ++j) acc += in[4*i + j]; out[2*i] = acc; } return 2*i;
+    auto outer = w.nom_lam(w.cn({M, I32}), w.dbg("outer"));
+    auto start = w.nom_lam(w.cn(M), w.dbg("start"));
+    auto inner = w.nom_lam(w.cn({M, I32, F32}), w.dbg("inner"));
+    auto body  = w.nom_lam(w.cn(M), w.dbg("body"));
+    auto latch = w.nom_lam(w.cn(M), w.dbg("latch"));
+    auto exit  = w.nom_lam(w.cn(M), w.dbg("exit"));
+    auto [om, i] = outer->vars<2>();
+    auto [im, j, acc] = inner->vars<3>();
+    auto twice = w.op(Wrap::mul, WMode::none, i, w.lit_int_width(32, 2));
+    f->app(outer, {mem, w.lit_int_width(32, 0)});
+    outer->branch(w.op(ICmp::ul, i, w.lit_int_width(32, 100)), start, exit, om);
+    start->app(inner, {start->var(), w.lit_int_width(32, 0), w.lit_real(32, 0.0)});
+    inner->branch(w.op(ICmp::ul, j, w.lit_int_width(32, 4)), body, latch, im);
+    auto index = w.op(Wrap::add, WMode::none, w.op(Wrap::mul, WMode::none, i, w.lit_int_width(32, 4)), j);
+    auto [bm, x] = w.op_load(body->var(), w.op_lea_unsafe(in, index))->projs<2>();
+    body->app(inner, {bm, w.op(Wrap::add, WMode::none, j, w.lit_int_width(32, 1)), w.op(ROp::add, RMode::none, acc, x)});
+    auto sm = w.op_store(latch->var(), w.op_lea_unsafe(out, twice), acc);
+    latch->app(outer, {sm, w.op(Wrap::add, WMode::none, i, w.lit_int_width(32, 1))});
+    exit->app(ret, {exit->var(), twice});
+
+    Cont2Config config;
+    config.emplace(f, std::make_unique<HLSKernelConfig>(HLSKernelConfig::Var2Size{{in, 400}, {out, 200}}));
+    std::ostringstream os;
+    emit_c(w, config, os, Lang::HLS, false);
+    auto c = os.str();
+
+    auto loops = hls_loops(c);
+    ASSERT_EQ(loops.size(), size_t(2));
+    EXPECT_EQ(loops[0], (std::vector<std::string>{"PIPELINE II=1", "LOOP_TRIPCOUNT min=100 max=100"}));
+    EXPECT_EQ(loops[1], (std::vector<std::string>{"UNROLL"}));
+
+    // the inner loop is nested within the outer one; both are continued instead of jumping back to their labels
+    auto outer_for = c.find("for (;;) {"), inner_for = c.find("for (;;) {", outer_for + 1);
+    EXPECT_LT(c.find("\n        }", inner_for), c.find("\n    }", inner_for));
+    EXPECT_EQ(count(c, "continue;"), size_t(2));
+    EXPECT_EQ(count(c, "goto "), count(c, "goto ", outer_for) + 1); // only the entry jumps to the outer loop
+
+    // the body of the loops only assigns - the prologue declares
+    for (auto type : {"uint32_t ", "float ", "float* ", "bool "}) EXPECT_EQ(c.find(type, outer_for), std::string::npos);
+}
+
+#ifdef LLVM_SUPPORT
+
+// Not a benchmark harness on its own - but the reported throughput of CodeGen::emit in emitted LLVM instructions per second tracks regressions.
+TEST(CodeGen, Throughput) {
+    World w;
+    diamonds(w, 2048);
+
+    CPUCodeGen codegen(w);
+    auto start = std::chrono::steady_clock::now();
+    auto& module = codegen.emit(0, false);
+    std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+
+    size_t num = 0, num_phis = 0;
+    for (const auto& fct : *module) {
+        for (const auto& bb : fct) {
+            num += bb.size();
+            for (const auto& phi : bb.phis()) {
+                // each join has exactly two preds - and one incoming value for each of them
+                EXPECT_EQ(phi.getNumIncomingValues(), size_t(2));
+                EXPECT_EQ(phi.getNumIncomingValues(), size_t(llvm::pred_size(&bb)));
+                ++num_phis;
+            }
+        }
+    }
+
+    EXPECT_FALSE(llvm::verifyModule(*module, &llvm::errs()));
+    EXPECT_GT(num, size_t(5 * 2048));
+    EXPECT_GE(num_phis, size_t(2048));
+    auto per_sec = size_t(num / time.count());
+    RecordProperty("instructions", int(num));
+    RecordProperty("instructions_per_second", int(std::min(per_sec, size_t(INT32_MAX))));
+}
+
+// Small arrays live in vector registers - dynamic indices must not go through stack memory.
+TEST(CodeGen, SmallArrays) {
+    World w;
+    auto M = w.type_mem();
+    auto F32 = w.type_real(32);
+    auto V = w.arr(4, F32);
+    auto f = w.nom_lam(w.cn({M, F32, w.type_ptr(V), w.type_int(4), w.cn({M, F32})}), w.dbg("f"));
+    auto [mem, x, ptr, i, ret] = f->vars<5>();
+    f->make_external();
+
+    auto load = w.op_load(w.op_store(mem, ptr, w.pack(4, x)), ptr);
+    auto vec  = w.insert(w.extract(load, 1), i, w.op(ROp::mul, RMode::none, x, x));
+    auto rev  = w.tuple({w.extract(vec, 3), w.extract(vec, 2), w.extract(vec, 1), w.extract(vec, 0_u64)});
+    auto mem2 = w.op_store(w.extract(load, 0_u64), ptr, rev);
+    f->app(ret, {mem2, w.extract(rev, i)});
+
+    CPUCodeGen codegen(w);
+    auto& module = codegen.emit(0, false);
+    EXPECT_FALSE(llvm::verifyModule(*module, &llvm::errs()));
+
+    size_t num_allocas = 0, num_shuffles = 0;
+    for (auto& inst : llvm::instructions(*module->getFunction("f"))) {
+        num_allocas  += llvm::isa<llvm::AllocaInst>(inst);
+        num_shuffles += llvm::isa<llvm::ShuffleVectorInst>(inst);
+    }
+    EXPECT_EQ(num_allocas, size_t(0));
+    EXPECT_GT(num_shuffles, size_t(1)); // splat and reverse
+}
+
+// Two fresh slots which don't escape are noalias in the callee; accesses of scalars carry a TBAA tag.
+TEST(CodeGen, AliasInfo) {
+    World w;
+    auto M = w.type_mem();
+    auto F32 = w.type_real(32);
+    auto A = w.arr(16, F32);
+    auto g = w.nom_lam(w.cn({M, w.type_ptr(A), w.type_ptr(A), w.cn(M)}), w.dbg("g"));
+    auto [gm, p, q, gret] = g->vars<4>();
+    auto [gm1, x] = w.op_load(gm, w.op_lea_unsafe(p, 0_u64))->projs<2>();
+    g->app(gret, w.op_store(gm1, w.op_lea_unsafe(q, 0_u64), x));
+
+    auto f = w.nom_lam(w.cn({M, w.cn(M)}), w.dbg("f"));
+    auto [fm, fret] = f->vars<2>();
+    f->make_external();
+    auto next = w.nom_lam(w.cn(M), w.dbg("next"));
+    next->app(fret, next->var());
+    auto [m1, a] = w.op_slot(A, fm)->projs<2>();
+    auto [m2, b] = w.op_slot(A, m1)->projs<2>();
+    f->app(g, {m2, a, b, next});
+
+    CPUCodeGen codegen(w);
+    auto& module = codegen.emit(0, false);
+    EXPECT_FALSE(llvm::verifyModule(*module, &llvm::errs()));
+
+    for (auto& fct : *module) {
+        if (!fct.getName().startswith("g_")) continue;
+        for (auto& arg : fct.args()) {
+            EXPECT_TRUE(arg.hasNoAliasAttr());
+            EXPECT_EQ(arg.getDereferenceableBytes(), uint64_t(16 * 4));
+        }
+        for (auto& inst : llvm::instructions(fct)) {
+            if (llvm::isa<llvm::LoadInst>(inst) || llvm::isa<llvm::StoreInst>(inst))
+                EXPECT_NE(inst.getMetadata(llvm::LLVMContext::MD_tbaa), nullptr);
+        }
+    }
+}
+
+// Casting through bytes still accesses a float as an int - both may alias anything; params of externals aren't known to be dereferenceable.
+TEST(CodeGen, AliasInfoPun) {
+    World w;
+    auto M = w.type_mem();
+    auto F32 = w.type_real(32);
+    auto I32 = w.type_int_width(32);
+    auto f = w.nom_lam(w.cn({M, w.type_ptr(F32), w.cn({M, F32, I32})}), w.dbg("f"));
+    auto [mem, p, ret] = f->vars<3>();
+    f->make_external();
+
+    auto q = w.op_bitcast(w.type_ptr(I32), w.op_bitcast(w.type_ptr(w.type_int_width(8)), p));
+    auto [m1, x] = w.op_load(mem, p)->projs<2>();
+    auto [m2, y] = w.op_load(m1, q)->projs<2>();
+    f->app(ret, {m2, x, y});
+
+    CPUCodeGen codegen(w);
+    auto& module = codegen.emit(0, false);
+    EXPECT_FALSE(llvm::verifyModule(*module, &llvm::errs()));
+
+    auto fct = module->getFunction("f");
+    for (auto& arg : fct->args()) EXPECT_EQ(arg.getDereferenceableBytes(), uint64_t(0));
+
+    size_t num_loads = 0;
+    for (auto& inst : llvm::instructions(*fct)) {
+        if (!llvm::isa<llvm::LoadInst>(inst)) continue;
+        ++num_loads;
+        auto tag = inst.getMetadata(llvm::LLVMContext::MD_tbaa);
+        ASSERT_TRUE(tag != nullptr);
+        auto access = llvm::cast<llvm::MDNode>(tag->getOperand(1));
+        EXPECT_EQ(llvm::cast<llvm::MDString>(access->getOperand(0))->getString(), "omnipotent char");
+    }
+    EXPECT_EQ(num_loads, size_t(2));
+}
+
+// Hints on the exit condition of a loop become branch weights and llvm.loop metadata on its latch.
+TEST(CodeGen, Hints) {
+    World w;
+    auto M = w.type_mem();
+    auto I32 = w.type_int_width(32);
+    auto f = w.nom_lam(w.cn({M, I32, w.cn({M, I32})}), w.dbg("f"));
+    auto [mem, n, ret] = f->vars<3>();
+    f->make_external();
+
+    auto head = w.nom_lam(w.cn({M, I32, I32}), w.dbg("head"));
+    auto body = w.nom_lam(w.cn(M), w.dbg("body"));
+    auto exit = w.nom_lam(w.cn(M), w.dbg("exit"));
+    auto [m, i, acc] = head->vars<3>();
+    f->app(head, {mem, w.lit_int_width(32, 0), w.lit_int_width(32, 0)});
+    head->branch(w.op_hint_loop(4, 2, 1, w.op_likely(w.op(ICmp::ul, i, n))), body, exit, m);
+    body->app(head, {body->var(), w.op(Wrap::add, WMode::none, i, w.lit_int_width(32, 1)), w.op(Wrap::add, WMode::none, acc, i)});
+    exit->app(ret, {exit->var(), acc});
+
+    EXPECT_EQ(w.op_likely(w.lit_true()), w.lit_true());
+
+    CPUCodeGen codegen(w);
+    auto& module = codegen.emit(0, false);
+    EXPECT_FALSE(llvm::verifyModule(*module, &llvm::errs()));
+
+    size_t num_prof = 0, num_loop = 0;
+    for (auto& inst : llvm::instructions(*module->getFunction("f"))) {
+        num_prof += inst.getMetadata(llvm::LLVMContext::MD_prof) != nullptr;
+        num_loop += inst.getMetadata(llvm::LLVMContext::MD_loop) != nullptr;
+    }
+    EXPECT_EQ(num_prof, size_t(1));
+    EXPECT_EQ(num_loop, size_t(1));
+}
+
+/// An external @c f which increments each of the @c n elements of the array @c a - a loop for LLVM's loop vectorizer.
+static void inc_loop(World& w) {
+    auto M = w.type_mem();
+    auto I32 = w.type_int_width(32);
+    auto f = w.nom_lam(w.cn({M, w.type_ptr(w.arr_unsafe(I32)), I32, w.cn(M)}), w.dbg("f"));
+    auto [mem, a, n, ret] = f->vars<4>();
+    f->make_external();
+
+    auto head = w.nom_lam(w.cn({M, I32}), w.dbg("head"));
+    auto body = w.nom_lam(w.cn(M), w.dbg("body"));
+    auto exit = w.nom_lam(w.cn(M), w.dbg("exit"));
+    auto [m, i] = head->vars<2>();
+    f->app(head, {mem, w.lit_int_width(32, 0)});
+    head->branch(w.op(ICmp::ul, i, n), body, exit, m);
+    auto ptr = w.op_lea_unsafe(a, i);
+    auto [m1, x] = w.op_load(body->var(), ptr)->projs<2>();
+    body->app(head, {w.op_store(m1, ptr, w.op(Wrap::add, WMode::none, x, w.lit_int_width(32, 1))), w.op(Wrap::add, WMode::none, i, w.lit_int_width(32, 1))});
+    exit->app(ret, exit->var());
+}
+
+// At O2 the loop is vectorized - unless the Pipeline disables this as the GPU backends do.
+TEST(CodeGen, Optimize) {
+    for (bool vectorize : {true, false}) {
+        World w;
+        inc_loop(w);
+        CPUCodeGen codegen(w);
+        codegen.pipeline().vectorize_loops = vectorize;
+        auto& module = codegen.emit(2, false);
+        EXPECT_FALSE(llvm::verifyModule(*module, &llvm::errs()));
+
+        size_t num_vectors = 0;
+        for (auto& inst : llvm::instructions(*module->getFunction("f"))) num_vectors += inst.getType()->isVectorTy();
+        EXPECT_EQ(num_vectors != 0, vectorize);
+    }
+}
+
+// Two slots which are dead before the next one starts share a single alloca - each within lifetime markers.
+TEST(CodeGen, SlotColoring) {
+    World w;
+    auto M = w.type_mem();
+    auto F32 = w.type_real(32);
+    auto A = w.arr(16, F32);
+    auto f = w.nom_lam(w.cn({M, F32, w.cn({M, F32})}), w.dbg("f"));
+    auto [mem, x, ret] = f->vars<3>();
+    f->make_external();
+
+    auto [m1, a] = w.op_slot(A, mem)->projs<2>();
+    auto pa = w.op_lea_unsafe(a, 3_u64);
+    auto [m2, y] = w.op_load(w.op_store(m1, pa, x), pa)->projs<2>();
+    auto [m3, b] = w.op_slot(A, m2)->projs<2>();
+    auto pb = w.op_lea_unsafe(b, 5_u64);
+    auto [m4, z] = w.op_load(w.op_store(m3, pb, y), pb)->projs<2>();
+    f->app(ret, {m4, z});
+
+    CPUCodeGen codegen(w);
+    auto& module = codegen.emit(0, false);
+    EXPECT_FALSE(llvm::verifyModule(*module, &llvm::errs()));
+
+    size_t num_allocas = 0, num_lifetimes = 0;
+    for (auto& inst : llvm::instructions(*module->getFunction("f"))) {
+        num_allocas += llvm::isa<llvm::AllocaInst>(inst);
+        if (auto intrinsic = llvm::dyn_cast<llvm::IntrinsicInst>(&inst))
+            num_lifetimes += intrinsic->isLifetimeStartOrEnd();
+    }
+    EXPECT_EQ(num_allocas, size_t(1));
+    EXPECT_EQ(num_lifetimes, size_t(4));
+}
+
+// Each partition is a valid module on its own: calls into another partition go to hidden declarations and each user of a global defines it.
+TEST(CodeGen, Partitioned) {
+    World w;
+    auto M = w.type_mem();
+    auto I32 = w.type_int_width(32);
+    auto G = w.global(w.lit_int_width(32, 0), true, w.dbg("G"));
+    auto add = [&](const Def* a, const Def* b) { return w.op(Wrap::add, WMode::none, a, b); };
+
+    // g(m, x): G += x * x; return G - the larger scope, so g and f end up in different partitions
+    auto g = w.nom_lam(w.cn({M, I32, w.cn({M, I32})}), w.dbg("g"));
+    auto [gm, x, gret] = g->vars<3>();
+    auto [gm1, old] = w.op_load(gm, G)->projs<2>();
+    auto y = add(old, w.op(Wrap::mul, WMode::none, x, x));
+    g->app(gret, {w.op_store(gm1, G, y), y});
+
+    // f(m, x): return g(m, x) + G
+    auto f = w.nom_lam(w.cn({M, I32, w.cn({M, I32})}), w.dbg("f"));
+    auto [fm, fx, fret] = f->vars<3>();
+    f->make_external();
+    auto k = w.nom_lam(w.cn({M, I32}), w.dbg("k"));
+    f->app(g, {fm, fx, k});
+    auto [km, z] = w.op_load(k->var(0_u64), G)->projs<2>();
+    k->app(fret, {km, add(k->var(1_u64), z)});
+
+    auto codegens = CodeGen::emit_partitioned(w, 2, 0, false, [](World& world) { return std::make_unique<CPUCodeGen>(world); });
+    ASSERT_EQ(codegens.size(), size_t(2));
+
+    const llvm::Module* modules[2] = {codegens[0]->module().get(), codegens[1]->module().get()};
+    for (auto module : modules) EXPECT_FALSE(llvm::verifyModule(*module, &llvm::errs()));
+    if (modules[0]->getFunction("f") == nullptr || modules[0]->getFunction("f")->isDeclaration()) std::swap(modules[0], modules[1]);
+    auto [mf, mg] = modules;
+
+    auto f_def = mf->getFunction("f"), g_decl = mf->getFunction(g->unique_name()), g_def = mg->getFunction(g->unique_name());
+    ASSERT_TRUE(f_def && g_decl && g_def);
+    EXPECT_FALSE(f_def->isDeclaration());
+    EXPECT_EQ(f_def->getLinkage(), llvm::GlobalValue::ExternalLinkage);
+    EXPECT_EQ(f_def->getVisibility(), llvm::GlobalValue::DefaultVisibility);
+    EXPECT_TRUE(g_decl->isDeclaration());
+    EXPECT_EQ(g_decl->getVisibility(), llvm::GlobalValue::HiddenVisibility);
+    EXPECT_FALSE(g_def->isDeclaration());
+    EXPECT_EQ(g_def->getLinkage(), llvm::GlobalValue::ExternalLinkage);
+    EXPECT_EQ(g_def->getVisibility(), llvm::GlobalValue::HiddenVisibility);
+    EXPECT_TRUE(mg->getFunction("f") == nullptr);
+
+    // both partitions access G - the linker merges their definitions
+    for (auto module : modules) {
+        ASSERT_EQ(module->global_size(), size_t(1));
+        const auto& var = *module->global_begin();
+        EXPECT_EQ(var.getName(), modules[0]->global_begin()->getName());
+        EXPECT_TRUE(var.hasInitializer());
+        EXPECT_EQ(var.getLinkage(), llvm::GlobalValue::LinkOnceODRLinkage);
+        EXPECT_EQ(var.getVisibility(), llvm::GlobalValue::HiddenVisibility);
+    }
+}
+
+// Tasks created in a loop each get their own environment on the heap; the runtime runs them once the root has finished.
+TEST(CodeGen, TaskGraph) {
+    World w;
+    auto M = w.type_mem();
+    auto I32 = w.type_int_width(32);
+    auto P = w.type_ptr(w.arr(4, I32));
+    auto Env = w.sigma({P, I32});
+
+    // task(m, (p, i), k): p[i] = i + 1
+    auto task = w.nom_lam(w.cn({M, Env, w.cn(M)}), w.dbg("task"));
+    auto [tm, env, tk] = task->vars<3>();
+    auto [p, i] = env->projs<2>();
+    task->app(tk, w.op_store(tm, w.op_lea_unsafe(p, i), w.op(Wrap::add, WMode::none, i, w.lit_int_width(32, 1))));
+
+    auto f = w.nom_lam(w.cn({M, P, w.cn(M)}), w.dbg("f"));
+    auto [mem, ptr, ret] = f->vars<3>();
+    f->make_external();
+
+    auto [m1, graph] = w.op_graph_create(mem)->projs<2>();
+    auto [m2, root] = w.op_graph_task(m1, graph, task, w.tuple({ptr, w.lit_int_width(32, 0)}))->projs<2>();
+
+    // for (j = 1; j != 4; ++j) graph_edge(root, graph_task((ptr, j)))
+    auto head = w.nom_lam(w.cn({M, I32}), w.dbg("head"));
+    auto body = w.nom_lam(w.cn(M), w.dbg("body"));
+    auto exit = w.nom_lam(w.cn(M), w.dbg("exit"));
+    auto [hm, j] = head->vars<2>();
+    f->app(head, {m2, w.lit_int_width(32, 1)});
+    head->branch(w.op(ICmp::ul, j, w.lit_int_width(32, 4)), body, exit, hm);
+    auto [bm, t] = w.op_graph_task(body->var(), graph, task, w.tuple({ptr, j}))->projs<2>();
+    body->app(head, {w.op_graph_edge(bm, root, t), w.op(Wrap::add, WMode::none, j, w.lit_int_width(32, 1))});
+    exit->app(ret, w.op_graph_exec(exit->var(), graph, root));
+
+    {
+        CPUCodeGen codegen(w);
+        auto& module = codegen.emit(0, false);
+        EXPECT_FALSE(llvm::verifyModule(*module, &llvm::errs()));
+        for (auto& inst : llvm::instructions(*module->getFunction("f"))) EXPECT_FALSE(llvm::isa<llvm::AllocaInst>(inst));
+    }
+
+    JIT jit(0);
+    auto module = jit.add(w);
+    int32_t a[4] = {0, 0, 0, 0};
+    jit.function<void(int32_t*)>(module, "f")(a);
+    for (int k = 0; k != 4; ++k) EXPECT_EQ(a[k], k + 1);
+}
+
+/// An external @c f which increments <tt>a[i]</tt> in iteration @c i of an @c Acc::parallel over @p n iterations - or over its @c nat param if @c nullptr.
+static void par_inc(World& w, const Def* n) {
+    auto M = w.type_mem();
+    auto I32 = w.type_int_width(32);
+    auto f = w.nom_lam(w.cn({M, w.type_nat(), w.type_ptr(w.arr(1000, I32)), w.cn(M)}), w.dbg("f"));
+    auto [mem, num, a, ret] = f->vars<4>();
+    f->make_external();
+    if (n == nullptr) n = num;
+
+    auto body = w.nom_lam(w.cn({M, w.type_int(n), w.cn(M)}), w.dbg("body"));
+    auto [bm, i, bret] = body->vars<3>();
+    auto ptr = w.op_lea_unsafe(a, i);
+    auto [m1, x] = w.op_load(bm, ptr)->projs<2>();
+    body->app(bret, w.op_store(m1, ptr, w.op(Wrap::add, WMode::none, x, w.lit_int_width(32, 1))));
+
+    auto exit = w.nom_lam(w.cn(M), w.dbg("exit"));
+    exit->app(ret, exit->var());
+    f->set_filter(false);
+    f->set_body(w.op(Acc::parallel, n, mem, body, exit));
+}
+
+// The runtime runs each iteration of an Acc::parallel exactly once - in chunks of a grain size which amortizes the scheduling of small kernels.
+TEST(CodeGen, Parallel) {
+    for (bool symbolic : {false, true}) {
+        World w;
+        par_inc(w, symbolic ? nullptr : w.lit_nat(1000));
+
+        {
+            CPUCodeGen codegen(w);
+            auto& module = codegen.emit(0, false);
+            EXPECT_FALSE(llvm::verifyModule(*module, &llvm::errs()));
+            size_t num_calls = 0;
+            for (auto& inst : llvm::instructions(*module->getFunction("f"))) {
+                auto call = llvm::dyn_cast<llvm::CallInst>(&inst);
+                if (call == nullptr || call->getCalledFunction()->getName() != "anydsl_parallel_for_grain") continue;
+                ++num_calls;
+                auto grain = llvm::dyn_cast<llvm::ConstantInt>(call->getArgOperand(3));
+                ASSERT_TRUE(grain);
+                EXPECT_GT(grain->getZExtValue(), 1u);
+            }
+            EXPECT_EQ(num_calls, size_t(1));
+        }
+        EXPECT_TRUE(isa<Tag::Acc>(Acc::parallel, w.lookup("f")->as_nom<Lam>()->body())); // emitting doesn't change the world
+
+        JIT jit(0);
+        auto m = jit.add(w);
+        std::vector<int32_t> a(1000, 0);
+        uint64_t n = symbolic ? 600 : 1000;
+        jit.function<void(uint64_t, int32_t*)>(m, "f")(n, a.data());
+        for (size_t i = 0; i != a.size(); ++i) EXPECT_EQ(a[i], i < n ? 1 : 0);
+    }
+}
+
+/// A host function @p name which launches a kernel on @p acc for 100 threads - each sets its element of the host's array.
+static void launch(World& w, Acc acc, const char* name) {
+    auto M = w.type_mem();
+    auto I32 = w.type_int_width(32);
+    auto f = w.nom_lam(w.cn({M, w.type_ptr(w.arr(100, I32)), w.cn(M)}), w.dbg(name));
+    auto [mem, ptr, ret] = f->vars<3>();
+    f->make_external();
+
+    auto kernel = w.nom_lam(w.cn({M, w.type_int(100), w.cn(M)}), w.dbg("kernel"));
+    auto [km, j, kret] = kernel->vars<3>();
+    kernel->app(kret, w.op_store(km, w.op_lea(ptr, j), w.op(Conv::u2u, I32, j)));
+
+    f->set_filter(false);
+    f->set_body(w.op(acc, w.lit_nat(100), mem, kernel, ret));
+}
+
+// A kernel gets a world of its own and receives the host defs it uses as additional params.
+TEST(CodeGen, BackendsImport) {
+    World w;
+    launch(w, Acc::nvvm, "f");
+    Backends backends(w);
+
+    ASSERT_EQ(backends.kernels.size(), size_t(1));
+    auto kernel = backends.kernels.front();
+    const auto& args = backends.kernel_args[kernel];
+    ASSERT_EQ(args.size(), size_t(1));
+    EXPECT_EQ(args.front(), w.lookup("f")->as_nom<Lam>()->var(1));
+
+    for (size_t i = 0; i != Backends::Num_Backends; ++i) {
+        EXPECT_EQ(bool(backends.codegens[i]), i == Backends::CPU || i == Backends::NVVM);
+        if (i != Backends::CPU) EXPECT_EQ(backends.worlds[i]->empty(), i != Backends::NVVM);
+    }
+
+    auto imported = backends.rewriters[Backends::NVVM].old2new[kernel]->as_nom<Lam>();
+    EXPECT_TRUE(imported->is_external());
+    EXPECT_EQ(imported->num_doms(), kernel->num_doms() + 1);
+    EXPECT_TRUE(isa<Tag::Ptr>(imported->dom(3)));
+}
+
+// The backends are emitted concurrently - each to its own stream and logging via its own Stream.
+// The host launches each kernel via the runtime - by its name in the module of its backend.
+TEST(CodeGen, BackendsEmit) {
+    World w;
+    w.set(std::make_shared<Stream>(std::cerr));
+    launch(w, Acc::nvvm, "f");
+    launch(w, Acc::amdgpu, "g");
+    Backends backends(w);
+    ASSERT_EQ(backends.kernels.size(), size_t(2));
+    for (size_t i = Backends::CUDA; i != Backends::Num_Backends; ++i) EXPECT_NE(&backends.worlds[i]->stream(), &w.stream());
+
+    std::ostringstream cpu, nvvm, amdgpu;
+    std::array<std::ostream*, Backends::Num_Backends> streams = {};
+    streams[Backends::CPU] = &cpu;
+    streams[Backends::NVVM] = &nvvm;
+    streams[Backends::AMDGPU] = &amdgpu;
+    backends.emit(streams, 0, false);
+
+    auto host = cpu.str();
+    for (auto kernel : backends.kernels) {
+        auto stream = backends.rewriters[Backends::NVVM].old2new.contains(kernel) ? &nvvm : &amdgpu;
+        EXPECT_NE(stream->str().find(kernel->unique_name()), std::string::npos);
+        EXPECT_NE(host.find("c\"" + kernel->unique_name() + "\\00\""), std::string::npos);
+    }
+
+    size_t num_launches = 0;
+    for (size_t pos = 0; (pos = host.find("call void @anydsl_launch_kernel(", pos)) != std::string::npos; ++pos) ++num_launches;
+    EXPECT_EQ(num_launches, size_t(2));
+    EXPECT_TRUE(isa<Tag::Acc>(Acc::nvvm, w.lookup("f")->as_nom<Lam>()->body())); // emitting doesn't change the world
+}
+
+// With emulate_gpu, nothing is left for the GPU backends.
+TEST(CodeGen, BackendsEmulateGPU) {
+    World w;
+    launch(w, Acc::nvvm, "f");
+    Backends backends(w, true);
+
+    EXPECT_TRUE(backends.kernels.empty());
+    for (size_t i = 0; i != Backends::Num_Backends; ++i) EXPECT_EQ(bool(backends.codegens[i]), i == Backends::CPU);
+
+    std::ostringstream cpu;
+    std::array<std::ostream*, Backends::Num_Backends> streams = {};
+    streams[Backends::CPU] = &cpu;
+    backends.emit(streams, 0, false);
+    EXPECT_NE(cpu.str().find("define"), std::string::npos);
+}
+
+/// An external @p name which returns its argument times @p factor.
+static void scale(World& w, const char* name, u32 factor) {
+    auto M = w.type_mem();
+    auto I32 = w.type_int_width(32);
+    auto f = w.nom_lam(w.cn({M, I32, w.cn({M, I32})}), w.dbg(name));
+    auto [mem, x, ret] = f->vars<3>();
+    f->make_external();
+    f->app(ret, {mem, w.op(Wrap::mul, WMode::none, x, w.lit_int_width(32, factor))});
+}
+
+// A function is compiled on its first call; asking for a function the world doesn't have fails.
+TEST(JIT, Call) {
+    World w;
+    scale(w, "f", 3);
+    JIT jit;
+    auto m = jit.add(w);
+    auto f = jit.function<int32_t(int32_t)>(m, "f");
+    EXPECT_EQ(f(14), 42);
+    EXPECT_EQ(f(-5), -15);
+    EXPECT_EQ(jit.function<int32_t(int32_t)>(m, "f"), f);
+    EXPECT_THROW(jit.lookup(m, "g"), std::runtime_error);
+}
+
+// Each world gets its own namespace - externals with the same name don't clash.
+TEST(JIT, SameNames) {
+    World w1, w2;
+    scale(w1, "f", 2);
+    scale(w2, "f", 3);
+    JIT jit;
+    auto m1 = jit.add(w1);
+    auto m2 = jit.add(w2);
+    EXPECT_NE(m1, m2);
+
+    auto f1 = jit.function<int32_t(int32_t)>(m1, "f");
+    auto f2 = jit.function<int32_t(int32_t)>(m2, "f");
+    EXPECT_NE(f1, f2);
+    EXPECT_EQ(f1(5), 10);
+    EXPECT_EQ(f2(5), 15);
+}
+
+/// A fresh directory for an @p ObjectCache which is removed again at the end of the test.
+struct CacheDir {
+    CacheDir(const char* name)
+        : path(std::filesystem::temp_directory_path() / name)
+    {
+        std::filesystem::remove_all(path);
+    }
+    ~CacheDir() { std::filesystem::remove_all(path); }
+
+    size_t num_objects() const {
+        size_t res = 0;
+        for (const auto& file : std::filesystem::directory_iterator(path)) res += file.path().extension() == ".o";
+        return res;
+    }
+
+    std::filesystem::path path;
+};
+
+// The second emission of the same module is served from the cache - a different optimization level isn't.
+TEST(ObjectCache, HitMiss) {
+    CacheDir dir("thorin-object-cache-hit-miss");
+    ObjectCache cache(dir.path.string());
+    EXPECT_TRUE(cache.load("0123") == nullptr);
+
+    World w;
+    scale(w, "f", 3);
+    auto emit = [&](int opt) {
+        std::ostringstream os;
+        CPUCodeGen(w).emit_object(os, opt, false, &cache);
+        return os.str();
+    };
+
+    auto object = emit(2);
+    EXPECT_FALSE(object.empty());
+    ASSERT_EQ(dir.num_objects(), size_t(1));
+
+    // the hit doesn't compile again but returns what is in the cache
+    auto path = std::filesystem::directory_iterator(dir.path)->path();
+    std::ofstream(path, std::ios::binary) << "cached";
+    EXPECT_EQ(emit(2), "cached");
+    EXPECT_EQ(dir.num_objects(), size_t(1));
+
+    EXPECT_NE(emit(0), "cached");
+    EXPECT_EQ(dir.num_objects(), size_t(2));
+}
+
+// The key covers the module and the config.
+TEST(ObjectCache, Key) {
+    World w1, w2;
+    scale(w1, "f", 2);
+    scale(w2, "f", 3);
+    CPUCodeGen cg1(w1), cg2(w2);
+    auto& m1 = *cg1.emit(0, false);
+    auto& m2 = *cg2.emit(0, false);
+
+    EXPECT_EQ(ObjectCache::key(m1, "x86_64;O2"), ObjectCache::key(m1, "x86_64;O2"));
+    EXPECT_NE(ObjectCache::key(m1, "x86_64;O2"), ObjectCache::key(m1, "x86_64;O3"));
+    EXPECT_NE(ObjectCache::key(m1, "x86_64;O2"), ObjectCache::key(m2, "x86_64;O2"));
+}
+
+// Beyond its maximal size, the cache evicts the objects which haven't been stored or loaded for the longest time.
+TEST(ObjectCache, Eviction) {
+    CacheDir dir("thorin-object-cache-eviction");
+    ObjectCache cache(dir.path.string(), 10);
+    auto wait = [] { std::this_thread::sleep_for(std::chrono::milliseconds(20)); };
+
+    cache.store("a", "1234");
+    wait();
+    cache.store("b", "1234");
+    wait();
+    EXPECT_TRUE(cache.load("a") != nullptr);
+    wait();
+    EXPECT_EQ(dir.num_objects(), size_t(2));
+
+    cache.store("c", "1234"); // 12 bytes: b is the least recently used
+    EXPECT_EQ(dir.num_objects(), size_t(2));
+    EXPECT_TRUE(cache.load("b") == nullptr);
+    auto a = cache.load("a"), c = cache.load("c");
+    ASSERT_TRUE(a && c);
+    EXPECT_EQ(a->getBuffer().str(), "1234");
+    EXPECT_EQ(c->getBuffer().str(), "1234");
+}
+
+#endif
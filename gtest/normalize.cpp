@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+
+#include "thorin/world.h"
+
+using namespace thorin;
+
+/// <tt>lift (1, n) (n_i, «n_i; T», 1, T, f)</tt> - @p f lifted to @p n_i arrays of @p n @p T%s.
+static const Def* lift(World& w, nat_t n, const Def* T, nat_t n_i, const Def* f) {
+    auto lift = w.app(w.ax_lift(), {w.lit_nat_1(), w.lit_nat(n)});
+    return w.app(lift, {w.lit_nat(n_i), w.tuple(DefArray(n_i, T)), w.lit_nat_1(), T, f});
+}
+
+// A lift over packs is a pack of its function - also for a symbolic shape.
+TEST(Normalize, LiftPack) {
+    World w;
+    auto F32 = w.type_real(32);
+    auto f = w.nom_lam(w.cn({w.type_nat(), F32, F32}), w.dbg("f"));
+    auto [n, a, b] = f->vars<3>();
+    auto add = w.fn(ROp::add, w.lit_nat(RMode::none), w.lit_nat(32));
+
+    auto lit = w.app(lift(w, 4, F32, 2, add), {w.pack(4, a), w.pack(4, b)});
+    EXPECT_EQ(lit, w.pack(4, w.op(ROp::add, RMode::none, a, b)));
+
+    auto sym = w.app(w.app(w.app(w.ax_lift(), {w.lit_nat_1(), n}), {w.lit_nat(2), w.tuple({F32, F32}), w.lit_nat_1(), F32, add}), {w.pack(n, a), w.pack(n, b)});
+    EXPECT_EQ(sym, w.pack(n, w.op(ROp::add, RMode::none, a, b)));
+}
+
+// A lift over tuples with a literal shape is split into its lanes; the operands of commutative ops are ordered.
+TEST(Normalize, LiftTuple) {
+    World w;
+    auto F32 = w.type_real(32);
+    auto V = w.arr(2, F32);
+    auto f = w.nom_lam(w.cn({V, V, F32, F32}), w.dbg("f"));
+    auto [x, y, a, b] = f->vars<4>();
+    auto mul = w.fn(ROp::mul, w.lit_nat(RMode::none), w.lit_nat(32));
+
+    auto split = w.app(lift(w, 2, F32, 2, mul), {w.tuple({a, b}), w.tuple({b, a})});
+    EXPECT_EQ(split, w.tuple({w.op(ROp::mul, RMode::none, a, b), w.op(ROp::mul, RMode::none, b, a)}));
+
+    EXPECT_EQ(w.app(lift(w, 2, F32, 2, mul), {x, y}), w.app(lift(w, 2, F32, 2, mul), {y, x}));
+}
+
+// Fusing lifts needs to know whether the intermediate has other uses - so it's up to LiftFusion and not the normalizer.
+TEST(Normalize, LiftNoFusion) {
+    World w;
+    auto F32 = w.type_real(32);
+    auto V = w.arr(4, F32);
+    auto f = w.nom_lam(w.cn({V, V, V}), w.dbg("f"));
+    auto [x, y, z] = f->vars<3>();
+    auto add = w.fn(ROp::add, w.lit_nat(RMode::none), w.lit_nat(32));
+    auto mul = w.fn(ROp::mul, w.lit_nat(RMode::none), w.lit_nat(32));
+
+    auto prod = w.app(lift(w, 4, F32, 2, mul), {x, y});
+    auto sum  = w.app(lift(w, 4, F32, 2, add), {prod, z});
+    EXPECT_TRUE(isa<Tag::Lift>(sum));
+    EXPECT_EQ(sum, w.app(lift(w, 4, F32, 2, add), {w.app(lift(w, 4, F32, 2, mul), {x, y}), z}));
+}
+
+// Only shifting by at least the width of the type is undefined - also for 64 bits whose modulus is 0.
+TEST(Normalize, Shr) {
+    World w;
+    for (nat_t width : {8, 64}) {
+        auto I = w.type_int_width(width);
+        auto f = w.nom_lam(w.cn(I), w.dbg("f"));
+        auto a = f->var();
+
+        EXPECT_FALSE(w.op(Shr::lshr, a, w.lit_int_width(width, width - 1))->isa<Bot>());
+        EXPECT_TRUE (w.op(Shr::lshr, a, w.lit_int_width(width, width    ))->isa<Bot>());
+    }
+}
@@ -0,0 +1,179 @@
+#include <gtest/gtest.h>
+
+#include "thorin/world.h"
+#include "thorin/pass/pass.h"
+#include "thorin/pass/rw/fma_contract.h"
+#include "thorin/pass/rw/lift_fusion.h"
+#include "thorin/pass/rw/slp.h"
+#include "thorin/pass/rw/tree_height_red.h"
+
+using namespace thorin;
+
+/// All @p Def%s reachable from the body of @p nom which match @p pred - without entering other nominals.
+template<class P>
+static DefVec find_defs(Def* nom, P pred) {
+    DefVec res;
+    DefSet done;
+    std::vector<const Def*> queue(nom->ops().begin(), nom->ops().end());
+    while (!queue.empty()) {
+        auto def = queue.back();
+        queue.pop_back();
+        if (def->isa_nom() || !done.emplace(def).second) continue;
+        if (pred(def)) res.emplace_back(def);
+        for (auto op : def->ops()) queue.emplace_back(op);
+    }
+    return res;
+}
+
+template<class P>
+static void run(World& w) {
+    PassMan man(w);
+    man.add<P>();
+    man.run();
+}
+
+/// <tt>lift (1, n) (n_i, «n_i; T», 1, T, f)</tt> - @p f lifted to @p n_i arrays of @p n @p T%s.
+static const Def* lift(World& w, nat_t n, const Def* T, nat_t n_i, const Def* f) {
+    auto lift = w.app(w.ax_lift(), {w.lit_nat_1(), w.lit_nat(n)});
+    return w.app(lift, {w.lit_nat(n_i), w.tuple(DefArray(n_i, T)), w.lit_nat_1(), T, f});
+}
+
+/// <tt>f (mem, x, y, z, ret) = ret (mem', lift (+) (lift (*) (x, y), z))</tt> where @p keep also stores the product to memory.
+static void mul_add(World& w, bool keep) {
+    auto M = w.type_mem();
+    auto F32 = w.type_real(32);
+    auto V = w.arr(4, F32);
+    auto f = w.nom_lam(w.cn({M, V, V, V, w.type_ptr(V), w.cn({M, V})}), w.dbg("f"));
+    auto [mem, x, y, z, ptr, ret] = f->vars<6>();
+    f->make_external();
+
+    auto prod = w.app(lift(w, 4, F32, 2, w.fn(ROp::mul, w.lit_nat(RMode::none), w.lit_nat(32))), {x, y});
+    auto sum  = w.app(lift(w, 4, F32, 2, w.fn(ROp::add, w.lit_nat(RMode::none), w.lit_nat(32))), {prod, z});
+    f->app(ret, {keep ? w.op_store(mem, ptr, prod) : mem, sum});
+}
+
+// lift (+) (lift (*) (x, y), z) becomes a single lift of a function which multiplies and adds.
+TEST(Pass, LiftFusion) {
+    World w;
+    mul_add(w, false);
+    run<LiftFusion>(w);
+
+    auto lifts = find_defs(w.lookup("f"), [](const Def* def) { return isa<Tag::Lift>(def); });
+    ASSERT_TRUE(lifts.size() == 1);
+    auto fn = isa<Tag::Lift>(lifts.front())->decurry()->arg(4)->isa_nom<Lam>();
+    ASSERT_TRUE(fn != nullptr);
+    EXPECT_TRUE(isa<Tag::ROp>(ROp::add, fn->body()));
+    EXPECT_TRUE(isa_lit(isa<Tag::Lift>(lifts.front())->decurry()->arg(0)) == 3);
+}
+
+// The product is also stored, so fusing would compute it twice.
+TEST(Pass, LiftFusionSharedIntermediate) {
+    World w;
+    mul_add(w, true);
+    run<LiftFusion>(w);
+
+    auto lifts = find_defs(w.lookup("f"), [](const Def* def) { return isa<Tag::Lift>(def); });
+    EXPECT_EQ(lifts.size(), size_t(2));
+}
+
+/// Height of the tree of @p op%s rooted at @p def.
+static int height(ROp op, const Def* def) {
+    auto app = isa<Tag::ROp>(op, def);
+    if (!app) return 0;
+    auto [a, b] = app->args<2>();
+    return 1 + std::max(height(op, a), height(op, b));
+}
+
+/// <tt>f (a, b, c, d, ret) = ret (((a + b) + c) + d)</tt>
+static void sum4(World& w, nat_t mode) {
+    auto F32 = w.type_real(32);
+    auto f = w.nom_lam(w.cn({F32, F32, F32, F32, w.cn(F32)}), w.dbg("f"));
+    auto [a, b, c, d, ret] = f->vars<5>();
+    f->make_external();
+    f->app(ret, w.op(ROp::add, mode, w.op(ROp::add, mode, w.op(ROp::add, mode, a, b), c), d));
+}
+
+TEST(Pass, TreeHeightRed) {
+    World w;
+    sum4(w, RMode::reassoc);
+    run<TreeHeightRed>(w);
+    EXPECT_EQ(height(ROp::add, w.lookup("f")->as<Lam>()->body()->as<App>()->arg()), 2);
+}
+
+// Without RMode::reassoc we must not change the order of the additions.
+TEST(Pass, TreeHeightRedStrict) {
+    World w;
+    sum4(w, RMode::none);
+    run<TreeHeightRed>(w);
+    EXPECT_EQ(height(ROp::add, w.lookup("f")->as<Lam>()->body()->as<App>()->arg()), 3);
+}
+
+/// <tt>f (a, b, c, ret) = ret (a * b + c, x)</tt> where @c x is the product if @p keep and @c c otherwise.
+static void mul_add(World& w, nat_t mode, bool keep) {
+    auto F32 = w.type_real(32);
+    auto f = w.nom_lam(w.cn({F32, F32, F32, w.cn({F32, F32})}), w.dbg("f"));
+    auto [a, b, c, ret] = f->vars<4>();
+    f->make_external();
+    auto prod = w.op(ROp::mul, mode, a, b);
+    w.op(ROp::sub, mode, prod, a); // dead
+    f->app(ret, {w.op(ROp::add, mode, prod, c), keep ? prod : c});
+}
+
+static size_t num_fmas(World& w) {
+    return find_defs(w.lookup("f"), [](const Def* def) { return isa<Tag::FMA>(def); }).size();
+}
+
+// The dead subtraction doesn't count as a use of the product.
+TEST(Pass, FMAContract) {
+    World w;
+    mul_add(w, RMode::contract, false);
+    run<FMAContract>(w);
+    EXPECT_EQ(num_fmas(w), size_t(1));
+}
+
+TEST(Pass, FMAContractStrict) {
+    World w;
+    mul_add(w, RMode::none, false);
+    run<FMAContract>(w);
+    EXPECT_EQ(num_fmas(w), size_t(0));
+}
+
+// The product is also returned, so an fma would compute it twice.
+TEST(Pass, FMAContractSharedProduct) {
+    World w;
+    mul_add(w, RMode::contract, true);
+    run<FMAContract>(w);
+    EXPECT_EQ(num_fmas(w), size_t(0));
+}
+
+/// <tt>f (x, y, c, ret) = ret (x#0 * y#0 + c, ..., x#3 * y#3 + c)</tt> - or with a subtraction in the last lane if not @p isomorphic.
+static void lanes(World& w, bool isomorphic) {
+    auto F32 = w.type_real(32);
+    auto V = w.arr(4, F32);
+    auto f = w.nom_lam(w.cn({V, V, F32, w.cn(V)}), w.dbg("f"));
+    auto [x, y, c, ret] = f->vars<4>();
+    f->make_external();
+    DefArray lanes(4, [&](size_t i) {
+        auto prod = w.op(ROp::mul, RMode::none, w.extract(x, 4, i), w.extract(y, 4, i));
+        return w.op(isomorphic || i != 3 ? ROp::add : ROp::sub, RMode::none, prod, c);
+    });
+    f->app(ret, w.tuple(lanes));
+}
+
+TEST(Pass, SLP) {
+    World w;
+    lanes(w, true);
+    run<SLP>(w);
+    auto res = w.lookup("f")->as<Lam>()->body()->as<App>()->arg();
+    ASSERT_TRUE(isa<Tag::Lift>(res));
+    EXPECT_TRUE(isa<Tag::Lift>(res->as<App>()->arg(2_u64, 0_u64)) || isa<Tag::Lift>(res->as<App>()->arg(2_u64, 1_u64)));
+}
+
+TEST(Pass, SLPNonIsomorphic) {
+    World w;
+    lanes(w, false);
+    run<SLP>(w);
+    auto res = w.lookup("f")->as<Lam>()->body()->as<App>()->arg();
+    EXPECT_TRUE(res->isa<Tuple>());
+    EXPECT_TRUE(find_defs(w.lookup("f"), [](const Def* def) { return isa<Tag::Lift>(def); }).empty());
+}
@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <atomic>
+#include <tuple>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "runtime/runtime.h"
+#include "runtime/thread_pool.h"
+
+using namespace thorin::rt;
+
+/// Runs a @p ThreadPool::parallel_for over <tt>[lower, upper)</tt> and counts how often each index is visited and how many chunks there are - indices outside count as @c -1.
+static std::vector<int> coverage(ThreadPool& pool, int32_t lower, int32_t upper, int32_t grain, int& num_chunks) {
+    std::vector<std::atomic<int>> hits(size_t(std::max(upper - lower, 0)));
+    std::atomic<int> chunks = 0, outside = 0;
+    pool.parallel_for(0, lower, upper, grain, [&](int32_t lo, int32_t hi) {
+        ++chunks;
+        for (auto i = lo; i != hi; ++i) {
+            if (lower <= i && i < upper)
+                ++hits[i - lower];
+            else
+                ++outside;
+        }
+    });
+
+    num_chunks = chunks;
+    std::vector<int> res;
+    for (auto& hit : hits) res.emplace_back(hit.load());
+    for (int i = 0; i != outside; ++i) res.emplace_back(-1);
+    return res;
+}
+
+// Every index is visited exactly once - no matter how the iterations are scheduled and stolen.
+TEST(Runtime, ParallelFor) {
+    for (auto schedule : {Schedule::Static, Schedule::Dynamic, Schedule::Guided}) {
+        ThreadPool pool(Config{4, schedule, 0, false});
+        int num_chunks;
+
+        for (auto [lower, upper, grain] : {std::tuple(-37, 10000, 7), std::tuple(0, 100000, 1), std::tuple(3, 5, 64), std::tuple(0, 1, 1)}) {
+            auto hits = coverage(pool, lower, upper, grain, num_chunks);
+            for (auto hit : hits) EXPECT_EQ(hit, 1);
+            if (schedule == Schedule::Static) {
+                EXPECT_LE(num_chunks, 4); // one contiguous subrange per thread
+            }
+        }
+
+        auto hits = coverage(pool, 5, 5, 1, num_chunks);
+        EXPECT_TRUE(hits.empty());
+        EXPECT_EQ(num_chunks, 0);
+    }
+}
+
+static void increment(void* args) { ++*static_cast<std::atomic<int>*>(args); }
+
+/// Spawns a thread which increments @p args and waits for it - the waiting happens within a worker of the pool.
+static void nested(void* args) { anydsl_sync_thread(anydsl_spawn_thread(args, reinterpret_cast<void*>(increment))); }
+
+// Each spawned thread has finished once it's synced - also if spawning and syncing happens on a worker.
+TEST(Runtime, SpawnSync) {
+    std::vector<std::atomic<int>> counters(64);
+    std::vector<int32_t> ids;
+    for (size_t i = 0; i != counters.size(); ++i)
+        ids.emplace_back(anydsl_spawn_thread(&counters[i], reinterpret_cast<void*>(i % 2 == 0 ? increment : nested)));
+
+    for (auto id : ids) anydsl_sync_thread(id);
+    for (auto& counter : counters) EXPECT_EQ(counter.load(), 1);
+}
+
+/// A task which counts its runs and notes when it has finished last.
+struct Record {
+    static void run(uint64_t payload) {
+        auto record = reinterpret_cast<Record*>(payload);
+        record->finished = (*record->clock)++;
+        ++record->runs;
+    }
+
+    Closure closure() { return {run, reinterpret_cast<uint64_t>(this)}; }
+
+    std::atomic<int>* clock;
+    int finished = -1;
+    std::atomic<int> runs = 0;
+};
+
+// Each task of a diamond - and of a wide fan-out and fan-in - runs after its preds; a graph may be executed again.
+TEST(Runtime, TaskGraphs) {
+    std::atomic<int> clock = 0;
+    std::vector<Record> records(104);
+    for (auto& record : records) record.clock = &clock;
+    auto &a = records[0], &b = records[1], &c = records[2], &d = records[3];
+
+    auto graph = anydsl_create_graph();
+    std::vector<int32_t> tasks;
+    for (auto& record : records) tasks.emplace_back(anydsl_create_task(graph, record.closure()));
+    anydsl_create_edge(tasks[0], tasks[1]);
+    anydsl_create_edge(tasks[0], tasks[2]);
+    anydsl_create_edge(tasks[1], tasks[3]);
+    anydsl_create_edge(tasks[2], tasks[3]);
+    for (size_t i = 4; i != records.size(); ++i) {
+        anydsl_create_edge(tasks[3], tasks[i]);
+        if (i != 4) anydsl_create_edge(tasks[i], tasks[4]);
+    }
+
+    for (int runs = 1; runs != 3; ++runs) {
+        anydsl_execute_graph(graph, tasks[0]);
+        for (auto& record : records) EXPECT_EQ(record.runs.load(), runs);
+        EXPECT_LT(a.finished, b.finished);
+        EXPECT_LT(a.finished, c.finished);
+        EXPECT_LT(b.finished, d.finished);
+        EXPECT_LT(c.finished, d.finished);
+        for (size_t i = 5; i != records.size(); ++i) {
+            EXPECT_LT(d.finished, records[i].finished);
+            EXPECT_LT(records[i].finished, records[4].finished);
+        }
+    }
+}
+
+// Only the tasks reachable from the root run - and they don't wait for preds which aren't.
+TEST(Runtime, TaskGraphsUnreachable) {
+    std::atomic<int> clock = 0;
+    std::vector<Record> records(5);
+    for (auto& record : records) record.clock = &clock;
+
+    // a -> b -> d <- c <- x
+    auto graph = anydsl_create_graph();
+    std::vector<int32_t> tasks;
+    for (auto& record : records) tasks.emplace_back(anydsl_create_task(graph, record.closure()));
+    auto [a, b, c, d, x] = std::tuple(tasks[0], tasks[1], tasks[2], tasks[3], tasks[4]);
+    anydsl_create_edge(a, b);
+    anydsl_create_edge(b, d);
+    anydsl_create_edge(c, d);
+    anydsl_create_edge(x, c);
+
+    anydsl_execute_graph(graph, a);
+    EXPECT_EQ(records[0].runs.load(), 1);
+    EXPECT_EQ(records[1].runs.load(), 1);
+    EXPECT_EQ(records[2].runs.load(), 0);
+    EXPECT_EQ(records[3].runs.load(), 1);
+    EXPECT_EQ(records[4].runs.load(), 0);
+
+    anydsl_execute_graph(graph, x);
+    EXPECT_EQ(records[0].runs.load(), 1);
+    EXPECT_EQ(records[1].runs.load(), 1);
+    EXPECT_EQ(records[2].runs.load(), 1);
+    EXPECT_EQ(records[3].runs.load(), 2);
+    EXPECT_EQ(records[4].runs.load(), 1);
+    EXPECT_LT(records[2].finished, records[3].finished);
+}
@@ -0,0 +1,538 @@
+#include <gtest/gtest.h>
+
+#include "thorin/world.h"
+#include "thorin/analyses/scope.h"
+#include "thorin/pass/pass.h"
+#include "thorin/pass/rw/ret_wrap.h"
+#include "thorin/transform/aos2soa.h"
+#include "thorin/transform/cleanup_world.h"
+#include "thorin/transform/grid_emulation.h"
+#include "thorin/transform/loop_fusion.h"
+#include "thorin/transform/parallel_reduction.h"
+#include "thorin/transform/strength_reduction.h"
+#include "thorin/transform/vectorize.h"
+#ifdef LLVM_SUPPORT
+#include "thorin/be/llvm/jit.h"
+#endif
+
+using namespace thorin;
+
+/// All @p Def%s reachable from the body of @p nom which match @p pred - without entering other nominals.
+template<class P>
+static DefVec find_defs(Def* nom, P pred) {
+    DefVec res;
+    DefSet done;
+    std::vector<const Def*> queue(nom->ops().begin(), nom->ops().end());
+    while (!queue.empty()) {
+        auto def = queue.back();
+        queue.pop_back();
+        if (def->isa_nom() || !done.emplace(def).second) continue;
+        if (pred(def)) res.emplace_back(def);
+        for (auto op : def->ops()) queue.emplace_back(op);
+    }
+    return res;
+}
+
+// In the internal g, i * 3 within the loop becomes a loop-carried var while i * 5 after the loop gets the closed form n * 5.
+TEST(Transform, StrengthReduction) {
+    World w;
+    auto M = w.type_mem();
+    auto I32 = w.type_int_width(32);
+    auto P = w.type_ptr(w.arr_unsafe(I32));
+    auto g = w.nom_lam(w.cn({M, P, I32, w.cn({M, I32})}), w.dbg("g"));
+    auto [mem, ptr, n, ret] = g->vars<4>();
+
+    auto head = w.nom_lam(w.cn({M, I32}), w.dbg("head"));
+    auto body = w.nom_lam(w.cn(M), w.dbg("body"));
+    auto exit = w.nom_lam(w.cn(M), w.dbg("exit"));
+    auto [m, i] = head->vars<2>();
+    g->app(head, {mem, w.lit_int_width(32, 0)});
+    head->branch(w.op(ICmp::ul, i, n), body, exit, m);
+    auto i3 = w.op(Wrap::mul, WMode::none, i, w.lit_int_width(32, 3));
+    body->app(head, {w.op_store(body->var(), w.op_lea_unsafe(ptr, i), i3), w.op(Wrap::add, WMode::none, i, w.lit_int_width(32, 1))});
+    exit->app(ret, {exit->var(), w.op(Wrap::mul, WMode::none, i, w.lit_int_width(32, 5))});
+
+    auto f = w.nom_lam(g->type(), w.dbg("f"));
+    f->make_external();
+    f->app(g, f->var());
+
+    EXPECT_TRUE(strength_reduction(w));
+
+    auto new_head = g->body()->as<App>()->callee()->as_nom<Lam>();
+    ASSERT_TRUE(new_head != head);
+    EXPECT_EQ(new_head->num_vars(), size_t(3)); // mem, i and i * 3 - but nothing for i * 5
+    EXPECT_TRUE(isa_lit(g->body()->as<App>()->arg(3, 2)) == 0);
+
+    auto muls = [&](Def* nom) { return find_defs(nom, [](const Def* def) { return isa<Tag::Wrap>(Wrap::mul, def); }); };
+    auto targets = new_head->body()->as<App>()->callee()->as<Extract>()->tuple();
+    auto new_exit = targets->op(0)->as_nom<Lam>(), new_body = targets->op(1)->as_nom<Lam>();
+    EXPECT_TRUE(muls(new_body).empty());
+    auto closed = muls(new_exit);
+    ASSERT_TRUE(closed.size() == 1);
+    auto [a, b] = closed.front()->as<App>()->args<2>();
+    EXPECT_TRUE(a == n || b == n);
+}
+
+/**
+ * Two loops over <tt>i < 16</tt> in @c f(mem, out, ret):
+ * With @p carried, the first one sums up @c i and the second one stores the sum to each @c out[j];
+ * otherwise, the first one stores @c i*i to a local array @c tmp and the second one stores <tt>tmp[j] + 1</tt> to @c out[j].
+ * If @p internal, the loops are in an internal @c g which the external @c f calls.
+ */
+static void producer_consumer(World& w, bool carried, bool internal = false) {
+    auto M = w.type_mem();
+    auto I32 = w.type_int_width(32);
+    auto P = w.type_ptr(w.arr_unsafe(I32));
+    auto f = w.nom_lam(w.cn({M, P, w.cn(M)}), w.dbg(internal ? "g" : "f"));
+    auto [mem, out, ret] = f->vars<3>();
+    if (internal) {
+        auto caller = w.nom_lam(f->type(), w.dbg("f"));
+        auto back = w.nom_lam(w.cn(M), w.dbg("back"));
+        auto [cm, cout, cret] = caller->vars<3>();
+        caller->make_external();
+        caller->app(f, {cm, cout, back});
+        back->app(cret, back->var());
+    } else {
+        f->make_external();
+    }
+    auto lit = [&](u64 i) { return w.lit_int_width(32, i); };
+    auto inc = [&](const Def* i) { return w.op(Wrap::add, WMode::none, i, lit(1)); };
+
+    auto head1 = w.nom_lam(w.cn({M, I32, I32}), w.dbg("head1"));
+    auto body1 = w.nom_lam(w.cn(M), w.dbg("body1"));
+    auto exit1 = w.nom_lam(w.cn(M), w.dbg("exit1"));
+    auto head2 = w.nom_lam(w.cn({M, I32}), w.dbg("head2"));
+    auto body2 = w.nom_lam(w.cn(M), w.dbg("body2"));
+    auto exit2 = w.nom_lam(w.cn(M), w.dbg("exit2"));
+    auto [m1, i, sum] = head1->vars<3>();
+    auto [m2, j] = head2->vars<2>();
+
+    head1->branch(w.op(ICmp::ul, i, lit(16)), body1, exit1, m1);
+    exit1->app(head2, {exit1->var(), lit(0)});
+    head2->branch(w.op(ICmp::ul, j, lit(16)), body2, exit2, m2);
+    exit2->app(ret, exit2->var());
+
+    if (carried) {
+        f->app(head1, {mem, lit(0), lit(0)});
+        body1->app(head1, {body1->var(), inc(i), w.op(Wrap::add, WMode::none, sum, i)});
+        body2->app(head2, {w.op_store(body2->var(), w.op_lea_unsafe(out, j), sum), inc(j)});
+    } else {
+        auto [m, tmp] = w.op_slot(w.arr(16, I32), mem)->projs<2>();
+        f->app(head1, {m, lit(0), lit(0)});
+        body1->app(head1, {w.op_store(body1->var(), w.op_lea_unsafe(tmp, i), w.op(Wrap::mul, WMode::none, i, i)), inc(i), sum});
+        auto [m3, x] = w.op_load(body2->var(), w.op_lea_unsafe(tmp, j))->projs<2>();
+        body2->app(head2, {w.op_store(m3, w.op_lea_unsafe(out, j), inc(x)), inc(j)});
+    }
+}
+
+// The intermediate array is contracted to the stored scalar - also in an internal function.
+TEST(Transform, LoopFusion) {
+    for (bool internal : {false, true}) {
+        World w;
+        producer_consumer(w, false, internal);
+        EXPECT_TRUE(loop_fusion(w));
+    }
+}
+
+// The consumer needs the final sum - fusing would hand it the partial sum of the current iteration.
+TEST(Transform, LoopFusionLoopCarried) {
+    World w;
+    producer_consumer(w, true);
+    EXPECT_FALSE(loop_fusion(w));
+}
+
+#ifdef LLVM_SUPPORT
+// Both loops compute the same out[] whether fused or not.
+TEST(Transform, LoopFusionResult) {
+    for (auto [carried, internal] : {std::pair(false, false), std::pair(true, false), std::pair(false, true)}) {
+        World w1, w2;
+        producer_consumer(w1, carried, internal);
+        producer_consumer(w2, carried, internal);
+        loop_fusion(w2);
+
+        JIT jit(0);
+        auto m1 = jit.add(w1);
+        auto m2 = jit.add(w2);
+        int32_t out1[16], out2[16];
+        jit.function<void(int32_t*)>(m1, "f")(out1);
+        jit.function<void(int32_t*)>(m2, "f")(out2);
+        for (int i = 0; i != 16; ++i) EXPECT_EQ(out1[i], out2[i]);
+        EXPECT_EQ(out1[15], carried ? 120 : 15 * 15 + 1);
+    }
+}
+#endif
+
+/**
+ * @c vecotrize over the @p n elements of an array of @p T: each one is incremented - or, if @p guarded, the ones less than 10 are set to 0.
+ * The latter stores within a block which only some lanes take.
+ */
+static void vec_loop(World& w, nat_t n, const Def* T, bool guarded) {
+    auto M = w.type_mem();
+    auto P = w.type_ptr(w.arr(n, T));
+    auto f = w.nom_lam(w.cn({M, P, w.cn(M)}), w.dbg("f"));
+    auto [mem, ptr, ret] = f->vars<3>();
+    f->make_external();
+
+    auto body = w.nom_lam(w.cn({M, w.type_int(n), w.cn(M)}), w.dbg("body"));
+    auto [bm, i, bret] = body->vars<3>();
+    auto p = w.op_lea(ptr, i);
+    auto [m1, x] = w.op_load(bm, p)->projs<2>();
+    if (guarded) {
+        auto t    = w.nom_lam(w.cn(M), w.dbg("t"));
+        auto e    = w.nom_lam(w.cn(M), w.dbg("e"));
+        auto join = w.nom_lam(w.cn(M), w.dbg("join"));
+        body->branch(w.op(ICmp::ul, x, w.lit_int(T, 10)), t, e, m1);
+        t->app(join, w.op_store(t->var(), p, w.lit_int(T, 0)));
+        e->app(join, e->var());
+        join->app(bret, join->var());
+    } else {
+        body->app(bret, w.op_store(m1, p, w.op(Wrap::add, WMode::none, x, w.lit_int(T, 1))));
+    }
+
+    f->set_filter(false);
+    f->set_body(w.op(Acc::vecotrize, w.lit_nat(n), mem, body, ret));
+}
+
+/// All stores of @p w - collected first as looking at their args may create new defs.
+static std::vector<const App*> all_stores(World& w) {
+    std::vector<const App*> res;
+    for (auto def : w.defs()) {
+        if (auto store = isa<Tag::Store>(def)) res.emplace_back(store);
+    }
+    return res;
+}
+
+/// The number of lanes of each store to an array.
+static std::vector<nat_t> vector_stores(World& w) {
+    std::vector<nat_t> res;
+    for (auto store : all_stores(w)) {
+        if (auto arr = as<Tag::Ptr>(store->arg(1)->type())->arg(0)->isa<Arr>()) res.emplace_back(as_lit(arr->shape()));
+    }
+    return res;
+}
+
+// 256 bits of 24-bit ints would be 10 lanes - but the vector loop ends at N & ~(lanes - 1) which needs a power of two.
+TEST(Transform, VectorizeLanes) {
+    World w;
+    vec_loop(w, 100, w.type_int_width(24), false);
+    EXPECT_TRUE(vectorize(w));
+
+    auto stores = vector_stores(w);
+    ASSERT_EQ(stores.size(), size_t(1));
+    EXPECT_EQ(stores[0], nat_t(8));
+}
+
+// The inactive lanes of a guarded store write back what they have loaded.
+TEST(Transform, VectorizeMasked) {
+    World w;
+    vec_loop(w, 64, w.type_int_width(32), true);
+    EXPECT_TRUE(vectorize(w));
+
+    auto stores = vector_stores(w);
+    ASSERT_EQ(stores.size(), size_t(1));
+    EXPECT_EQ(stores[0], nat_t(8));
+
+    size_t num_blends = 0;
+    for (auto store : all_stores(w)) {
+        if (store->arg(2)->type()->isa<Arr>()) num_blends += isa<Tag::Lift>(store->arg(2)) != nullptr;
+    }
+    EXPECT_EQ(num_blends, size_t(1));
+}
+
+#ifdef LLVM_SUPPORT
+// Without a multiple of the lanes, the scalar loop handles the remaining elements - guarded or not.
+TEST(Transform, VectorizeRemainder) {
+    for (bool guarded : {false, true}) {
+        World w;
+        vec_loop(w, 21, w.type_int_width(32), guarded);
+        EXPECT_TRUE(vectorize(w));
+        // as in optimize - the backend expects a cleaned-up world with wrapped return continuations
+        cleanup_world(w);
+        PassMan man(w);
+        man.add<RetWrap>();
+        man.run();
+
+        JIT jit(0);
+        auto m = jit.add(w);
+        int32_t a[21];
+        for (int i = 0; i != 21; ++i) a[i] = i;
+        jit.function<void(int32_t*)>(m, "f")(a);
+        for (int i = 0; i != 21; ++i) EXPECT_EQ(a[i], guarded ? (i < 10 ? 0 : i) : i + 1);
+    }
+}
+#endif
+
+/// An @c Acc::cuda launch of @p n threads - or of the @c nat param of @c f if @c nullptr - of which thread @c j sets <tt>p[j] = j</tt>.
+static void grid(World& w, const Def* n) {
+    auto M = w.type_mem();
+    auto I32 = w.type_int_width(32);
+    auto f = w.nom_lam(w.cn({M, w.type_nat(), w.type_ptr(w.arr(1000, I32)), w.cn(M)}), w.dbg("f"));
+    auto [mem, num, ptr, ret] = f->vars<4>();
+    f->make_external();
+    if (n == nullptr) n = num;
+
+    auto kernel = w.nom_lam(w.cn({M, w.type_int(n), w.cn(M)}), w.dbg("kernel"));
+    auto [km, j, kret] = kernel->vars<3>();
+    kernel->app(kret, w.op_store(km, w.op_lea_unsafe(ptr, j), w.op(Conv::u2u, I32, j)));
+
+    f->set_filter(false);
+    f->set_body(w.op(Acc::cuda, n, mem, kernel, ret));
+}
+
+// A launch of a single block becomes a sequential loop over its threads - larger ones run their blocks in an Acc::parallel.
+TEST(Transform, GridEmulation) {
+    for (nat_t n : {100, 1000, 0}) {
+        World w;
+        grid(w, n == 0 ? nullptr : w.lit_nat(n));
+        EXPECT_TRUE(emulate_grid(w));
+        EXPECT_FALSE(emulate_grid(w));
+
+        auto f = w.lookup("f")->as_nom<Lam>();
+        EXPECT_FALSE(isa<Tag::Acc>(Acc::cuda, f->body()));
+        if (n == 100) {
+            EXPECT_TRUE(f->body()->as<App>()->callee()->isa_nom<Lam>());
+        } else {
+            auto par = isa<Tag::Acc>(Acc::parallel, f->body());
+            ASSERT_TRUE(par);
+            auto blocks = isa_lit(par->decurry()->arg());
+            EXPECT_EQ(blocks.has_value(), n != 0);
+            if (blocks) EXPECT_EQ(*blocks, nat_t(4));
+        }
+    }
+}
+
+#ifdef LLVM_SUPPORT
+// Each thread of the emulated launch runs exactly once.
+TEST(Transform, GridEmulationResult) {
+    for (nat_t n : {100, 1000, 0}) {
+        World w;
+        grid(w, n == 0 ? nullptr : w.lit_nat(n));
+        EXPECT_TRUE(emulate_grid(w));
+        cleanup_world(w);
+        PassMan man(w);
+        man.add<RetWrap>();
+        man.run();
+
+        JIT jit(0);
+        auto m = jit.add(w);
+        std::vector<int32_t> a(1000, -1);
+        uint64_t num = n == 0 ? 700 : n;
+        jit.function<void(uint64_t, int32_t*)>(m, "f")(num, a.data());
+        for (size_t i = 0; i != a.size(); ++i) EXPECT_EQ(a[i], i < num ? int32_t(i) : -1);
+    }
+}
+#endif
+
+/// Further accesses of the accumulator - or of its updated value - within the body of @p par_sum.
+enum class Extra { None, Load, Store, Escape, Partial };
+
+/**
+ * An @c Acc::parallel over @p n iterations - or over the @c nat param of @c f if @c nullptr - which sums up the iterations in <tt>*p</tt>.
+ * Each iteration additionally accesses the accumulator as given by @p extra.
+ */
+static void par_sum(World& w, const Def* n, Extra extra) {
+    auto M = w.type_mem();
+    auto I32 = w.type_int_width(32);
+    auto P = w.type_ptr(I32);
+    auto f = w.nom_lam(w.cn({M, w.type_nat(), P, w.cn({M, I32})}), w.dbg("f"));
+    auto [mem, num, out, ret] = f->vars<4>();
+    f->make_external();
+    if (n == nullptr) n = num;
+
+    auto [m, p] = w.op_slot(I32, mem, w.dbg("p"))->projs<2>();
+    m = w.op_store(m, p, w.lit_int_width(32, 0));
+
+    auto body = w.nom_lam(w.cn({M, w.type_int(n), w.cn(M)}), w.dbg("body"));
+    auto [bm, i, bret] = body->vars<3>();
+    auto [m1, x] = w.op_load(bm, p)->projs<2>();
+    auto y = w.op(Wrap::add, WMode::none, x, w.op(Conv::u2u, I32, i));
+    m1 = w.op_store(m1, p, y);
+    switch (extra) {
+        case Extra::None: break;
+        case Extra::Load:    m1 = w.op_store(m1, out, w.op_load(m1, p)->proj(2_u64, 1_u64)); break;
+        case Extra::Store:   m1 = w.op_store(m1, p, w.lit_int_width(32, 1)); break;
+        case Extra::Escape:  m1 = w.op_store(m1, out, x); break;
+        case Extra::Partial: m1 = w.op_store(m1, out, y); break;
+    }
+    body->app(bret, m1);
+
+    auto exit = w.nom_lam(w.cn(M), w.dbg("exit"));
+    auto [em, sum] = w.op_load(exit->var(), p)->projs<2>();
+    exit->app(ret, {em, sum});
+
+    f->set_filter(false);
+    f->set_body(w.op(Acc::parallel, n, m, body, exit));
+}
+
+/// The parallel loop of @c f in @p w and the accumulator @c p.
+static auto par_of(World& w) {
+    auto f = w.lookup("f")->as_nom<Lam>();
+    auto par = isa<Tag::Acc>(Acc::parallel, f->body());
+    auto p = find_defs(f, [](const Def* def) { return isa<Tag::Slot>(def) && !as<Tag::Slot>(def)->decurry()->arg(0)->isa<Arr>(); });
+    EXPECT_EQ(p.size(), size_t(1));
+    return std::pair(par, p.front()->proj(2_u64, 1_u64));
+}
+
+// Each of the (at most 64) blocks accumulates into its own partial result - which the continuation folds into *p.
+TEST(Transform, ParallelReduction) {
+    for (auto [n, blocks] : {std::pair<nat_t, nat_t>(10, 10), std::pair<nat_t, nat_t>(64, 64), std::pair<nat_t, nat_t>(1000, 64), std::pair<nat_t, nat_t>(0, 64)}) {
+        World w;
+        par_sum(w, n == 0 ? nullptr : w.lit_nat(n), Extra::None); // 0: symbolic
+        EXPECT_TRUE(parallel_reduction(w));
+
+        auto [par, p] = par_of(w);
+        ASSERT_TRUE(par);
+        EXPECT_EQ(par->decurry()->arg(), w.lit_nat(blocks));
+        auto [mem, block, combine] = par->args<3>();
+
+        // the partial results live in the caller's frame
+        auto partials = find_defs(w.lookup("f")->as_nom<Lam>(), [](const Def* def) { return isa<Tag::Slot>(def); });
+        ASSERT_EQ(partials.size(), size_t(2));
+        auto arr = as<Tag::Slot>(partials[0] == p->op(0) ? partials[1] : partials[0])->decurry()->arg(0)->isa<Arr>();
+        ASSERT_TRUE(arr);
+        EXPECT_EQ(arr->shape(), w.lit_nat(blocks));
+
+        // a block initializes its partial result and updates it in each iteration - it doesn't touch *p
+        size_t num_stores = 0;
+        Scope scope(block->as_nom<Lam>());
+        for (auto def : scope.bound()) {
+            if (auto store = isa<Tag::Store>(def)) {
+                ++num_stores;
+                EXPECT_NE(store->arg(1), p);
+                EXPECT_TRUE(isa<Tag::LEA>(store->arg(1)));
+            }
+            if (auto load = isa<Tag::Load>(def)) {
+                EXPECT_NE(load->arg(1), p);
+            }
+        }
+        EXPECT_EQ(num_stores, size_t(2));
+
+        // the continuation loads each partial result and *p - and stores *p once besides the initialization in f
+        auto is_store = [](const Def* def) { return isa<Tag::Store>(def); };
+        auto combine_lam = combine->as_nom<Lam>();
+        auto loads  = find_defs(combine_lam, [](const Def* def) { return isa<Tag::Load>(def); });
+        auto stores = find_defs(combine_lam, is_store);
+        auto init   = find_defs(w.lookup("f")->as_nom<Lam>(), is_store);
+        ASSERT_EQ(init.size(), size_t(1));
+        EXPECT_EQ(loads.size(), size_t(blocks + 1));
+        ASSERT_EQ(stores.size(), size_t(2));
+        auto store = stores[stores[0] == init[0] ? 1 : 0]->as<App>();
+        EXPECT_EQ(store->arg(1), p);
+        EXPECT_TRUE(isa<Tag::Wrap>(Wrap::add, store->arg(2)));
+        EXPECT_FALSE(parallel_reduction(w)); // the blocks don't reduce anymore
+    }
+}
+
+// Another load or store of the accumulator within an iteration - or another use of the loaded value - prevents the transformation.
+TEST(Transform, ParallelReductionRejected) {
+    for (auto extra : {Extra::Load, Extra::Store, Extra::Escape, Extra::Partial}) {
+        World w;
+        par_sum(w, w.lit_nat(100), extra);
+        EXPECT_FALSE(parallel_reduction(w));
+
+        auto [par, p] = par_of(w);
+        ASSERT_TRUE(par);
+        EXPECT_EQ(par->decurry()->arg(), w.lit_nat(100));
+        EXPECT_EQ(par->arg(1)->as_nom<Lam>()->name(), "body");
+    }
+}
+
+/**
+ * A local <tt>«16; [I32, I32]»</tt> whose element 3 is stored and loaded as a whole and whose field 5.1 is accessed individually - @c f returns the sum.
+ * If @p escape, the array is also accessed via a bitcast of its pointer.
+ * If @p internal, this is an internal @c g which the external @c f calls.
+ * Returns the function with the array.
+ */
+static Lam* aos(World& w, bool escape, bool internal = false) {
+    auto M = w.type_mem();
+    auto I32 = w.type_int_width(32);
+    auto f = w.nom_lam(w.cn({M, I32, w.cn({M, I32})}), w.dbg(internal ? "g" : "f"));
+    auto [mem, x, ret] = f->vars<3>();
+    if (internal) {
+        auto caller = w.nom_lam(f->type(), w.dbg("f"));
+        auto back = w.nom_lam(w.cn({M, I32}), w.dbg("back"));
+        auto [cm, cx, cret] = caller->vars<3>();
+        caller->make_external();
+        caller->app(f, {cm, cx, back});
+        back->app(cret, back->var());
+    } else {
+        f->make_external();
+    }
+
+    auto add = [&](const Def* a, const Def* b) { return w.op(Wrap::add, WMode::none, a, b); };
+    auto [m, p] = w.op_slot(w.arr(16, w.sigma({I32, I32})), mem, w.dbg("aos"))->projs<2>();
+    auto elem3 = w.op_lea(p, w.lit_int(16_u64, 3));
+    auto field = w.op_lea(w.op_lea(p, w.lit_int(16_u64, 5)), w.lit_int(2_u64, 1));
+    m = w.op_store(m, elem3, w.tuple({x, add(x, w.lit_int_width(32, 1))}));
+    m = w.op_store(m, field, w.lit_int_width(32, 7));
+    auto [m1, v] = w.op_load(m, elem3)->projs<2>();
+    auto [m2, y] = w.op_load(m1, field)->projs<2>();
+    auto sum = add(add(w.extract(v, 2_u64, 0_u64), w.extract(v, 2_u64, 1_u64)), y);
+    if (escape) {
+        auto [m3, z] = w.op_load(m2, w.op_bitcast(w.type_ptr(I32), p))->projs<2>();
+        m2 = m3;
+        sum = add(sum, z);
+    }
+    f->app(ret, {m2, sum});
+    return f;
+}
+
+/// The types of all @c slot%s of @p f.
+static DefVec slot_types(Lam* f) {
+    DefVec res;
+    for (auto slot : find_defs(f, [](const Def* def) { return isa<Tag::Slot>(def); }))
+        res.emplace_back(as<Tag::Slot>(slot)->decurry()->arg(0));
+    return res;
+}
+
+// An array of structures becomes one array per field - unless its pointer escapes.
+TEST(Transform, AoS2SoA) {
+    World w;
+    auto f = aos(w, false);
+    EXPECT_EQ(aos2soa(w), size_t(1));
+    auto types = slot_types(f);
+    auto I32 = w.type_int_width(32);
+    EXPECT_EQ(types, (DefVec{w.arr(16, I32), w.arr(16, I32)}));
+
+    // each access of a whole element becomes one per field
+    size_t num_loads = 0, num_stores = 0;
+    for (auto def : find_defs(f, [](const Def* def) { return isa<Tag::Load>(def) || isa<Tag::Store>(def); })) {
+        EXPECT_EQ(as<Tag::Ptr>(def->as<App>()->arg(1)->type())->arg(0), I32);
+        (isa<Tag::Load>(def) ? num_loads : num_stores)++;
+    }
+    EXPECT_EQ(num_loads, size_t(3));
+    EXPECT_EQ(num_stores, size_t(3));
+
+    World w2;
+    auto f2 = aos(w2, true);
+    EXPECT_EQ(aos2soa(w2), size_t(0));
+    EXPECT_EQ(slot_types(f2), (DefVec{w2.arr(16, w2.sigma({w2.type_int_width(32), w2.type_int_width(32)}))}));
+}
+
+// Arrays in functions which are only called by others are converted, too.
+TEST(Transform, AoS2SoAInternal) {
+    World w;
+    auto g = aos(w, false, true);
+    EXPECT_EQ(aos2soa(w), size_t(1));
+    auto I32 = w.type_int_width(32);
+    EXPECT_EQ(slot_types(g), (DefVec{w.arr(16, I32), w.arr(16, I32)}));
+}
+
+#ifdef LLVM_SUPPORT
+// The fields still end up where the program expects them.
+TEST(Transform, AoS2SoAResult) {
+    for (bool internal : {false, true}) {
+        World w;
+        aos(w, false, internal);
+        EXPECT_EQ(aos2soa(w), size_t(1));
+        cleanup_world(w);
+        PassMan man(w);
+        man.add<RetWrap>();
+        man.run();
+
+        JIT jit(0);
+        auto m = jit.add(w);
+        EXPECT_EQ(jit.function<int32_t(int32_t)>(m, "f")(10), 10 + 11 + 7);
+    }
+}
+#endif
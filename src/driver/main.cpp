@@ -1,8 +1,20 @@
+#include <array>
 #include <cstring>
 #include <iostream>
 #include <fstream>
 
+#include "thorin/be/c.h"
 #include "thorin/fe/parser.h"
+#include "thorin/transform/aos2soa.h"
+#include "thorin/transform/cleanup_world.h"
+
+#ifdef LLVM_SUPPORT
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/TimeProfiler.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "thorin/be/llvm/llvm.h"
+#endif
 
 using namespace thorin;
 
@@ -12,6 +24,18 @@ static const auto usage =
 "Options:\n"
 "\t-h, --help\tdisplay this help and exit\n"
 "\t-v, --version\tdisplay version info and exit\n"
+"\t--emit-c\temit the CPU code as C99 to <module>.c - needs no LLVM\n"
+"\t--no-vectorize\tdisable LLVM's loop and SLP vectorizers and the vector types of --emit-c\n"
+"\t--aos2soa\tsplit local arrays of structures whose pointers don't escape into one array per field\n"
+#ifdef LLVM_SUPPORT
+"\t--emit-llvm\temit each backend to <module>.ll, <module>.nvvm, ...\n"
+"\t--emulate-gpu\trun the GPU kernels on the CPU instead of emitting them for their backends\n"
+"\t-O0, -O1, -O2, -O3, -Os\n"
+"\t\t\toptimization level of the LLVM pipeline (default: -O2)\n"
+"\t--no-unroll\tdisable LLVM's loop unroller\n"
+"\t--time-trace <file>\n"
+"\t\t\twrite a trace of the LLVM passes on the main thread to <file>\n"
+#endif
 "\n"
 "Hint: use '-' as file to read from stdin.\n"
 ;
@@ -21,6 +45,16 @@ static const auto version = "thorin command-line utility 0.1\n";
 int main(int argc, char** argv) {
     try {
         const char* file = nullptr;
+        bool emit_c99 = false;
+        bool vectorize = true;
+        bool aos_to_soa = false;
+#ifdef LLVM_SUPPORT
+        bool emit_llvm = false;
+        bool emulate_gpu = false;
+        int opt = 2;
+        CodeGen::Pipeline pipeline;
+        const char* time_trace = nullptr;
+#endif
 
         for (int i = 1; i != argc; ++i) {
             if (strcmp("-h", argv[i]) == 0 || strcmp("--help", argv[i]) == 0) {
@@ -29,6 +63,27 @@ int main(int argc, char** argv) {
             } else if (strcmp("-v", argv[i]) == 0 || strcmp("--version", argv[i]) == 0) {
                 std::cerr << version;
                 return EXIT_SUCCESS;
+            } else if (strcmp("--emit-c", argv[i]) == 0) {
+                emit_c99 = true;
+            } else if (strcmp("--no-vectorize", argv[i]) == 0) {
+                vectorize = false;
+            } else if (strcmp("--aos2soa", argv[i]) == 0) {
+                aos_to_soa = true;
+#ifdef LLVM_SUPPORT
+            } else if (strcmp("--emit-llvm", argv[i]) == 0) {
+                emit_llvm = true;
+            } else if (strcmp("--emulate-gpu", argv[i]) == 0) {
+                emulate_gpu = true;
+            } else if (strcmp("-Os", argv[i]) == 0) {
+                opt = -1;
+            } else if (strncmp("-O", argv[i], 2) == 0 && argv[i][2] >= '0' && argv[i][2] <= '3' && argv[i][3] == '\0') {
+                opt = argv[i][2] - '0';
+            } else if (strcmp("--no-unroll", argv[i]) == 0) {
+                pipeline.unroll_loops = false;
+            } else if (strcmp("--time-trace", argv[i]) == 0) {
+                if (++i == argc) throw std::logic_error("missing file name after '--time-trace'");
+                time_trace = argv[i];
+#endif
             } else if (file == nullptr) {
                 file = argv[i];
             } else {
@@ -56,6 +111,40 @@ int main(int argc, char** argv) {
 
         //if (eval) exp = exp->eval();
         //exp->dump();
+
+        if (aos_to_soa && aos2soa(world) != 0) cleanup_world(world);
+
+        if (emit_c99) {
+            std::ofstream ofs(world.name() + ".c");
+            emit_c(world, {}, ofs, Lang::C99, false, vectorize);
+        }
+
+#ifdef LLVM_SUPPORT
+        if (emit_llvm) {
+            if (time_trace) llvm::timeTraceProfilerInitialize(500, argv[0]);
+            if (!vectorize) pipeline.vectorize_loops = pipeline.vectorize_slp = pipeline.interleave_loops = false;
+
+            static const char* exts[Backends::Num_Backends] = { ".ll", ".cu", ".nvvm", ".cl", ".amdgpu", ".hls" };
+            Backends backends(world, emulate_gpu);
+            std::array<std::ofstream, Backends::Num_Backends> files;
+            std::array<std::ostream*, Backends::Num_Backends> streams = {};
+            for (size_t i = 0; i != Backends::Num_Backends; ++i) {
+                if (!backends.codegens[i]) continue;
+                backends.codegens[i]->pipeline() = pipeline;
+                files[i].open(world.name() + exts[i]);
+                streams[i] = &files[i];
+            }
+            backends.emit(streams, opt, false);
+
+            if (time_trace) {
+                std::error_code error;
+                llvm::raw_fd_ostream os(time_trace, error, llvm::sys::fs::OF_Text);
+                if (error) throw std::runtime_error("cannot write time trace to '" + std::string(time_trace) + "'");
+                llvm::timeTraceProfilerWrite(os);
+                llvm::timeTraceProfilerCleanup();
+            }
+        }
+#endif
     } catch (const std::exception& e) {
         std::cerr << "error: " << e.what() << std::endl;
         std::cerr << usage;
@@ -0,0 +1,118 @@
+#include "runtime/runtime.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <unordered_map>
+
+#include "runtime/task_graph.h"
+#include "runtime/thread_pool.h"
+
+using namespace thorin::rt;
+
+namespace {
+
+enum Platform { CPU_PLATFORM = 0 };
+
+/// Memory that is handed out to generated code is aligned for the widest vector unit.
+static constexpr size_t alignment = 64;
+
+[[noreturn]] void error(const char* msg, int32_t val) {
+    std::fprintf(stderr, "anydsl runtime: ");
+    std::fprintf(stderr, msg, int(val));
+    std::fprintf(stderr, "\n");
+    std::abort();
+}
+
+void check_cpu(int32_t dev) {
+    if ((dev & 0xf) != CPU_PLATFORM) error("only the CPU platform is supported, got device %d", dev);
+}
+
+using ForFn = void (*)(void*, int32_t, int32_t);
+using SpawnFn = void (*)(void*);
+
+class SpawnTask : public Task {
+public:
+    SpawnTask(void* args, SpawnFn fun)
+        : args(args)
+        , fun(fun)
+    {}
+
+    void run() override {
+        fun(args);
+        done.store(true, std::memory_order_release);
+    }
+
+    void* args;
+    SpawnFn fun;
+    std::atomic<bool> done = false;
+};
+
+std::mutex spawn_mutex;
+std::unordered_map<int32_t, std::unique_ptr<SpawnTask>> spawned;
+int32_t spawn_counter = 0;
+
+}
+
+void* anydsl_alloc(int32_t dev, int64_t size) {
+    check_cpu(dev);
+    if (size == 0) return nullptr;
+    auto ptr = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+    if (ptr == nullptr) error("out of memory on device %d", dev);
+    return ptr;
+}
+
+void* anydsl_alloc_unified(int32_t dev, int64_t size) { return anydsl_alloc(dev, size); }
+
+void anydsl_release(int32_t dev, void* ptr) {
+    check_cpu(dev);
+    std::free(ptr);
+}
+
+void anydsl_launch_kernel(int32_t dev, const char*, const char*, const uint32_t*, const uint32_t*, void**, const uint32_t*, const uint32_t*, const uint8_t*, uint32_t) {
+    error("kernel launches are not supported by the CPU runtime, got device %d", dev);
+}
+
+void anydsl_parallel_for(int32_t num_threads, int32_t lower, int32_t upper, void* args, void* fun) {
+    anydsl_parallel_for_grain(num_threads, lower, upper, 0, args, fun);
+}
+
+void anydsl_parallel_for_grain(int32_t num_threads, int32_t lower, int32_t upper, int32_t grain, void* args, void* fun) {
+    auto f = reinterpret_cast<ForFn>(fun);
+    ThreadPool::get().parallel_for(num_threads, lower, upper, grain, [&](int32_t lo, int32_t hi) { f(args, lo, hi); });
+}
+
+int32_t anydsl_spawn_thread(void* args, void* fun) {
+    auto task = std::make_unique<SpawnTask>(args, reinterpret_cast<SpawnFn>(fun));
+    auto ptr = task.get();
+
+    int32_t id;
+    {
+        std::lock_guard<std::mutex> lock(spawn_mutex);
+        id = spawn_counter++;
+        spawned.emplace(id, std::move(task));
+    }
+
+    ThreadPool::get().submit(ptr);
+    return id;
+}
+
+void anydsl_sync_thread(int32_t id) {
+    SpawnTask* task;
+    {
+        std::lock_guard<std::mutex> lock(spawn_mutex);
+        auto i = spawned.find(id);
+        if (i == spawned.end()) error("unknown thread id %d", id);
+        task = i->second.get();
+    }
+
+    ThreadPool::get().help_until([&]() { return task->done.load(std::memory_order_acquire); });
+
+    std::lock_guard<std::mutex> lock(spawn_mutex);
+    spawned.erase(id);
+}
+
+int32_t anydsl_create_graph() { return TaskGraphs::get().create_graph(); }
+int32_t anydsl_create_task(int32_t graph, Closure closure) { return TaskGraphs::get().create_task(graph, closure); }
+void anydsl_create_edge(int32_t from, int32_t to) { TaskGraphs::get().create_edge(from, to); }
+void anydsl_execute_graph(int32_t graph, int32_t root) { TaskGraphs::get().execute(ThreadPool::get(), graph, root); }
@@ -0,0 +1,55 @@
+#ifndef THORIN_RUNTIME_RUNTIME_H
+#define THORIN_RUNTIME_RUNTIME_H
+
+#include <cstdint>
+
+/**
+ * C entry points of the in-tree CPU runtime as declared in @c be/llvm/runtime.inc.
+ * Devices are encoded as <tt>platform | (device << 4)</tt>; this runtime only knows the CPU platform @c 0.
+ */
+extern "C" {
+
+/// @name memory
+//@{
+void* anydsl_alloc(int32_t dev, int64_t size);
+void* anydsl_alloc_unified(int32_t dev, int64_t size);
+void anydsl_release(int32_t dev, void* ptr);
+//@}
+
+/// @name kernels
+//@{
+void anydsl_launch_kernel(int32_t dev, const char* file, const char* kernel,
+                          const uint32_t* grid, const uint32_t* block,
+                          void** args, const uint32_t* sizes, const uint32_t* aligns, const uint8_t* types,
+                          uint32_t num_args);
+//@}
+
+/// @name parallelism
+//@{
+/// Runs <tt>fun(args, lo, hi)</tt> for disjoint subranges <tt>[lo, hi)</tt> covering <tt>[lower, upper)</tt>; @p num_threads @c 0 uses all threads.
+void anydsl_parallel_for(int32_t num_threads, int32_t lower, int32_t upper, void* args, void* fun);
+/// Same as above but subranges contain at least @p grain iterations - unless overridden via @c ANYDSL_CHUNK_SIZE.
+void anydsl_parallel_for_grain(int32_t num_threads, int32_t lower, int32_t upper, int32_t grain, void* args, void* fun);
+int32_t anydsl_spawn_thread(void* args, void* fun);
+void anydsl_sync_thread(int32_t id);
+//@}
+
+/// @name task graphs
+//@{
+/// A task of a graph runs <tt>fn(payload)</tt>.
+struct Closure {
+    void (*fn)(uint64_t);
+    uint64_t payload;
+};
+
+int32_t anydsl_create_graph();
+int32_t anydsl_create_task(int32_t graph, Closure closure);
+/// Task @p to won't start before task @p from has finished.
+void anydsl_create_edge(int32_t from, int32_t to);
+/// Runs all tasks reachable from @p root as soon as their predecessors have finished; returns once all of them are done.
+void anydsl_execute_graph(int32_t graph, int32_t root);
+//@}
+
+}
+
+#endif
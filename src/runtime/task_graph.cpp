@@ -0,0 +1,106 @@
+#include "runtime/task_graph.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+namespace thorin::rt {
+
+[[noreturn]] static void error(const char* msg, int32_t val) {
+    std::fprintf(stderr, "anydsl runtime: ");
+    std::fprintf(stderr, msg, int(val));
+    std::fprintf(stderr, "\n");
+    std::abort();
+}
+
+TaskGraphs& TaskGraphs::get() {
+    static TaskGraphs graphs;
+    return graphs;
+}
+
+TaskGraphs::Node& TaskGraphs::node(int32_t task) {
+    if (task < 0 || size_t(task) >= nodes_.size()) error("unknown task id %d", task);
+    return nodes_[task];
+}
+
+int32_t TaskGraphs::create_graph() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    graphs_.emplace_back();
+    return int32_t(graphs_.size() - 1);
+}
+
+int32_t TaskGraphs::create_task(int32_t graph, Closure closure) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (graph < 0 || size_t(graph) >= graphs_.size()) error("unknown graph id %d", graph);
+    auto& node = nodes_.emplace_back(graph, closure);
+    graphs_[graph].emplace_back(&node);
+    return int32_t(nodes_.size() - 1);
+}
+
+void TaskGraphs::create_edge(int32_t from, int32_t to) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& src = node(from);
+    auto& dst = node(to);
+    if (src.graph != dst.graph) error("task %d belongs to another graph than its predecessor", to);
+    src.succs.emplace_back(&dst);
+}
+
+void TaskGraphs::execute(ThreadPool& pool, int32_t graph, int32_t root) {
+    Execution execution{&pool, 0};
+    Node* start;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (graph < 0 || size_t(graph) >= graphs_.size()) error("unknown graph id %d", graph);
+        start = &node(root);
+        if (start->graph != graph) error("task %d doesn't belong to the executed graph", root);
+
+        // only predecessors that are reachable from root will ever finish
+        for (auto node : graphs_[graph]) {
+            node->execution = nullptr;
+            node->pending.store(0, std::memory_order_relaxed);
+        }
+
+        std::vector<Node*> stack{start};
+        start->execution = &execution;
+        size_t num = 0;
+        while (!stack.empty()) {
+            auto node = stack.back();
+            stack.pop_back();
+            ++num;
+            for (auto succ : node->succs) {
+                succ->pending.fetch_add(1, std::memory_order_relaxed);
+                if (succ->execution == nullptr) {
+                    succ->execution = &execution;
+                    stack.emplace_back(succ);
+                }
+            }
+        }
+        execution.remaining.store(num, std::memory_order_relaxed);
+    }
+
+    start->run();
+    pool.help_until([&]() { return execution.remaining.load(std::memory_order_acquire) == 0; });
+}
+
+void TaskGraphs::Node::run() {
+    auto node = this;
+    do {
+        node->closure.fn(node->closure.payload);
+
+        // continue with the first successor that becomes ready and leave the others to thieves
+        auto execution = node->execution;
+        Node* next = nullptr;
+        for (auto succ : node->succs) {
+            if (succ->pending.fetch_sub(1, std::memory_order_acq_rel) != 1) continue;
+            if (next == nullptr)
+                next = succ;
+            else
+                execution->pool->submit(succ);
+        }
+
+        // execution may be gone once the last task has finished
+        execution->remaining.fetch_sub(1, std::memory_order_acq_rel);
+        node = next;
+    } while (node != nullptr);
+}
+
+}
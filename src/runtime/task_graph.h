@@ -0,0 +1,66 @@
+#ifndef THORIN_RUNTIME_TASK_GRAPH_H
+#define THORIN_RUNTIME_TASK_GRAPH_H
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "runtime/runtime.h"
+#include "runtime/thread_pool.h"
+
+namespace thorin::rt {
+
+/**
+ * Registry of all task graphs.
+ * Building a graph takes a lock; executing it doesn't:
+ * Each task counts its unfinished predecessors and the task that finishes the last predecessor makes it ready.
+ * One of the tasks that become ready is run right away by the same thread, all others go to its work-stealing @p Deque.
+ * Task ids are unique across all graphs.
+ */
+class TaskGraphs {
+public:
+    static TaskGraphs& get();
+
+    int32_t create_graph();
+    int32_t create_task(int32_t graph, Closure closure);
+    /// @p to may only start once @p from has finished; both must belong to the same graph.
+    void create_edge(int32_t from, int32_t to);
+    /**
+     * Runs @p root and - as they become ready - all tasks reachable from it; returns when all of them have finished.
+     * A graph may be executed several times but neither concurrently nor while it is being modified.
+     */
+    void execute(ThreadPool& pool, int32_t graph, int32_t root);
+
+private:
+    struct Execution {
+        ThreadPool* pool;
+        std::atomic<size_t> remaining;  ///< Number of tasks which haven't finished yet.
+    };
+
+    class Node : public Task {
+    public:
+        Node(int32_t graph, Closure closure)
+            : graph(graph)
+            , closure(closure)
+        {}
+
+        void run() override;
+
+        int32_t graph;
+        Closure closure;
+        std::vector<Node*> succs;
+        std::atomic<int32_t> pending = 0;   ///< Number of predecessors which haven't finished yet.
+        Execution* execution = nullptr;
+    };
+
+    Node& node(int32_t task);
+
+    std::mutex mutex_;
+    std::deque<Node> nodes_;            ///< Indexed by task id; a @c std::deque keeps @p Node%s in place as it grows.
+    std::deque<std::vector<Node*>> graphs_;
+};
+
+}
+
+#endif
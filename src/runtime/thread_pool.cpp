@@ -0,0 +1,226 @@
+#include "runtime/thread_pool.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace thorin::rt {
+
+static thread_local int tls_worker_index = -1;
+
+/*
+ * Deque
+ */
+
+Deque::Deque(size_t log_size)
+    : top_(0)
+    , bottom_(0)
+{
+    buffers_.emplace_back(std::make_unique<Buffer>(size_t(1) << log_size));
+    buffer_.store(buffers_.back().get(), std::memory_order_relaxed);
+}
+
+void Deque::push(Task* task) {
+    auto b = bottom_.load(std::memory_order_relaxed);
+    auto t = top_.load(std::memory_order_acquire);
+    auto buffer = buffer_.load(std::memory_order_relaxed);
+
+    if (b - t >= int64_t(buffer->size)) {
+        auto grown = std::make_unique<Buffer>(2 * buffer->size);
+        for (auto i = t; i != b; ++i) grown->put(i, buffer->get(i));
+        buffer = grown.get();
+        buffers_.emplace_back(std::move(grown));
+        buffer_.store(buffer, std::memory_order_release);
+    }
+
+    buffer->put(b, task);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(b + 1, std::memory_order_relaxed);
+}
+
+Task* Deque::pop() {
+    auto b = bottom_.load(std::memory_order_relaxed) - 1;
+    auto buffer = buffer_.load(std::memory_order_relaxed);
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto t = top_.load(std::memory_order_relaxed);
+
+    if (t > b) {
+        bottom_.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    auto task = buffer->get(b);
+    if (t == b) {
+        // last element: race against thieves
+        if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) task = nullptr;
+        bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+    return task;
+}
+
+Task* Deque::steal() {
+    auto t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto b = bottom_.load(std::memory_order_acquire);
+    if (t >= b) return nullptr;
+
+    auto task = buffer_.load(std::memory_order_acquire)->get(t);
+    if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) return nullptr;
+    return task;
+}
+
+/*
+ * Config
+ */
+
+Config Config::from_env() {
+    Config config;
+    config.num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+    if (auto s = std::getenv("ANYDSL_NUM_THREADS")) {
+        if (auto n = std::atoi(s); n > 0) config.num_threads = n;
+    }
+    if (auto s = std::getenv("ANYDSL_SCHEDULE")) {
+        if      (std::strcmp(s, "static")  == 0) config.schedule = Schedule::Static;
+        else if (std::strcmp(s, "dynamic") == 0) config.schedule = Schedule::Dynamic;
+        else if (std::strcmp(s, "guided")  == 0) config.schedule = Schedule::Guided;
+    }
+    if (auto s = std::getenv("ANYDSL_CHUNK_SIZE")) config.chunk_size = std::max(std::atoi(s), 0);
+    if (auto s = std::getenv("ANYDSL_AFFINITY"))   config.affinity = std::atoi(s) != 0;
+
+    return config;
+}
+
+/*
+ * ThreadPool
+ */
+
+ThreadPool::ThreadPool(const Config& config)
+    : config_(config)
+{
+    auto num_workers = std::max(config.num_threads, size_t(1)) - 1;
+    for (size_t i = 0; i != num_workers; ++i) deques_.emplace_back();
+    for (size_t i = 0; i != num_workers; ++i) workers_.emplace_back([this, i]() { work(i); });
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    for (auto& worker : workers_) worker.join();
+}
+
+ThreadPool& ThreadPool::get() {
+    static ThreadPool pool(Config::from_env());
+    return pool;
+}
+
+int ThreadPool::worker_index() { return tls_worker_index; }
+
+void ThreadPool::submit(Task* task) {
+    num_queued_.fetch_add(1, std::memory_order_acq_rel);
+
+    if (auto self = worker_index(); self >= 0) {
+        deques_[self].push(task);
+    } else {
+        std::lock_guard<std::mutex> lock(mutex_);
+        injected_.emplace_back(task);
+    }
+
+    // lock to avoid a lost wake-up between a worker's check and its wait
+    { std::lock_guard<std::mutex> lock(mutex_); }
+    cv_.notify_one();
+}
+
+Task* ThreadPool::find_task(int self) {
+    Task* task = nullptr;
+
+    if (self >= 0) task = deques_[self].pop();
+
+    if (task == nullptr && num_queued_.load(std::memory_order_acquire) > 0) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!injected_.empty()) {
+                task = injected_.front();
+                injected_.pop_front();
+            }
+        }
+
+        // start at a random victim to spread the thieves
+        static thread_local std::minstd_rand rng(std::random_device{}());
+        auto n = deques_.size();
+        for (size_t i = 0, start = n != 0 ? rng() % n : 0; task == nullptr && i != n; ++i) {
+            auto victim = (start + i) % n;
+            if (int(victim) != self) task = deques_[victim].steal();
+        }
+    }
+
+    if (task != nullptr) num_queued_.fetch_sub(1, std::memory_order_acq_rel);
+    return task;
+}
+
+void ThreadPool::work(size_t index) {
+    tls_worker_index = int(index);
+
+#ifdef __linux__
+    if (config_.affinity) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET((index + 1) % std::max(std::thread::hardware_concurrency(), 1u), &set); // core 0 is left to the main thread
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+#endif
+
+    while (true) {
+        if (auto task = find_task(int(index))) {
+            task->run();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [&]() { return stop_ || num_queued_.load(std::memory_order_acquire) > 0; });
+        if (stop_) return;
+    }
+}
+
+/*
+ * Range
+ */
+
+bool ThreadPool::Range::take(int32_t n, int32_t& lo, int32_t& hi) {
+    auto b = bounds_.load(std::memory_order_acquire);
+    while (true) {
+        auto [l, h] = unpack(b);
+        if (l >= h) return false;
+        auto m = int32_t(std::min(int64_t(l) + int64_t(n), int64_t(h)));
+        if (bounds_.compare_exchange_weak(b, pack(m, h), std::memory_order_acq_rel, std::memory_order_acquire)) {
+            lo = l;
+            hi = m;
+            return true;
+        }
+    }
+}
+
+bool ThreadPool::Range::steal(int32_t& lo, int32_t& hi) {
+    auto b = bounds_.load(std::memory_order_acquire);
+    while (true) {
+        auto [l, h] = unpack(b);
+        if (l >= h) return false;
+        auto m = int32_t(int64_t(l) + (int64_t(h) - int64_t(l)) / 2);
+        if (bounds_.compare_exchange_weak(b, pack(l, m), std::memory_order_acq_rel, std::memory_order_acquire)) {
+            lo = m;
+            hi = h;
+            return true;
+        }
+    }
+}
+
+}
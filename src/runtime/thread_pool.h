@@ -0,0 +1,218 @@
+#ifndef THORIN_RUNTIME_THREAD_POOL_H
+#define THORIN_RUNTIME_THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace thorin::rt {
+
+/// A unit of work which is run exactly once by some thread of the @p ThreadPool.
+class Task {
+public:
+    virtual ~Task() {}
+
+    virtual void run() = 0;
+};
+
+/**
+ * Chase-Lev work-stealing deque.
+ * Only the owning thread may @p push and @p pop at the bottom while any thread may @p steal from the top.
+ */
+class Deque {
+public:
+    Deque(size_t log_size = 8);
+    Deque(const Deque&) = delete;
+    Deque& operator=(const Deque&) = delete;
+
+    void push(Task*);
+    Task* pop();
+    Task* steal();
+    bool empty() const { return bottom_.load(std::memory_order_relaxed) <= top_.load(std::memory_order_relaxed); }
+
+private:
+    struct Buffer {
+        Buffer(size_t size)
+            : size(size)
+            , tasks(new std::atomic<Task*>[size])
+        {}
+
+        Task* get(int64_t i) const { return tasks[i & (size - 1)].load(std::memory_order_relaxed); }
+        void put(int64_t i, Task* task) { tasks[i & (size - 1)].store(task, std::memory_order_relaxed); }
+
+        size_t size;
+        std::unique_ptr<std::atomic<Task*>[]> tasks;
+    };
+
+    alignas(64) std::atomic<int64_t> top_;
+    alignas(64) std::atomic<int64_t> bottom_;
+    std::atomic<Buffer*> buffer_;
+    std::vector<std::unique_ptr<Buffer>> buffers_; ///< Keeps outgrown @p Buffer%s alive as thieves may still read from them.
+};
+
+enum class Schedule {
+    Static,     ///< One contiguous subrange per thread; no stealing.
+    Dynamic,    ///< Chunks of fixed size; idle threads steal half of the remaining iterations of others.
+    Guided,     ///< Like @p Dynamic but chunks shrink with the remaining iterations down to the chunk size.
+};
+
+struct Config {
+    size_t num_threads;                 ///< Including the thread that calls into the runtime.
+    Schedule schedule = Schedule::Guided;
+    int32_t chunk_size = 0;             ///< Minimal chunk size; @c 0 uses the grain size hint of the generated code.
+    bool affinity = false;              ///< Pins worker @c i to core <tt>i + 1</tt>; core @c 0 is left to the thread that calls into the runtime.
+
+    /// Reads @c ANYDSL_NUM_THREADS, @c ANYDSL_SCHEDULE (@c static, @c dynamic, @c guided), @c ANYDSL_CHUNK_SIZE, and @c ANYDSL_AFFINITY.
+    static Config from_env();
+};
+
+class ThreadPool {
+public:
+    explicit ThreadPool(const Config&);
+    ~ThreadPool();
+
+    /// The global pool which is configured via @p Config::from_env upon first use.
+    static ThreadPool& get();
+
+    const Config& config() const { return config_; }
+    size_t num_workers() const { return workers_.size(); }
+    /// Index of the calling worker of the global pool or @c -1 if the caller is not a worker.
+    static int worker_index();
+
+    /// Enqueues @p task; the caller retains ownership and must keep it alive until it has run.
+    void submit(Task* task);
+    /// Runs other @p Task%s until @p done holds - this is how a thread waits without blocking a worker.
+    template<class P>
+    void help_until(P done) {
+        while (!done()) {
+            if (auto task = find_task(worker_index())) {
+                task->run();
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    /// Calls <tt>body(lo, hi)</tt> for disjoint subranges of <tt>[lower, upper)</tt> according to @p config().
+    template<class F>
+    void parallel_for(int32_t num_threads, int32_t lower, int32_t upper, int32_t grain, F body);
+
+private:
+    Task* find_task(int self);
+    void work(size_t index);
+
+    /// The iterations <tt>[lo, hi)</tt> which are not yet taken - packed into one word to update them with a single CAS.
+    class alignas(64) Range {
+    public:
+        void set(int32_t lo, int32_t hi) { bounds_.store(pack(lo, hi), std::memory_order_release); }
+        /// Takes up to @p n iterations from the front.
+        bool take(int32_t n, int32_t& lo, int32_t& hi);
+        /// Takes the back half - or the last iteration.
+        bool steal(int32_t& lo, int32_t& hi);
+        int64_t size() const { auto [lo, hi] = unpack(bounds_.load(std::memory_order_relaxed)); return int64_t(hi) - int64_t(lo); }
+
+    private:
+        static uint64_t pack(int32_t lo, int32_t hi) { return uint64_t(uint32_t(lo)) | (uint64_t(uint32_t(hi)) << 32); }
+        static std::pair<int32_t, int32_t> unpack(uint64_t b) { return {int32_t(uint32_t(b)), int32_t(uint32_t(b >> 32))}; }
+
+        std::atomic<uint64_t> bounds_;
+    };
+
+    template<class F>
+    class ForTask : public Task {
+    public:
+        void run() override;
+
+        F* body;
+        std::vector<Range>* ranges;
+        std::atomic<size_t>* pending;
+        size_t self;
+        int32_t chunk;
+        Schedule schedule;
+    };
+
+    Config config_;
+    std::vector<std::thread> workers_;
+    std::deque<Deque> deques_;          ///< One per worker.
+    std::deque<Task*> injected_;        ///< @p Task%s submitted by threads that are no workers.
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::atomic<int64_t> num_queued_ = 0;
+    bool stop_ = false;
+};
+
+template<class F>
+void ThreadPool::ForTask<F>::run() {
+    int32_t lo, hi;
+    auto& own = (*ranges)[self];
+    auto n = ranges->size();
+
+    auto next_chunk = [&]() {
+        if (schedule == Schedule::Static) return own.take(INT32_MAX, lo, hi);
+        auto size = own.size();
+        auto c = schedule == Schedule::Guided ? std::max(int64_t(chunk), size / int64_t(2 * n)) : int64_t(chunk);
+        return own.take(int32_t(std::min(c, int64_t(INT32_MAX))), lo, hi);
+    };
+
+    while (true) {
+        while (next_chunk()) (*body)(lo, hi);
+        if (schedule == Schedule::Static) break;
+
+        // steal half of the remaining iterations of someone else and continue with those
+        bool stolen = false;
+        for (size_t i = 1; i != n && !stolen; ++i) {
+            if ((*ranges)[(self + i) % n].steal(lo, hi)) {
+                own.set(lo, hi);
+                stolen = true;
+            }
+        }
+        if (!stolen) break;
+    }
+
+    pending->fetch_sub(1, std::memory_order_acq_rel);
+}
+
+template<class F>
+void ThreadPool::parallel_for(int32_t num_threads, int32_t lower, int32_t upper, int32_t grain, F body) {
+    if (lower >= upper) return;
+
+    int64_t size = int64_t(upper) - int64_t(lower);
+    int32_t chunk = std::max(config_.chunk_size != 0 ? config_.chunk_size : grain, 1);
+    size_t n = num_threads > 0 ? std::min(size_t(num_threads), num_workers() + 1) : num_workers() + 1;
+    n = size_t(std::min(int64_t(n), (size + chunk - 1) / chunk));
+
+    if (n <= 1) {
+        body(lower, upper);
+        return;
+    }
+
+    std::vector<Range> ranges(n);
+    for (size_t i = 0; i != n; ++i)
+        ranges[i].set(int32_t(lower + size * int64_t(i) / int64_t(n)), int32_t(lower + size * int64_t(i + 1) / int64_t(n)));
+
+    std::atomic<size_t> pending = n;
+    std::vector<ForTask<F>> tasks(n);
+    for (size_t i = 0; i != n; ++i) {
+        auto& task = tasks[i];
+        task.body = &body;
+        task.ranges = &ranges;
+        task.pending = &pending;
+        task.self = i;
+        task.chunk = chunk;
+        task.schedule = config_.schedule;
+        if (i != 0) submit(&task);
+    }
+
+    tasks[0].run();
+    help_until([&]() { return pending.load(std::memory_order_acquire) == 0; });
+}
+
+}
+
+#endif
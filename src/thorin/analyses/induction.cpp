@@ -0,0 +1,191 @@
+#include "thorin/analyses/induction.h"
+
+#include <limits>
+#include <stack>
+
+#include "thorin/world.h"
+#include "thorin/analyses/cfg.h"
+#include "thorin/analyses/scope.h"
+#include "thorin/util/container.h"
+
+namespace thorin {
+
+static void collect(const LoopTree<true>::Base* node, NomSet& body) {
+    for (auto n : node->cf_nodes())
+        body.emplace(n->nom());
+
+    if (auto head = node->isa<LoopTree<true>::Head>()) {
+        for (const auto& child : head->children())
+            collect(child.get(), body);
+    }
+}
+
+InductionVars::InductionVars(const Scope& scope)
+    : scope_(scope)
+{
+    visit(scope.f_cfg().looptree().root());
+}
+
+void InductionVars::visit(const Loop* loop) {
+    for (const auto& child : loop->children()) {
+        if (auto inner = child->isa<Loop>()) {
+            // irreducible loops have more than one header - we don't deal with them
+            if (inner->num_cf_nodes() == 1) {
+                if (auto header = inner->cf_nodes().front()->nom()->isa_nom<Lam>()) {
+                    header2loop_[header] = inner;
+                    collect(inner, header2body_[header]);
+                    analyze(header);
+                }
+            }
+
+            visit(inner);
+        }
+    }
+}
+
+bool InductionVars::is_invariant(Lam* header, const Def* def) const {
+    const auto& body = this->body(header);
+    std::stack<const Def*> stack;
+    DefSet done;
+
+    auto push = [&](const Def* def) {
+        if (done.emplace(def).second) stack.push(def);
+    };
+
+    push(def);
+    while (!stack.empty()) {
+        auto def = pop(stack);
+
+        if (auto nom = def->isa_nom()) {
+            if (body.contains(nom)) return false;
+        } else if (auto var = def->isa<Var>()) {
+            if (body.contains(var->nom())) return false;
+        } else if (scope().bound(def)) {
+            for (auto op : def->ops()) push(op);
+        }
+    }
+
+    return true;
+}
+
+std::optional<u64> InductionVars::trip_count(Lam* header) const {
+    auto app     = header->is_set()  ? header->body()->isa<App>()     : nullptr;
+    auto select  = app               ? app->callee()->isa<Extract>()  : nullptr;
+    auto targets = select            ? select->tuple()->isa<Tuple>()  : nullptr;
+    if (targets == nullptr || targets->num_ops() != 2) return {};
+
+    // the loop continues if the condition holds
+    auto exit = targets->op(0)->isa_nom<Lam>(), body = targets->op(1)->isa_nom<Lam>();
+    if (exit == nullptr || body == nullptr || in_loop(header, exit) || !in_loop(header, body)) return {};
+
+    auto cmp = isa<Tag::ICmp>(unhint(select->index()));
+    if (!cmp) return {};
+    auto [i, bound] = cmp->args<2>();
+    if (cmp.flags() == ICmp::ne && basic(bound)) std::swap(i, bound); // the normalizer may put the bound first
+    auto iv = basic(i);
+    if (iv == nullptr || iv->header != header || iv->init == nullptr) return {};
+
+    auto l_init = isa_lit(iv->init), l_step = isa_lit(iv->step), l_bound = isa_lit(bound);
+    auto mod = isa_lit(as<Tag::Int>(i->type())->arg());
+    auto width = mod ? mod2width(*mod) : std::nullopt;
+    if (!l_init || !l_step || !l_bound || !width) return {};
+
+    auto count = [&](auto first, auto step, auto end) -> std::optional<u64> {
+        if (step <= 0) return {};
+        switch (cmp.flags()) {
+            case ICmp::ule:
+            case ICmp::sle: if (end == std::numeric_limits<decltype(end)>::max()) return {}; ++end; [[fallthrough]];
+            case ICmp::ul:
+            case ICmp::sl:  return end > first ? u64((end - first + step - 1) / step) : 0_u64;
+            case ICmp::ne:  if (end >= first && (end - first) % step == 0) return u64((end - first) / step); return {};
+            default:        return {};
+        }
+    };
+
+    // the literals of signed comparisons need a sign extension
+    auto sext = [&](u64 val) { return *width < 64 ? s64(val << (64 - *width)) >> (64 - *width) : s64(val); };
+    if (cmp.flags() == ICmp::sl || cmp.flags() == ICmp::sle) return count(sext(*l_init), sext(*l_step), sext(*l_bound));
+    return count(*l_init, *l_step, *l_bound);
+}
+
+void InductionVars::analyze(Lam* header) {
+    if (header == scope().entry() || !header->is_set()) return;
+
+    std::vector<const App*> entries, latches;
+    for (auto pred : scope().f_cfg().preds(header)) {
+        auto lam = pred->nom()->isa_nom<Lam>();
+        auto app = lam && lam->is_set() ? lam->body()->isa<App>() : nullptr;
+        // a branch or passing the header around - we don't know which args belong to which edge
+        if (app == nullptr || app->callee() != header) return;
+        (in_loop(header, lam) ? latches : entries).emplace_back(app);
+    }
+
+    if (entries.empty() || latches.empty()) return;
+
+    for (size_t k = 0, n = header->num_vars(); k != n; ++k) {
+        auto var = header->var(n, k);
+        const Def* step = nullptr;
+        const App* inc  = nullptr;
+
+        auto is_basic = [&]() {
+            for (auto latch : latches) {
+                auto add = isa<Tag::Wrap>(Wrap::add, latch->arg(n, k));
+                if (!add) return false;
+
+                auto [a, b] = add->args<2>();
+                auto s = a == var ? b : (b == var ? a : nullptr);
+                if (s == nullptr || !is_invariant(header, s)) return false;
+                if (inc != nullptr && (s != step || add->callee() != inc->callee())) return false;
+
+                step = s;
+                inc  = add;
+            }
+            return true;
+        };
+
+        if (!is_basic()) continue;
+
+        const Def* init = entries.front()->arg(n, k);
+        for (auto entry : entries) {
+            if (entry->arg(n, k) != init) init = nullptr;
+        }
+
+        auto& basic = basics_.emplace(var, Basic{header, k, var, init, step, inc}).first->second;
+        header->world().DLOG("basic induction variable {} of {}: init {}, step {}", var, header, init, step);
+        find_derived(basic);
+    }
+}
+
+void InductionVars::find_derived(const Basic& basic) {
+    auto check = [&](const Def* def) {
+        if (def == basic.inc) return;
+
+        if (auto wrap = isa<Tag::Wrap>(def)) {
+            auto [a, b] = wrap->args<2>();
+            auto other = a == basic.var ? b : a;
+
+            switch (wrap.flags()) {
+                case Wrap::shl: if (a != basic.var) return; break;
+                case Wrap::mul:
+                case Wrap::add: break;
+                default: return;
+            }
+
+            if (other != basic.var && is_invariant(basic.header, other))
+                deriveds_.emplace(def, Derived{basic.var, wrap, other});
+        } else if (auto lea = isa<Tag::LEA>(def)) {
+            auto [ptr, index] = lea->args<2>();
+            if (index == basic.var && is_invariant(basic.header, ptr))
+                deriveds_.emplace(def, Derived{basic.var, lea, ptr});
+        }
+    };
+
+    // binary ops take their operands as a tuple
+    for (auto use : basic.var->uses()) {
+        if (use->isa<Tuple>()) {
+            for (auto tuple_use : use->uses()) check(tuple_use.def());
+        }
+    }
+}
+
+}
@@ -0,0 +1,83 @@
+#ifndef THORIN_ANALYSES_INDUCTION_H
+#define THORIN_ANALYSES_INDUCTION_H
+
+#include <optional>
+
+#include "thorin/def.h"
+#include "thorin/lam.h"
+#include "thorin/analyses/looptree.h"
+
+namespace thorin {
+
+/**
+ * Finds the induction variables of all loops within a @p Scope by inspecting its @p LoopTree.
+ * A loop is a cycle of continuations whose header @p Lam receives the loop-carried values as @p Var%s.
+ * * A @em basic induction variable is a @p Var of a header that is incremented by a loop-invariant @c step along all back edges:
+ * @code header(..., i, ...) = ...; latch(...) = header(..., i + step, ...) @endcode
+ * * A @em derived induction variable is either <tt>i * c</tt>, <tt>i << c</tt>, <tt>i + c</tt>, or <tt>lea(p, i)</tt>
+ *   for a basic induction variable @c i and a loop-invariant @c c or @c p.
+ */
+class InductionVars {
+public:
+    struct Basic {
+        Lam* header;         ///< The loop header.
+        size_t index;        ///< @p var is the @p index%th @p Var of @p header.
+        const Def* var;
+        const Def* init;     ///< The initial value if all entry edges agree; @c nullptr otherwise.
+        const Def* step;     ///< Loop-invariant increment.
+        const App* inc;      ///< The <tt>var + step</tt> on the back edges.
+    };
+
+    struct Derived {
+        const Def* basic;    ///< The basic induction variable this one is derived from.
+        const App* def;      ///< The <tt>%Wrap_mul</tt>, <tt>%Wrap_shl</tt>, <tt>%Wrap_add</tt>, or <tt>%lea</tt>.
+        const Def* other;    ///< The loop-invariant operand of @p def.
+    };
+
+    using Loop = LoopTree<true>::Head;
+
+    InductionVars(const InductionVars&) = delete;
+    InductionVars& operator=(InductionVars) = delete;
+
+    explicit InductionVars(const Scope&);
+
+    /// @name getters
+    //@{
+    const Scope& scope() const { return scope_; }
+    const DefMap<Basic>& basics() const { return basics_; }
+    const DefMap<Derived>& deriveds() const { return deriveds_; }
+    const Basic* basic(const Def* def) const { auto i = basics_.find(def); return i != basics_.end() ? &i->second : nullptr; }
+    const Derived* derived(const Def* def) const { auto i = deriveds_.find(def); return i != deriveds_.end() ? &i->second : nullptr; }
+    //@}
+
+    /// @name loop queries
+    //@{
+    const Loop* loop(Lam* header) const { return header2loop_.lookup(header).value_or(nullptr); }
+    /// All noms of the innermost loop headed by @p header including nested loops.
+    const NomSet& body(Lam* header) const { return header2body_.find(header)->second; }
+    bool in_loop(Lam* header, Def* nom) const { return body(header).contains(nom); }
+    /// Is @p def loop-invariant w.r.t. the loop headed by @p header?
+    bool is_invariant(Lam* header, const Def* def) const;
+    /**
+     * Number of iterations of the loop headed by @p header - if its basic induction variable @c i counts with literals from @c init to @c bound:
+     * @code header(..., i, ...) = (exit, body)#(i cmp bound) ... @endcode
+     * @c cmp is one of @c ul, @c ule, @c sl, @c sle or @c ne.
+     */
+    std::optional<u64> trip_count(Lam* header) const;
+    //@}
+
+private:
+    void visit(const Loop*);
+    void analyze(Lam* header);
+    void find_derived(const Basic&);
+
+    const Scope& scope_;
+    LamMap<const Loop*> header2loop_;
+    LamMap<NomSet> header2body_;
+    DefMap<Basic> basics_;
+    DefMap<Derived> deriveds_;
+};
+
+}
+
+#endif
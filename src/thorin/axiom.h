@@ -99,6 +99,12 @@ constexpr std::optional<uint64_t> mod2width(uint64_t n) {
 
 bool is_memop(const Def* def);
 
+/// @p def without the @p Hint%s wrapped around it.
+inline const Def* unhint(const Def* def) {
+    while (auto hint = isa<Tag::Hint>(def)) def = hint->arg();
+    return def;
+}
+
 }
 
 #endif
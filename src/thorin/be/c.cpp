@@ -1,1229 +1,1200 @@
-#if 0
-#include "thorin/primop.h"
+#include "thorin/be/c.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
 #include "thorin/world.h"
-#include "thorin/analyses/cfg.h"
-#include "thorin/analyses/domtree.h"
+#include "thorin/analyses/induction.h"
 #include "thorin/analyses/schedule.h"
 #include "thorin/analyses/scope.h"
-#include "thorin/util/log.h"
 #include "thorin/util/stream.h"
-#include "thorin/be/c.h"
-
-#include <cmath>
-#include <sstream>
-#include <type_traits>
 
 namespace thorin {
 
+/// Emits the CPU code of a @p World as C99 or as the C of HLS tools - mirrors the structure of @p CodeGen::emit_module.
 class CCodeGen {
 public:
-    CCodeGen(World& world, const Cont2Config& kernel_config, std::ostream& stream, Lang lang, bool debug)
+    CCodeGen(World& world, const Cont2Config& kernel_config, std::ostream& ostream, Lang lang, bool debug, bool simd)
         : world_(world)
         , kernel_config_(kernel_config)
+        , ostream_(ostream)
         , lang_(lang)
         , debug_(debug)
-        , os_(stream)
+        , simd_(simd && lang == Lang::C99)
     {}
 
-    void emit();
     World& world() const { return world_; }
+    void emit_module();
 
 private:
-    std::ostream& emit_aggop_defs(const Def*);
-    std::ostream& emit_aggop_decl(const Def*);
-    std::ostream& emit_debug_info(const Def*);
-    std::ostream& emit_addr_space(std::ostream&, const Def*);
-    std::ostream& emit_type(std::ostream&, const Def*);
-    std::ostream& emit(const Def*);
-
-    template <typename T, typename IsInfFn, typename IsNanFn>
-    std::ostream& emit_float(T, IsInfFn, IsNanFn);
-
-    // TODO use Symbol instead of std::string
-    bool lookup(const Def*);
-    void insert(const Def*, std::string);
-    std::string& get_name(const Def*);
-    const std::string var_name(const Def*);
-    const std::string get_lang() const;
-    bool is_texture_type(const Def*);
+    std::string convert(const Def* type);
+    std::string convert_ret(const Pi* ret);
+    std::string convert_signed(const Def* type);
+    u64 vector_lanes(const Def* type) const;
+    const Def* vector_type(const Def* elem, u64 lanes) const;
+    std::string elem(const Def* type, const std::string& agg, const std::string& index) const;
+    std::string convert_param(Lam*, size_t, const std::string&);
+    std::string emit_fun_decl(Lam*);
+    std::string lookup(const Def*);
+    std::string emit(const Def*);
+    std::string emit_binop(const App*, const Def*, const std::string&, const std::string&);
+    std::string emit_conv(const App*, const std::string&);
+    std::string emit_lift(const App*);
+    std::optional<std::string> emit_lifted_app(const Def*, const std::vector<std::string>&, u64, bool);
+    std::optional<std::string> emit_lifted(const Def*, DefMap<std::string>&, u64, bool);
+    std::string emit_lit(const Lit*);
+    std::string emit_global(const Global*);
+    std::string emit_constant(const Def*);
+    std::string bind(const Def* def, const std::string& type, const std::string& expr);
+    std::string bind(const Def* def, const std::string& expr) { return bind(def, convert(def->type()), expr); }
+    void emit_jump(Lam* bb, const App* app);
+    void emit_goto(Lam* bb);
+    void declare(const std::string& type, const std::string& name);
+    void emit_loc(const Def*);
+    std::vector<std::string> emit_hls_pragmas(const Scope&, const Schedule&, const HLSKernelConfig*);
+
+    /// Maximal number of lanes for which we emit vector types - just like @p CodeGen::max_vector_lanes.
+    static constexpr u64 max_vector_lanes = 16;
+
+    /// @name HLS - see @p emit_hls_pragmas
+    //@{
+    static constexpr u64 max_unroll  = 16;      ///< Innermost loops with at most this many iterations are unrolled.
+    static constexpr u64 mem_latency = 2;       ///< Cycles from a store to a dependent load of the same array in block RAM.
+    static constexpr u64 fp_latency  = 4;       ///< Cycles of a floating-point add or multiply.
+    //@}
 
     World& world_;
     const Cont2Config& kernel_config_;
+    std::ostream& ostream_;
     Lang lang_;
-    DefMap<std::string> def2str_;
-    DefMap<std::string> global2str_;
-    DefMap<std::string> primop2str_;
-    bool use_64_ = false;
-    bool use_16_ = false;
-    bool use_channels_ = false;
     bool debug_;
-    int primop_counter = 0;
-    std::ostream& os_;
-    std::ostringstream func_impl_;
-    std::ostringstream func_decls_;
-    std::ostringstream type_decls_;
+    bool simd_;                                 ///< Use the vector types of GCC/Clang - see @p vector_lanes.
+    StringStream type_decls_;
+    StringStream vars_decls_;
+    StringStream fun_decls_;
+    StringStream fun_impls_;
+    Stream* prologue_ = nullptr;                ///< Start of the current function - see @p lookup.
+    Stream* bb_ = nullptr;                      ///< Where @p emit writes to.
+    DefMap<std::string> types_;
+    DefMap<std::string> globals_;
+    LamMap<std::string> funs_;
+    DefMap<std::string> names_;                 ///< C expression of each @p Def within the current scope.
+    LamMap<std::vector<std::string>> loop_pragmas_; ///< @c #pragma @c HLS directives of the loop headers within the current scope.
+    std::vector<Lam*> loops_;                   ///< Headers of the structured loops around the current block - innermost last.
+    LamSet nexts_;                              ///< Headers of structured loops which are continued from a nested one - see @p emit_goto.
+    bool use_alloc_ = false;
+    bool use_contract_ = false;
+    bool use_vectors_ = false;
 };
 
+//------------------------------------------------------------------------------
 
-std::ostream& CCodeGen::emit_debug_info(const Def* def) {
-    if (debug_)
-        return streamf(func_impl_, "#line {} \"{}\"", def->loc().front_line(), def->loc().filename()) << endl;
-    return func_impl_;
+/// @p Def::unique_name without the characters C doesn't allow in an identifier.
+static std::string id(const Def* def) {
+    std::string res;
+    for (auto c : def->unique_name()) {
+        if (std::isalnum(c) || c == '_') res.push_back(c);
+        else if (c != '%')               res.push_back('_');
+    }
+    if (!std::isalpha(res.front())) res.insert(0, "v");
+    return res;
 }
 
-std::ostream& CCodeGen::emit_addr_space(std::ostream& os, const Def* type) {
-    if (auto ptr = type->isa<PtrType>()) {
-        if (lang_==Lang::OPENCL) {
-            switch (ptr->addr_space()) {
-                default:
-                case AddrSpace::Generic:                   break;
-                case AddrSpace::Global: os << "__global "; break;
-                case AddrSpace::Shared: os << "__local ";  break;
-            }
-        }
-    }
+/// @p Mem%s and units don't have a value in C.
+static bool is_void(const Def* type) { return isa<Tag::Mem>(type) || type == type->world().sigma(); }
 
-    return os;
+/// @p elems separated by commas.
+static std::string list(const std::vector<std::string>& elems) {
+    std::string res;
+    for (size_t i = 0, e = elems.size(); i != e; ++i) res += (i == 0 ? "" : ", ") + elems[i];
+    return res;
 }
 
-inline bool is_string_type(const Def* type) {
-    if (auto array = type->isa<DefiniteArrayType>())
-        if (auto primtype = array->elem_type()->isa<PrimType>())
-            if (primtype->primtype_tag() == PrimType_pu8)
-                return true;
-    return false;
+/// Width in bits of an @p Int or a @p Real - just like the LLVM backend, @p Int%s without a width are 64 bits wide.
+static nat_t width(const Def* type) {
+    if (type->isa<Nat>()) return 64;
+    if (auto int_ = isa<Tag::Int>(type)) {
+        if (int_->arg()->isa<Top>()) return 64;
+        if (auto width = mod2width(as_lit(int_->arg()))) return *width;
+        return 64;
+    }
+    return as_lit(as<Tag::Real>(type)->arg());
 }
 
-std::ostream& CCodeGen::emit_type(std::ostream& os, const Def* type) {
-    if (lookup(type))
-        return os << get_name(type);
-
-    if (type == nullptr) {
-        return os << "NULL";
-    } else if (type->isa<FrameType>()) {
-        return os;
-    } else if (type->isa<MemType>() || type == world().sigma()) {
-        return os << "void";
-    } else if (type->isa<Pi>()) {
-        THORIN_UNREACHABLE;
-    } else if (auto variant = type->isa<VariantType>()) {
-        os << "union variant_" << variant->gid() << " {" << up;
-        for (size_t i = 0, e = variant->ops().size(); i != e; ++i) {
-            os << endl;
-            emit_type(os, variant->op(i)) << " " << variant->op(i) << ";";
+std::string CCodeGen::convert(const Def* type) {
+    if (auto name = types_.lookup(type)) return *name;
+
+    std::string name;
+    if (is_void(type)) {
+        name = "void";
+    } else if (type->isa<Nat>() || isa<Tag::Int>(type)) {
+        switch (width(type)) {
+            case  1: name = "bool";     break;
+            case  2:
+            case  4:
+            case  8: name = "uint8_t";  break;
+            case 16: name = "uint16_t"; break;
+            case 32: name = "uint32_t"; break;
+            default: name = "uint64_t"; break;
         }
-        os << down << endl << "};";
-        return os;
+    } else if (isa<Tag::Real>(type)) {
+        switch (width(type)) {
+            case 32: name = "float";  break;
+            case 64: name = "double"; break;
+            default: world().edef(type, "C backend: C99 has no type for '{}'", type);
+        }
+    } else if (auto ptr = isa<Tag::Ptr>(type)) {
+        // pointers to arrays of unknown size point to their first element
+        auto pointee = ptr->arg(0);
+        if (auto arr = pointee->isa<Arr>(); arr && !isa_lit(arr->shape())) pointee = arr->body();
+        name = convert(pointee) + "*";
+    } else if (auto lanes = vector_lanes(type)) {
+        // the alignment of the element keeps the layout of the struct below - so vectors may live in memory and aggregates, too
+        auto elem = type->as<Arr>()->body();
+        auto bytes = width(elem) / 8;
+        name = "vec_" + std::to_string(type->gid());
+        type_decls_.fmt("\ntypedef {} {} __attribute__((vector_size({}), aligned({})));", convert(elem), name, lanes * bytes, bytes);
+        if (isa<Tag::Int>(elem))
+            type_decls_.fmt("\ntypedef {} s{} __attribute__((vector_size({}), aligned({})));", convert_signed(elem), name, lanes * bytes, bytes);
+        use_vectors_ = true;
+    } else if (auto arr = type->isa<Arr>()) {
+        auto size = isa_lit(arr->shape());
+        if (!size) world().edef(type, "C backend: array '{}' of unknown size is only supported behind a pointer", type);
+        auto elem = convert(arr->body());
+        name = "arr_" + std::to_string(type->gid());
+        type_decls_.fmt("\ntypedef struct {{ {} e[{}]; }} {};", elem, *size, name);
     } else if (auto sigma = type->isa<Sigma>()) {
-        os << "typedef struct {" << up;
+        // declare the struct first as a nominal sigma may refer to itself
+        name = "sig_" + std::to_string(type->gid());
+        types_[type] = name;
+        type_decls_.fmt("\ntypedef struct {} {};", name, name);
+
+        std::vector<std::string> fields;
         for (size_t i = 0, e = sigma->num_ops(); i != e; ++i) {
-            os << endl;
-            emit_type(os, sigma->op(i)) << " e" << i << ";";
+            if (!is_void(sigma->op(i))) fields.emplace_back(convert(sigma->op(i)) + " e" + std::to_string(i) + ";");
         }
-        os << down << endl << "} " << sigma->unique_name() << ";";
-        if (sigma->name().str().find("channel_") != std::string::npos)
-            use_channels_ = true;
-        return os;
-    } else if (type->isa<Var>()) {
-        THORIN_UNREACHABLE;
-    } else if (auto array = type->isa<IndefiniteArrayType>()) {
-        emit_type(os, array->elem_type());
-        return os;
-    } else if (auto array = type->isa<DefiniteArrayType>()) { // DefArray is mapped to a struct
-        os << "typedef struct {" << up << endl;
-        emit_type(os, array->elem_type()) << " e[" << array->dim() << "];";
-        os << down << endl << "} array_" << array->gid() << ";";
-        return os;
-    } else if (auto ptr = type->isa<PtrType>()) {
-        emit_type(os, ptr->pointee());
-        os << '*';
-        return os;
-    } else if (auto primtype = type->isa<PrimType>()) {
-        switch (primtype->primtype_tag()) {
-            case PrimType_bool:                     os << "bool";                   break;
-            case PrimType_ps8:  case PrimType_qs8:  os << "char";                   break;
-            case PrimType_pu8:  case PrimType_qu8:  os << "unsigned char";          break;
-            case PrimType_ps16: case PrimType_qs16: os << "short";                  break;
-            case PrimType_pu16: case PrimType_qu16: os << "unsigned short";         break;
-            case PrimType_ps32: case PrimType_qs32: os << "int";                    break;
-            case PrimType_pu32: case PrimType_qu32: os << "unsigned int";           break;
-            case PrimType_ps64: case PrimType_qs64: os << "long";                   break;
-            case PrimType_pu64: case PrimType_qu64: os << "unsigned long";          break;
-            case PrimType_pf16: case PrimType_qf16: os << "half";   use_16_ = true; break;
-            case PrimType_pf32: case PrimType_qf32: os << "float";                  break;
-            case PrimType_pf64: case PrimType_qf64: os << "double"; use_64_ = true; break;
-        }
-        return os;
-    }
-    THORIN_UNREACHABLE;
-}
-
-std::ostream& CCodeGen::emit_aggop_defs(const Def* def) {
-    if (lookup(def) || is_unit(def))
-        return func_impl_;
-
-    // look for nested array
-    if (auto array = def->isa<DefiniteArray>()) {
-        for (auto op : array->ops())
-            emit_aggop_defs(op);
-        if (lookup(def))
-            return func_impl_;
-        emit(array) << endl;
+        type_decls_.fmt("\nstruct {} {{ { } }};", name, fields);
+    } else {
+        world().edef(type, "C backend: cannot convert type '{}'", type);
     }
 
-    // look for nested struct - TODO also look for arrays?
-    if (auto tuple = def->isa<Tuple>()) {
-        for (auto op : tuple->ops())
-            emit_aggop_defs(op);
-        if (lookup(def))
-            return func_impl_;
-        emit(tuple) << endl;
-    }
+    return types_[type] = name;
+}
 
-    // look for nested variants
-    if (auto variant = def->isa<Variant>()) {
-        for (auto op : variant->ops())
-            emit_aggop_defs(op);
-        if (lookup(def))
-            return func_impl_;
-        emit(variant) << endl;
+/// The type which a function returns to the continuation of type @p ret - a struct if there are several values.
+std::string CCodeGen::convert_ret(const Pi* ret) {
+    DefVec types;
+    for (auto dom : ret->doms()) {
+        if (!is_void(dom)) types.emplace_back(dom);
     }
 
-    // emit declarations for bottom - required for nested data structures
-    if (is_bot(def)) emit(def) << endl;
-
-    return func_impl_;
+    if (types.empty())     return "void";
+    if (types.size() == 1) return convert(types.front());
+    return convert(world().sigma(types));
 }
 
-std::ostream& CCodeGen::emit_aggop_decl(const Def* type) {
-    if (lookup(type) || type == world().sigma())
-        return type_decls_;
-
-    // set indent to zero
-    auto indent = detail::get_indent();
-    while (detail::get_indent() != 0)
-        type_decls_ << down;
+/// C99 doesn't have signless integers - so we use the unsigned types and cast to these ones for signed operations.
+std::string CCodeGen::convert_signed(const Def* type) {
+    auto name = convert(type);
+    if (name == "bool") return name;
+    if (vector_lanes(type)) return "s" + name;
+    assert(name.front() == 'u');
+    return name.substr(1);
+}
 
-    if (auto ptr = type->isa<PtrType>())
-        emit_aggop_decl(ptr->pointee());
+/// Like @p CodeGen::vector_type: small @p Arr%s of byte-sized integers or floats become vector types of GCC/Clang - unless @p simd_ is off.
+/// Returns the number of lanes or @c 0 if @p type stays a struct.
+u64 CCodeGen::vector_lanes(const Def* type) const {
+    auto arr = type->isa<Arr>();
+    if (!simd_ || arr == nullptr) return 0;
+
+    auto lanes = isa_lit(arr->shape());
+    auto elem = arr->body();
+    bool prim = (isa<Tag::Int>(elem) && width(elem) >= 8) || isa<Tag::Real>(elem);
+    // GCC/Clang only support vectors whose size is a power of 2
+    bool pow2 = lanes && (*lanes & (*lanes - 1)) == 0;
+    return prim && pow2 && 2 <= *lanes && *lanes <= max_vector_lanes ? *lanes : 0;
+}
 
-    if (auto array = type->isa<IndefiniteArrayType>())
-        emit_aggop_decl(array->elem_type());
+/// The vector of @p lanes @p elem%s or @c nullptr if there is no such vector type.
+const Def* CCodeGen::vector_type(const Def* elem, u64 lanes) const {
+    auto type = world().arr(lanes, elem);
+    return vector_lanes(type) ? type : nullptr;
+}
 
-    if (auto pi = type->isa<Pi>()) {
-        assert(pi->is_cn());
-        for (auto type : pi->domains()) // TODO remove loop
-            emit_aggop_decl(type);
-    }
+/// Element @p index of the value @p agg of the @p Arr @p type - vector types are subscripted directly.
+std::string CCodeGen::elem(const Def* type, const std::string& agg, const std::string& index) const {
+    return vector_lanes(type) ? agg + "[" + index + "]" : agg + ".e[" + index + "]";
+}
 
-    // look for nested array
-    if (auto array = type->isa<DefiniteArrayType>()) {
-        emit_aggop_decl(array->elem_type());
-        emit_type(type_decls_, array) << endl;
-        insert(type, "array_" + std::to_string(type->gid()));
+/// Declares the @p i%th param of @p lam as @p name - HLS derives the interface of an array from its size in the @p HLSKernelConfig of @p lam.
+std::string CCodeGen::convert_param(Lam* lam, size_t i, const std::string& name) {
+    auto type = lam->dom(i);
+    auto sep = name.empty() ? "" : " ";
+    if (auto config = kernel_config_.find(lam); lang_ == Lang::HLS && config != kernel_config_.end()) {
+        auto ptr = isa<Tag::Ptr>(type);
+        auto hls = config->second->isa<HLSKernelConfig>();
+        // the type of an array of known size already fixes its interface
+        auto arr = ptr ? ptr->arg(0)->isa<Arr>() : nullptr;
+        if (auto size = hls ? hls->var_size(lam->var(lam->num_vars(), i)) : 0; ptr && size != 0 && !(arr && isa_lit(arr->shape())))
+            return convert(arr ? arr->body() : ptr->arg(0)) + sep + name + "[" + std::to_string(size) + "]";
     }
+    return convert(type) + sep + name;
+}
 
-    // look for nested sigma
-    if (auto sigma = type->isa<Sigma>()) {
-        for (auto op : sigma->ops())
-            emit_aggop_decl(op);
-        emit_type(type_decls_, sigma) << endl;
-        insert(type, sigma->unique_name());
+std::string CCodeGen::emit_fun_decl(Lam* lam) {
+    if (auto name = funs_.lookup(lam)) return *name;
+
+    std::string name = (lam->is_external() || !lam->is_set()) ? lam->debug().name : id(lam);
+    std::string ret;
+    std::vector<std::string> params;
+    for (size_t i = 0, e = lam->num_doms(); i != e; ++i) {
+        auto dom = lam->dom(i);
+        if (is_void(dom)) continue;
+        if (auto pi = dom->isa<Pi>()) {
+            assert(ret.empty() && "only one 'return' supported");
+            ret = convert_ret(pi);
+        } else {
+            params.emplace_back(convert_param(lam, i, {}));
+        }
     }
+    assert(!ret.empty());
+    if (params.empty()) params.emplace_back("void");
 
-    // look for nested variants
-    if (auto variant = type->isa<VariantType>()) {
-        for (auto op : variant->ops())
-            emit_aggop_decl(op);
-        emit_type(type_decls_, variant) << endl;
-        insert(type, "union variant_" + std::to_string(type->gid()));
-    }
+    bool internal = lam->is_set() && !lam->is_external();
+    fun_decls_.fmt("\n{}{} {}({, });", internal ? "static " : "", ret, name, params);
+    return funs_[lam] = name;
+}
 
-    // restore indent
-    while (detail::get_indent() != indent)
-        type_decls_ << up;
+void CCodeGen::emit_loc(const Def* def) {
+    auto loc = def->debug().loc;
+    if (debug_ && !loc.file.empty())
+        bb_->fmt("\n#line {} \"{}\"", loc.begin.row, loc.file);
+}
 
-    return type_decls_;
+/// Declares a variable @p name of @p type - in the prologue within a structured loop as the blocks after the loop may use it, too.
+void CCodeGen::declare(const std::string& type, const std::string& name) {
+    (loops_.empty() ? bb_ : prologue_)->fmt("\n{} {};", type, name);
 }
 
-void CCodeGen::emit() {
-    if (lang_==Lang::CUDA) {
-        func_decls_ << "__device__ inline int threadIdx_x() { return threadIdx.x; }" << endl;
-        func_decls_ << "__device__ inline int threadIdx_y() { return threadIdx.y; }" << endl;
-        func_decls_ << "__device__ inline int threadIdx_z() { return threadIdx.z; }" << endl;
-        func_decls_ << "__device__ inline int blockIdx_x() { return blockIdx.x; }" << endl;
-        func_decls_ << "__device__ inline int blockIdx_y() { return blockIdx.y; }" << endl;
-        func_decls_ << "__device__ inline int blockIdx_z() { return blockIdx.z; }" << endl;
-        func_decls_ << "__device__ inline int blockDim_x() { return blockDim.x; }" << endl;
-        func_decls_ << "__device__ inline int blockDim_y() { return blockDim.y; }" << endl;
-        func_decls_ << "__device__ inline int blockDim_z() { return blockDim.z; }" << endl;
-        func_decls_ << "__device__ inline int gridDim_x() { return gridDim.x; }" << endl;
-        func_decls_ << "__device__ inline int gridDim_y() { return gridDim.y; }" << endl;
-        func_decls_ << "__device__ inline int gridDim_z() { return gridDim.z; }" << endl;
+/// Declares a variable of @p type for @p def which is initialized with @p expr.
+std::string CCodeGen::bind(const Def* def, const std::string& type, const std::string& expr) {
+    auto name = id(def);
+    emit_loc(def);
+    if (loops_.empty()) {
+        bb_->fmt("\n{} {} = {};", type, name, expr);
+    } else {
+        declare(type, name);
+        bb_->fmt("\n{} = {}{};", name, expr.front() == '{' ? "(" + type + ")" : "", expr); // initializer lists become compound literals
     }
+    return name;
+}
 
-    // emit all globals
-    for (auto def : world().defs()) {
-        if (auto global = def->isa<Global>()) {
-            // skip strings as they are emitted inline
-            if (is_string_type(global->init()->type()))
-                continue;
-            emit_aggop_decl(global->type());
-            emit(global) << endl;
-        }
-    }
+/// <tt>(f, t)#cond</tt>
+static const Extract* is_select(const Def* def) {
+    if (auto extract = def->isa<Extract>(); extract && extract->tuple()->isa<Tuple>() && extract->tuple()->num_ops() == 2 && !isa_lit(extract->index()))
+        return extract;
+    return nullptr;
+}
 
-    Scope::for_each(world(), [&] (const Scope& scope) {
-        if (scope.entry() == world().branch())
-            return;
-
-        // lam declarations
-        auto lam = scope.entry();
-        if (lam->is_intrinsic())
-            return;
-
-        assert(lam->is_returning());
-
-        auto ret_var = lam->ret_var();
-
-        // emit function & its declaration
-        auto ret_var_cn_type = ret_var->type()->as<Pi>();
-        auto ret_type = ret_var_cn_type->num_ops() > 2 ? world_.sigma(ret_var_cn_type->ops().skip_front()) : ret_var_cn_type->ops().back();
-        auto name = (lam->is_external() || lam->is_empty()) ? lam->name() : lam->unique_name();
-        if (lam->is_external()) {
-            auto config = kernel_config_.find(lam);
-            switch (lang_) {
-                default: break;
-                case Lang::CUDA:
-                   func_decls_ << "__global__ ";
-                   func_impl_  << "__global__ ";
-                   if (config != kernel_config_.end()) {
-                       auto block = config->second->as<GPUKernelConfig>()->block_size();
-                       if (std::get<0>(block) > 0 && std::get<1>(block) > 0 && std::get<2>(block) > 0)
-                           func_impl_ << "__launch_bounds__ (" << std::get<0>(block) << " * " << std::get<1>(block) << " * " << std::get<2>(block) << ") ";
-                   }
-                   break;
-                case Lang::OPENCL:
-                   func_decls_ << "__kernel ";
-                   func_impl_  << "__kernel ";
-                   if (config != kernel_config_.end()) {
-                       auto block = config->second->as<GPUKernelConfig>()->block_size();
-                       if (std::get<0>(block) > 0 && std::get<1>(block) > 0 && std::get<2>(block) > 0)
-                           func_impl_ << "__attribute__((reqd_work_group_size(" << std::get<0>(block) << ", " << std::get<1>(block) << ", " << std::get<2>(block) << "))) ";
-                   }
-                   break;
-            }
-        } else {
-            if (lang_==Lang::CUDA) {
-                func_decls_ << "__device__ ";
-                func_impl_  << "__device__ ";
-            }
-        }
-        emit_aggop_decl(ret_type);
-        emit_addr_space(func_decls_, ret_type);
-        emit_addr_space(func_impl_,  ret_type);
-        emit_type(func_decls_, ret_type) << " " << name << "(";
-        emit_type(func_impl_,  ret_type) << " " << name << "(";
-        size_t fi = 0;
-        std::string hls_pragmas;
-        // emit and store all first-order vars
-        for (auto var : lam->vars()) {
-            if (is_mem(var) || is_unit(var))
-                continue;
-            if (var->type()->order() == 0) {
-                emit_aggop_decl(var->type());
-                if (is_texture_type(var->type())) {
-                    // emit texture declaration for CUDA
-                    type_decls_ << "texture<";
-                    emit_type(type_decls_, var->type()->as<PtrType>()->pointee());
-                    type_decls_ << ", cudaTextureType1D, cudaReadModeElementType> ";
-                    type_decls_ << var->name() << ";" << endl;
-                    insert(var, var->name().str());
-                    // skip arrays bound to texture memory
-                    continue;
-                }
-                if (fi++ > 0) {
-                    func_decls_ << ", ";
-                    func_impl_  << ", ";
-                }
+void CCodeGen::emit_module() {
+    world().visit([&](const Scope& scope) {
+        auto entry = scope.entry()->isa<Lam>();
+        if (entry == nullptr) return;
+        if (!entry->type()->is_cn()) return;
 
-                // get the kernel launch config
-                KernelConfig* config = nullptr;
-                if (lam->is_external()) {
-                    auto config_it = kernel_config_.find(lam);
-                    assert(config_it != kernel_config_.end());
-                    config = config_it->second.get();
-                }
+        assert(entry->is_returning());
+        auto name = emit_fun_decl(entry);
 
-                if (lang_ == Lang::OPENCL && lam->is_external() &&
-                    (var->type()->isa<DefiniteArrayType>() ||
-                     var->type()->isa<Sigma>())) {
-                    // structs are passed via buffer; the var is a pointer to this buffer
-                    func_decls_ << "__global ";
-                    func_impl_  << "__global ";
-                    emit_type(func_decls_, var->type()) << " *";
-                    emit_type(func_impl_,  var->type()) << " *" << var->unique_name() << "_";
-                } else if (lang_ == Lang::HLS && lam->is_external() && var->type()->isa<PtrType>()) {
-                    auto array_size = config->as<HLSKernelConfig>()->var_size(var);
-                    assert(array_size > 0);
-                    auto ptr_type = var->type()->as<PtrType>();
-                    auto elem_type = ptr_type->pointee();
-                    if (auto array_type = elem_type->isa<ArrayType>())
-                        elem_type = array_type->elem_type();
-                    emit_type(func_decls_, elem_type) << "[" << array_size << "]";
-                    emit_type(func_impl_,  elem_type) << " " << var->unique_name() << "[" << array_size << "]";
-                    if (elem_type->isa<Sigma>() || elem_type->isa<DefiniteArrayType>())
-                        hls_pragmas += "#pragma HLS data_pack variable=" + var->unique_name() + " struct_level\n";
-                } else {
-                    std::string qualifier;
-                    // add restrict qualifier when possible
-                    if ((lang_ == Lang::OPENCL || lang_ == Lang::CUDA) &&
-                        config && config->as<GPUKernelConfig>()->has_restrict() &&
-                        var->type()->isa<PtrType>()) {
-                        qualifier = lang_ == Lang::CUDA ? " __restrict" : " restrict";
-                    }
-                    emit_addr_space(func_decls_, var->type());
-                    emit_addr_space(func_impl_,  var->type());
-                    emit_type(func_decls_, var->type()) << qualifier;
-                    emit_type(func_impl_,  var->type()) << qualifier << " " << var->unique_name();
-                }
-                insert(var, var->unique_name());
-            }
-        }
-        func_decls_ << ");" << endl;
-        func_impl_  << ") {" << up;
-        if (!hls_pragmas.empty())
-            func_impl_ << down << endl << hls_pragmas << up;
-
-        // OpenCL: load struct from buffer
-        for (auto var : lam->vars()) {
-            if (is_mem(var) || is_unit(var))
-                continue;
-            if (var->type()->order() == 0) {
-                if (lang_==Lang::OPENCL && lam->is_external() &&
-                    (var->type()->isa<DefiniteArrayType>() ||
-                     var->type()->isa<Sigma>())) {
-                    func_impl_ << endl;
-                    emit_type(func_impl_, var->type()) << " " << var->unique_name() << " = *" << var->unique_name() << "_;";
-                }
-            }
-        }
+        StringStream prologue, body;
+        prologue.indent();
+        body.indent();
+        prologue_ = &prologue;
+        bb_ = &body;
 
-        Schedule schedule(scope);
+        const HLSKernelConfig* config = nullptr;
+        if (auto i = kernel_config_.find(entry); i != kernel_config_.end()) config = i->second->isa<HLSKernelConfig>();
 
-        // emit function arguments and phi nodes
-        for (const auto& block : schedule) {
-            for (auto var : block.lam()->vars()) {
-                if (is_mem(var) || is_unit(var))
-                    continue;
-                emit_aggop_decl(var->type());
-                insert(var, var->unique_name());
-            }
+        // vars of the entry are the params; the vars of all other basic blocks are assigned via the "p_" variables before jumping to them
+        const Schedule schedule(scope);
+        if (lang_ == Lang::HLS) {
+            for (const auto& pragma : emit_hls_pragmas(scope, schedule, config)) prologue.fmt("\n#pragma HLS {}", pragma);
+        }
 
-            auto lam = block.lam();
-            if (scope.entry() != lam) {
-                for (auto var : lam->vars()) {
-                    if (!is_mem(var) && !is_unit(var)) {
-                        func_impl_ << endl;
-                        emit_addr_space(func_impl_, var->type());
-                        emit_type(func_impl_, var->type()) << "  " << var->unique_name() << ";" << endl;
-                        emit_addr_space(func_impl_, var->type());
-                        emit_type(func_impl_, var->type()) << " p" << var->unique_name() << ";";
-                    }
+        DefSet vars;
+        const Def* ret_var = nullptr;
+        std::vector<std::string> params;
+        for (const auto& block : schedule) {
+            if (block.nom() == schedule.exit()) continue;
+            auto lam = block.nom()->as<Lam>();
+            for (size_t i = 0, e = lam->num_vars(); i != e; ++i) {
+                auto var = lam->var(e, i);
+                vars.emplace(var);
+                if (is_void(var->type())) {
+                    names_[var] = {};
+                } else if (lam != entry) {
+                    auto type = convert(var->type());
+                    names_[var] = id(var);
+                    prologue.fmt("\n{} {};\n{} p_{};", type, id(var), type, id(var));
+                } else if (var->type()->order() == 0) {
+                    params.emplace_back(convert_param(entry, i, id(var)));
+                    names_[var] = id(var);
+                } else {
+                    assert(!ret_var);
+                    ret_var = var;
                 }
             }
         }
+        assert(ret_var);
+        if (params.empty()) params.emplace_back("void");
 
-        for (const auto& block : schedule) {
-            auto lam = block.lam();
-            if (lam->is_empty())
-                continue;
-            assert(lam == scope.entry() || lam->is_basicblock());
-            func_impl_ << endl;
-
-            // print label for the current basic block
-            if (lam != scope.entry()) {
-                func_impl_ << "l" << lam->gid() << ": ;" << up << endl;
-                // load vars from phi node
+        auto emit_block = [&](const Schedule::Block& block) {
+            auto nom = block.nom();
+            if (nom == schedule.exit()) return;
+
+            auto lam = nom->as<Lam>();
+            assert(lam == entry || lam->is_basicblock());
+            if (lam != entry) {
+                if (loops_.empty() || loops_.back() != lam) body.fmt("\b\n{}: ;\t", id(lam)); // a structured loop has its label in front
                 for (auto var : lam->vars()) {
-                    if (!is_mem(var) && !is_unit(var))
-                        func_impl_ << var->unique_name() << " = p" << var->unique_name() << ";" << endl;
+                    if (!is_void(var->type())) body.fmt("\n{} = p_{};", id(var), id(var));
                 }
             }
 
             for (auto def : block) {
-                if (def->type()->order() >= 1) {
-                    // ignore higher-order primops which come from a match intrinsic
-                    // TODO see llvm.cpp
-                    //if (is_arg_of_app(def)) continue;
-                    THORIN_UNREACHABLE;
-                }
-
-                // struct/tuple/array declarations
-                if (!def->isa<MemOp>()) {
-                    emit_aggop_decl(def->type());
-                    // search for inlined tuples/arrays
-                    if (auto aggop = def->isa<AggOp>()) {
-                        if (!aggop->agg()->isa<MemOp>())
-                            emit_aggop_decl(aggop->agg()->type());
-                    }
-                }
-
-                // skip higher-order def, stuff dealing with frames and all memory related stuff except stores
-                if (def->type()->isa<Pi>() || def->type()->isa<FrameType>() || ((is_mem(def) || is_unit(def)) && !def->isa<Store>()))
-                    continue;
-
-                emit_debug_info(def);
-                emit(def) << endl;
+                if (def->isa<Var>())          continue;
+                if (def->type()->isa<Bot>())  continue;
+                if (is_tuple_arg_of_app(def)) continue;
+                if (vars.contains(def))       continue;
+                if (names_.contains(def))     continue; // already emitted by a lookup
+                // ignore branch/switch and the pairs of selects
+                if ((def->isa<Tuple>() || def->isa<Pack>()) && def->type()->order() > 0) continue;
+                if (def->isa<Tuple>() && std::all_of(def->uses().begin(), def->uses().end(), [](Use use) { return is_select(use.def()); })) continue;
+                if (def->isa<Extract>() && def->type()->order() > 0) continue;
+
+                names_[def] = emit(def);
             }
 
-            for (auto arg : lam->app()->args()) {
-                // emit definitions of inlined elements
-                emit_aggop_defs(arg);
-
-                // emit temporaries for arguments
-                if (arg->type()->order() >= 1 || is_mem(arg) || is_unit(arg) || lookup(arg) || arg->isa<Lit>())
-                    continue;
+            // terminate bb
+            auto app = lam->body()->as<App>();
+            auto callee = app->callee();
+            emit_loc(lam);
 
-                emit(arg) << endl;
+            // emit all args first - they must not end up within the scope of a branch
+            for (auto arg : app->args()) {
+                if (!is_void(arg->type()) && arg->type()->order() == 0) lookup(arg);
             }
 
-            // terminate bb
-            if (lam->app()->callee() == ret_var) { // return
-                size_t num_args = lam->app()->num_args();
-                if (num_args == 0) func_impl_ << "return ;";
-                else {
-                    DefArray values(num_args);
-                    DefArray types(num_args);
-
-                    size_t n = 0;
-                    for (auto arg : lam->app()->args()) {
-                        if (!is_mem(arg) && !is_unit(arg)) {
-                            values[n] = arg;
-                            types[n] = arg->type();
-                            n++;
-                        }
-                    }
+            if (callee == ret_var) { // return
+                std::vector<std::string> values;
+                DefVec types;
+                for (auto arg : app->args()) {
+                    if (is_void(arg->type())) continue;
+                    values.emplace_back(lookup(arg));
+                    types.emplace_back(arg->type());
+                }
 
-                    if (n == 0) func_impl_ << "return ;";
-                    else if (n == 1) {
-                        func_impl_ << "return ";
-                        emit(values[0]) << ";";
-                    } else {
-                        types.shrink(n);
-                        auto ret_type = world_.sigma(types);
-                        auto ret_tuple_name = "ret_tuple" + std::to_string(lam->gid());
-                        emit_aggop_decl(ret_type);
-                        emit_type(func_impl_, ret_type) << " " << ret_tuple_name << ";";
-
-                        for (size_t i = 0; i != n; ++i) {
-                            func_impl_ << endl << ret_tuple_name << ".e" << i << " = ";
-                            emit(values[i]) << ";";
-                        }
-
-                        func_impl_ << endl << "return " << ret_tuple_name << ";";
+                if (values.empty())          body.fmt("\nreturn;");
+                else if (values.size() == 1) body.fmt("\nreturn {};", values.front());
+                else                         body.fmt("\nreturn ({}) {{ {, } }};", convert(world().sigma(types)), values);
+            } else if (auto extract = callee->isa<Extract>()) {
+                auto targets = extract->tuple()->ops();
+                auto index = lookup(extract->index());
+                if (targets.size() == 2) {
+                    body.fmt("\nif ({}) {{\t", index);
+                    emit_jump(targets[1]->as_nom<Lam>(), app);
+                    body.fmt("\b\n}} else {{\t");
+                    emit_jump(targets[0]->as_nom<Lam>(), app);
+                    body.fmt("\b\n}}");
+                } else {
+                    body.fmt("\nswitch ({}) {{", index);
+                    for (size_t i = 0, e = targets.size(); i != e; ++i) {
+                        body.fmt("\n{}: {{\t", i + 1 == e ? std::string("default") : "case " + std::to_string(i));
+                        emit_jump(targets[i]->as_nom<Lam>(), app);
+                        body.fmt("\b\n}}");
                     }
+                    body.fmt("\n}}");
                 }
-            } else if (lam->app()->callee() == world().branch()) {
-                emit_debug_info(lam->app()->arg(0)); // TODO correct?
-                func_impl_ << "if (";
-                emit(lam->app()->arg(0));
-                func_impl_ << ") ";
-                emit(lam->app()->arg(1));
-                func_impl_ << " else ";
-                emit(lam->app()->arg(2));
-            } else if (lam->app()->callee()->isa<Lam>() &&
-                       lam->app()->callee()->as<Lam>()->intrinsic() == Intrinsic::Match) {
-                func_impl_ << "switch (";
-                emit(lam->app()->arg(0)) << ") {" << up << endl;
-                for (size_t i = 2; i < lam->app()->num_args(); i++) {
-                    auto arg = lam->app()->arg(i)->as<Tuple>();
-                    func_impl_ << "case ";
-                    emit(arg->op(0)) << ": ";
-                    emit(arg->op(1)) << endl;
+            } else if (callee->isa<Bot>()) {
+                body.fmt("\nabort(); // unreachable");
+            } else if (auto callee_lam = callee->isa_nom<Lam>(); callee_lam && callee_lam->is_basicblock()) {
+                emit_jump(callee_lam, app); // ordinary jump
+            } else if (callee_lam) {
+                std::vector<std::string> args;
+                const Def* ret_arg = nullptr;
+                for (auto arg : app->args()) {
+                    if (arg->type()->order() == 0) {
+                        if (!is_void(arg->type())) args.emplace_back(lookup(arg));
+                    } else {
+                        assert(!ret_arg);
+                        ret_arg = arg;
+                    }
                 }
-                func_impl_ << "default: ";
-                emit(lam->app()->arg(1));
-                func_impl_ << down << endl << "}";
-            } else if (is_bot(lam->app()->callee())) {
-                func_impl_ << "return ; // bottom: unreachable";
-            } else {
-                auto store_phi = [&] (const Def* var, const Def* arg) {
-                    func_impl_ << "p" << var->unique_name() << " = ";
-                    emit(arg) << ";";
-                };
-
-                auto callee = lam->app()->callee()->as_nom<Lam>();
-                emit_debug_info(callee);
-
-                if (callee->is_basicblock()) {   // ordinary jump
-                    assert(callee->num_vars()==lam->app()->num_args());
-                    for (size_t i = 0, size = callee->num_vars(); i != size; ++i)
-                        if (!is_mem(callee->var(i)) && !is_unit(callee->var(i))) {
-                            store_phi(callee->var(i), lam->app()->arg(i));
-                            func_impl_ << endl;
-                        }
-                    emit(callee);
+
+                auto fun = emit_fun_decl(callee_lam);
+                if (ret_arg == ret_var) { // tail call
+                    if (convert_ret(ret_var->type()->as<Pi>()) == "void")
+                        body.fmt("\n{}({, });\nreturn;", fun, args);
+                    else
+                        body.fmt("\nreturn {}({, });", fun, args);
                 } else {
-                    if (callee->is_intrinsic()) {
-                        if (callee->intrinsic() == Intrinsic::Reserve) {
-                            if (!lam->app()->arg(1)->isa<Lit>())
-                                EDEF(lam->app()->arg(1), "reserve_shared: couldn't extract memory size");
-
-                            switch (lang_) {
-                                default:                                        break;
-                                case Lang::CUDA:   func_impl_ << "__shared__ "; break;
-                                case Lang::OPENCL: func_impl_ << "__local ";    break;
-                            }
-
-                            auto l = lam->app()->arg(2)->as_nom<Lam>();
-                            auto elem_type = lam->var(1)->type()->as<PtrType>()->pointee()->as<ArrayType>()->elem_type();
-                            auto name = "reserver_" + lam->var(1)->unique_name();
-                            emit_type(func_impl_, elem_type) << " " << name << "[";
-                            emit(lam->app()->arg(1)) << "];" << endl;
-                            // store_phi:
-                            func_impl_ << "p" << l->var(1)->unique_name() << " = " << name << ";";
-                            if (lang_ == Lang::HLS)
-                                func_impl_ << endl
-                                           << "#pragma HLS dependence variable=" << name << " inter false" << endl
-                                           << "#pragma HLS data_pack  variable=" << name;
-                        } else {
-                            THORIN_UNREACHABLE;
-                        }
+                    auto succ = ret_arg->as_nom<Lam>();
+                    std::vector<const Def*> results;
+                    for (auto var : succ->vars()) {
+                        if (!is_void(var->type())) results.emplace_back(var);
+                    }
+
+                    if (results.empty()) {
+                        body.fmt("\n{}({, });", fun, args);
+                    } else if (results.size() == 1) {
+                        body.fmt("\np_{} = {}({, });", id(results.front()), fun, args);
                     } else {
-                        auto emit_call = [&] (const Def* var = nullptr) {
-                            auto name = (callee->is_external() || callee->is_empty()) ? callee->name() : callee->unique_name();
-                            if (var)
-                                emit(var) << " = ";
-                            func_impl_ << name << "(";
-                            // emit all first-order args
-                            size_t fi = 0;
-                            for (auto arg : lam->app()->args()) {
-                                if (arg->type()->order() == 0 && !(is_mem(arg) || is_unit(arg))) {
-                                    if (fi++ > 0)
-                                        func_impl_ << ", ";
-                                    emit(arg);
-                                }
-                            }
-                            func_impl_ << ");";
-                            if (var) {
-                                func_impl_ << endl;
-                                store_phi(var, var);
-                            }
-                        };
-
-                        const Def* ret_arg = 0;
-                        for (auto arg : lam->app()->args()) {
-                            if (arg->type()->order() != 0) {
-                                assert(!ret_arg);
-                                ret_arg = arg;
-                            }
-                        }
-
-                        // must be call + lam --- call + return has been removed by codegen_prepare
-                        auto succ = ret_arg->as_nom<Lam>();
-                        size_t num_vars = succ->num_vars();
-
-                        size_t n = 0;
-                        DefArray values(num_vars);
-                        DefArray types(num_vars);
-                        for (auto var : succ->vars()) {
-                            if (!is_mem(var) && !is_unit(var)) {
-                                values[n] = var;
-                                types[n] = var->type();
-                                n++;
-                            }
-                        }
-
-                        if (n == 0)
-                            emit_call();
-                        else if (n == 1)
-                            emit_call(values[0]);
-                        else {
-                            types.shrink(n);
-                            auto ret_type = world_.sigma(types);
-                            auto ret_tuple_name = "ret_tuple" + std::to_string(lam->gid());
-                            emit_aggop_decl(ret_type);
-                            emit_type(func_impl_, ret_type) << " " << ret_tuple_name << ";" << endl << ret_tuple_name << " = ";
-                            emit_call();
-
-                            // store arguments to phi node
-                            for (size_t i = 0; i != n; ++i)
-                                func_impl_ << endl << "p" << values[i]->unique_name() << " = " << ret_tuple_name << ".e" << i << ";";
-                        }
+                        auto ret = id(lam) + "_ret";
+                        declare(convert_ret(ret_arg->type()->as<Pi>()), ret);
+                        body.fmt("\n{} = {}({, });", ret, fun, args);
+                        for (size_t i = 0, e = results.size(); i != e; ++i)
+                            body.fmt("\np_{} = {}.e{};", id(results[i]), ret, i);
                     }
+                    emit_goto(succ);
                 }
+            } else {
+                world().edef(callee, "C backend: calling the closure '{}' is not supported", callee);
             }
-            if (lam != scope.entry())
-                func_impl_ << down;
-            primop2str_.clear();
-        }
-        func_impl_ << down << endl << "}" << endl << endl;
-        def2str_.clear();
-    });
+        };
 
-    def2str_.clear();
-    global2str_.clear();
-
-    if (lang_==Lang::OPENCL) {
-        if (use_channels_)
-            os_ << "#pragma OPENCL EXTENSION cl_intel_channels : enable" << endl;
-        if (use_16_)
-            os_ << "#pragma OPENCL EXTENSION cl_khr_fp16 : enable" << endl;
-        if (use_64_)
-            os_ << "#pragma OPENCL EXTENSION cl_khr_fp64 : enable" << endl;
-        if (use_channels_ || use_16_ || use_64_)
-            os_ << endl;
-    }
+        // HLS tools only take the directives of a loop from within the body of a C loop:
+        // each loop with directives becomes a "for (;;)" around its blocks - its header comes first as it precedes them in RPO
+        std::function<size_t(const LoopTree<true>::Base*)> first = [&](const LoopTree<true>::Base* node) {
+            if (auto leaf = node->isa<LoopTree<true>::Leaf>()) return schedule[leaf->cf_node()].index();
+            size_t res = schedule.size();
+            for (const auto& child : node->as<LoopTree<true>::Head>()->children()) res = std::min(res, first(child.get()));
+            return res;
+        };
+        std::function<void(const LoopTree<true>::Base*)> emit_loop = [&](const LoopTree<true>::Base* node) {
+            if (auto leaf = node->isa<LoopTree<true>::Leaf>()) return emit_block(schedule[leaf->cf_node()]);
+
+            auto loop = node->as<LoopTree<true>::Head>();
+            Lam* header = nullptr;
+            if (loop->num_cf_nodes() == 1) header = loop->cf_nodes().front()->nom()->isa_nom<Lam>();
+            if (header && !loop_pragmas_.contains(header)) header = nullptr;
+
+            if (header) {
+                body.fmt("\b\n{}: ;\t", id(header));
+                body.fmt("\nfor (;;) {{\t");
+                for (const auto& pragma : loop_pragmas_[header]) body.fmt("\n#pragma HLS {}", pragma);
+                loops_.emplace_back(header);
+            }
+
+            std::vector<const LoopTree<true>::Base*> children;
+            for (const auto& child : loop->children()) children.emplace_back(child.get());
+            std::sort(children.begin(), children.end(), [&](auto a, auto b) { return first(a) < first(b); });
+            for (auto child : children) emit_loop(child);
 
-    if (lang_==Lang::CUDA && use_16_)
-        os_ << "#include <cuda_fp16.h>" << endl << endl;
+            if (header) {
+                loops_.pop_back();
+                if (nexts_.contains(header)) body.fmt("\b\n{}_next: ;\t", id(header));
+                body.fmt("\b\n}}");
+            }
+        };
+
+        if (loop_pragmas_.empty()) {
+            for (const auto& block : schedule) emit_block(block);
+        } else {
+            emit_loop(scope.f_cfg().looptree().root());
+        }
 
-    if (lang_==Lang::CUDA || lang_==Lang::HLS)
-        os_ << "extern \"C\" {" << endl;
+        bool internal = !entry->is_external();
+        fun_impls_.fmt("\n\n{}{} {}({, }) {{", internal ? "static " : "", convert_ret(ret_var->type()->as<Pi>()), name, params);
+        fun_impls_.ostream() << prologue.str() << body.str();
+        fun_impls_.fmt("\n}}");
 
-    if (!type_decls_.str().empty())
-        os_ << type_decls_.str() << endl;
-    if (!func_decls_.str().empty())
-        os_ << func_decls_.str() << endl;
-    os_ << func_impl_.str();
+        names_.clear();
+        loop_pragmas_.clear();
+        nexts_.clear();
+    });
 
-    if (lang_==Lang::CUDA || lang_==Lang::HLS)
-        os_ << "}"; // extern "C"
+    Stream s(ostream_);
+    s.fmt("#include <math.h>\n#include <stdbool.h>\n#include <stddef.h>\n#include <stdint.h>\n#include <stdlib.h>\n");
+    if (use_vectors_)  s.fmt("\n#ifndef __GNUC__\n#error \"vector types need GCC or Clang - emit without SIMD instead\"\n#endif\n");
+    if (use_contract_) s.fmt("\n#pragma STDC FP_CONTRACT ON\n");
+    if (use_alloc_)    s.fmt("\nvoid* anydsl_alloc(int32_t, int64_t);\n");
+    s.ostream() << type_decls_.str() << '\n' << vars_decls_.str() << '\n' << fun_decls_.str() << fun_impls_.str();
+    s.endl();
 }
 
-template <typename T, typename IsInfFn, typename IsNanFn>
-std::ostream& CCodeGen::emit_float(T t, IsInfFn is_inf, IsNanFn is_nan) {
-    auto float_mode = lang_ == Lang::CUDA ? std::scientific : std::hexfloat;
-    const char* suf = "", * pref = "";
-
-    if (lang_ == Lang::CUDA) {
-        if (std::is_same<T, half>::value) {
-            pref = "__float2half(";
-            suf  = ")";
-        } else if (std::is_same<T, float>::value) {
-            suf  = "f";
+/**
+ * Infers the directives of HLS tools for the loops of @p scope from its @p LoopTree and returns the ones for the whole function:
+ * * An innermost loop with a trip count of at most @p max_unroll within another loop is unrolled; its parent is pipelined instead.
+ *   All other innermost loops are pipelined.
+ * * The initiation interval of a pipelined loop covers its recurrences:
+ *   @p mem_latency divided by the distance of a store to a later load of the same array, or @p fp_latency for a floating-point reduction.
+ *   Accesses which don't index an array with the induction variable might alias - so they need the full @p mem_latency.
+ * * Arrays of the kernel's interface which an unrolled loop indexes with its induction variable are partitioned by its trip count.
+ * * Several loops at the top level form a @c DATAFLOW region if each array is written by one of them at most.
+ */
+std::vector<std::string> CCodeGen::emit_hls_pragmas(const Scope& scope, const Schedule& schedule, const HLSKernelConfig* config) {
+    using Loop = InductionVars::Loop;
+    InductionVars ivs(scope);
+
+    struct Access {
+        Lam* lam;
+        const Def* base;
+        const Def* index;   ///< @c nullptr if @p base isn't indexed.
+        bool is_store;
+    };
+
+    std::vector<Access> accesses;
+    for (const auto& block : schedule) {
+        if (block.nom() == schedule.exit()) continue;
+        for (auto def : block) {
+            const Def* ptr = nullptr;
+            if (auto load = isa<Tag::Load>(def)) ptr = load->arg(1);
+            auto store = isa<Tag::Store>(def);
+            if (store) ptr = store->arg(1);
+            if (ptr == nullptr) continue;
+
+            auto lea = isa<Tag::LEA>(ptr);
+            accesses.emplace_back(Access{block.nom()->as<Lam>(), lea ? lea->arg(0) : ptr, lea ? lea->arg(1) : nullptr, bool(store)});
         }
-    } else if (std::is_same<T, half>::value) {
-        suf = "h";
     }
 
-    auto emit_nn = [&] (std::string def, std::string cuda, std::string opencl) {
-        switch (lang_) {
-            default:           func_impl_ << def;    break;
-            case Lang::CUDA:   func_impl_ << cuda;   break;
-            case Lang::OPENCL: func_impl_ << opencl; break;
+    auto root = [](const Def* ptr) {
+        while (auto lea = isa<Tag::LEA>(ptr)) ptr = lea->arg(0);
+        return ptr;
+    };
+    auto sext = [](u64 val, const Def* type) { auto w = width(type); return w < 64 ? s64(val << (64 - w)) >> (64 - w) : s64(val); };
+
+    // the index of access as "i + offset" for a basic induction variable i of header
+    auto affine = [&](Lam* header, const Access& access) -> std::optional<std::pair<const InductionVars::Basic*, s64>> {
+        auto index = access.index;
+        if (index == nullptr) return {};
+        if (auto conv = isa<Tag::Conv>(index); conv && (conv.flags() == Conv::u2u || conv.flags() == Conv::s2s)) index = conv->arg();
+        if (auto iv = ivs.basic(index); iv && iv->header == header) return {{iv, 0}};
+        if (auto derived = ivs.derived(index); derived && isa<Tag::Wrap>(Wrap::add, derived->def)) {
+            auto iv = ivs.basic(derived->basic);
+            if (auto offset = isa_lit(derived->other); offset && iv->header == header) return {{iv, sext(*offset, index->type())}};
         }
+        return {};
     };
 
-    if (is_inf(t)) {
-        if (std::is_same<T, half>::value) {
-            emit_nn("std::numeric_limits<half>::infinity()", "__short_as_half(0x7c00)", "as_half(0x7c00)");
-        } else if (std::is_same<T, float>::value) {
-            emit_nn("std::numeric_limits<float>::infinity()", "__int_as_float(0x7f800000)", "as_float(0x7f800000)");
-        } else {
-            emit_nn("std::numeric_limits<double>::infinity()", "__longlong_as_double(0x7ff0000000000000LL)", "as_double(0x7ff0000000000000LL)");
-        }
-    } else if (is_nan(t)) {
-        if (std::is_same<T, half>::value) {
-            emit_nn("nan(\"\")", "__short_as_half(0x7fff)", "as_half(0x7fff)");
-        } else if (std::is_same<T, float>::value) {
-            emit_nn("nan(\"\")", "__int_as_float(0x7fffffff)", "as_float(0x7fffffff)");
-        } else {
-            emit_nn("nan(\"\")", "__longlong_as_double(0x7fffffffffffffffLL)", "as_double(0x7fffffffffffffffLL)");
-        }
-    } else {
-        func_impl_ << float_mode << pref << t << suf;
-    }
-    return func_impl_;
-}
+    auto initiation_interval = [&](Lam* header) {
+        u64 ii = 1;
+        for (const auto& store : accesses) {
+            if (!store.is_store || !ivs.in_loop(header, store.lam)) continue;
+            for (const auto& load : accesses) {
+                if (load.is_store || !ivs.in_loop(header, load.lam) || root(load.base) != root(store.base)) continue;
 
-std::ostream& CCodeGen::emit(const Def* def) {
-    if (auto lam = def->isa<Lam>())
-        return func_impl_ << "goto l" << lam->gid() << ";";
-
-    if (lookup(def))
-        return func_impl_ << get_name(def);
-
-    auto def_name = var_name(def);
-
-    if (auto bin = def->isa<BinOp>()) {
-        // emit definitions of inlined elements
-        emit_aggop_defs(bin->lhs());
-        emit_aggop_defs(bin->rhs());
-        emit_type(func_impl_, bin->type()) << " " << def_name << ";" << endl;
-        func_impl_ << def_name << " = ";
-        emit(bin->lhs());
-        if (auto cmp = bin->isa<Cmp>()) {
-            switch (cmp->cmp_tag()) {
-                case Cmp_eq: func_impl_ << " == "; break;
-                case Cmp_ne: func_impl_ << " != "; break;
-                case Cmp_gt: func_impl_ << " > ";  break;
-                case Cmp_ge: func_impl_ << " >= "; break;
-                case Cmp_lt: func_impl_ << " < ";  break;
-                case Cmp_le: func_impl_ << " <= "; break;
-            }
-        }
+                auto s = affine(header, store), l = affine(header, load);
+                if (load.base != store.base || !s || !l || s->first != l->first || !isa_lit(s->first->step)) {
+                    ii = std::max(ii, mem_latency);
+                    continue;
+                }
 
-        if (auto arithop = bin->isa<ArithOp>()) {
-            switch (arithop->arithop_tag()) {
-                case ArithOp_add: func_impl_ << " + ";  break;
-                case ArithOp_sub: func_impl_ << " - ";  break;
-                case ArithOp_mul: func_impl_ << " * ";  break;
-                case ArithOp_div: func_impl_ << " / ";  break;
-                case ArithOp_rem: func_impl_ << " % ";  break;
-                case ArithOp_and: func_impl_ << " & ";  break;
-                case ArithOp_or:  func_impl_ << " | ";  break;
-                case ArithOp_xor: func_impl_ << " ^ ";  break;
-                case ArithOp_shl: func_impl_ << " << "; break;
-                case ArithOp_shr: func_impl_ << " >> "; break;
+                // the load of iteration k + d reads what the store of iteration k wrote
+                auto step = sext(as_lit(s->first->step), s->first->var->type());
+                auto dist = s->second - l->second;
+                if (step != 0 && dist % step == 0 && dist / step > 0) ii = std::max(ii, (mem_latency + u64(dist / step) - 1) / u64(dist / step));
             }
         }
-        emit(bin->rhs()) << ";";
-        insert(def, def_name);
-        return func_impl_;
-    }
 
-    if (auto conv = def->isa<ConvOp>()) {
-        emit_aggop_defs(conv->from());
-        auto src_type = conv->from()->type();
-        auto dst_type = conv->type();
-
-        // string handling: bitcast [n*pu8]* -> [pu8]*
-        if (conv->isa<Bitcast>() && conv->from()->isa<Global>() && is_string_type(conv->from()->as<Global>()->init()->type())) {
-            auto dst_ptr = dst_type->isa<PtrType>();
-            if (dst_ptr && dst_ptr->pointee()->isa<IndefiniteArrayType>()) {
-                func_impl_ << "// skipped string bitcast: ";
-                emit(conv->from());
-                insert(def, get_name(conv->from()));
-                return func_impl_;
+        for (auto pred : scope.f_cfg().preds(header)) {
+            auto latch = pred->nom()->isa_nom<Lam>();
+            if (latch == nullptr || !ivs.in_loop(header, latch)) continue;
+            auto app = latch->body()->isa<App>();
+            if (app == nullptr || app->callee() != header) continue;
+
+            for (size_t i = 0, n = header->num_vars(); i != n; ++i) {
+                auto var = header->var(n, i);
+                if (auto rop = isa<Tag::ROp>(app->arg(n, i)); rop && (rop->arg(0) == var || rop->arg(1) == var)) ii = std::max(ii, fp_latency);
             }
         }
 
-        emit_addr_space(func_impl_, dst_type);
-        emit_type(func_impl_, dst_type) << " " << def_name << ";" << endl;
+        return ii;
+    };
 
-        if (conv->isa<Cast>()) {
-            func_impl_ << def_name << " = ";
+    auto header_of = [](const Loop* loop) -> Lam* {
+        return loop->num_cf_nodes() == 1 ? loop->cf_nodes().front()->nom()->isa_nom<Lam>() : nullptr;
+    };
 
-            if (src_type->isa<VariantType>()) {
-                emit(conv->from()) << "." << dst_type << ";";
-            } else {
-                auto from = src_type->as<PrimType>();
-                auto to   = dst_type->as<PrimType>();
-
-                if (lang_==Lang::CUDA && from && (from->primtype_tag() == PrimType_pf16 || from->primtype_tag() == PrimType_qf16)) {
-                    func_impl_ << "(";
-                    emit_type(func_impl_, dst_type) << ") __half2float(";
-                    emit(conv->from()) << ");";
-                } else if (lang_==Lang::CUDA && to && (to->primtype_tag() == PrimType_pf16 || to->primtype_tag() == PrimType_qf16)) {
-                    func_impl_ << "__float2half((float)";
-                    emit(conv->from()) << ");";
-                } else {
-                    func_impl_ << "(";
-                    emit_addr_space(func_impl_, dst_type);
-                    emit_type(func_impl_, dst_type) << ")";
-                    emit(conv->from()) << ";";
-                }
-            }
+    DefMap<u64> partitions;
+    auto partition = [&](Lam* header, u64 trip_count) {
+        for (const auto& access : accesses) {
+            auto base = root(access.base);
+            if (config == nullptr || config->var_size(base) == 0 || !ivs.in_loop(header, access.lam) || !affine(header, access)) continue;
+            auto& factor = partitions[base];
+            factor = std::max(factor, trip_count);
         }
+    };
 
-        if (conv->isa<Bitcast>()) {
-            auto src_ptr = src_type->isa<PtrType>();
-            auto dst_ptr = dst_type->isa<PtrType>();
-            if (src_ptr && dst_ptr && src_ptr->addr_space() == dst_ptr->addr_space()) {
-                func_impl_ << def_name << " = (";
-                emit_addr_space(func_impl_, dst_type);
-                emit_type(func_impl_, dst_type) << ")";
-                emit(conv->from()) << ";";
-            } else {
-                func_impl_ << "union { ";
-                emit_addr_space(func_impl_, dst_type);
-                emit_type(func_impl_, dst_type) << " dst; ";
-                emit_addr_space(func_impl_, src_type);
-                emit_type(func_impl_, src_type) << " src; ";
-                func_impl_ << "} u" << def_name << ";" << endl;
-                func_impl_ << "u" << def_name << ".src = ";
-                emit(conv->from()) << ";" << endl;
-                func_impl_ << def_name << " = u" << def_name << ".dst;";
+    // returns whether loop is unrolled
+    std::function<bool(const Loop*)> visit = [&](const Loop* loop) {
+        bool innermost = true, all_unrolled = true;
+        for (const auto& child : loop->children()) {
+            if (auto inner = child->isa<Loop>()) {
+                innermost = false;
+                all_unrolled &= visit(inner);
             }
         }
 
-        insert(def, def_name);
-        return func_impl_;
-    }
+        auto header = header_of(loop);
+        if (loop->is_root() || header == nullptr || header == scope.entry()) return false;
 
-    if (auto size_of = def->isa<SizeOf>()) {
-        func_impl_ << "sizeof(";
-        emit_type(func_impl_, size_of->of()) << ")";
-        return func_impl_;
-    }
-
-    if (auto array = def->isa<DefiniteArray>()) { // DefArray is mapped to a struct
-        emit_aggop_decl(def->type());
-        // emit definitions of inlined elements
-        for (auto op : array->ops())
-            emit_aggop_defs(op);
-
-        emit_type(func_impl_, array->type()) << " " << def_name << ";" << endl << "{" << endl;
-        emit_type(func_impl_, array->type()) << " " << def_name << "_tmp = { { ";
-        for (size_t i = 0, e = array->num_ops(); i != e; ++i)
-            emit(array->op(i)) << ", ";
-        func_impl_ << "} };" << endl;
-        func_impl_ << " " << def_name << " = " << def_name << "_tmp;" << endl << "}" << endl;
-        insert(def, def_name);
-        return func_impl_;
-    }
-
-    // aggregate operations
-    {
-        auto emit_access = [&] (const Def* def, const Def* index) -> std::ostream& {
-            if (def->type()->isa<ArrayType>()) {
-                func_impl_ << ".e[";
-                emit(index) << "]";
-            } else if (def->type()->isa<Sigma>()) {
-                func_impl_ << ".e";
-                emit(index);
-            } else {
-                THORIN_UNREACHABLE;
-            }
-            return func_impl_;
-        };
-
-        if (auto tuple = def->isa<Tuple>()) {
-            emit_aggop_decl(tuple->type());
-            // emit definitions of inlined elements
-            for (auto op : tuple->ops())
-                emit_aggop_defs(op);
-
-            emit_type(func_impl_, tuple->type()) << " " << def_name << ";" << endl << "{" << endl;
-            emit_type(func_impl_, tuple->type()) << " " << def_name << "_tmp = { " << up;
-            for (size_t i = 0, e = tuple->ops().size(); i != e; ++i) {
-                func_impl_ << endl;
-                emit(tuple->op(i)) << ",";
-            }
-            func_impl_ << down << endl << "};" << endl;
-            func_impl_ << " " << def_name << " = " << def_name << "_tmp;" << endl << "}" << endl;
-            insert(def, def_name);
-            return func_impl_;
+        auto& pragmas = loop_pragmas_[header];
+        auto trip_count = ivs.trip_count(header);
+        if (innermost && trip_count && *trip_count <= max_unroll && !loop->parent()->is_root()) {
+            pragmas.emplace_back("UNROLL");
+            partition(header, *trip_count);
+            return true;
         }
 
-        if (auto aggop = def->isa<AggOp>()) {
-            emit_aggop_defs(aggop->agg());
-
-            if (auto extract = aggop->isa<Extract>()) {
-                if (is_mem(extract) || extract->type()->isa<FrameType>())
-                    return func_impl_;
-                if (!extract->agg()->isa<Assembly>()) { // extract is a nop for inline assembly
-                    emit_type(func_impl_, aggop->type()) << " " << def_name << ";" << endl;
-                    func_impl_ << def_name << " = ";
-                    if (auto memop = extract->agg()->isa<MemOp>())
-                        emit(memop) << ";";
-                    else {
-                        emit(aggop->agg());
-                        emit_access(aggop->agg(), aggop->index()) << ";";
-                    }
-                }
-                insert(def, def_name);
-                return func_impl_;
-            }
+        if (innermost || all_unrolled) pragmas.emplace_back("PIPELINE II=" + std::to_string(initiation_interval(header)));
+        if (trip_count) pragmas.emplace_back("LOOP_TRIPCOUNT min=" + std::to_string(*trip_count) + " max=" + std::to_string(*trip_count));
+        return false;
+    };
+    auto root_loop = scope.f_cfg().looptree().root();
+    visit(root_loop);
 
-            auto ins = def->as<Insert>();
-            emit_type(func_impl_, aggop->type()) << " " << def_name << ";" << endl;
-            func_impl_ << def_name << " = ";
-            emit(ins->agg()) << ";" << endl;
-            func_impl_ << def_name;
-            emit_access(def, ins->index()) << " = ";
-            emit(ins->value()) << ";";
-            insert(def, def_name);
-            return func_impl_;
-        }
+    std::vector<std::string> res;
+    std::vector<Lam*> top;
+    for (const auto& child : root_loop->children()) {
+        if (auto loop = child->isa<Loop>()) top.emplace_back(header_of(loop));
     }
 
-    if (auto lit = def->isa<Lit>()) {
-        switch (lit->type()->as<PrimType>()->primtype_tag()) {
-            case PrimType_bool:                     func_impl_ << (lit->box().get_bool() ? "true" : "false");      break;
-            case PrimType_ps8:  case PrimType_qs8:  func_impl_ << (int) lit->box().get_ps8();                      break;
-            case PrimType_pu8:  case PrimType_qu8:  func_impl_ << (unsigned) lit->box().get_pu8();                 break;
-            case PrimType_ps16: case PrimType_qs16: func_impl_ << lit->box().get_ps16();                           break;
-            case PrimType_pu16: case PrimType_qu16: func_impl_ << lit->box().get_pu16();                           break;
-            case PrimType_ps32: case PrimType_qs32: func_impl_ << lit->box().get_ps32();                           break;
-            case PrimType_pu32: case PrimType_qu32: func_impl_ << lit->box().get_pu32();                           break;
-            case PrimType_ps64: case PrimType_qs64: func_impl_ << lit->box().get_ps64();                           break;
-            case PrimType_pu64: case PrimType_qu64: func_impl_ << lit->box().get_pu64();                           break;
-            case PrimType_pf16: case PrimType_qf16: emit_float<half>(lit->box().get_pf16(),
-                                                                     [](half v) { return half_float::isinf(v); },
-                                                                     [](half v) { return half_float::isnan(v); }); break;
-            case PrimType_pf32: case PrimType_qf32: emit_float<float>(lit->box().get_pf32(),
-                                                                      [](float v) { return std::isinf(v); },
-                                                                      [](float v) { return std::isnan(v); });      break;
-            case PrimType_pf64: case PrimType_qf64: emit_float<double>(lit->box().get_pf64(),
-                                                                       [](double v) { return std::isinf(v); },
-                                                                       [](double v) { return std::isnan(v); });    break;
+    if (top.size() >= 2 && std::find(top.begin(), top.end(), nullptr) == top.end()) {
+        DefMap<Lam*> producers;
+        bool single_producer = true;
+        for (auto header : top) {
+            for (const auto& access : accesses) {
+                if (!access.is_store || !ivs.in_loop(header, access.lam)) continue;
+                auto [i, ins] = producers.emplace(root(access.base), header);
+                single_producer &= i->second == header;
+            }
         }
-        return func_impl_;
+        if (single_producer) res.emplace_back("DATAFLOW");
     }
 
-    if (auto variant = def->isa<Variant>()) {
-        emit_type(func_impl_, variant->type()) << " " << def_name << ";" << endl;
-        func_impl_ << def_name << "." << variant->op(0)->type() << " = ";
-        emit(variant->op(0)) << ";";
-        insert(def, def_name);
-        return func_impl_;
+    std::vector<const Def*> arrays;
+    for (const auto& [array, factor] : partitions) arrays.emplace_back(array);
+    std::sort(arrays.begin(), arrays.end(), [](const Def* a, const Def* b) { return a->gid() < b->gid(); });
+    for (auto array : arrays) {
+        auto factor = partitions[array];
+        auto kind = config->var_size(array) <= factor ? std::string(" complete") : " cyclic factor=" + std::to_string(factor);
+        res.emplace_back("ARRAY_PARTITION variable=" + id(array) + kind + " dim=1");
     }
 
-    if (is_bot(def)) {
-        emit_addr_space(func_impl_, def->type());
-        emit_type(func_impl_, def->type()) << " " << def_name << "; // bottom";
-        insert(def, def_name);
-        return func_impl_;
+    return res;
+}
+
+/// Like @p CodeGen::lookup, constants are emitted at the start of the function since they are not part of the schedule.
+std::string CCodeGen::lookup(const Def* def) {
+    if (auto lam = def->isa_nom<Lam>()) return emit_fun_decl(lam);
+    if (auto name = names_.lookup(def)) return *name;
+
+    std::string name;
+    if (def->no_dep()) {
+        auto bb = bb_;
+        bb_ = prologue_;
+        name = emit(def);
+        bb_ = bb;
+    } else {
+        name = emit(def);
     }
 
-    if (auto load = def->isa<Load>()) {
-        emit_type(func_impl_, load->out_val()->type()) << " " << def_name << ";" << endl;
-        func_impl_ << def_name << " = ";
-        // handle texture fetches
-        if (!is_texture_type(load->ptr()->type()))
-            func_impl_ << "*";
-        emit(load->ptr()) << ";";
+    return names_[def] = name;
+}
 
-        insert(def, def_name);
-        return func_impl_;
+/// Assigns the args of @p app to the vars of @p bb and jumps there.
+void CCodeGen::emit_jump(Lam* bb, const App* app) {
+    for (size_t i = 0, e = bb->num_vars(); i != e; ++i) {
+        auto var = bb->var(i);
+        if (!is_void(var->type())) bb_->fmt("\np_{} = {};", id(var), lookup(app->arg(i)));
     }
+    emit_goto(bb);
+}
 
-    if (auto store = def->isa<Store>()) {
-        emit_aggop_defs(store->val()) << "*";
-        emit(store->ptr()) << " = ";
-        emit(store->val()) << ";";
-
-        insert(def, def_name);
-        return func_impl_;
+/// Jumps to @p bb - the header of a structured loop around the current block is reached by continuing the loop.
+void CCodeGen::emit_goto(Lam* bb) {
+    if (!loops_.empty() && loops_.back() == bb) {
+        bb_->fmt("\ncontinue;");
+    } else if (std::find(loops_.begin(), loops_.end(), bb) != loops_.end()) {
+        nexts_.emplace(bb);
+        bb_->fmt("\ngoto {}_next;", id(bb));
+    } else {
+        bb_->fmt("\ngoto {};", id(bb));
     }
+}
 
-    if (auto slot = def->isa<Slot>()) {
-        emit_type(func_impl_, slot->alloced_type()) << " " << def_name << "_slot;" << endl;
-        emit_type(func_impl_, slot->alloced_type()) << "* " << def_name << ";" << endl;
-        func_impl_ << def_name << " = &" << def_name << "_slot;";
-        insert(def, def_name);
-        return func_impl_;
+static bool is_binop(tag_t tag) {
+    switch (tag) {
+        case Tag::Bit:
+        case Tag::Shr:
+        case Tag::Wrap:
+        case Tag::ROp:
+        case Tag::ICmp:
+        case Tag::RCmp: return true;
+        default:        return false;
     }
+}
 
-    if (def->isa<Enter>())
-        return func_impl_;
-
-    if (auto lea = def->isa<LEA>()) {
-        emit_aggop_defs(lea->ptr());
-        emit_aggop_defs(lea->index());
-        if (is_texture_type(lea->type())) { // handle texture fetches
-            emit_type(func_impl_, lea->ptr_pointee()) << " " << def_name << ";" << endl;
-            func_impl_ << def_name << " = tex1Dfetch(";
-            emit(lea->ptr()) << ", ";
-            emit(lea->index()) << ");";
-        } else {
-            if (lea->ptr_pointee()->isa<Sigma>()) {
-                emit_type(func_impl_, lea->type()) << " " << def_name << ";" << endl;
-                func_impl_ << def_name << " = &";
-                emit(lea->ptr()) << "->e";
-                emit(lea->index()) << ";";
-            } else if (lea->ptr_pointee()->isa<DefiniteArrayType>()) {
-                emit_type(func_impl_, lea->type()) << " " << def_name << ";" << endl;
-                func_impl_ << def_name << " = &";
-                emit(lea->ptr()) << "->e[";
-                emit(lea->index()) << "];";
-            } else {
-                emit_addr_space(func_impl_, lea->ptr()->type());
-                emit_type(func_impl_, lea->type()) << " " << def_name << ";" << endl;
-                func_impl_ << def_name << " = ";
-                emit(lea->ptr()) << " + ";
-                emit(lea->index()) << ";";
-            }
+/**
+ * Emits the binary op @p fn - the callee of an application - for @p a and @p b of @p type.
+ * The operands of integers narrower than @c int are promoted to @c uint32_t so they can't overflow.
+ * If @p type is a vector type, the op works lane-wise; returns an empty string if there is no such operator for vector types.
+ */
+std::string CCodeGen::emit_binop(const App* fn, const Def* type, const std::string& a, const std::string& b) {
+    bool is_vector = vector_lanes(type) != 0;
+    bool is_bool = isa<Tag::Int>(type) && width(type) == 1;
+    auto s = [&](const std::string& x) { return "(" + convert_signed(type) + ")" + x; };
+    auto u = [&](const std::string& x) { return !is_vector && width(type) < 32 ? "(uint32_t)" + x : x; };
+    auto n = [&](const std::string& x) { return (is_bool ? "!" : "~") + x; };
+
+    if (is_vector) {
+        auto flags = fn->axiom()->flags();
+        switch (fn->axiom()->tag()) {
+            // comparisons of vector types yield masks instead of bools
+            case Tag::ICmp:
+            case Tag::RCmp: return {};
+            case Tag::Bit:  if (Bit(flags) == Bit::f || Bit(flags) == Bit::t) return {}; break;
+            case Tag::ROp:  if (ROp(flags) == ROp::rem) return {}; break; // fmod doesn't know vector types
+            case Tag::Shr:  if (Shr(flags) == Shr::ashr) return "(" + convert(type) + ")(" + s(a) + " >> " + s(b) + ")"; break;
+            default: break;
         }
-
-        insert(def, def_name);
-        return func_impl_;
     }
 
-    if (auto assembly = def->isa<Assembly>()) {
-        size_t out_size = assembly->type()->num_ops() - 1;
-        Array<std::string> outputs(out_size, std::string(""));
-        for (auto use : assembly->uses()) {
-            auto extract = use->as<Extract>();
-            size_t index = as_lit<u64>(extract->index());
-            if (index == 0)
-                continue;   // skip the mem
-
-            assert(outputs[index - 1] == "" && "Each use must belong to a unique index.");
-            auto name = var_name(extract);
-            outputs[index - 1] = name;
-            emit_type(func_impl_, assembly->type()->op(index)) << " " << name << ";" << endl;
-        }
-        // some outputs that were originally there might have been pruned because
-        // they are not used but we still need them as operands for the asm
-        // statement so we need to generate them here
-        for (size_t i = 0; i < out_size; ++i) {
-            if (outputs[i] == "") {
-                auto name = var_name(assembly) + "_" + std::to_string(i + 1);
-                emit_type(func_impl_, assembly->type()->op(i + 1)) << " " << name << ";" << endl;
-                outputs[i] = name;
+    switch (fn->axiom()->tag()) {
+        case Tag::Bit:
+            switch (Bit(fn->axiom()->flags())) {
+                case Bit::    f: return "0";
+                case Bit::  nor: return n("(" + a + " | " + b + ")");
+                case Bit::nciff: return n(a) + " & " + b;
+                case Bit::   na: return n(a);
+                case Bit:: niff: return a + " & " + n(b);
+                case Bit::   nb: return n(b);
+                case Bit:: _xor: return a + " ^ " + b;
+                case Bit:: nand: return n("(" + a + " & " + b + ")");
+                case Bit:: _and: return a + " & " + b;
+                case Bit:: nxor: return n("(" + a + " ^ " + b + ")");
+                case Bit::    b: return b;
+                case Bit::  iff: return n(a) + " | " + b;
+                case Bit::    a: return a;
+                case Bit:: ciff: return a + " | " + n(b);
+                case Bit:: _or : return a + " | " + b;
+                case Bit::    t: return n("0");
+                default: THORIN_UNREACHABLE;
             }
-        }
+        case Tag::Shr:
+            switch (Shr(fn->axiom()->flags())) {
+                case Shr::ashr: return s(a) + " >> " + b;
+                case Shr::lshr: return a + " >> " + b;
+                default: THORIN_UNREACHABLE;
+            }
+        case Tag::Wrap:
+            // bool arithmetic wraps around modulo 2
+            switch (Wrap(fn->axiom()->flags())) {
+                case Wrap::add: return is_bool ? a + " ^ "  + b : u(a) + " + "  + b;
+                case Wrap::sub: return is_bool ? a + " ^ "  + b : u(a) + " - "  + b;
+                case Wrap::mul: return is_bool ? a + " & "  + b : u(a) + " * "  + b;
+                case Wrap::shl: return is_bool ? a + " & !" + b : u(a) + " << " + b;
+                default: THORIN_UNREACHABLE;
+            }
+        case Tag::ROp:
+            // C99 has no fast-math flags - they are up to the flags of the C compiler
+            switch (ROp(fn->axiom()->flags())) {
+                case ROp::add: return a + " + " + b;
+                case ROp::sub: return a + " - " + b;
+                case ROp::mul: return a + " * " + b;
+                case ROp::div: return a + " / " + b;
+                case ROp::rem: return std::string(width(type) == 32 ? "fmodf(" : "fmod(") + a + ", " + b + ")";
+                default: THORIN_UNREACHABLE;
+            }
+        case Tag::ICmp:
+            switch (ICmp(fn->axiom()->flags())) {
+                case ICmp::_f:  return "false";
+                case ICmp::e:   return a + " == " + b;
+                case ICmp::ne:  return a + " != " + b;
+                case ICmp::sg:  return s(a) + " > "  + s(b);
+                case ICmp::sge: return s(a) + " >= " + s(b);
+                case ICmp::sl:  return s(a) + " < "  + s(b);
+                case ICmp::sle: return s(a) + " <= " + s(b);
+                case ICmp::ug:  return a + " > "  + b;
+                case ICmp::uge: return a + " >= " + b;
+                case ICmp::ul:  return a + " < "  + b;
+                case ICmp::ule: return a + " <= " + b;
+                case ICmp::_t:  return "true";
+                default: world().edef(fn, "C backend: unsupported integer comparison '{}'", fn); THORIN_UNREACHABLE;
+            }
+        case Tag::RCmp:
+            // the relational operators of C are ordered - except for !=
+            switch (RCmp(fn->axiom()->flags())) {
+                case RCmp::  f: return "false";
+                case RCmp::  e: return a + " == " + b;
+                case RCmp::  l: return a + " < "  + b;
+                case RCmp:: le: return a + " <= " + b;
+                case RCmp::  g: return a + " > "  + b;
+                case RCmp:: ge: return a + " >= " + b;
+                case RCmp:: ne: return "islessgreater(" + a + ", " + b + ")";
+                case RCmp::  o: return "!isunordered(" + a + ", " + b + ")";
+                case RCmp::  u: return "isunordered(" + a + ", " + b + ")";
+                case RCmp:: ue: return "!islessgreater(" + a + ", " + b + ")";
+                case RCmp:: ul: return "!(" + a + " >= " + b + ")";
+                case RCmp::ule: return "!(" + a + " > "  + b + ")";
+                case RCmp:: ug: return "!(" + a + " <= " + b + ")";
+                case RCmp::uge: return "!(" + a + " < "  + b + ")";
+                case RCmp::une: return a + " != " + b;
+                case RCmp::  t: return "true";
+                default: THORIN_UNREACHABLE;
+            }
+        default: THORIN_UNREACHABLE;
+    }
+}
 
-        func_impl_ << "asm ";
-        if (assembly->has_sideeffects())
-            func_impl_ << "volatile ";
-        if (assembly->is_alignstack() || assembly->is_inteldialect())
-            WDEF(assembly, "stack alignment and inteldialect flags unsupported for C output");
-        func_impl_ << "(\"" << assembly->asm_template() << "\"";
-
-        // emit the outputs
-        const char* separator = " : ";
-        const auto& output_constraints = assembly->output_constraints();
-        for (size_t i = 0; i < output_constraints.size(); ++i) {
-            func_impl_ << separator << "\"" << output_constraints[i] << "\"("
-                << outputs[i] << ")";
-            separator = ", ";
-        }
+/// Converts @p src as the @c Conv @p fn - the callee of an application - does.
+std::string CCodeGen::emit_conv(const App* fn, const std::string& src) {
+    auto pi = fn->type()->as<Pi>();
+    auto dom = pi->dom(), codom = pi->codom();
+    auto s_src = width(dom), s_dst = width(codom);
+    auto dst = convert(codom);
+
+    switch (Conv(fn->axiom()->flags())) {
+        case Conv::s2s:
+            if (s_src < s_dst) return s_src == 1 ? "-(" + dst + ")" + src : "(" + convert_signed(dom) + ")" + src;
+            [[fallthrough]];
+        case Conv::u2u:
+            // truncating to bool keeps the lowest bit whereas a C cast compares against 0
+            return s_dst == 1 && s_src > 1 ? src + " & 1" : src;
+        case Conv::r2r:
+        case Conv::u2r:
+        case Conv::r2u: return src;
+        case Conv::s2r: return "(" + convert_signed(dom) + ")" + src;
+        case Conv::r2s: return "(" + convert_signed(codom) + ")" + src;
+        default: THORIN_UNREACHABLE;
+    }
+}
 
-        // emit the inputs
-        separator = output_constraints.empty() ? " :: " : " : ";
-        auto input_constraints = assembly->input_constraints();
-        for (size_t i = 0; i < input_constraints.size(); ++i) {
-            func_impl_ << separator << "\"" << input_constraints[i] << "\"(";
-            emit(assembly->op(i + 1)) << ")";
-            separator = ", ";
+/// Applies the scalar function @p f lane-wise to @p args - like @p CodeGen::emit_lifted_app.
+/// With @p vector, @p args are values of vector types with @p lanes lanes, otherwise they are the elements of a single lane.
+/// Returns @c std::nullopt if this is not possible.
+std::optional<std::string> CCodeGen::emit_lifted_app(const Def* f, const std::vector<std::string>& args, u64 lanes, bool vector) {
+    auto [axiom, currying_depth] = get_axiom(f);
+    if (axiom && currying_depth == 1) {
+        auto fn = f->as<App>();
+        auto pi = fn->type()->as<Pi>();
+        auto type = [&](const Def* elem) { return vector ? vector_type(elem, lanes) : elem; };
+
+        if (is_binop(axiom->tag()) && args.size() == 2) {
+            if (auto t = type(pi->dom()->proj(2, 0_u64))) {
+                if (auto res = emit_binop(fn, t, args[0], args[1]); !res.empty()) return res;
+            }
+        } else if (axiom->tag() == Tag::FMA && args.size() == 3) {
+            if (as_lit(fn->arg(0)) & RMode::contract) {
+                use_contract_ = true;
+                return args[0] + " * " + args[1] + " + " + args[2];
+            }
+            // C has no fma for vector types
+            if (!vector) return (width(pi->codom()) == 32 ? "fmaf(" : "fma(") + list(args) + ")";
+        } else if (axiom->tag() == Tag::Conv && args.size() == 1) {
+            if (!vector) return emit_conv(fn, args[0]);
+
+            auto src = type(pi->dom()), dst = type(pi->codom());
+            if (src == nullptr || dst == nullptr) return {};
+            auto cvt = [&](const std::string& x, const std::string& to) { return "__builtin_convertvector(" + x + ", " + to + ")"; };
+            switch (Conv(axiom->flags())) {
+                case Conv::s2s:
+                    if (width(pi->dom()) < width(pi->codom()))
+                        return "(" + convert(dst) + ")" + cvt("(" + convert_signed(src) + ")" + args[0], convert_signed(dst));
+                    [[fallthrough]];
+                case Conv::u2u:
+                case Conv::r2r:
+                case Conv::u2r:
+                case Conv::r2u: return cvt(args[0], convert(dst));
+                case Conv::s2r: return cvt("(" + convert_signed(src) + ")" + args[0], convert(dst));
+                case Conv::r2s: return "(" + convert(dst) + ")" + cvt(args[0], convert_signed(dst));
+                default: THORIN_UNREACHABLE;
+            }
         }
+        return {};
+    }
 
-        // emit the clobbers
-        separator = input_constraints.empty() ? output_constraints.empty() ? " ::: " : " :: " : " : ";
-        for (auto clob : assembly->clobbers()) {
-            func_impl_ << separator << "\"" << clob << "\"";
-            separator = ", ";
-        }
-        return func_impl_ << ");";
+    if (auto lam = f->isa_nom<Lam>(); lam && lam->is_set()) {
+        DefMap<std::string> values;
+        auto n = args.size();
+        if (n == 1)
+            values[lam->var()] = args[0];
+        else
+            for (size_t i = 0; i != n; ++i) values[lam->var(n, i)] = args[i];
+        return emit_lifted(lam->body(), values, lanes, vector);
     }
 
-    if (auto global = def->isa<Global>()) {
-        assert(!global->init()->isa_nom<Lam>() && "no global init lam supported");
-
-        // string handling
-        if (auto str_array = global->init()->isa<DefiniteArray>()) {
-            if (as_lit<pu8>(str_array->ops().back()) == pu8(0)) {
-                if (auto primtype = str_array->elem_type()->isa<PrimType>()) {
-                    if (primtype->primtype_tag() == PrimType_pu8) {
-                        std::string str = "\"";
-                        for (auto op : str_array->ops().skip_back())
-                            str += as_lit<pu8>(op);
-                        str += '"';
-                        insert(def, str);
-                        return func_impl_;
-                    }
-                }
-            }
-        }
+    return {};
+}
 
-        WDEF(global, "{}: Global variable '{}' will not be synced with host", get_lang(), global);
-        switch (lang_) {
-            default:                                        break;
-            case Lang::CUDA:   func_impl_ << "__device__ "; break;
-            case Lang::OPENCL: func_impl_ << "__constant "; break;
+std::optional<std::string> CCodeGen::emit_lifted(const Def* def, DefMap<std::string>& values, u64 lanes, bool vector) {
+    if (auto value = values.lookup(def)) return *value;
+
+    std::optional<std::string> res;
+    if (def->no_dep()) {
+        if (!vector)
+            res = lookup(def);
+        else if (auto type = vector_type(def->type(), lanes))
+            res = "(" + convert(type) + "){ " + list(std::vector<std::string>(lanes, lookup(def))) + " }";
+    } else if (auto select = is_select(def)) {
+        // C has no lane-wise ?: - so vector types need the same condition for all lanes
+        auto [f, t] = select->tuple()->projs<2>();
+        auto c = vector ? (select->index()->no_dep() ? lookup(select->index()) : std::optional<std::string>()) : emit_lifted(select->index(), values, lanes, vector);
+        auto ff = emit_lifted(f, values, lanes, vector);
+        auto tt = emit_lifted(t, values, lanes, vector);
+        if (c && ff && tt) res = "(" + *c + " ? " + *tt + " : " + *ff + ")";
+    } else if (auto app = def->isa<App>()) {
+        auto n = app->num_args();
+        std::vector<std::string> args(n);
+        for (size_t i = 0; i != n; ++i) {
+            auto arg = emit_lifted(app->arg(n, i), values, lanes, vector);
+            if (!arg) return {};
+            args[i] = *arg;
         }
-        bool bottom = is_bot(global->init());
-        if (!bottom)
-            emit(global->init()) << endl;
-        emit_type(func_impl_, global->alloced_type()) << " " << def_name << "_slot";
-        if (bottom) {
-            func_impl_ << "; // bottom";
-        } else {
-            func_impl_ << " = ";
-            emit(global->init()) << ";";
-        }
-        func_impl_ << endl;
+        // a single lane isn't bound to a variable - so integers need the conversion to their unsigned C type: signed or promoted operands must not overflow
+        auto type = app->type();
+        bool truncate = !vector && isa<Tag::Int>(type) && width(type) > 1;
+        if (auto r = emit_lifted_app(app->callee(), args, lanes, vector))
+            res = truncate ? "((" + convert(type) + ")(" + *r + "))" : "(" + *r + ")";
+    }
 
-        switch (lang_) {
-            default:                                        break;
-            case Lang::CUDA:   func_impl_ << "__device__ "; break;
-            case Lang::OPENCL: func_impl_ << "__constant "; break;
-        }
-        emit_type(func_impl_, global->alloced_type()) << " *" << def_name << " = &" << def_name << "_slot;";
+    if (res) values[def] = *res;
+    return res;
+}
 
-        insert(def, def_name);
-        return func_impl_;
+/**
+ * Lowers <tt>lift (1, n) (n_i, Is, 1, Os, f) (a_1, ..., a_{n_i})</tt> - like @p CodeGen::emit_lift.
+ * If the arguments and the result have vector types, the ops of @p f become the lane-wise operators of these types.
+ * Otherwise, or if an op has no such operator, the ops are applied to each lane in a loop.
+ */
+std::string CCodeGen::emit_lift(const App* lift) {
+    auto [r, s] = lift->decurry()->decurry()->args<2>();
+    auto [n_i, Is, n_o, Os, f] = lift->decurry()->args<5>();
+    auto l_r = isa_lit(r), l_s = isa_lit(s), l_i = isa_lit(n_i), l_o = isa_lit(n_o);
+    if (!l_r || *l_r != 1 || !l_s || !l_i || !l_o || *l_o != 1)
+        world().edef(lift, "C backend: cannot lower lift '{}'", lift);
+
+    std::vector<std::string> args(*l_i);
+    bool vector = vector_lanes(lift->type()) != 0;
+    for (size_t i = 0; i != *l_i; ++i) {
+        args[i] = lookup(lift->arg(*l_i, i));
+        vector &= vector_lanes(lift->arg(*l_i, i)->type()) != 0;
     }
 
-    if (auto select = def->isa<Select>()) {
-        emit_aggop_defs(select->cond());
-        emit_aggop_defs(select->tval());
-        emit_aggop_defs(select->fval());
-        emit_type(func_impl_, select->type()) << " " << def_name << ";" << endl;
-        func_impl_ << def_name << " = ";
-        emit(select->cond()) << " ? ";
-        emit(select->tval()) << " : ";
-        emit(select->fval()) << ";";
-        insert(def, def_name);
-        return func_impl_;
+    if (vector) {
+        if (auto res = emit_lifted_app(f, args, *l_s, true)) return bind(lift, *res);
     }
 
-    THORIN_UNREACHABLE;
-}
+    for (size_t i = 0; i != *l_i; ++i) args[i] = elem(lift->arg(*l_i, i)->type(), args[i], "i");
+    auto res = emit_lifted_app(f, args, *l_s, false);
+    if (!res) world().edef(lift, "C backend: cannot lower lift '{}'", lift);
 
-bool CCodeGen::lookup(const Def* def) {
-    if (def->isa<Global>())
-        return global2str_.contains(def);
-    else if (def->isa<PrimOp>() && is_const(def))
-        return primop2str_.contains(def);
-    else
-        return def2str_.contains(def);
+    auto name = id(lift);
+    emit_loc(lift);
+    declare(convert(lift->type()), name);
+    bb_->fmt("\nfor (size_t i = 0; i != {}; ++i) {} = {};", *l_s, elem(lift->type(), name, "i"), *res);
+    return name;
 }
 
-std::string& CCodeGen::get_name(const Def* def) {
-    if (def->isa<Global>())
-        return global2str_[def];
-    else if (def->isa<PrimOp>() && is_const(def))
-        return primop2str_[def];
-    else
-        return def2str_[def];
-}
+std::string CCodeGen::emit_lit(const Lit* lit) {
+    auto type = lit->type();
+    if (auto real = isa<Tag::Real>(type)) {
+        auto val = width(type) == 32 ? double(lit->get<r32>()) : lit->get<r64>();
+        if (std::isnan(val)) return "NAN";
+        if (std::isinf(val)) return val < 0 ? "-INFINITY" : "INFINITY";
+        std::ostringstream os;
+        os << std::hexfloat << val << (width(type) == 32 ? "f" : "");
+        return os.str();
+    }
 
-const std::string CCodeGen::var_name(const Def* def) {
-    if (def->isa<PrimOp>() && is_const(def))
-        return def->unique_name() + "_" + std::to_string(primop_counter++);
-    else
-        return def->unique_name();
+    auto w = width(type);
+    auto val = lit->get<u64>();
+    if (w == 1) return val & 1 ? "true" : "false";
+    if (w < 64) val &= (1_u64 << w) - 1_u64;
+    return std::to_string(val) + (w == 64 ? "ull" : "u");
 }
-const std::string CCodeGen::get_lang() const {
-    switch (lang_) {
-        default:
-        case Lang::C99:    return "C99";
-        case Lang::HLS:    return "HLS";
-        case Lang::CUDA:   return "CUDA";
-        case Lang::OPENCL: return "OpenCL";
+
+/// The initializer of a @p Global - C requires a constant expression.
+std::string CCodeGen::emit_constant(const Def* def) {
+    if (auto lit = def->isa<Lit>()) return emit_lit(lit);
+    if (def->isa<Bot>()) return "{ 0 }";
+
+    std::vector<std::string> elems;
+    if (auto tuple = def->isa<Tuple>()) {
+        for (auto op : tuple->ops()) elems.emplace_back(emit_constant(op));
+    } else if (auto pack = def->isa<Pack>(); pack && isa_lit(pack->shape())) {
+        elems.resize(as_lit(pack->shape()), emit_constant(pack->body()));
+    } else {
+        world().edef(def, "C backend: initializer '{}' is not a constant", def);
     }
+
+    auto res = "{ " + list(elems) + " }";
+    return def->type()->isa<Arr>() && !vector_lanes(def->type()) ? "{ " + res + " }" : res;
 }
 
-void CCodeGen::insert(const Def* def, std::string str) {
-    if (def->isa<Global>())
-        global2str_[def] = str;
-    else if (def->isa<PrimOp>() && is_const(def))
-        primop2str_[def] = str;
-    else
-        def2str_[def] = str;
+std::string CCodeGen::emit_global(const Global* global) {
+    if (auto name = globals_.lookup(global)) return *name;
+
+    if (global->init()->isa_nom<Lam>())
+        world().edef(global, "C backend: function pointer '{}' is not supported", global);
+
+    auto name = id(global);
+    vars_decls_.fmt("\nstatic {} {} = {};", convert(global->alloced_type()), name, emit_constant(global->init()));
+    return globals_[global] = "(&" + name + ")";
 }
 
-bool CCodeGen::is_texture_type(const Def* type) {
-    if (auto ptr = type->isa<PtrType>()) {
-        if (ptr->addr_space()==AddrSpace::Texture) {
-            assert(lang_==Lang::CUDA && "Textures currently only supported in CUDA");
-            return true;
+std::string CCodeGen::emit(const Def* def) {
+    if (is_void(def->type())) {
+        // side effects only
+    } else if (auto [axiom, currying_depth] = get_axiom(def); axiom && currying_depth == 0 && is_binop(axiom->tag())) {
+        auto app = def->as<App>();
+        auto [a, b] = app->args<2>([&](auto def) { return lookup(def); });
+        return bind(def, emit_binop(app->decurry(), app->arg(0)->type(), a, b));
+    } else if (auto div = isa<Tag::Div>(def)) {
+        auto [m, aa, bb] = div->args<3>();
+        auto a = lookup(aa), b = lookup(bb);
+        auto type = aa->type();
+        auto s = [&](const std::string& x) { return "(" + convert_signed(type) + ")" + x; };
+        switch (div.flags()) {
+            case Div::sdiv: return bind(def, convert(type), s(a) + " / " + s(b));
+            case Div::udiv: return bind(def, convert(type),   a  + " / " +   b );
+            case Div::srem: return bind(def, convert(type), s(a) + " % " + s(b));
+            case Div::urem: return bind(def, convert(type),   a  + " % " +   b );
+            default: THORIN_UNREACHABLE;
+        }
+    } else if (auto fma = isa<Tag::FMA>(def)) {
+        auto [a, b, c] = fma->args<3>([&](auto def) { return lookup(def); });
+        // with contract, the C compiler may still split the op if the target doesn't have a fused instruction
+        if (as_lit(fma->decurry()->arg(0)) & RMode::contract) {
+            use_contract_ = true;
+            return bind(def, a + " * " + b + " + " + c);
+        }
+        return bind(def, (width(def->type()) == 32 ? "fmaf(" : "fma(") + a + ", " + b + ", " + c + ")");
+    } else if (auto conv = isa<Tag::Conv>(def)) {
+        return bind(def, emit_conv(conv->decurry(), lookup(conv->arg())));
+    } else if (auto lift = isa<Tag::Lift>(def)) {
+        return emit_lift(lift);
+    } else if (auto hint = isa<Tag::Hint>(def)) {
+        return lookup(hint->arg());
+    } else if (auto bitcast = isa<Tag::Bitcast>(def)) {
+        auto src = lookup(bitcast->arg());
+        auto src_type_ptr = isa<Tag::Ptr>(bitcast->arg()->type());
+        auto dst_type_ptr = isa<Tag::Ptr>(bitcast->type());
+        if (src_type_ptr && dst_type_ptr) return bind(def, "(" + convert(def->type()) + ")" + src);
+        if (src_type_ptr || dst_type_ptr) return bind(def, "(" + convert(def->type()) + ")(uintptr_t)" + src);
+        // C99 allows type punning through unions
+        declare("union { " + convert(bitcast->arg()->type()) + " src; " + convert(def->type()) + " dst; }", id(def) + "_cast");
+        bb_->fmt("\n{}_cast.src = {};", id(def), src);
+        return bind(def, id(def) + "_cast.dst");
+    } else if (auto lea = isa<Tag::LEA>(def)) {
+        auto [ptr, index] = lea->args<2>();
+        auto pointee = as<Tag::Ptr>(ptr->type())->arg(0);
+        if (pointee->isa<Sigma>())
+            return bind(def, "&" + lookup(ptr) + "->e" + std::to_string(as_lit(index)));
+        assert(pointee->isa<Arr>());
+        // C doesn't allow to take the address of a vector element
+        if (vector_lanes(pointee))
+            return bind(def, "(" + convert(pointee->as<Arr>()->body()) + "*)" + lookup(ptr) + " + " + lookup(index));
+        if (isa_lit(pointee->as<Arr>()->shape()))
+            return bind(def, "&" + lookup(ptr) + "->e[" + lookup(index) + "]");
+        return bind(def, lookup(ptr) + " + " + lookup(index));
+    } else if (auto trait = isa<Tag::Trait>(def)) {
+        auto type = convert(trait->arg());
+        switch (trait.flags()) {
+            case Trait::size:  return bind(def, "sizeof(" + type + ")");
+            case Trait::align: return bind(def, "offsetof(struct { char c; " + type + " t; }, t)");
+            default: THORIN_UNREACHABLE;
+        }
+    } else if (auto alloc = isa<Tag::Alloc>(def)) {
+        auto alloced_type = alloc->decurry()->arg(0);
+        std::string size;
+        if (auto arr = alloced_type->isa<Arr>(); arr && !isa_lit(arr->shape()))
+            size = "sizeof(" + convert(arr->body()) + ") * " + lookup(arr->shape());
+        else
+            size = "sizeof(" + convert(alloced_type) + ")";
+        if (lang_ == Lang::HLS) world().edef(def, "C backend: HLS doesn't support the dynamic allocation '{}'", def);
+        use_alloc_ = true;
+        return bind(def, convert(def->type()->op(1)), "anydsl_alloc(0, " + size + ")");
+    } else if (auto slot = isa<Tag::Slot>(def)) {
+        auto alloced_type = slot->decurry()->arg(0);
+        declare(convert(alloced_type), id(def) + "_slot");
+        return bind(def, convert(def->type()->op(1)), "&" + id(def) + "_slot");
+    } else if (auto load = isa<Tag::Load>(def)) {
+        auto [mem, ptr] = load->args<2>();
+        return bind(def, convert(def->type()->op(1)), "*" + lookup(ptr));
+    } else if (auto tuple = def->isa<Tuple>()) {
+        std::vector<std::string> elems;
+        for (size_t i = 0, e = tuple->num_ops(); i != e; ++i) {
+            auto op = tuple->op(i);
+            if (is_void(op->type())) continue;
+            elems.emplace_back(def->type()->isa<Arr>() ? lookup(op) : ".e" + std::to_string(i) + " = " + lookup(op));
         }
+        auto init = "{ " + list(elems) + " }";
+        return bind(def, def->type()->isa<Arr>() && !vector_lanes(def->type()) ? "{ " + init + " }" : init);
+    } else if (auto pack = def->isa<Pack>()) {
+        auto name = id(def);
+        if (auto lanes = vector_lanes(def->type()); lanes && !pack->body()->isa<Bot>())
+            return bind(def, "{ " + list(std::vector<std::string>(lanes, lookup(pack->body()))) + " }");
+        emit_loc(def);
+        declare(convert(def->type()), name);
+        if (!pack->body()->isa<Bot>())
+            bb_->fmt("\nfor (size_t i = 0; i != {}; ++i) {} = {};", as_lit(pack->shape()), elem(def->type(), name, "i"), lookup(pack->body()));
+        return name;
+    } else if (auto select = is_select(def)) {
+        auto [f, t] = select->tuple()->projs<2>();
+        return bind(def, lookup(select->index()) + " ? " + lookup(t) + " : " + lookup(f));
+    } else if (auto extract = def->isa<Extract>()) {
+        if (is_memop(extract->tuple())) return lookup(extract->tuple());
+        auto agg = lookup(extract->tuple());
+        if (extract->tuple()->type()->isa<Arr>()) return bind(def, elem(extract->tuple()->type(), agg, lookup(extract->index())));
+        return bind(def, agg + ".e" + std::to_string(as_lit(extract->index())));
+    } else if (auto insert = def->isa<Insert>()) {
+        auto name = bind(def, lookup(insert->tuple()));
+        if (insert->tuple()->type()->isa<Arr>())
+            bb_->fmt("\n{} = {};", elem(insert->tuple()->type(), name, lookup(insert->index())), lookup(insert->value()));
+        else
+            bb_->fmt("\n{}.e{} = {};", name, as_lit(insert->index()), lookup(insert->value()));
+        return name;
+    } else if (auto lit = def->isa<Lit>()) {
+        return emit_lit(lit);
+    } else if (def->isa<Bot>()) {
+        auto name = id(def);
+        declare(convert(def->type()), name);
+        return name;
+    } else if (auto global = def->isa<Global>()) {
+        return emit_global(global);
+    } else {
+        world().edef(def, "C backend: '{}' is not supported", def);
+    }
+
+    // only memory ops remain
+    if (auto store = isa<Tag::Store>(def)) {
+        auto [mem, ptr, val] = store->args<3>();
+        emit_loc(def);
+        bb_->fmt("\n*{} = {};", lookup(ptr), lookup(val));
+    } else if (auto remem = isa<Tag::Remem>(def)) {
+        lookup(remem->arg());
     }
-    return false;
+    return {};
 }
 
 //------------------------------------------------------------------------------
 
-void emit_c(World& world, const Cont2Config& kernel_config, std::ostream& stream, Lang lang, bool debug) { CCodeGen(world, kernel_config, stream, lang, debug).emit(); }
+void emit_c(World& world, const Cont2Config& kernel_config, std::ostream& stream, Lang lang, bool debug, bool simd) {
+    if (lang != Lang::C99 && lang != Lang::HLS) {
+        world.log(LogLevel::Warn, {}, "C backend: only C99 and HLS have been ported to the current IR - no code emitted for '{}'", world.name());
+        return;
+    }
+
+    CCodeGen(world, kernel_config, stream, lang, debug, simd).emit_module();
+}
 
 //------------------------------------------------------------------------------
 
 }
-#endif
@@ -18,8 +18,15 @@ enum class Lang : uint8_t {
     OPENCL  ///< Flag for OpenCL
 };
 
-inline void emit_c(World&, const Cont2Config&, std::ostream&, Lang, bool) {}
-//void emit_c(World&, const Cont2Config& kernel_config, std::ostream& stream, Lang lang, bool debug);
+/**
+ * Emits @p world as source code in @p lang to @p stream.
+ * @c Lang::C99 covers the code of the CPU and only needs a C99 compiler - the functions which @p world doesn't define are resolved when linking.
+ * With @p simd, small arrays of integers or floats become the vector types of GCC/Clang and @c lift%s their lane-wise operators; without, the output is plain C99.
+ * @c Lang::HLS emits the same C plus the @c "#pragma HLS" directives for pipelining, unrolling, dataflow and array partitioning which the @p LoopTree of each kernel suggests;
+ * the sizes of array params come from the @p HLSKernelConfig in @p kernel_config.
+ * The other @p Lang%s haven't been ported to the current IR yet and emit nothing.
+ */
+void emit_c(World& world, const Cont2Config& kernel_config, std::ostream& stream, Lang lang, bool debug, bool simd = true);
 
 }
 
@@ -27,6 +27,7 @@ void AMDGPUCodeGen::emit_function_decl_hook(Lam* lam, llvm::Function* f) {
             annotation_values_wgsize[2] = llvm::ConstantAsMetadata::get(irbuilder_.getInt32(std::get<2>(block)));
             f->setMetadata(llvm::StringRef("reqd_work_group_size"),  llvm::MDNode::get(context_, llvm_ref(annotation_values_wgsize)));
         }
+        if (config->second->as<GPUKernelConfig>()->has_restrict()) emit_noalias(f);
     }
 }
 
@@ -12,6 +12,11 @@ public:
     AMDGPUCodeGen(World& world, const Cont2Config&);
 
 protected:
+    // each thread is scalar - vectorizing within a thread only adds register pressure
+    virtual Pipeline tune(Pipeline pipeline) const override {
+        pipeline.vectorize_loops = pipeline.vectorize_slp = pipeline.interleave_loops = false;
+        return pipeline;
+    }
     virtual void emit_function_decl_hook(Lam*, llvm::Function*) override;
     virtual unsigned convert_addr_space(u64) override;
     virtual llvm::Value* emit_global(const Global*) override;
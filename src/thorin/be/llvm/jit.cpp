@@ -0,0 +1,110 @@
+#include "thorin/be/llvm/jit.h"
+
+#include <stdexcept>
+#include <utility>
+
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/ExecutionEngine/ObjectCache.h>
+#include <llvm/ExecutionEngine/Orc/CompileUtils.h>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "thorin/world.h"
+#include "thorin/be/llvm/cpu.h"
+#include "thorin/be/llvm/object_cache.h"
+
+namespace thorin {
+
+template<class T>
+static T unwrap(llvm::Expected<T> expected, const std::string& what) {
+    if (!expected) throw std::runtime_error(what + ": " + llvm::toString(expected.takeError()));
+    return std::forward<T>(*expected);
+}
+
+static void check(llvm::Error error, const std::string& what) {
+    if (error) throw std::runtime_error(what + ": " + llvm::toString(std::move(error)));
+}
+
+namespace {
+
+/// Adapts an @p ObjectCache for the modules compiled by the JIT - each of which holds a part of a @p World.
+class JITCache : public llvm::ObjectCache {
+public:
+    JITCache(thorin::ObjectCache& cache, std::string config)
+        : cache_(cache)
+        , config_(std::move(config))
+    {}
+
+    void notifyObjectCompiled(const llvm::Module* module, llvm::MemoryBufferRef object) override {
+        cache_.store(thorin::ObjectCache::key(*module, config_), object.getBuffer());
+    }
+    std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module* module) override {
+        return cache_.load(thorin::ObjectCache::key(*module, config_));
+    }
+
+private:
+    thorin::ObjectCache& cache_;
+    std::string config_;
+};
+
+}
+
+JIT::JIT(int opt, ObjectCache* cache)
+    : opt_(opt)
+{
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+
+    llvm::orc::LLLazyJITBuilder builder;
+    if (cache != nullptr) {
+        builder.setCompileFunctionCreator([&](llvm::orc::JITTargetMachineBuilder machine) -> llvm::Expected<std::unique_ptr<llvm::orc::IRCompileLayer::IRCompiler>> {
+            auto config = machine.getTargetTriple().str() + ';' + machine.getCPU() + ';' + machine.getFeatures().getString() + ";jit";
+            cache_ = std::make_unique<JITCache>(*cache, config);
+            return std::make_unique<llvm::orc::ConcurrentIRCompiler>(std::move(machine), cache_.get());
+        });
+    }
+    jit_ = unwrap(builder.create(), "cannot create JIT");
+}
+
+JIT::~JIT() {}
+
+JIT::Module JIT::add(World& world) {
+    // a CodeGen owns its llvm::LLVMContext whereas the JIT needs to own the one of each module - so we hand the module over as bitcode
+    llvm::SmallVector<char, 0> bitcode;
+    {
+        CPUCodeGen codegen(world);
+        auto& module = codegen.emit(opt_, false);
+        if (module->getTargetTriple() != jit_->getTargetTriple().str())
+            throw std::runtime_error("cannot JIT-compile for target '" + module->getTargetTriple() + "'");
+        llvm::raw_svector_ostream os(bitcode);
+        llvm::WriteBitcodeToFile(*module, os);
+    }
+
+    auto context = std::make_unique<llvm::LLVMContext>();
+    auto buffer  = llvm::MemoryBufferRef(llvm::StringRef(bitcode.data(), bitcode.size()), world.name());
+    auto module  = unwrap(llvm::parseBitcodeFile(buffer, *context), "cannot load module");
+
+    auto& dylib = unwrap<llvm::orc::JITDylib&>(jit_->createJITDylib(world.name() + "." + std::to_string(modules_.size())), "cannot create module");
+    auto prefix = jit_->getDataLayout().getGlobalPrefix();
+    dylib.addGenerator(unwrap(llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(prefix), "cannot access host process"));
+    check(jit_->addLazyIRModule(dylib, llvm::orc::ThreadSafeModule(std::move(module), std::move(context))), "cannot add module");
+
+    modules_.emplace_back(&dylib);
+    return modules_.size() - 1;
+}
+
+void* JIT::lookup(Module module, const std::string& name) {
+    auto symbol = unwrap(jit_->lookup(*modules_[module], name), "cannot find '" + name + "'");
+#if LLVM_VERSION_MAJOR >= 15
+    return symbol.toPtr<void*>();
+#else
+    return reinterpret_cast<void*>(symbol.getAddress());
+#endif
+}
+
+}
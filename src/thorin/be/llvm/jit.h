@@ -0,0 +1,50 @@
+#ifndef THORIN_BE_LLVM_JIT_H
+#define THORIN_BE_LLVM_JIT_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace llvm {
+class ObjectCache;
+namespace orc {
+class JITDylib;
+class LLLazyJIT;
+}
+}
+
+namespace thorin {
+
+class ObjectCache;
+class World;
+
+/**
+ * Compiles @p World%s in-process via the @p CPUCodeGen and LLVM's ORC JIT.
+ * Each top-level function is only compiled to machine code on its first call.
+ * Symbols that a @p World doesn't define - like the @c anydsl_* functions of the runtime - are resolved from the host process.
+ * With an @p ObjectCache, machine code of functions which have been compiled before - possibly by another process - is reused.
+ */
+class JIT {
+public:
+    /// A compiled @p World; the externals of different @p World%s may have the same names.
+    using Module = size_t;
+
+    explicit JIT(int opt = 2, ObjectCache* cache = nullptr);
+    ~JIT();
+
+    Module add(World&);
+    /// The address of the external @p name of @p module.
+    void* lookup(Module module, const std::string& name);
+    template<class F>
+    F* function(Module module, const std::string& name) { return reinterpret_cast<F*>(lookup(module, name)); }
+
+private:
+    int opt_;
+    std::unique_ptr<llvm::ObjectCache> cache_;
+    std::unique_ptr<llvm::orc::LLLazyJIT> jit_;
+    std::vector<llvm::orc::JITDylib*> modules_;
+};
+
+}
+
+#endif
@@ -1,28 +1,32 @@
 #include "thorin/be/llvm/llvm.h"
 
 #include <algorithm>
+#include <deque>
+#include <exception>
 #include <stdexcept>
+#include <thread>
 
 #include <llvm/ADT/Triple.h>
+#include <llvm/Analysis/AliasAnalysis.h>
 #include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Config/llvm-config.h>
 #include <llvm/IR/Constant.h>
 #include <llvm/IR/Constants.h>
 #include <llvm/IR/Function.h>
 #include <llvm/IR/GlobalVariable.h>
 #include <llvm/IR/InlineAsm.h>
 #include <llvm/IR/Instructions.h>
+#include <llvm/IR/LegacyPassManager.h>
 #include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/MDBuilder.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Type.h>
 #include <llvm/IR/Verifier.h>
-#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/Passes/PassBuilder.h>
 #include <llvm/Support/Host.h>
 #include <llvm/Support/Path.h>
 #include <llvm/Support/raw_os_ostream.h>
 #include <llvm/Support/FileSystem.h>
-#include <llvm/Transforms/IPO/PassManagerBuilder.h>
-#include <llvm/Transforms/Scalar.h>
-#include <llvm/Transforms/IPO.h>
 
 #include "thorin/config.h"
 #if THORIN_ENABLE_RV
@@ -31,6 +35,7 @@
 
 #include "thorin/def.h"
 #include "thorin/world.h"
+#include "thorin/analyses/looptree.h"
 #include "thorin/analyses/schedule.h"
 #include "thorin/analyses/scope.h"
 #include "thorin/be/llvm/amdgpu.h"
@@ -38,10 +43,14 @@
 #include "thorin/be/llvm/cuda.h"
 #include "thorin/be/llvm/hls.h"
 #include "thorin/be/llvm/nvvm.h"
+#include "thorin/be/llvm/object_cache.h"
 #include "thorin/be/llvm/opencl.h"
 #include "thorin/pass/optimize.h"
+#include "thorin/pass/rw/ret_wrap.h"
 #include "thorin/transform/cleanup_world.h"
+#include "thorin/transform/grid_emulation.h"
 #include "thorin/util/array.h"
+#include "thorin/util/container.h"
 
 namespace thorin {
 
@@ -57,30 +66,17 @@ CodeGen::CodeGen(World& world, llvm::CallingConv::ID function_calling_convention
     , runtime_(new Runtime(context_, *module_.get(), irbuilder_))
 {}
 
-Lam* CodeGen::emit_intrinsic(Lam*) {
-    /*
-    auto callee = lam->body()->as<App>()->callee()->as_nom<Lam>();
-    switch (callee->intrinsic()) {
-        case Lam::Intrinsic::Atomic:    return emit_atomic(lam);
-        case Lam::Intrinsic::CmpXchg:   return emit_cmpxchg(lam);
-        case Lam::Intrinsic::Reserve:   return emit_reserve(lam);
-        case Lam::Intrinsic::CUDA:      return runtime_->emit_host_code(*this, Runtime::CUDA_PLATFORM,   ".cu",     lam);
-        case Lam::Intrinsic::NVVM:      return runtime_->emit_host_code(*this, Runtime::CUDA_PLATFORM,   ".nvvm",   lam);
-        case Lam::Intrinsic::OpenCL:    return runtime_->emit_host_code(*this, Runtime::OPENCL_PLATFORM, ".cl",     lam);
-        case Lam::Intrinsic::AMDGPU:    return runtime_->emit_host_code(*this, Runtime::HSA_PLATFORM,    ".amdgpu", lam);
-        case Lam::Intrinsic::HLS:       return emit_hls(lam);
-        case Lam::Intrinsic::Parallel:  return emit_parallel(lam);
-        case Lam::Intrinsic::Spawn:     return emit_spawn(lam);
-        case Lam::Intrinsic::Sync:      return emit_sync(lam);
-#if THORIN_ENABLE_RV
-        case Lam::Intrinsic::Vectorize: return emit_vectorize_lam(lam);
-#else
-        case Lam::Intrinsic::Vectorize: throw std::runtime_error("rebuild with RV support");
-#endif
+Lam* CodeGen::emit_intrinsic(Lam* lam) {
+    const auto& launch = launches_[lam->body()->as<App>()->callee()->as_nom<Lam>()];
+    auto kernel = isa<Tag::Acc>(launch.body)->arg(1)->as_nom<Lam>();
+    switch (launch.acc) {
+        case Acc::parallel: return emit_parallel(lam);
+        case Acc::cuda:     return runtime_->emit_host_code(*this, Runtime::CUDA_PLATFORM,   ".cu",     lam, kernel);
+        case Acc::nvvm:     return runtime_->emit_host_code(*this, Runtime::CUDA_PLATFORM,   ".nvvm",   lam, kernel);
+        case Acc::opencl:   return runtime_->emit_host_code(*this, Runtime::OPENCL_PLATFORM, ".cl",     lam, kernel);
+        case Acc::amdgpu:   return runtime_->emit_host_code(*this, Runtime::HSA_PLATFORM,    ".amdgpu", lam, kernel);
         default: THORIN_UNREACHABLE;
     }
-    */
-    return nullptr;
 }
 
 Lam* CodeGen::emit_hls(Lam* lam) {
@@ -101,7 +97,7 @@ Lam* CodeGen::emit_hls(Lam* lam) {
 }
 
 void CodeGen::emit_result_phi(const Def* var, llvm::Value* value) {
-    phis_.lookup(var).value()->addIncoming(value, irbuilder_.GetInsertBlock());
+    llvm::cast<llvm::PHINode>(*values_[number(var)])->addIncoming(value, irbuilder_.GetInsertBlock());
 }
 
 Lam* CodeGen::emit_atomic(Lam* lam) {
@@ -115,7 +111,7 @@ Lam* CodeGen::emit_atomic(Lam* lam) {
     assert(int(llvm::AtomicRMWInst::BinOp::Xchg) <= int(tag) && int(tag) <= int(llvm::AtomicRMWInst::BinOp::UMin) && "unsupported atomic");
     auto binop = (llvm::AtomicRMWInst::BinOp)tag;
     auto l = lam->body()->as<App>()->arg(4)->as_nom<Lam>();
-    auto call = irbuilder_.CreateAtomicRMW(binop, ptr, val, llvm::AtomicOrdering::SequentiallyConsistent, llvm::SyncScope::System);
+    auto call = irbuilder_.CreateAtomicRMW(binop, ptr, val, llvm::MaybeAlign(), llvm::AtomicOrdering::SequentiallyConsistent, llvm::SyncScope::System);
     emit_result_phi(l->var(1), call);
     return l;
 }
@@ -128,7 +124,7 @@ Lam* CodeGen::emit_cmpxchg(Lam* lam) {
     auto cmp  = lookup(lam->body()->as<App>()->arg(2));
     auto val  = lookup(lam->body()->as<App>()->arg(3));
     auto l = lam->body()->as<App>()->arg(4)->as_nom<Lam>();
-    auto call = irbuilder_.CreateAtomicCmpXchg(ptr, cmp, val, llvm::AtomicOrdering::SequentiallyConsistent, llvm::AtomicOrdering::SequentiallyConsistent, llvm::SyncScope::System);
+    auto call = irbuilder_.CreateAtomicCmpXchg(ptr, cmp, val, llvm::MaybeAlign(), llvm::AtomicOrdering::SequentiallyConsistent, llvm::AtomicOrdering::SequentiallyConsistent, llvm::SyncScope::System);
     emit_result_phi(l->var(1), irbuilder_.CreateExtractValue(call, 0));
     emit_result_phi(l->var(2), irbuilder_.CreateExtractValue(call, 1));
     return l;
@@ -148,7 +144,7 @@ Lam* CodeGen::emit_reserve_shared(Lam* lam, bool init_undef) {
     auto type = convert(lam->var(1)->type());
     // construct array type
     auto elem_type = as<Tag::Ptr>(l->var(1)->type())->arg(0)->as<Arr>()->body();
-    auto smem_type = this->convert(lam->world().arr(num_elems, elem_type));
+    auto smem_type = convert_in_memory(lam->world().arr(num_elems, elem_type));
     auto name = lam->unique_name();
     // NVVM doesn't allow '.' in global identifier
     std::replace(name.begin(), name.end(), '.', '_');
@@ -173,6 +169,194 @@ llvm::FunctionType* CodeGen::convert_fn_type(Lam* lam) {
     return llvm::cast<llvm::FunctionType>(convert(lam->type()));
 }
 
+/// The pointer of the @c alloc or @c slot which @p def points into - through @c bitcast%s and @c lea%s - or @c nullptr.
+static const Def* isa_fresh(const Def* def) {
+    while (true) {
+        if (auto bitcast = isa<Tag::Bitcast>(def))
+            def = bitcast->arg();
+        else if (auto lea = isa<Tag::LEA>(def))
+            def = lea->arg(0);
+        else
+            break;
+    }
+    if (auto extract = def->isa<Extract>(); extract && isa<Tag::Ptr>(def->type()) && (isa<Tag::Alloc>(extract->tuple()) || isa<Tag::Slot>(extract->tuple()))) return def;
+    return nullptr;
+}
+
+static bool escapes(const Def* ptr, DefSet& done);
+
+/// Does a pointer escape as the @p i%th of the @p n args of @p app?
+static bool escapes(const App* app, size_t i, size_t n, DefSet& done) {
+    if (isa<Tag::Load>(app))    return false;
+    if (isa<Tag::Store>(app))   return i != 1;
+    if (isa<Tag::LEA>(app))     return i != 0 || escapes(app, done);
+    if (isa<Tag::Bitcast>(app)) return escapes(app, done);
+
+    // passing it to a param of a function is fine if the function doesn't let it escape either
+    auto lam = app->callee()->isa_nom<Lam>();
+    if (lam == nullptr || !lam->is_set() || lam->is_external() || !lam->is_returning()) return true;
+    if (n != 1 && !std::all_of(lam->var()->uses().begin(), lam->var()->uses().end(), [](Use use) { return use->isa<Extract>(); })) return true;
+    return escapes(lam->var(n, i), done);
+}
+
+/**
+ * Does @p ptr escape - can it be reached by other means than @p ptr itself?
+ * It doesn't if it's only loaded from, stored to, offset, cast or passed to functions which don't let it escape either.
+ * Recursive functions are assumed to not let it escape while they are being checked.
+ */
+static bool escapes(const Def* ptr, DefSet& done) {
+    if (!done.emplace(ptr).second) return false;
+
+    for (auto use : ptr->uses()) {
+        if (auto app = use->isa<App>()) {
+            if (use.index() == 0 || escapes(app, 0, 1, done)) return true;
+        } else if (auto tuple = use->isa<Tuple>()) {
+            for (auto arg_use : tuple->uses()) {
+                auto app = arg_use->isa<App>();
+                if (app == nullptr || arg_use.index() != 1 || escapes(app, use.index(), tuple->num_ops(), done)) return true;
+            }
+        } else {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Is the @p i%th param of @p lam @c noalias?
+ * This is the case if each call passes a fresh pointer - see @p isa_fresh - which doesn't escape and none of the other args points into the same allocation.
+ */
+static bool is_noalias(Lam* lam, size_t i) {
+    if (!lam->is_set() || lam->is_external() || lam->uses().empty()) return false;
+
+    auto n = lam->num_vars();
+    for (auto use : lam->uses()) {
+        if (use->isa<Var>()) continue;
+        auto app = use->isa<App>();
+        if (app == nullptr || use.index() != 0) return false;
+
+        auto fresh = isa_fresh(app->arg(n, i));
+        if (fresh == nullptr) return false;
+        for (size_t j = 0; j != n; ++j) {
+            if (j != i && isa_fresh(app->arg(n, j)) == fresh) return false;
+        }
+
+        DefSet done;
+        if (escapes(fresh, done)) return false;
+    }
+    return true;
+}
+
+/**
+ * Is the @p i%th param of @p lam dereferenceable for the whole size of its pointee?
+ * This is the case if each call passes a fresh pointer - see @p isa_fresh - to an allocation of exactly the param's type.
+ */
+static bool is_dereferenceable(Lam* lam, size_t i) {
+    if (!lam->is_set() || lam->is_external() || lam->uses().empty()) return false;
+
+    auto n = lam->num_vars();
+    for (auto use : lam->uses()) {
+        if (use->isa<Var>()) continue;
+        auto app = use->isa<App>();
+        if (app == nullptr || use.index() != 0) return false;
+
+        auto arg = app->arg(n, i);
+        if (isa_fresh(arg) != arg) return false;
+    }
+    return true;
+}
+
+/// Do all values of @p type have the same size - i.e. it contains no @p Arr of unknown shape?
+static bool has_static_size(const Def* type) {
+    if (auto arr = type->isa<Arr>()) return isa_lit(arr->shape()) && has_static_size(arr->body());
+    if (auto sigma = type->isa<Sigma>()) return std::all_of(sigma->ops().begin(), sigma->ops().end(), has_static_size);
+    return true;
+}
+
+void CodeGen::emit_param_attrs(llvm::Argument* arg, Lam* lam, size_t i) {
+    auto ptr = isa<Tag::Ptr>(lam->dom(i));
+    if (!ptr) return;
+
+    if (auto pointee = ptr->arg(0); has_static_size(pointee) && is_dereferenceable(lam, i)) {
+        if (auto size = module_->getDataLayout().getTypeAllocSize(convert_in_memory(pointee)); size != 0)
+            arg->addAttr(llvm::Attribute::getWithDereferenceableBytes(context_, size));
+    }
+    if (is_noalias(lam, i)) arg->addAttr(llvm::Attribute::NoAlias);
+}
+
+void CodeGen::emit_noalias(llvm::Function* f) {
+    for (auto& arg : f->args()) {
+        if (arg.getType()->isPointerTy()) arg.addAttr(llvm::Attribute::NoAlias);
+    }
+}
+
+/// The @p Hint @p o among the @p Hint%s wrapped around the condition @p cond - if any.
+static const App* isa_hint(Hint o, const Def* cond) {
+    for (auto hint = isa<Tag::Hint>(cond); hint; hint = isa<Tag::Hint>(hint->arg())) {
+        if (hint.flags() == o) return hint;
+    }
+    return nullptr;
+}
+
+static void collect(const LoopTree<true>::Base* node, LamSet& body) {
+    for (auto n : node->cf_nodes()) {
+        if (auto lam = n->nom()->isa_nom<Lam>()) body.emplace(lam);
+    }
+
+    if (auto head = node->isa<LoopTree<true>::Head>()) {
+        for (const auto& child : head->children())
+            collect(child.get(), body);
+    }
+}
+
+/**
+ * Translates the @c Hint::loop on the exit condition of each loop header in @p scope to @c llvm.loop metadata.
+ * LLVM looks for this metadata on the terminators of the latches: the returned map assigns it to the @p Lam%s which jump back to the header.
+ */
+LamMap<llvm::MDNode*> CodeGen::emit_loop_hints(const Scope& scope) {
+    LamMap<llvm::MDNode*> latches;
+    const auto& cfg = scope.f_cfg();
+    auto i32 = [&](nat_t n) { return llvm::ConstantAsMetadata::get(irbuilder_.getInt32(u32(n))); };
+
+    auto visit = [&](const LoopTree<true>::Head* loop, auto visit) -> void {
+        for (auto cf_node : loop->is_root() ? ArrayRef<const CFNode*>() : loop->cf_nodes()) {
+            auto header = cf_node->nom()->isa_nom<Lam>();
+            auto app    = header && header->is_set() ? header->body()->isa<App>() : nullptr;
+            auto select = app ? app->callee()->isa<Extract>() : nullptr;
+            auto hint   = select ? isa_hint(Hint::loop, select->index()) : nullptr;
+            if (hint == nullptr) continue;
+
+            std::vector<llvm::Metadata*> ops = { nullptr }; // the self reference which keeps the node distinct
+            auto add = [&](const char* name, llvm::Metadata* value = nullptr) {
+                std::vector<llvm::Metadata*> option = { llvm::MDString::get(context_, name) };
+                if (value) option.emplace_back(value);
+                ops.emplace_back(llvm::MDNode::get(context_, option));
+            };
+            auto [vectorize, interleave, unroll] = hint->decurry()->args<3>(as_lit<nat_t>);
+            if (vectorize == 1) add("llvm.loop.vectorize.enable", llvm::ConstantAsMetadata::get(irbuilder_.getFalse()));
+            if (vectorize >  1) add("llvm.loop.vectorize.enable", llvm::ConstantAsMetadata::get(irbuilder_.getTrue())), add("llvm.loop.vectorize.width", i32(vectorize));
+            if (interleave != 0) add("llvm.loop.interleave.count", i32(interleave));
+            if (unroll == 1) add("llvm.loop.unroll.disable");
+            if (unroll >  1) add("llvm.loop.unroll.count", i32(unroll));
+            auto md = llvm::MDNode::getDistinct(context_, ops);
+            md->replaceOperandWith(0, md);
+
+            LamSet body;
+            collect(loop, body);
+            for (auto pred : cfg.preds(header)) {
+                if (auto lam = pred->nom()->isa_nom<Lam>(); lam && body.contains(lam)) latches[lam] = md;
+            }
+        }
+
+        // the hints of an inner loop win if a latch jumps back to several headers
+        for (const auto& child : loop->children()) {
+            if (auto inner = child->isa<LoopTree<true>::Head>()) visit(inner, visit);
+        }
+    };
+    visit(cfg.looptree().root(), visit);
+    return latches;
+}
+
 llvm::Function* CodeGen::emit_function_decl(Lam* lam) {
     if (auto f = fcts_.lookup(lam)) return *f;
 
@@ -191,10 +375,15 @@ llvm::Function* CodeGen::emit_function_decl(Lam* lam) {
 #endif
 
     // set linkage
-    if (!lam->is_set() || lam->is_external())
+    if (!lam->is_set() || lam->is_external()) {
         f->setLinkage(llvm::Function::ExternalLinkage);
-    else
+    } else if (partition_ != nullptr) {
+        // other partitions may call this function
+        f->setLinkage(llvm::Function::ExternalLinkage);
+        f->setVisibility(llvm::Function::HiddenVisibility);
+    } else {
         f->setLinkage(llvm::Function::InternalLinkage);
+    }
 
     // set calling convention
     if (lam->is_external()) {
@@ -211,6 +400,12 @@ llvm::Function* CodeGen::emit_function_decl(Lam* lam) {
 }
 
 std::unique_ptr<llvm::Module>& CodeGen::emit(int opt, bool debug) {
+    emit_module(opt, debug);
+    optimize(opt);
+    return module_;
+}
+
+void CodeGen::emit_module(int opt, bool debug) {
     llvm::DICompileUnit* dicompile_unit;
     if (debug) {
         module_->addModuleFlag(llvm::Module::Warning, "Debug Info Version", llvm::DEBUG_METADATA_VERSION);
@@ -220,9 +415,16 @@ std::unique_ptr<llvm::Module>& CodeGen::emit(int opt, bool debug) {
         dicompile_unit = dibuilder_.createCompileUnit(llvm::dwarf::DW_LANG_C, dibuilder_.createFile(world_.name(), llvm::StringRef()), "Impala", opt > 0, llvm::StringRef(), 0);
     }
 
+    // emit_partitioned outlines the kernels for all partitions
+    bool outline = partition_ == nullptr;
+    if (outline) launches_ = outline_kernels(world_);
+
     world_.visit([&](const Scope& scope) {
         entry_ = scope.entry()->isa<Lam>();
         if (entry_ == nullptr) return;
+        // direct-style lams only occur as lifted functions which emit_lift emits inline
+        if (!entry_->type()->is_cn()) return;
+        if (partition_ != nullptr && !partition_->contains(entry_)) return;
 
         assert(entry_->is_returning());
         llvm::Function* fct = emit_function_decl(entry_);
@@ -242,31 +444,47 @@ std::unique_ptr<llvm::Module>& CodeGen::emit(int opt, bool debug) {
             discope = disub_program;
         }
 
+        // number the vars of all basic blocks first and then the scheduled defs - see values_
+        Schedule schedule(scope);
+        for (const auto& block : schedule) {
+            if (block.nom() == schedule.exit()) continue;
+            for (auto var : block.nom()->as<Lam>()->vars()) number(var);
+        }
+        num_vars_ = u32(values_.size());
+        std::vector<u32> scheduled;         // the numbers of all scheduled defs in order - so emitting them needs no further lookups
+        for (const auto& block : schedule) {
+            if (block.nom() == schedule.exit()) continue;
+            for (auto def : block) scheduled.emplace_back(number(def));
+        }
+
         // map vars
         const Def* ret_var = nullptr;
         auto arg = fct->arg_begin();
-        for (auto var : entry_->vars()) {
+        for (size_t i = 0, e = entry_->num_vars(); i != e; ++i) {
+            auto var = entry_->var(e, i);
             if (isa<Tag::Mem>(var->type()) || is_unit(var)) {
-                vars_[var] = nullptr;
+                values_[number(var)] = nullptr;
             } else if (var->type()->order() == 0) {
                 auto argv = &*arg;
                 auto value = map_var(fct, argv, var);
                 if (value == argv) {
                     arg->setName(var->unique_name()); // use var
-                    vars_[var] = &*arg++;
+                    emit_param_attrs(argv, entry_, i);
+                    values_[number(var)] = &*arg++;
                 } else {
-                    vars_[var] = value;             // use provided value
+                    values_[number(var)] = value;   // use provided value
                 }
             } else {
                 assert(!ret_var);
                 ret_var = var;
-                vars_[var] = nullptr;
+                values_[number(var)] = nullptr;
             }
         }
         assert(ret_var);
 
         BBMap bb2lam;
-        Schedule schedule(scope);
+        // incoming jumps of all phis of each basic block - collected in one sweep over its callers
+        LamMap<std::vector<std::pair<Lam*, const App*>>> jumps;
 
         for (const auto& block : schedule) {
             auto nom = block.nom();
@@ -278,11 +496,21 @@ std::unique_ptr<llvm::Module>& CodeGen::emit(int opt, bool debug) {
 
             // create phi node stubs (for all lams different from entry)
             if (entry_ != lam) {
+                auto& preds = jumps[lam];
+                for (auto use : lam->uses()) {
+                    if (auto app = use->isa<App>(); app && use.index() == 0) {
+                        for (auto use : app->uses()) {
+                            if (auto pred = use->isa_nom<Lam>(); pred && pred->body() == app)
+                                preds.emplace_back(pred, app);
+                        }
+                    }
+                }
+
                 for (auto var : lam->vars()) {
                     auto phi = (isa<Tag::Mem>(var->type()) || is_unit(var))
                                 ? nullptr
-                                : llvm::PHINode::Create(convert(var->type()), (unsigned) peek(var).size(), var->debug().name, bb);
-                    phis_[var] = phi;
+                                : llvm::PHINode::Create(convert(var->type()), (unsigned) preds.size(), var->debug().name, bb);
+                    values_[number(var)] = phi;
                 }
             }
         }
@@ -297,6 +525,9 @@ std::unique_ptr<llvm::Module>& CodeGen::emit(int opt, bool debug) {
         emit_function_start(startBB, entry_);
         irbuilder_.CreateBr(&*oldStartBB);
 
+        auto latches = emit_loop_hints(scope);
+        color_slots(schedule);
+        auto next = scheduled.begin();
         for (auto& block : schedule) {
             auto nom = block.nom();
             if (nom == schedule.exit()) continue;
@@ -306,6 +537,7 @@ std::unique_ptr<llvm::Module>& CodeGen::emit(int opt, bool debug) {
             irbuilder_.SetInsertPoint(bb2lam[lam]);
 
             for (auto def : block) {
+                auto n = *next++;
                 if (debug) {
                     auto di_loc = llvm::DILocation::get(discope->getContext(), def->loc().begin.row, def->loc().begin.col, discope);
                     irbuilder_.SetCurrentDebugLocation(di_loc);
@@ -314,8 +546,7 @@ std::unique_ptr<llvm::Module>& CodeGen::emit(int opt, bool debug) {
                 if (def->isa<Var>())          continue;
                 if (def->type()->isa<Bot>())  continue;
                 if (is_tuple_arg_of_app(def)) continue;
-                if (phis_.  contains(def))    continue;
-                if (vars_.contains(def))      continue;
+                if (n < num_vars_)            continue;
 #if 0
                 // ignore tuple arguments for lams
                 if (auto tuple = def->isa<Tuple>()) {
@@ -338,7 +569,11 @@ std::unique_ptr<llvm::Module>& CodeGen::emit(int opt, bool debug) {
                 if (def->isa<Extract>() && def->type()->order() > 0) continue;
 
                 if (auto llvm_value = emit(def))
-                    defs_[def] = llvm_value;
+                    values_[n] = llvm_value;
+
+                if (auto slots = lifetime_ends_.lookup(def)) {
+                    for (auto slot : *slots) emit_lifetime(false, slot_colors_[slot2color_[slot]].storage);
+                }
             }
 
             // terminate bb
@@ -382,7 +617,11 @@ std::unique_ptr<llvm::Module>& CodeGen::emit(int opt, bool debug) {
                 auto cond = lookup(extract->index());
                 auto tbb = bb2lam[t->as_nom<Lam>()];
                 auto fbb = bb2lam[f->as_nom<Lam>()];
-                irbuilder_.CreateCondBr(cond, tbb, fbb);
+                auto br = irbuilder_.CreateCondBr(cond, tbb, fbb);
+                if (auto hint = isa_hint(Hint::branch, extract->index())) {
+                    auto [tw, fw] = hint->decurry()->args<2>(as_lit<nat_t>);
+                    br->setMetadata(llvm::LLVMContext::MD_prof, llvm::MDBuilder(context_).createBranchWeights(u32(tw), u32(fw)));
+                }
 #if 0
             } else if (lam->body()->as<App>()->callee()->isa<Lam>() &&
                        lam->body()->as<App>()->callee()->as<Lam>()->intrinsic() == Lam::Intrinsic::Match) {
@@ -396,6 +635,11 @@ std::unique_ptr<llvm::Module>& CodeGen::emit(int opt, bool debug) {
                     match->addCase(case_const, case_bb);
                 }
 #endif
+            } else if (auto stub = lam->body()->as<App>()->callee()->isa_nom<Lam>(); stub && launches_.contains(stub)) {
+                if (auto cont = emit_intrinsic(lam))
+                    irbuilder_.CreateBr(bb2lam[cont]);
+                else
+                    irbuilder_.CreateRetVoid(); // the launch continues with the return of the function - which only receives mem
             } else if (lam->body()->as<App>()->callee()->isa<Bot>()) {
                 irbuilder_.CreateUnreachable();
             } else {
@@ -481,22 +725,29 @@ std::unique_ptr<llvm::Module>& CodeGen::emit(int opt, bool debug) {
                     }
                 }
             }
+
+            if (auto loop = latches.lookup(lam)) irbuilder_.GetInsertBlock()->getTerminator()->setMetadata(llvm::LLVMContext::MD_loop, *loop);
         }
 
-        // add missing arguments to phis_
-        for (const auto& p : phis_) {
-            if (auto phi = p.second) {
-                auto var = p.first;
-                for (auto&& p : peek(var))
-                    phi->addIncoming(lookup(p.def()), bb2lam[p.from()]);
+        // add missing arguments to phis
+        for (const auto& [lam, preds] : jumps) {
+            for (size_t i = 0, e = lam->num_vars(); i != e; ++i) {
+                if (auto phi = llvm::cast_or_null<llvm::PHINode>(*values_[number(lam->var(i))])) {
+                    for (auto [pred, app] : preds)
+                        phi->addIncoming(lookup(app->arg(i)), bb2lam[pred]);
+                }
             }
         }
 
-        vars_.clear();
-        phis_.clear();
-        defs_.clear();
+        numbers_.clear();
+        values_.clear();
+        slot_colors_.clear();
+        slot2color_.clear();
+        lifetime_ends_.clear();
+        tmp_allocas_.clear();
     });
 
+    if (outline) restore_kernels(launches_);
     if (debug)
         dibuilder_.finalize();
 
@@ -512,9 +763,6 @@ std::unique_ptr<llvm::Module>& CodeGen::emit(int opt, bool debug) {
 #if THORIN_ENABLE_CHECKS
     llvm::verifyModule(*module_);
 #endif
-    optimize(opt);
-
-    return module_;
 }
 
 void CodeGen::emit(std::ostream& stream, int opt, bool debug) {
@@ -522,6 +770,75 @@ void CodeGen::emit(std::ostream& stream, int opt, bool debug) {
     emit(opt, debug)->print(llvm_stream, nullptr);
 }
 
+void CodeGen::emit_object(std::ostream& stream, int opt, bool debug, ObjectCache* cache) {
+    if (machine_ == nullptr) throw std::runtime_error("cannot emit an object file for '" + world_.name() + "' without a target machine");
+    emit_module(opt, debug);
+
+    // the unoptimized module, the target and all options determine the object file
+    std::string key;
+    if (cache != nullptr) {
+        auto pipeline = tune(pipeline_);
+        std::string config = module_->getTargetTriple() + ';' + machine_->getTargetCPU().str() + ';' + machine_->getTargetFeatureString().str()
+                           + ";O" + std::to_string(opt) + (debug ? ";g" : "")
+                           + ';' + std::to_string(pipeline.vectorize_loops) + std::to_string(pipeline.vectorize_slp)
+                           + std::to_string(pipeline.interleave_loops) + std::to_string(pipeline.unroll_loops);
+        key = ObjectCache::key(*module_, config);
+        if (auto object = cache->load(key)) {
+            stream.write(object->getBufferStart(), object->getBufferSize());
+            return;
+        }
+    }
+
+    optimize(opt);
+
+    llvm::SmallVector<char, 0> object;
+    llvm::raw_svector_ostream os(object);
+    llvm::legacy::PassManager codegen;
+    if (machine_->addPassesToEmitFile(codegen, os, nullptr, llvm::CGFT_ObjectFile))
+        throw std::runtime_error("target '" + module_->getTargetTriple() + "' cannot emit object files");
+    codegen.run(*module_);
+
+    if (cache != nullptr) cache->store(key, llvm::StringRef(object.data(), object.size()));
+    stream.write(object.data(), object.size());
+}
+
+std::vector<std::unique_ptr<CodeGen>> CodeGen::emit_partitioned(World& world, size_t num_partitions, int opt, bool debug,
+                                                                const std::function<std::unique_ptr<CodeGen>(World&)>& make) {
+    // the kernels must be outlined before partitioning - each partition needs to know all stubs
+    auto launches = outline_kernels(world);
+    std::vector<std::pair<Lam*, size_t>> entries;
+    world.visit([&](const Scope& scope) {
+        if (auto lam = scope.entry()->isa<Lam>(); lam && lam->type()->is_cn()) entries.emplace_back(lam, scope.bound().size());
+    });
+
+    // largest scopes first - each one goes to the partition with the least work so far
+    std::stable_sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+    num_partitions = std::clamp(num_partitions, size_t(1), std::max(entries.size(), size_t(1)));
+    std::vector<LamSet> partitions(num_partitions);
+    std::vector<size_t> sizes(num_partitions, 0);
+    for (const auto& [lam, size] : entries) {
+        auto i = std::min_element(sizes.begin(), sizes.end()) - sizes.begin();
+        partitions[i].emplace(lam);
+        sizes[i] += size;
+    }
+
+    std::vector<std::unique_ptr<CodeGen>> codegens;
+    for (const auto& partition : partitions) {
+        auto& codegen = codegens.emplace_back(make(world));
+        codegen->launches_ = launches;
+        codegen->partition_ = &partition;
+        codegen->emit(0, debug);
+        codegen->partition_ = nullptr;
+    }
+    restore_kernels(launches);
+
+    std::vector<std::thread> threads;
+    for (auto& codegen : codegens) threads.emplace_back([&codegen, opt] { codegen->optimize(opt); });
+    for (auto& thread : threads) thread.join();
+
+    return codegens;
+}
+
 // work-around stupid llvm bahvior that sexts i1s
 llvm::Value* CodeGen::i1toi32(llvm::Value* val) {
     if (val->getType()->isIntegerTy(1))
@@ -530,56 +847,74 @@ llvm::Value* CodeGen::i1toi32(llvm::Value* val) {
 }
 
 void CodeGen::optimize(int opt) {
-    if (opt != 0) {
-        llvm::PassManagerBuilder pmbuilder;
-        llvm::legacy::PassManager pass_manager;
-        if (opt == -1) {
-            pmbuilder.OptLevel = 2u;
-            pmbuilder.SizeLevel = 1;
-        } else {
-            pmbuilder.OptLevel = (unsigned) opt;
-            pmbuilder.SizeLevel = 0u;
-        }
-        if (opt == 3) {
-            pass_manager.add(llvm::createFunctionInliningPass());
-            pass_manager.add(llvm::createAggressiveDCEPass());
-        }
-        pmbuilder.populateModulePassManager(pass_manager);
+    if (opt == 0) return;
 
-        pass_manager.run(*module_);
-    }
+    auto pipeline = tune(pipeline_);
+    llvm::PipelineTuningOptions tuning;
+    tuning.LoopVectorization = pipeline.vectorize_loops;
+    tuning.SLPVectorization  = pipeline.vectorize_slp;
+    tuning.LoopInterleaving  = pipeline.interleave_loops;
+    tuning.LoopUnrolling     = pipeline.unroll_loops;
+
+#if LLVM_VERSION_MAJOR >= 13
+    llvm::PassBuilder builder(machine_.get(), tuning);
+#else
+    llvm::PassBuilder builder(false, machine_.get(), tuning);
+#endif
+    llvm::LoopAnalysisManager   loop_analyses;
+    llvm::FunctionAnalysisManager fct_analyses;
+    llvm::CGSCCAnalysisManager  cgscc_analyses;
+    llvm::ModuleAnalysisManager module_analyses;
+    fct_analyses.registerPass([&] { return builder.buildDefaultAAPipeline(); });
+    builder.registerModuleAnalyses(module_analyses);
+    builder.registerCGSCCAnalyses(cgscc_analyses);
+    builder.registerFunctionAnalyses(fct_analyses);
+    builder.registerLoopAnalyses(loop_analyses);
+    builder.crossRegisterProxies(loop_analyses, fct_analyses, cgscc_analyses, module_analyses);
+
+#if LLVM_VERSION_MAJOR >= 14
+    using OptLevel = llvm::OptimizationLevel;
+#else
+    using OptLevel = llvm::PassBuilder::OptimizationLevel;
+#endif
+    auto level = opt == -1 ? OptLevel::Os : opt == 1 ? OptLevel::O1 : opt == 2 ? OptLevel::O2 : OptLevel::O3;
+    builder.buildPerModuleDefaultPipeline(level).run(*module_, module_analyses);
 }
 
-llvm::Value* CodeGen::lookup(const Def* def) {
-    auto i = phis_.  find(def);
-    if (i != phis_.  end()) return i->second;
-    auto j = vars_.find(def);
-    if (j != vars_.end()) return j->second;
+u32 CodeGen::number(const Def* def) {
+    auto [i, ins] = numbers_.emplace(def, u32(values_.size()));
+    if (ins) values_.emplace_back();
+    return i->second;
+}
 
+llvm::Value* CodeGen::lookup(const Def* def) {
     if (auto lam = def->isa_nom<Lam>())
         return emit_function_decl(lam);
 
-    if (auto res = defs_.lookup(def))
+    auto n = number(def);
+    if (auto res = values_[n])
         return *res;
-    else {
-        // we emit all Thorin constants in the entry block, since they are not part of the schedule
-        if (def->no_dep()) {
-            auto bb = irbuilder_.GetInsertBlock();
-            auto fn = bb->getParent();
-            auto& entry = fn->getEntryBlock();
-
-            auto dbg = irbuilder_.getCurrentDebugLocation();
-            auto ip = irbuilder_.saveAndClearIP();
-            irbuilder_.SetInsertPoint(&entry, entry.begin());
-            auto llvm_value = emit(def);
-            irbuilder_.restoreIP(ip);
-            irbuilder_.SetCurrentDebugLocation(dbg);
-            return defs_[def] = llvm_value;
-        }
 
-        auto llvm_value = emit(def);
-        return defs_[def] = llvm_value;
+    llvm::Value* llvm_value;
+    // we emit all Thorin constants in the entry block, since they are not part of the schedule
+    if (def->no_dep()) {
+        auto bb = irbuilder_.GetInsertBlock();
+        auto fn = bb->getParent();
+        auto& entry = fn->getEntryBlock();
+
+        auto dbg = irbuilder_.getCurrentDebugLocation();
+        auto ip = irbuilder_.saveAndClearIP();
+        irbuilder_.SetInsertPoint(&entry, entry.begin());
+        llvm_value = emit(def);
+        irbuilder_.restoreIP(ip);
+        irbuilder_.SetCurrentDebugLocation(dbg);
+    } else {
+        llvm_value = emit(def);
     }
+
+    // emit may have numbered further defs - so don't hold a reference into values_ across it
+    values_[n] = llvm_value;
+    return llvm_value;
 }
 
 llvm::AllocaInst* CodeGen::emit_alloca(llvm::Type* type, const std::string& name) {
@@ -593,9 +928,132 @@ llvm::AllocaInst* CodeGen::emit_alloca(llvm::Type* type, const std::string& name
     return alloca;
 }
 
+llvm::AllocaInst* CodeGen::emit_tmp_alloca(llvm::Type* type) {
+    auto& alloca = tmp_allocas_[type];
+    if (alloca == nullptr) alloca = emit_alloca(type, "tmp_alloca");
+    return alloca;
+}
+
+void CodeGen::emit_lifetime(bool start, llvm::AllocaInst* alloca) {
+    auto void_cast = irbuilder_.CreateBitCast(alloca, llvm::PointerType::get(irbuilder_.getInt8Ty(), alloca->getType()->getPointerAddressSpace()));
+    // the intrinsics are overloaded on the type of the pointer
+    auto intrinsic = llvm::Intrinsic::getDeclaration(module_.get(), start ? llvm::Intrinsic::lifetime_start : llvm::Intrinsic::lifetime_end, { void_cast->getType() });
+    auto size = irbuilder_.getInt64(module_->getDataLayout().getTypeAllocSize(alloca->getAllocatedType()));
+    irbuilder_.CreateCall(intrinsic, { size, void_cast });
+}
+
+/// Collects the loads, stores, leas and bitcasts of @p ptr in @p accesses - @c false if @p ptr is used in any other way.
+static bool collect_accesses(const Def* ptr, DefVec& accesses) {
+    auto access = [&](const Def* def, size_t i, size_t index) {
+        auto app = def->isa<App>();
+        if (app == nullptr || index != 1) return false;
+        if (isa<Tag::Load>(app) || (isa<Tag::Store>(app) && i == 1)) {
+            accesses.emplace_back(app);
+            return true;
+        }
+        if ((isa<Tag::LEA>(app) && i == 0) || isa<Tag::Bitcast>(app)) {
+            accesses.emplace_back(app);
+            return collect_accesses(app, accesses);
+        }
+        return false;
+    };
+
+    for (auto use : ptr->uses()) {
+        if (auto tuple = use->isa<Tuple>()) {
+            for (auto arg_use : tuple->uses()) {
+                if (!access(arg_use.def(), use.index(), arg_use.index())) return false;
+            }
+        } else if (!access(use.def(), 0, use.index())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Stack-slot coloring:
+ * A @c slot is local if all accesses of its pointer - see @p collect_accesses - are scheduled in the same block as the @c slot.
+ * Its lifetime ends right after the last of them.
+ * A block runs from its first @p Def to its terminator, so local @c slot%s of different blocks are never alive at the same time;
+ * within a block, local @c slot%s whose lifetimes don't overlap share the storage of a @p SlotColor.
+ * All other @c slot%s get an alloca of their own.
+ */
+void CodeGen::color_slots(const Schedule& schedule) {
+    DefMap<std::pair<size_t, size_t>> where; // block and position within it of each scheduled def
+    size_t b = 0;
+    for (const auto& block : schedule) {
+        size_t i = 0;
+        for (auto def : block) where[def] = {b, i++};
+        ++b;
+    }
+
+    const auto& layout = module_->getDataLayout();
+    b = 0;
+    for (const auto& block : schedule) {
+        std::vector<std::optional<size_t>> busy_until(slot_colors_.size());
+        for (auto def : block) {
+            auto slot = isa<Tag::Slot>(def);
+            if (!slot) continue;
+
+            bool local = true;
+            DefVec accesses;
+            for (auto use : def->uses()) {
+                auto extract = use->isa<Extract>();
+                auto index = extract ? isa_lit(extract->index()) : std::nullopt;
+                local &= index && (*index == 0 || collect_accesses(extract, accesses));
+            }
+
+            auto start = where[def].second, end = start;
+            const Def* last = def;
+            for (auto access : accesses) {
+                auto i = where.find(access);
+                if (i == where.end()) continue; // dead
+                local &= i->second.first == b;
+                if (i->second.second > end) end = i->second.second, last = access;
+            }
+            if (!local) continue;
+
+            size_t c = 0;
+            while (c != busy_until.size() && busy_until[c] && *busy_until[c] >= start) ++c;
+            if (c == slot_colors_.size()) {
+                slot_colors_.emplace_back();
+                busy_until.emplace_back();
+            }
+            busy_until[c] = end;
+
+            auto type = convert_in_memory(slot->decurry()->arg(0));
+            auto& color = slot_colors_[c];
+            color.size  = std::max(color.size,  u64(layout.getTypeAllocSize(type)));
+            color.align = std::max(color.align, u64(layout.getPrefTypeAlign(type).value()));
+            ++color.num_slots;
+            slot2color_[def] = c;
+            lifetime_ends_[last].emplace_back(def);
+        }
+        ++b;
+    }
+}
+
+llvm::Value* CodeGen::emit_slot(const App* slot) {
+    auto type = convert_in_memory(slot->decurry()->arg(0));
+    auto c = slot2color_.lookup(slot);
+    if (!c) return emit_alloca(type, slot->unique_name());
+
+    auto& color = slot_colors_[*c];
+    if (color.storage == nullptr) {
+        if (color.num_slots == 1) {
+            color.storage = emit_alloca(type, slot->unique_name());
+        } else {
+            color.storage = emit_alloca(llvm::ArrayType::get(irbuilder_.getInt8Ty(), color.size), "slots");
+            color.storage->setAlignment(llvm::Align(color.align));
+        }
+    }
+    emit_lifetime(true, color.storage);
+    return irbuilder_.CreatePointerCast(color.storage, llvm::PointerType::get(type, color.storage->getType()->getPointerAddressSpace()));
+}
+
 llvm::Value* CodeGen::emit_alloc(const Def* type) {
     auto llvm_malloc = runtime_->get(get_alloc_name().c_str());
-    auto alloced_type = convert(type);
+    auto alloced_type = convert_in_memory(type);
     llvm::CallInst* void_ptr;
     auto layout = module_->getDataLayout();
     if (auto arr = type->isa<Arr>()) {
@@ -603,7 +1061,7 @@ llvm::Value* CodeGen::emit_alloc(const Def* type) {
         auto size = irbuilder_.CreateAdd(
                 irbuilder_.getInt64(layout.getTypeAllocSize(alloced_type)),
                 irbuilder_.CreateMul(irbuilder_.CreateIntCast(num, irbuilder_.getInt64Ty(), false),
-                                     irbuilder_.getInt64(layout.getTypeAllocSize(convert(arr->body())))));
+                                     irbuilder_.getInt64(layout.getTypeAllocSize(convert_in_memory(arr->body())))));
         llvm::Value* malloc_args[] = { irbuilder_.getInt32(0), size };
         void_ptr = irbuilder_.CreateCall(llvm_malloc, malloc_args);
     } else {
@@ -614,41 +1072,298 @@ llvm::Value* CodeGen::emit_alloc(const Def* type) {
     return irbuilder_.CreatePointerCast(void_ptr, llvm::PointerType::get(alloced_type, 0));
 }
 
-llvm::Value* CodeGen::emit(const Def* def) {
-    if (auto bit = isa<Tag::Bit>(def)) {
-        auto [a, b] = bit->args<2>([&](auto def) { return lookup(def); });
-        switch (bit.flags()) {
-            case Bit::_and: return irbuilder_.CreateAnd(a, b);
-            case Bit:: _or: return irbuilder_.CreateOr (a, b);
-            case Bit::_xor: return irbuilder_.CreateXor(a, b);
-            case Bit::nand: return irbuilder_.CreateNeg(irbuilder_.CreateAnd(a, b));
-            case Bit:: nor: return irbuilder_.CreateNeg(irbuilder_.CreateOr (a, b));
-            case Bit::nxor: return irbuilder_.CreateNeg(irbuilder_.CreateXor(a, b));
-            case Bit:: iff: return irbuilder_.CreateAnd(irbuilder_.CreateNeg(a), b);
-            case Bit::niff: return irbuilder_.CreateOr (a, irbuilder_.CreateNeg(b));
-            default: THORIN_UNREACHABLE;
+static bool is_binop(tag_t tag) {
+    switch (tag) {
+        case Tag::Bit:
+        case Tag::Shr:
+        case Tag::Wrap:
+        case Tag::ROp:
+        case Tag::ICmp:
+        case Tag::RCmp: return true;
+        default:        return false;
+    }
+}
+
+static llvm::FastMathFlags fast_math_flags(nat_t mode) {
+    llvm::FastMathFlags flags;
+    if (mode & RMode::nnan    ) flags.setNoNaNs();
+    if (mode & RMode::ninf    ) flags.setNoInfs();
+    if (mode & RMode::nsz     ) flags.setNoSignedZeros();
+    if (mode & RMode::arcp    ) flags.setAllowReciprocal();
+    if (mode & RMode::contract) flags.setAllowContract();
+    if (mode & RMode::afn     ) flags.setApproxFunc();
+    if (mode & RMode::reassoc ) flags.setAllowReassoc();
+    return flags;
+}
+
+/// Emits the binary op @p fn - a partially applied axiom like <tt>%Wrap_add (m, w)</tt> - for @p a and @p b.
+/// @p a and @p b may either be scalars or LLVM vectors.
+llvm::Value* CodeGen::emit_binop(const App* fn, llvm::Value* a, llvm::Value* b, const std::string& name) {
+    switch (fn->axiom()->tag()) {
+        case Tag::Bit:
+            switch (Bit(fn->axiom()->flags())) {
+                case Bit::_and: return irbuilder_.CreateAnd(a, b);
+                case Bit:: _or: return irbuilder_.CreateOr (a, b);
+                case Bit::_xor: return irbuilder_.CreateXor(a, b);
+                case Bit::nand: return irbuilder_.CreateNeg(irbuilder_.CreateAnd(a, b));
+                case Bit:: nor: return irbuilder_.CreateNeg(irbuilder_.CreateOr (a, b));
+                case Bit::nxor: return irbuilder_.CreateNeg(irbuilder_.CreateXor(a, b));
+                case Bit:: iff: return irbuilder_.CreateAnd(irbuilder_.CreateNeg(a), b);
+                case Bit::niff: return irbuilder_.CreateOr (a, irbuilder_.CreateNeg(b));
+                default: THORIN_UNREACHABLE;
+            }
+        case Tag::Shr:
+            switch (Shr(fn->axiom()->flags())) {
+                case Shr::ashr: return irbuilder_.CreateAShr(a, b, name);
+                case Shr::lshr: return irbuilder_.CreateLShr(a, b, name);
+                default: THORIN_UNREACHABLE;
+            }
+        case Tag::Wrap: {
+            auto [mode, width] = fn->args<2>(as_lit<nat_t>);
+            bool nuw = mode & WMode::nuw;
+            bool nsw = mode & WMode::nsw;
+            switch (Wrap(fn->axiom()->flags())) {
+                case Wrap::add: return irbuilder_.CreateAdd(a, b, name, nuw, nsw);
+                case Wrap::sub: return irbuilder_.CreateSub(a, b, name, nuw, nsw);
+                case Wrap::mul: return irbuilder_.CreateMul(a, b, name, nuw, nsw);
+                case Wrap::shl: return irbuilder_.CreateShl(a, b, name, nuw, nsw);
+                default: THORIN_UNREACHABLE;
+            }
         }
-    } else if (auto shr = isa<Tag::Shr>(def)) {
-        auto [a, b] = shr->args<2>([&](auto def) { return lookup(def); });
-        auto name = def->debug().name;
-        switch (shr.flags()) {
-            case Shr::ashr: return irbuilder_.CreateAShr(a, b, name);
-            case Shr::lshr: return irbuilder_.CreateLShr(a, b, name);
-            default: THORIN_UNREACHABLE;
+        case Tag::ROp: {
+            auto [mode, width] = fn->args<2>(as_lit<nat_t>);
+            irbuilder_.setFastMathFlags(fast_math_flags(mode));
+
+            switch (ROp(fn->axiom()->flags())) {
+                case ROp::add: return irbuilder_.CreateFAdd(a, b, name);
+                case ROp::sub: return irbuilder_.CreateFSub(a, b, name);
+                case ROp::mul: return irbuilder_.CreateFMul(a, b, name);
+                case ROp::div: return irbuilder_.CreateFDiv(a, b, name);
+                case ROp::rem: return irbuilder_.CreateFRem(a, b, name);
+                default: THORIN_UNREACHABLE;
+            }
         }
-    } else if (auto wrap = isa<Tag::Wrap>(def)) {
-        auto [a, b] = wrap->args<2>([&](auto def) { return lookup(def); });
-        auto name = def->debug().name;
-        auto [mode, width] = wrap->decurry()->args<2>(as_lit<nat_t>);
-        bool nuw = mode & WMode::nuw;
-        bool nsw = mode & WMode::nsw;
-        switch (wrap.flags()) {
-            case Wrap::add: return irbuilder_.CreateAdd(a, b, name, nuw, nsw);
-            case Wrap::sub: return irbuilder_.CreateSub(a, b, name, nuw, nsw);
-            case Wrap::mul: return irbuilder_.CreateMul(a, b, name, nuw, nsw);
-            case Wrap::shl: return irbuilder_.CreateShl(a, b, name, nuw, nsw);
-            default: THORIN_UNREACHABLE;
+        case Tag::ICmp:
+            switch (ICmp(fn->axiom()->flags())) {
+                case ICmp::e:   return irbuilder_.CreateICmpEQ (a, b, name);
+                case ICmp::ne:  return irbuilder_.CreateICmpNE (a, b, name);
+                case ICmp::sg:  return irbuilder_.CreateICmpSGT(a, b, name);
+                case ICmp::sge: return irbuilder_.CreateICmpSGE(a, b, name);
+                case ICmp::sl:  return irbuilder_.CreateICmpSLT(a, b, name);
+                case ICmp::sle: return irbuilder_.CreateICmpSLE(a, b, name);
+                case ICmp::ug:  return irbuilder_.CreateICmpUGT(a, b, name);
+                case ICmp::uge: return irbuilder_.CreateICmpUGE(a, b, name);
+                case ICmp::ul:  return irbuilder_.CreateICmpULT(a, b, name);
+                case ICmp::ule: return irbuilder_.CreateICmpULE(a, b, name);
+                default: THORIN_UNREACHABLE;
+            }
+        case Tag::RCmp:
+            switch (RCmp(fn->axiom()->flags())) {
+                case RCmp::  e: return irbuilder_.CreateFCmpOEQ(a, b, name);
+                case RCmp::  l: return irbuilder_.CreateFCmpOLT(a, b, name);
+                case RCmp:: le: return irbuilder_.CreateFCmpOLE(a, b, name);
+                case RCmp::  g: return irbuilder_.CreateFCmpOGT(a, b, name);
+                case RCmp:: ge: return irbuilder_.CreateFCmpOGE(a, b, name);
+                case RCmp:: ne: return irbuilder_.CreateFCmpONE(a, b, name);
+                case RCmp::  o: return irbuilder_.CreateFCmpORD(a, b, name);
+                case RCmp::  u: return irbuilder_.CreateFCmpUNO(a, b, name);
+                case RCmp:: ue: return irbuilder_.CreateFCmpUEQ(a, b, name);
+                case RCmp:: ul: return irbuilder_.CreateFCmpULT(a, b, name);
+                case RCmp::ule: return irbuilder_.CreateFCmpULE(a, b, name);
+                case RCmp:: ug: return irbuilder_.CreateFCmpUGT(a, b, name);
+                case RCmp::uge: return irbuilder_.CreateFCmpUGE(a, b, name);
+                case RCmp::une: return irbuilder_.CreateFCmpUNE(a, b, name);
+                default: THORIN_UNREACHABLE;
+            }
+        default: THORIN_UNREACHABLE;
+    }
+}
+
+static llvm::Type* get_vector_type(llvm::Type* elem, unsigned num) {
+#if LLVM_VERSION_MAJOR >= 11
+    return llvm::FixedVectorType::get(elem, num);
+#else
+    return llvm::VectorType::get(elem, num);
+#endif
+}
+
+static unsigned num_lanes(llvm::Type* vector_type) {
+#if LLVM_VERSION_MAJOR >= 11
+    return llvm::cast<llvm::FixedVectorType>(vector_type)->getNumElements();
+#else
+    return vector_type->getVectorNumElements();
+#endif
+}
+
+llvm::Type* CodeGen::vector_type(llvm::Type* type) {
+    auto array_type = llvm::dyn_cast<llvm::ArrayType>(type);
+    if (array_type == nullptr) return nullptr;
+
+    // i1 vectors are bit-packed in memory - unlike i1 arrays
+    auto num  = array_type->getNumElements();
+    auto elem = array_type->getElementType();
+    bool prim = elem->isFloatingPointTy() || (elem->isIntegerTy() && elem->getIntegerBitWidth() % 8 == 0);
+    return prim && 2 <= num && num <= max_vector_lanes ? get_vector_type(elem, unsigned(num)) : nullptr;
+}
+
+llvm::Value* CodeGen::array2vector(llvm::Value* array) {
+    if (array->getType()->isVectorTy()) return array;
+
+    auto array_type = llvm::cast<llvm::ArrayType>(array->getType());
+    auto num = unsigned(array_type->getNumElements());
+    llvm::Value* vector = llvm::UndefValue::get(get_vector_type(array_type->getElementType(), num));
+    for (unsigned i = 0; i != num; ++i)
+        vector = irbuilder_.CreateInsertElement(vector, irbuilder_.CreateExtractValue(array, { i }), irbuilder_.getInt32(i));
+    return vector;
+}
+
+llvm::Value* CodeGen::vector2array(llvm::Value* vector, llvm::Type* array_type) {
+    if (!vector->getType()->isVectorTy() || array_type->isVectorTy()) return vector;
+
+    llvm::Value* array = llvm::UndefValue::get(array_type);
+    for (unsigned i = 0, e = array_type->getArrayNumElements(); i != e; ++i)
+        array = irbuilder_.CreateInsertValue(array, irbuilder_.CreateExtractElement(vector, irbuilder_.getInt32(i)), { i });
+    return array;
+}
+
+llvm::Value* CodeGen::insert_value(llvm::Value* agg, llvm::Value* val, unsigned i) {
+    return irbuilder_.CreateInsertValue(agg, vector2array(val, llvm::ExtractValueInst::getIndexedType(agg->getType(), i)), { i });
+}
+
+llvm::Value* CodeGen::extract_value(llvm::Value* agg, unsigned i) {
+    auto val = irbuilder_.CreateExtractValue(agg, { i });
+    return vector_type(val->getType()) ? array2vector(val) : val;
+}
+
+/// Emits @p tuple as a @c shufflevector if it only consists of lanes of the same vector; returns @c nullptr otherwise.
+llvm::Value* CodeGen::emit_shuffle(const Tuple* tuple) {
+    const Def* src = nullptr;
+    std::vector<llvm::Constant*> mask;
+    for (auto op : tuple->ops()) {
+        auto extract = op->isa<Extract>();
+        if (extract == nullptr || (src != nullptr && extract->tuple() != src)) return nullptr;
+        auto index = isa_lit<u64>(extract->index());
+        if (!index) return nullptr;
+        src = extract->tuple();
+        mask.emplace_back(irbuilder_.getInt32(u32(*index)));
+    }
+
+    auto vector = lookup(src);
+    if (!vector->getType()->isVectorTy()) return nullptr;
+    return irbuilder_.CreateShuffleVector(vector, llvm::UndefValue::get(vector->getType()), llvm::ConstantVector::get(mask), tuple->debug().name);
+}
+
+/// Converts @p src as the partially applied @c Conv @p fn does; @p type is the converted type which may also be a vector.
+llvm::Value* CodeGen::emit_conv(const App* fn, llvm::Value* src, llvm::Type* type, const std::string& name) {
+    auto size2width = [&](const Def* type) {
+        if (auto int_ = isa<Tag::Int>(type)) {
+            // sizes which are unknown at compile time need 64 bits
+            if (!int_->arg()->isa<Lit>()) return 64_u64;
+            if (auto width = mod2width(as_lit(int_->arg()))) return *width;
+            return 64_u64;
         }
+        return as_lit(as<Tag::Real>(type)->arg());
+    };
+
+    auto pi = fn->type()->as<Pi>();
+    nat_t s_src = size2width(pi->dom());
+    nat_t s_dst = size2width(pi->codom());
+
+    switch (Conv(fn->axiom()->flags())) {
+        case Conv::s2s: return s_src < s_dst ? irbuilder_.CreateSExt (src, type, name) : irbuilder_.CreateTrunc  (src, type, name);
+        case Conv::u2u: return s_src < s_dst ? irbuilder_.CreateZExt (src, type, name) : irbuilder_.CreateTrunc  (src, type, name);
+        case Conv::r2r: return s_src < s_dst ? irbuilder_.CreateFPExt(src, type, name) : irbuilder_.CreateFPTrunc(src, type, name);
+        case Conv::s2r: return irbuilder_.CreateSIToFP(src, type, name);
+        case Conv::u2r: return irbuilder_.CreateUIToFP(src, type, name);
+        case Conv::r2s: return irbuilder_.CreateFPToSI(src, type, name);
+        case Conv::r2u: return irbuilder_.CreateFPToUI(src, type, name);
+        default: THORIN_UNREACHABLE;
+    }
+}
+
+llvm::Value* CodeGen::emit_fma(nat_t mode, llvm::Value* a, llvm::Value* b, llvm::Value* c, const std::string& name) {
+    irbuilder_.setFastMathFlags(fast_math_flags(mode));
+    // with contract, LLVM may still split the op if the target doesn't have a fused instruction
+    auto id = mode & RMode::contract ? llvm::Intrinsic::fmuladd : llvm::Intrinsic::fma;
+    auto callee = llvm::Intrinsic::getDeclaration(module_.get(), id, { a->getType() });
+    return irbuilder_.CreateCall(callee, { a, b, c }, name);
+}
+
+/// Applies the scalar function @p f lane-wise to the LLVM vectors @p args.
+/// @p f is either a binary op, an @c fma, or a nominal @p Lam whose body only consists of those - as built by fusing @c lift%s.
+/// Returns @c nullptr if this is not possible.
+llvm::Value* CodeGen::emit_lifted_app(const Def* f, Array<llvm::Value*> args, u64 lanes) {
+    auto [axiom, currying_depth] = get_axiom(f);
+    if (axiom && currying_depth == 1) {
+        auto fn = f->as<App>();
+        if (is_binop(axiom->tag()) && args.size() == 2) return emit_binop(fn, args[0], args[1], {});
+        if (axiom->tag() == Tag::FMA && args.size() == 3) return emit_fma(as_lit(fn->arg(0)), args[0], args[1], args[2], {});
+        if (axiom->tag() == Tag::Conv && args.size() == 1) {
+            auto type = convert(fn->type()->as<Pi>()->codom());
+            return emit_conv(fn, args[0], get_vector_type(type, unsigned(lanes)), {});
+        }
+        return nullptr;
+    }
+
+    if (auto lam = f->isa_nom<Lam>(); lam && lam->is_set()) {
+        DefMap<llvm::Value*> vectors;
+        auto n = args.size();
+        if (n == 1)
+            vectors[lam->var()] = args[0];
+        else
+            for (size_t i = 0; i != n; ++i) vectors[lam->var(n, i)] = args[i];
+        return emit_lifted(lam->body(), vectors, lanes);
+    }
+
+    return nullptr;
+}
+
+llvm::Value* CodeGen::emit_lifted(const Def* def, DefMap<llvm::Value*>& vectors, u64 lanes) {
+    if (auto vector = vectors.lookup(def)) return *vector;
+
+    llvm::Value* res = nullptr;
+    if (def->no_dep()) {
+        res = irbuilder_.CreateVectorSplat(unsigned(lanes), lookup(def));
+    } else if (auto select = def->isa<Extract>(); select && select->tuple()->isa<Tuple>() && select->tuple()->num_ops() == 2) {
+        // (f, t)#cond
+        auto f = emit_lifted(select->tuple()->op(0), vectors, lanes);
+        auto t = emit_lifted(select->tuple()->op(1), vectors, lanes);
+        auto c = emit_lifted(select->index(), vectors, lanes);
+        if (f != nullptr && t != nullptr && c != nullptr) res = irbuilder_.CreateSelect(c, t, f);
+    } else if (auto app = def->isa<App>()) {
+        auto n = app->num_args();
+        Array<llvm::Value*> args(n);
+        for (size_t i = 0; i != n; ++i) {
+            if ((args[i] = emit_lifted(app->arg(n, i), vectors, lanes)) == nullptr) return nullptr;
+        }
+        res = emit_lifted_app(app->callee(), args, lanes);
+    }
+
+    if (res != nullptr) vectors[def] = res;
+    return res;
+}
+
+/// Lowers <tt>lift (1, n) (n_i, Is, 1, Os, f) (a_1, ..., a_{n_i})</tt> to LLVM vector instructions.
+/// The normalizer already splits all other @c lift%s with a literal shape whose arguments are tuples or packs.
+llvm::Value* CodeGen::emit_lift(const App* lift) {
+    auto [r, s] = lift->decurry()->decurry()->args<2>();
+    auto [n_i, Is, n_o, Os, f] = lift->decurry()->args<5>();
+    auto l_r = isa_lit(r), l_s = isa_lit(s), l_i = isa_lit(n_i), l_o = isa_lit(n_o);
+
+    if (l_r && *l_r == 1 && l_s && *l_s <= max_vector_lanes && l_i && l_o && *l_o == 1) {
+        Array<llvm::Value*> args(*l_i, [&](size_t i) { return array2vector(lookup(lift->arg(*l_i, i))); });
+        if (auto vector = emit_lifted_app(f, args, *l_s)) return vector2array(vector, convert(lift->type()));
+    }
+
+    world().edef(lift, "cannot lower lift '{}' to vector instructions", lift);
+    return llvm::UndefValue::get(convert(lift->type()));
+}
+
+llvm::Value* CodeGen::emit(const Def* def) {
+    if (auto [axiom, currying_depth] = get_axiom(def); axiom && currying_depth == 0 && is_binop(axiom->tag())) {
+        auto app = def->as<App>();
+        auto [a, b] = app->args<2>([&](auto def) { return lookup(def); });
+        return emit_binop(app->decurry(), a, b, def->debug().name);
     } else if (auto div = isa<Tag::Div>(def)) {
         auto [m, aa, bb] = div->args<3>();
         auto a = lookup(aa);
@@ -661,92 +1376,11 @@ llvm::Value* CodeGen::emit(const Def* def) {
             case Div::urem: return irbuilder_.CreateURem(a, b, name);
             default: THORIN_UNREACHABLE;
         }
-    } else if (auto rop = isa<Tag::ROp>(def)) {
-        auto name = def->debug().name;
-        auto [a, b] = rop->args<2>([&](auto def) { return lookup(def); });
-        auto [mode, width] = rop->decurry()->args<2>(as_lit<nat_t>);
-
-        llvm::FastMathFlags flags;
-        if (mode & RMode::nnan    ) flags.setNoNaNs();
-        if (mode & RMode::ninf    ) flags.setNoInfs();
-        if (mode & RMode::nsz     ) flags.setNoSignedZeros();
-        if (mode & RMode::arcp    ) flags.setAllowReciprocal();
-        if (mode & RMode::contract) flags.setAllowContract();
-        if (mode & RMode::afn     ) flags.setApproxFunc();
-        if (mode & RMode::reassoc ) flags.setAllowReassoc();
-        irbuilder_.setFastMathFlags(flags);
-
-        switch (rop.flags()) {
-            case ROp::add: return irbuilder_.CreateFAdd(a, b, name);
-            case ROp::sub: return irbuilder_.CreateFSub(a, b, name);
-            case ROp::mul: return irbuilder_.CreateFMul(a, b, name);
-            case ROp::div: return irbuilder_.CreateFDiv(a, b, name);
-            case ROp::rem: return irbuilder_.CreateFRem(a, b, name);
-            default: THORIN_UNREACHABLE;
-        }
-    } else if (auto icmp = isa<Tag::ICmp>(def)) {
-        auto [a, b] = icmp->args<2>([&](auto def) { return lookup(def); });
-        auto name = def->debug().name;
-        switch (icmp.flags()) {
-            case ICmp::e:   return irbuilder_.CreateICmpEQ (a, b, name);
-            case ICmp::ne:  return irbuilder_.CreateICmpNE (a, b, name);
-            case ICmp::sg:  return irbuilder_.CreateICmpSGT(a, b, name);
-            case ICmp::sge: return irbuilder_.CreateICmpSGE(a, b, name);
-            case ICmp::sl:  return irbuilder_.CreateICmpSLT(a, b, name);
-            case ICmp::sle: return irbuilder_.CreateICmpSLE(a, b, name);
-            case ICmp::ug:  return irbuilder_.CreateICmpUGT(a, b, name);
-            case ICmp::uge: return irbuilder_.CreateICmpUGE(a, b, name);
-            case ICmp::ul:  return irbuilder_.CreateICmpULT(a, b, name);
-            case ICmp::ule: return irbuilder_.CreateICmpULE(a, b, name);
-            default: THORIN_UNREACHABLE;
-        }
-    } else if (auto rcmp = isa<Tag::RCmp>(def)) {
-        auto [a, b] = rcmp->args<2>([&](auto def) { return lookup(def); });
-        auto name = def->debug().name;
-        switch (rcmp.flags()) {
-            case RCmp::  e: return irbuilder_.CreateFCmpOEQ(a, b, name);
-            case RCmp::  l: return irbuilder_.CreateFCmpOLT(a, b, name);
-            case RCmp:: le: return irbuilder_.CreateFCmpOLE(a, b, name);
-            case RCmp::  g: return irbuilder_.CreateFCmpOGT(a, b, name);
-            case RCmp:: ge: return irbuilder_.CreateFCmpOGE(a, b, name);
-            case RCmp:: ne: return irbuilder_.CreateFCmpONE(a, b, name);
-            case RCmp::  o: return irbuilder_.CreateFCmpORD(a, b, name);
-            case RCmp::  u: return irbuilder_.CreateFCmpUNO(a, b, name);
-            case RCmp:: ue: return irbuilder_.CreateFCmpUEQ(a, b, name);
-            case RCmp:: ul: return irbuilder_.CreateFCmpULT(a, b, name);
-            case RCmp::ule: return irbuilder_.CreateFCmpULE(a, b, name);
-            case RCmp:: ug: return irbuilder_.CreateFCmpUGT(a, b, name);
-            case RCmp::uge: return irbuilder_.CreateFCmpUGE(a, b, name);
-            case RCmp::une: return irbuilder_.CreateFCmpUNE(a, b, name);
-            default: THORIN_UNREACHABLE;
-        }
+    } else if (auto fma = isa<Tag::FMA>(def)) {
+        auto [a, b, c] = fma->args<3>([&](auto def) { return lookup(def); });
+        return emit_fma(as_lit(fma->decurry()->arg(0)), a, b, c, def->debug().name);
     } else if (auto conv = isa<Tag::Conv>(def)) {
-        auto src = lookup(conv->arg());
-        auto name = def->debug().name;
-        auto type = convert(def->type());
-
-        auto size2width = [&](const Def* type) {
-            if (auto int_ = isa<Tag::Int>(type)) {
-                if (int_->arg()->isa<Top>()) return 64_u64;
-                if (auto width = mod2width(as_lit(int_->arg()))) return *width;
-                return 64_u64;
-            }
-            return as_lit(as<Tag::Real>(type)->arg());
-        };
-
-        nat_t s_src = size2width(conv->arg()->type());
-        nat_t s_dst = size2width(conv->type());
-
-        switch (conv.flags()) {
-            case Conv::s2s: return s_src < s_dst ? irbuilder_.CreateSExt (src, type, name) : irbuilder_.CreateTrunc  (src, type, name);
-            case Conv::u2u: return s_src < s_dst ? irbuilder_.CreateZExt (src, type, name) : irbuilder_.CreateTrunc  (src, type, name);
-            case Conv::r2r: return s_src < s_dst ? irbuilder_.CreateFPExt(src, type, name) : irbuilder_.CreateFPTrunc(src, type, name);
-            case Conv::s2r: return irbuilder_.CreateSIToFP(src, type, name);
-            case Conv::u2r: return irbuilder_.CreateUIToFP(src, type, name);
-            case Conv::r2s: return irbuilder_.CreateFPToSI(src, type, name);
-            case Conv::r2u: return irbuilder_.CreateFPToUI(src, type, name);
-            default: THORIN_UNREACHABLE;
-        }
+        return emit_conv(conv->decurry(), lookup(conv->arg()), convert(def->type()), def->debug().name);
     } else if (auto bitcast = isa<Tag::Bitcast>(def)) {
         auto dst_type_ptr = isa<Tag::Ptr>(bitcast->type());
         auto src_type_ptr = isa<Tag::Ptr>(bitcast->arg()->type());
@@ -767,21 +1401,34 @@ llvm::Value* CodeGen::emit(const Def* def) {
         auto alloced_type = alloc->decurry()->arg(0);
         return emit_alloc(alloced_type);
     } else if (auto slot = isa<Tag::Slot>(def)) {
-        auto alloced_type = slot->decurry()->arg(0);
-        return emit_alloca(convert(alloced_type), slot->unique_name());
+        return emit_slot(slot);
     } else if (auto load = isa<Tag::Load>(def)) {
         return emit_load(load);
     } else if (auto remem = isa<Tag::Remem>(def)) {
         return lookup(remem->arg());
     } else if (auto store = isa<Tag::Store>(def)) {
         return emit_store(store);
+    } else if (auto lift = isa<Tag::Lift>(def)) {
+        return emit_lift(lift);
+    } else if (auto graph = isa<Tag::Graph>(def)) {
+        return emit_graph(graph);
+    } else if (auto hint = isa<Tag::Hint>(def)) {
+        return lookup(hint->arg()); // see emit_loop_hints and the branch weights of CondBr
     }
 
     if (auto tuple = def->isa<Tuple>()) {
-        llvm::Value* llvm_agg = llvm::UndefValue::get(convert(tuple->type()));
+        auto llvm_type = convert(tuple->type());
+        llvm::Value* llvm_agg = llvm::UndefValue::get(llvm_type);
+
+        if (llvm_type->isVectorTy()) {
+            if (auto shuffle = emit_shuffle(tuple)) return shuffle;
+            for (size_t i = 0, e = tuple->num_ops(); i != e; ++i)
+                llvm_agg = irbuilder_.CreateInsertElement(llvm_agg, lookup(tuple->op(i)), irbuilder_.getInt32(u32(i)));
+            return llvm_agg;
+        }
 
         for (size_t i = 0, e = tuple->num_ops(); i != e; ++i)
-            llvm_agg = irbuilder_.CreateInsertValue(llvm_agg, lookup(tuple->op(i)), { unsigned(i) });
+            llvm_agg = insert_value(llvm_agg, lookup(tuple->op(i)), unsigned(i));
 
         return llvm_agg;
     } else if (auto pack = def->isa<Pack>()) {
@@ -791,49 +1438,67 @@ llvm::Value* CodeGen::emit(const Def* def) {
         if (pack->body()->isa<Bot>()) return llvm_agg;
 
         auto elem = lookup(pack->body());
+        if (llvm_type->isVectorTy()) return irbuilder_.CreateVectorSplat(num_lanes(llvm_type), elem, def->debug().name);
+
         for (size_t i = 0, e = as_lit<u64>(pack->shape()); i != e; ++i)
-            llvm_agg = irbuilder_.CreateInsertValue(llvm_agg, elem, { unsigned(i) });
+            llvm_agg = insert_value(llvm_agg, elem, unsigned(i));
 
         return llvm_agg;
+    } else if (auto select = def->isa<Extract>(); select && select->tuple()->isa<Tuple>() && select->tuple()->num_ops() == 2 && !isa_lit(select->index())) {
+        // (f, t)#cond
+        auto [f, t] = select->tuple()->projs<2>();
+        return irbuilder_.CreateSelect(lookup(select->index()), lookup(t), lookup(f), def->debug().name);
     } else if (def->isa<Extract>() || def->isa<Insert>()) {
         auto llvm_agg = lookup(def->op(0));
         auto llvm_idx = lookup(def->op(1));
+        // the temporary dies right after this def - so it ends its lifetime itself
         auto copy_to_alloca = [&] () {
             world().wdef(def, "slow: alloca and loads/stores needed for aggregate '{}'", def);
-            auto alloca = emit_alloca(llvm_agg->getType(), def->debug().name);
+            auto alloca = emit_tmp_alloca(llvm_agg->getType());
+            emit_lifetime(true, alloca);
             irbuilder_.CreateStore(llvm_agg, alloca);
 
             llvm::Value* args[2] = { irbuilder_.getInt64(0), i1toi32(llvm_idx) };
-            auto gep = irbuilder_.CreateInBoundsGEP(alloca, args);
+            auto gep = irbuilder_.CreateInBoundsGEP(alloca->getAllocatedType(), alloca, args);
             return std::make_pair(alloca, gep);
         };
-        auto copy_to_alloca_or_global = [&] () -> llvm::Value* {
+        auto copy_to_alloca_or_global = [&] () -> std::pair<llvm::AllocaInst*, llvm::Value*> {
             if (auto constant = llvm::dyn_cast<llvm::Constant>(llvm_agg)) {
                 auto global = llvm::cast<llvm::GlobalVariable>(module_->getOrInsertGlobal(def->op(0)->unique_name().c_str(), llvm_agg->getType()));
                 global->setInitializer(constant);
-                return irbuilder_.CreateInBoundsGEP(global, { irbuilder_.getInt64(0), i1toi32(llvm_idx) });
+                llvm::Value* gep = irbuilder_.CreateInBoundsGEP(global->getValueType(), global, { irbuilder_.getInt64(0), i1toi32(llvm_idx) });
+                return {nullptr, gep};
             }
-            return copy_to_alloca().second;
+            return copy_to_alloca();
         };
 
         if (auto extract = def->isa<Extract>()) {
             if (is_memop(extract->tuple())) return lookup(extract->tuple());
-            if (extract->tuple()->type()->isa<Arr>()) return irbuilder_.CreateLoad(copy_to_alloca_or_global());
+            if (llvm_agg->getType()->isVectorTy()) return irbuilder_.CreateExtractElement(llvm_agg, i1toi32(llvm_idx), def->debug().name);
+            if (extract->tuple()->type()->isa<Arr>() && !isa_lit(extract->index())) {
+                auto [alloca, ptr] = copy_to_alloca_or_global();
+                llvm::Value* elem = irbuilder_.CreateLoad(llvm_agg->getType()->getArrayElementType(), ptr);
+                if (alloca) emit_lifetime(false, alloca);
+                return vector_type(elem->getType()) ? array2vector(elem) : elem;
+            }
 
-            // tuple/struct
-            return irbuilder_.CreateExtractValue(llvm_agg, {as_lit<u32>(extract->index())});
+            // tuple/struct or literal index
+            return extract_value(llvm_agg, as_lit<u32>(extract->index()));
         }
 
         auto insert = def->as<Insert>();
         auto val = lookup(insert->value());
 
-        if (insert->tuple()->type()->isa<Arr>()) {
-            auto p = copy_to_alloca();
-            irbuilder_.CreateStore(lookup(insert->value()), p.second);
-            return irbuilder_.CreateLoad(p.first);
+        if (llvm_agg->getType()->isVectorTy()) return irbuilder_.CreateInsertElement(llvm_agg, val, i1toi32(llvm_idx), def->debug().name);
+        if (insert->tuple()->type()->isa<Arr>() && !isa_lit(insert->index())) {
+            auto [alloca, ptr] = copy_to_alloca();
+            irbuilder_.CreateStore(vector2array(val, llvm_agg->getType()->getArrayElementType()), ptr);
+            auto agg = irbuilder_.CreateLoad(alloca->getAllocatedType(), alloca);
+            emit_lifetime(false, alloca);
+            return agg;
         }
-        // tuple/struct
-        return irbuilder_.CreateInsertValue(llvm_agg, val, {as_lit<u32>(insert->index())});
+        // tuple/struct or literal index
+        return insert_value(llvm_agg, val, as_lit<u32>(insert->index()));
     } else if (auto lit = def->isa<Lit>()) {
         llvm::Type* llvm_type = convert(lit->type());
 
@@ -841,7 +1506,7 @@ llvm::Value* CodeGen::emit(const Def* def) {
             return irbuilder_.getInt64(lit->get<u64>());
         } else if (isa<Tag::Int>(lit->type())) {
             auto size = isa_sized_type(lit->type());
-            if (size->isa<Top>()) return irbuilder_.getInt64(lit->get<u64>());
+            if (!size->isa<Lit>()) return irbuilder_.getInt64(lit->get<u64>());
             if (auto mod = mod2width(as_lit(size))) {
                 switch (*mod) {
                     case  1: return irbuilder_. getInt1(lit->get< u1>());
@@ -881,25 +1546,46 @@ llvm::Value* CodeGen::emit_global(const Global* global) {
     if (auto lam = global->init()->isa_nom<Lam>())
         val = fcts_[lam];
     else {
-        auto llvm_type = convert(global->alloced_type());
+        auto llvm_type = convert_in_memory(global->alloced_type());
         auto var = llvm::cast<llvm::GlobalVariable>(module_->getOrInsertGlobal(global->unique_name().c_str(), llvm_type));
+        // each partition that accesses the global defines it; the linker keeps one of them
+        if (partition_ != nullptr) {
+            var->setLinkage(llvm::GlobalValue::LinkOnceODRLinkage);
+            var->setVisibility(llvm::GlobalValue::HiddenVisibility);
+        }
         if (global->init()->isa<Bot>())
             var->setInitializer(llvm::Constant::getNullValue(llvm_type)); // HACK
         else
-            var->setInitializer(llvm::cast<llvm::Constant>(emit(global->init())));
+            var->setInitializer(llvm::cast<llvm::Constant>(vector2array(emit(global->init()), llvm_type)));
         val = var;
     }
     return val;
 }
 
+/// Small @p Arr%s are accessed as vectors - aligned as their elements since the memory holds an array.
+llvm::Value* CodeGen::vector_ptr(llvm::Value* ptr, llvm::Type* vector_type) {
+    return irbuilder_.CreatePointerCast(ptr, llvm::PointerType::get(vector_type, ptr->getType()->getPointerAddressSpace()));
+}
+
 llvm::Value* CodeGen::emit_load(const App* load) {
     auto [mem, ptr] = load->args<2>();
-    return irbuilder_.CreateLoad(lookup(ptr));
+    auto type = convert(as<Tag::Ptr>(ptr->type())->arg(0));
+    if (type->isVectorTy())
+        return irbuilder_.CreateAlignedLoad(type, vector_ptr(lookup(ptr), type), module_->getDataLayout().getABITypeAlign(type->getScalarType()));
+    auto inst = irbuilder_.CreateLoad(type, lookup(ptr));
+    if (auto tag = tbaa_tag(ptr)) inst->setMetadata(llvm::LLVMContext::MD_tbaa, tag);
+    return inst;
 }
 
 llvm::Value* CodeGen::emit_store(const App* store) {
     auto [mem, ptr, val] = store->args<3>();
-    return irbuilder_.CreateStore(lookup(val), lookup(ptr));
+    auto llvm_val = lookup(val);
+    auto type = llvm_val->getType();
+    if (type->isVectorTy())
+        return irbuilder_.CreateAlignedStore(llvm_val, vector_ptr(lookup(ptr), type), module_->getDataLayout().getABITypeAlign(type->getScalarType()));
+    auto inst = irbuilder_.CreateStore(llvm_val, lookup(ptr));
+    if (auto tag = tbaa_tag(ptr)) inst->setMetadata(llvm::LLVMContext::MD_tbaa, tag);
+    return inst;
 }
 
 llvm::Value* CodeGen::emit_lea(const App* lea) {
@@ -910,7 +1596,90 @@ llvm::Value* CodeGen::emit_lea(const App* lea) {
 
     assert(pointee->isa<Arr>());
     llvm::Value* args[2] = { irbuilder_.getInt64(0), i1toi32(lookup(index)) };
-    return irbuilder_.CreateInBoundsGEP(lookup(ptr), args);
+    return irbuilder_.CreateInBoundsGEP(convert_in_memory(pointee), lookup(ptr), args);
+}
+
+/// Is @p type a byte or an array of bytes - memory without a type of its own?
+static bool is_bytes(llvm::Type* type) {
+    while (type->isArrayTy()) type = type->getArrayElementType();
+    return type->isIntegerTy(8);
+}
+
+llvm::MDNode* CodeGen::tbaa_type(const Def* type) {
+    if (auto node = tbaa_types_.lookup(type)) return *node;
+
+    llvm::MDBuilder builder(context_);
+    if (tbaa_char_ == nullptr) {
+        tbaa_char_ = builder.createTBAAScalarTypeNode("omnipotent char", builder.createTBAARoot("Thorin TBAA"));
+
+        // a bitcast between pointers accesses the memory of one type - and all of its fields - as the other one;
+        // bytes don't have a type of their own but a typed pointer may be cast to bytes and back to another type
+        auto pun = [&](const Def* type, auto pun) -> void {
+            if (!punned_.emplace(type).second) return;
+            if (auto arr = type->isa<Arr>()) pun(arr->body(), pun);
+            if (auto sigma = type->isa<Sigma>()) {
+                for (auto op : sigma->ops()) pun(op, pun);
+            }
+        };
+        // converting types may create new defs - so collect the bitcasts first
+        std::vector<const App*> bitcasts;
+        for (auto def : world().defs()) {
+            if (auto bitcast = isa<Tag::Bitcast>(def)) bitcasts.emplace_back(bitcast);
+        }
+        for (auto bitcast : bitcasts) {
+            auto dst = isa<Tag::Ptr>(bitcast->type());
+            auto src = isa<Tag::Ptr>(bitcast->arg()->type());
+            if (!dst || !src) continue;
+            for (auto type : {dst->arg(0), src->arg(0)}) {
+                if (!is_bytes(convert_in_memory(type))) pun(type, pun);
+            }
+        }
+    }
+
+    auto llvm_type = convert_in_memory(type);
+    llvm::MDNode* node = tbaa_char_;
+    if (punned_.contains(type)) {
+        // may alias anything
+    } else if (auto sigma = type->isa<Sigma>(); sigma && !sigma->isa_nom()) {
+        auto layout = module_->getDataLayout().getStructLayout(llvm::cast<llvm::StructType>(llvm_type));
+        std::vector<std::pair<llvm::MDNode*, uint64_t>> fields;
+        for (size_t i = 0, e = sigma->num_ops(); i != e; ++i) {
+            auto field = sigma->op(i);
+            auto llvm_field = convert_in_memory(field);
+            if (llvm_field->isArrayTy() || field->isa_nom() || module_->getDataLayout().getTypeAllocSize(llvm_field) == 0) continue;
+            fields.emplace_back(tbaa_type(field), layout->getElementOffset(i));
+        }
+        node = builder.createTBAAStructTypeNode(sigma->unique_name(), fields);
+    } else if (llvm_type->isPointerTy()) {
+        node = builder.createTBAAScalarTypeNode("any pointer", tbaa_char_);
+    } else if ((llvm_type->isIntegerTy() && llvm_type->getIntegerBitWidth() > 8) || llvm_type->isFloatingPointTy()) {
+        std::string name;
+        llvm::raw_string_ostream os(name);
+        llvm_type->print(os);
+        node = builder.createTBAAScalarTypeNode(os.str(), tbaa_char_);
+    }
+    return tbaa_types_[type] = node;
+}
+
+llvm::MDNode* CodeGen::tbaa_tag(const Def* ptr) {
+    auto type = as<Tag::Ptr>(ptr->type())->arg(0);
+    auto llvm_type = convert_in_memory(type);
+    if (llvm_type->isAggregateType() || llvm_type->isVectorTy()) return nullptr;
+
+    // the path through the fields of structural sigmas distinguishes the fields of the same type
+    auto access = tbaa_type(type);
+    auto base = access;
+    uint64_t offset = 0;
+    while (auto lea = isa<Tag::LEA>(ptr)) {
+        auto [outer, index] = lea->args<2>();
+        auto sigma = as<Tag::Ptr>(outer->type())->arg(0)->isa<Sigma>();
+        if (sigma == nullptr || sigma->isa_nom() || punned_.contains(sigma)) break;
+        auto layout = module_->getDataLayout().getStructLayout(llvm::cast<llvm::StructType>(convert_in_memory(sigma)));
+        offset += layout->getElementOffset(as_lit<u64>(index));
+        base = tbaa_type(sigma);
+        ptr = outer;
+    }
+    return llvm::MDBuilder(context_).createTBAAStructTagNode(base, access, offset);
 }
 
 unsigned CodeGen::convert_addr_space(u64 addr_space) {
@@ -933,7 +1702,8 @@ llvm::Type* CodeGen::convert(const Def* type) {
         return types_[type] = irbuilder_.getInt64Ty();
     } else if (isa<Tag::Int>(type)) {
         auto size = isa_sized_type(type);
-        if (size->isa<Top>()) return types_[type] = irbuilder_.getInt64Ty();
+        // e.g. the index of a kernel whose size is only known at runtime
+        if (!size->isa<Lit>()) return types_[type] = irbuilder_.getInt64Ty();
         if (auto width = mod2width(as_lit(size))) {
             switch (*width) {
                 case  1: return types_[type] = irbuilder_. getInt1Ty();
@@ -957,14 +1727,13 @@ llvm::Type* CodeGen::convert(const Def* type) {
         }
     } else if (auto ptr = isa<Tag::Ptr>(type)) {
         auto [pointee, addr_space] = ptr->args<2>();
-        auto llvm_type = llvm::PointerType::get(convert(pointee), convert_addr_space(as_lit<nat_t>(addr_space)));
+        auto llvm_type = llvm::PointerType::get(convert_in_memory(pointee), convert_addr_space(as_lit<nat_t>(addr_space)));
         return types_[type] = llvm_type;
     } else if (auto arr = type->isa<Arr>()) {
-        auto elem_type = convert(arr->body());
-        if (auto arity = isa_lit<u64>(arr->shape()))
-            return types_[type] = llvm::ArrayType::get(elem_type, *arity);
-        else
-            return types_[type] = llvm::ArrayType::get(elem_type, 0);
+        auto elem_type = convert_in_memory(arr->body());
+        auto llvm_type = llvm::ArrayType::get(elem_type, isa_lit<u64>(arr->shape()).value_or(0));
+        if (auto vector = vector_type(llvm_type)) return types_[type] = vector;
+        return types_[type] = llvm_type;
     } else if (auto cn = type->isa<Pi>()) {
         // extract "return" type, collect all other types
         assert(cn->is_cn());
@@ -998,7 +1767,7 @@ llvm::Type* CodeGen::convert(const Def* type) {
             types_[sigma] = llvm_struct;
         }
 
-        Array<llvm::Type*> llvm_types(sigma->num_ops(), [&](auto i) { return convert(sigma->op(i)); });
+        Array<llvm::Type*> llvm_types(sigma->num_ops(), [&](auto i) { return convert_in_memory(sigma->op(i)); });
 
         if (llvm_struct)
             llvm_struct->setBody(llvm_ref(llvm_types));
@@ -1011,6 +1780,12 @@ llvm::Type* CodeGen::convert(const Def* type) {
     THORIN_UNREACHABLE;
 }
 
+llvm::Type* CodeGen::convert_in_memory(const Def* type) {
+    auto llvm_type = convert(type);
+    if (llvm_type->isVectorTy()) return llvm::ArrayType::get(llvm_type->getScalarType(), num_lanes(llvm_type));
+    return llvm_type;
+}
+
 llvm::GlobalVariable* CodeGen::emit_global_variable(llvm::Type* type, const std::string& name, unsigned addr_space, bool init_undef) {
     auto init = init_undef ? llvm::UndefValue::get(type) : llvm::Constant::getNullValue(type);
     return new llvm::GlobalVariable(*module_, type, false, llvm::GlobalValue::InternalLinkage, init, name, nullptr, llvm::GlobalVariable::NotThreadLocal, addr_space);
@@ -1040,207 +1815,244 @@ void CodeGen::create_loop(llvm::Value* lower, llvm::Value* upper, llvm::Value* i
 }
 
 llvm::Value* CodeGen::create_tmp_alloca(llvm::Type* type, std::function<llvm::Value* (llvm::AllocaInst*)> fun) {
-    // emit the alloca in the entry block
+    // emit the alloca in the entry block and mark its lifetime
     auto alloca = emit_alloca(type, "tmp_alloca");
-
-    // mark the lifetime of the alloca
-    auto lifetime_start = llvm::Intrinsic::getDeclaration(module_.get(), llvm::Intrinsic::lifetime_start);
-    auto lifetime_end   = llvm::Intrinsic::getDeclaration(module_.get(), llvm::Intrinsic::lifetime_end);
-    auto addr_space = alloca->getType()->getPointerAddressSpace();
-    auto void_cast = irbuilder_.CreateBitCast(alloca, llvm::PointerType::get(irbuilder_.getInt8Ty(), addr_space));
-
-    auto layout = llvm::DataLayout(module_->getDataLayout());
-    auto size = irbuilder_.getInt64(layout.getTypeAllocSize(type));
-
-    irbuilder_.CreateCall(lifetime_start, { size, void_cast });
+    emit_lifetime(true, alloca);
     auto result = fun(alloca);
-    irbuilder_.CreateCall(lifetime_end, { size, void_cast });
+    emit_lifetime(false, alloca);
     return result;
 }
 
 //------------------------------------------------------------------------------
 
-#if 0
-static void get_kernel_configs(Rewriter& rewriter,
-    const std::vector<Lam*>& kernels,
-    Cont2Config& kernel_config,
-    std::function<std::unique_ptr<KernelConfig> (Lam*, Lam*)> use_callback)
-{
-    optimize_old(rewriter.world());
-
-    auto externals = rewriter.world().externals();
-    for (auto lam : kernels) {
-        // recover the imported lam (lost after the call to opt)
-        Lam* imported = nullptr;
-        for (auto external : externals) {
-            if (auto ex_lam = external->isa<Lam>()) {
-                if (ex_lam->debug().name == lam->debug().name)
-                    imported = ex_lam;
-            }
-        }
-        if (!imported) continue;
+/// The allocation which @p def points to if it's a - possibly cast - pointer returned by an @c alloc.
+static const Def* isa_alloc(const Def* def) {
+    while (auto bitcast = isa<Tag::Bitcast>(def)) def = bitcast->arg();
+    if (auto extract = def->isa<Extract>(); extract && isa<Tag::Alloc>(extract->tuple())) return extract->tuple();
+    return nullptr;
+}
 
-        visit_uses(lam, [&] (Lam* use) {
-            auto config = use_callback(use, imported);
-            if (config) {
-                auto p = kernel_config.emplace(imported, std::move(config));
-                assert_unused(p.second && "single kernel config entry expected");
-            }
-            return false;
-        }, true);
+/**
+ * The free @p Def%s of @p kernel which become additional params once it's closed - see @p import.
+ * Types and partial applications - like the conversion of an index of a symbolic number of threads - are rebuilt within the kernel from the host @p Def%s they depend on.
+ */
+/**
+ * The @em noms which @p kernel reaches via other @em noms and which - directly or via further @em noms - use @p Var%s of the host.
+ * They can't be called as they are but must be copied along with @p kernel.
+ */
+static NomSet host_noms(Lam* kernel) {
+    NomMap<NomSet> callees;
+    NomSet noms;
+    unique_queue<NomSet> queue;
+    queue.push(kernel);
+
+    while (!queue.empty()) {
+        auto nom = queue.pop();
+        Scope scope(nom);
+        if (nom != kernel && !scope.free_vars().empty()) noms.emplace(nom);
+
+        for (auto callee : scope.free_noms()) {
+            if (callee->is_external() || !callee->is_set()) continue;
+            callees[nom].emplace(callee);
+            queue.push(callee);
+        }
+    }
 
-        lam->destroy();
+    for (bool todo = true; todo;) {
+        todo = false;
+        for (const auto& [nom, set] : callees) {
+            if (nom == kernel || noms.contains(nom)) continue;
+            if (std::any_of(set.begin(), set.end(), [&](Def* callee) { return noms.contains(callee); })) todo |= noms.emplace(nom).second;
+        }
     }
+
+    return noms;
 }
 
-static Lam* get_alloc_call(const Def* def) {
-    // look through casts
-    while (auto conv_op = def->isa<ConvOp>())
-        def = conv_op->op(0);
+/// The free @p Def%s of @p kernel and of its @p host_noms which the host passes to the kernel - sorted by @p gid.
+static DefVec free_args(Lam* kernel, const NomSet& noms) {
+    auto& world = kernel->world();
+    std::deque<Scope> scopes;
+    scopes.emplace_back(kernel);
+    for (auto nom : noms) scopes.emplace_back(nom);
+
+    DefVec args;
+    unique_queue<DefSet> queue;
+    for (const auto& scope : scopes) {
+        for (auto def : scope.free_defs()) queue.push(def);
+    }
 
-    auto var = def->isa<Var>();
-    if (!var) return nullptr;
+    while (!queue.empty()) {
+        auto def = queue.pop();
+        if (def->isa_nom() || def->no_dep() || is_unit(def)) continue;
+        if (std::any_of(scopes.begin(), scopes.end(), [&](const Scope& scope) { return scope.bound(def); })) continue;
 
-    auto ret = var->lam();
-    if (ret->num_uses() != 1) return nullptr;
+        // pass the components instead - e.g. the literal modulus of a Conv must stay a literal
+        if (def->level() != Sort::Term || def->isa<Tuple>() || def->isa<Pack>() || (def->isa<App>() && def->type()->isa<Pi>())) {
+            for (auto op : def->extended_ops()) {
+                if (op != nullptr) queue.push(op);
+            }
+        } else {
+            if (isa<Tag::Mem>(def->type()) || def->type()->isa<Pi>())
+                world.edef(def, "kernel '{}' must not use '{}' of the host", kernel, def);
+            args.emplace_back(def);
+        }
+    }
 
-    auto use = *(ret->uses().begin());
-    auto call = use.def()->isa_nom<Lam>();
-    if (!call || use.index() == 0) return nullptr;
+    std::sort(args.begin(), args.end(), [](const Def* a, const Def* b) { return a->gid() < b->gid(); });
+    return args;
+}
 
-    auto callee = call->body()->as<App>()->callee();
-    if (callee->debug().name != "anydsl_alloc") return nullptr;
+/**
+ * Imports @p kernel into the target @p World of @p rewriter - which may also be the @p World of @p kernel.
+ * The kernel can't access the host's @p Var%s, so all free @p Def%s of @p kernel are appended to @p args and become additional parameters:
+ * <tt>cn[M, int n, cn M, args...]</tt>
+ * Functions nested in the host are copied along with @p kernel - see @p host_noms.
+ * If @c n depends on the host, the index is an @c i64.
+ */
+static Lam* import(Rewriter& rewriter, Lam* kernel, DefVec& args) {
+    auto noms = host_noms(kernel);
+    args = free_args(kernel, noms);
+
+    auto& target = rewriter.new_world;
+    if (&target == &kernel->world()) {
+        // other functions called by the kernel stay as they are - and so do the host's Vars which args don't cover
+        auto keep = [&](Def* nom) {
+            Scope scope(nom);
+            for (auto callee : scope.free_noms()) {
+                if (callee != kernel && !noms.contains(callee)) rewriter.old2new[callee] = callee;
+            }
+            for (auto var : scope.free_vars()) rewriter.old2new[var] = var;
+        };
+        keep(kernel);
+        for (auto nom : noms) keep(nom);
+    }
 
-    return call;
+    DefVec doms;
+    for (auto dom : kernel->doms()) doms.emplace_back(dom->no_dep() ? rewriter.rewrite(dom) : target.type_int_width(64));
+    for (auto arg : args) doms.emplace_back(rewriter.rewrite(arg->type()));
+    auto imported = target.nom_lam(target.cn(doms), target.dbg(kernel->unique_name()));
+
+    auto num = kernel->num_doms();
+    rewriter.old2new[kernel] = imported;
+    rewriter.old2new[kernel->var()] = target.tuple(DefArray(num, [&](size_t i) { return imported->var(i); }));
+    for (size_t i = 0, e = args.size(); i != e; ++i) rewriter.old2new[args[i]] = imported->var(num + i);
+    imported->set(DefArray(kernel->num_ops(), [&](size_t i) { return rewriter.rewrite(kernel->op(i)); }));
+    return imported;
 }
 
-static uint64_t get_alloc_size(const Def* def) {
-    auto call = get_alloc_call(def);
-    if (!call) return 0;
+LamMap<CodeGen::Launch> CodeGen::outline_kernels(World& world) {
+    LamMap<Launch> launches;
 
-    // signature: anydsl_alloc(mem, i32, i64, fn(mem, &[i8]))
-    auto size = call->body()->as<App>()->arg(2)->isa<Lit>();
-    return size ? static_cast<uint64_t>(size->box().get_qu64()) : 0_u64;
+    for (auto lam : world.copy_lams()) {
+        if (!lam->is_set()) continue;
+        auto acc = isa<Tag::Acc>(lam->body());
+        if (!acc || acc.flags() == Acc::vecotrize) continue;
+
+        auto [mem, body, ret] = acc->args<3>();
+        auto kernel = body->isa_nom<Lam>();
+        if (kernel == nullptr || !kernel->is_set())
+            world.edef(body, "kernel of '{}' must be a known function", lam);
+
+        DefVec args, stub_args;
+        if (acc.flags() == Acc::parallel) {
+            Rewriter rewriter(world);
+            auto outlined = import(rewriter, kernel, args);
+            stub_args = {mem, acc->decurry()->arg(), outlined, ret};
+        } else {
+            // the kernel lives in the World of its backend - see Backends::kernel_args for the same args
+            args = free_args(kernel, host_noms(kernel));
+            stub_args = {mem, acc->decurry()->arg(), ret};
+        }
+        stub_args.insert(stub_args.end(), args.begin(), args.end());
+        auto stub = world.nom_lam(world.cn(DefArray(stub_args.size(), [&](size_t i) { return stub_args[i]->type(); })), world.dbg(op2str(acc.flags())));
+        launches[stub] = {acc.flags(), lam, lam->body()};
+        lam->app(stub, stub_args, lam->body()->dbg());
+    }
+
+    return launches;
 }
-#endif
 
-Backends::Backends(World& world)
-    : rewriters({world, world, world, world, world, world})
+void CodeGen::restore_kernels(const LamMap<Launch>& launches) {
+    for (const auto& [stub, launch] : launches) launch.lam->set_body(launch.body);
+}
+
+Backends::Backends(World& world, bool emulate_gpu)
+    : worlds({nullptr, std::make_unique<World>(world), std::make_unique<World>(world), std::make_unique<World>(world), std::make_unique<World>(world), std::make_unique<World>(world)})
+    , rewriters({Rewriter(world), Rewriter(world, *worlds[CUDA]), Rewriter(world, *worlds[NVVM]), Rewriter(world, *worlds[OpenCL]), Rewriter(world, *worlds[AMDGPU]), Rewriter(world, *worlds[HLS])})
 {
-    // TODO rewrite as loop
-#if 0
+    if (emulate_gpu && emulate_grid(world)) {
+        // the kernels are called like any other function now - which needs the same preparation
+        cleanup_world(world);
+        PassMan ret_wrap(world);
+        ret_wrap.add<RetWrap>();
+        ret_wrap.run();
+    }
+
     // determine different parts of the world which need to be compiled differently
-    Scope::for_each(world, [&] (const Scope& scope) {
-        auto lam = scope.entry();
-        Lam* imported = nullptr;
-
-        if (is_passed_to_intrinsic(lam, Intrinsic::CUDA))
-            imported = cuda.import(lam)->as_nom<Lam>();
-        else if (is_passed_to_intrinsic(lam, Intrinsic::NVVM))
-            imported = nvvm.import(lam)->as_nom<Lam>();
-        else if (is_passed_to_intrinsic(lam, Intrinsic::OpenCL))
-            imported = opencl.import(lam)->as_nom<Lam>();
-        else if (is_passed_to_intrinsic(lam, Intrinsic::AMDGPU))
-            imported = amdgpu.import(lam)->as_nom<Lam>();
-        else if (is_passed_to_intrinsic(lam, Intrinsic::HLS))
-            imported = hls.import(lam)->as_nom<Lam>();
-        else
-            return;
+    for (auto lam : world.copy_lams()) {
+        if (!lam->is_set()) continue;
+        auto acc = isa<Tag::Acc>(lam->body());
+        if (!acc) continue;
+
+        size_t backend;
+        switch (acc.flags()) {
+            case Acc::cuda:   backend = CUDA;   break;
+            case Acc::nvvm:   backend = NVVM;   break;
+            case Acc::opencl: backend = OpenCL; break;
+            case Acc::amdgpu: backend = AMDGPU; break;
+            default: continue;
+        }
 
-        // TODO
-        //imported->debug().set(lam->unique_name());
-        imported->make_external();
-        // TODO
-        //lam->debug().set(lam->unique_name());
+        auto kernel = acc->arg(1)->isa_nom<Lam>();
+        if (kernel == nullptr || !kernel->is_set())
+            world.edef(acc->arg(1), "kernel of '{}' must be a known function", lam);
+        if (kernel_args.contains(kernel)) continue;
 
-        //for (size_t i = 0, e = lam->num_vars(); i != e; ++i)
-            //imported->var(i)->debug().set(lam->var(i)->unique_name());
+        auto& args = kernel_args[kernel];
+        auto imported = import(rewriters[backend], kernel, args);
+        imported->make_external();
+        kernels.emplace_back(kernel);
+
+        // the launch doesn't specify the block size; the kernel may assume restrict pointers if all of them point to distinct allocations
+        bool has_restrict = true;
+        DefSet allocs;
+        for (auto arg : args) {
+            if (!isa<Tag::Ptr>(arg->type())) continue;
+            auto alloc = isa_alloc(arg);
+            has_restrict &= alloc != nullptr && allocs.emplace(alloc).second;
+        }
+        kernel_config.emplace(imported, std::make_unique<GPUKernelConfig>(std::tuple<int, int, int>{-1, -1, -1}, has_restrict));
+    }
 
-        kernels.emplace_back(lam);
-    });
+    codegens[CPU] = std::make_unique<CPUCodeGen>(world);
+    if (!worlds[CUDA  ]->empty()) codegens[CUDA  ] = std::make_unique<CUDACodeGen  >(*worlds[CUDA  ], kernel_config);
+    if (!worlds[NVVM  ]->empty()) codegens[NVVM  ] = std::make_unique<NVVMCodeGen  >(*worlds[NVVM  ], kernel_config);
+    if (!worlds[OpenCL]->empty()) codegens[OpenCL] = std::make_unique<OpenCLCodeGen>(*worlds[OpenCL], kernel_config);
+    if (!worlds[AMDGPU]->empty()) codegens[AMDGPU] = std::make_unique<AMDGPUCodeGen>(*worlds[AMDGPU], kernel_config);
+    if (!worlds[HLS   ]->empty()) codegens[HLS   ] = std::make_unique<HLSCodeGen   >(*worlds[HLS   ], kernel_config);
+}
 
-    // get the GPU kernel configurations
-    if (!cuda.world().empty()   ||
-        !nvvm.world().empty()   ||
-        !opencl.world().empty() ||
-        !amdgpu.world().empty()) {
-        auto get_gpu_config = [&] (Lam* use, Lam* /* imported */) {
-            // determine whether or not this kernel uses restrict pointers
-            bool has_restrict = true;
-            DefSet allocs;
-            for (size_t i = LaunchArgs::Num, e = use->body()->as<App>()->num_args(); has_restrict && i != e; ++i) {
-                auto arg = use->body()->as<App>()->arg(i);
-                if (!arg->type()->isa<Ptr>()) continue;
-                auto alloc = get_alloc_call(arg);
-                if (!alloc) has_restrict = false;
-                auto p = allocs.insert(alloc);
-                has_restrict &= p.second;
-            }
+void Backends::emit(const std::array<std::ostream*, Num_Backends>& streams, int opt, bool debug) {
+    std::array<std::exception_ptr, Num_Backends> errors;
+    auto run = [&](size_t i) {
+        try {
+            codegens[i]->emit(*streams[i], opt, debug);
+        } catch (...) {
+            errors[i] = std::current_exception();
+        }
+    };
 
-            auto it_config = use->body()->as<App>()->arg(LaunchArgs::Config)->as<Tuple>();
-            if (it_config->op(0)->isa<Lit>() &&
-                it_config->op(1)->isa<Lit>() &&
-                it_config->op(2)->isa<Lit>()) {
-                return std::make_unique<GPUKernelConfig>(std::tuple<int, int, int> {
-                    as_lit<qu32>(it_config->op(0)), as_lit<qu32>(it_config->op(1)), as_lit<qu32>(it_config->op(2)),
-                }, has_restrict);
-            }
-            return std::make_unique<GPUKernelConfig>(std::tuple<int, int, int> { -1, -1, -1 }, has_restrict);
-        };
-        get_kernel_configs(cuda,   kernels, kernel_config, get_gpu_config);
-        get_kernel_configs(nvvm,   kernels, kernel_config, get_gpu_config);
-        get_kernel_configs(opencl, kernels, kernel_config, get_gpu_config);
-        get_kernel_configs(amdgpu, kernels, kernel_config, get_gpu_config);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i != Num_Backends; ++i) {
+        if (i != CPU && codegens[i] && streams[i] != nullptr) threads.emplace_back(run, i);
     }
+    if (codegens[CPU] && streams[CPU] != nullptr) run(CPU);
+    for (auto& thread : threads) thread.join();
 
-    // get the HLS kernel configurations
-    if (!hls.world().empty()) {
-        auto get_hls_config = [&] (Lam* use, Lam* imported) {
-            HLSKernelConfig::Var2Size var_sizes;
-            for (size_t i = 3, e = use->body()->as<App>()->num_args(); i != e; ++i) {
-                auto arg = use->body()->as<App>()->arg(i);
-                auto ptr_type = arg->type()->isa<Ptr>();
-                if (!ptr_type) continue;
-                auto size = get_alloc_size(arg);
-                if (size == 0)
-                    world().edef(arg, "array size is not known at compile time");
-                auto elem_type = ptr_type->pointee();
-                size_t multiplier = 1;
-                if (!elem_type->isa<PrimType>()) {
-                    if (auto arr = elem_type->isa<Arr>())
-                        elem_type = arr->codom();
-                }
-                if (!elem_type->isa<PrimType>()) {
-                    if (auto arr = elem_type->isa<Arr>(); arr && arr->dom()->isa<Lit>()) {
-                        elem_type = arr->codom();
-                        multiplier = as_lit<u64>(arr->dom());
-                    }
-                }
-                auto prim_type = elem_type->isa<PrimType>();
-                if (!prim_type)
-                    world().edef(arg, "only pointers to arrays of primitive types are supported");
-                auto num_elems = size / (multiplier * num_bits(prim_type->primtype_tag()) / 8);
-                // imported has type: fn (mem, fn (mem), ...)
-                var_sizes.emplace(imported->var(i - 3 + 2), num_elems);
-            }
-            return std::make_unique<HLSKernelConfig>(var_sizes);
-        };
-        get_kernel_configs(hls, kernels, kernel_config, get_hls_config);
+    for (const auto& error : errors) {
+        if (error) std::rethrow_exception(error);
     }
-
-    cleanup_world(world);
-    codegen_prepare(world);
-
-#endif
-    codegens[CPU] = std::make_unique<CPUCodeGen>(world);
-
-#if 0
-    if (!cuda.  world().empty()) codegens[CUDA  ] = std::make_unique<CUDACodeGen  >(cuda  .world(), kernel_config);
-    if (!nvvm.  world().empty()) codegens[NVVM  ] = std::make_unique<NVVMCodeGen  >(nvvm  .world(), kernel_config);
-    if (!opencl.world().empty()) codegens[OpenCL] = std::make_unique<OpenCLCodeGen>(opencl.world(), kernel_config);
-    if (!amdgpu.world().empty()) codegens[AMDGPU] = std::make_unique<AMDGPUCodeGen>(amdgpu.world(), kernel_config);
-    if (!hls.   world().empty()) codegens[HLS   ] = std::make_unique<HLSCodeGen   >(hls   .world(), kernel_config);
-#endif
 }
 
 //------------------------------------------------------------------------------
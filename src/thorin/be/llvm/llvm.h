@@ -1,6 +1,9 @@
 #ifndef THORIN_BE_LLVM_LLVM_H
 #define THORIN_BE_LLVM_LLVM_H
 
+#include <optional>
+#include <vector>
+
 #include <llvm/IR/DIBuilder.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/Module.h>
@@ -14,6 +17,9 @@
 
 namespace thorin {
 
+class ObjectCache;
+class Schedule;
+class Scope;
 class World;
 
 typedef LamMap<llvm::BasicBlock*> BBMap;
@@ -23,23 +29,58 @@ protected:
     CodeGen(World& world, llvm::CallingConv::ID function_calling_convention, llvm::CallingConv::ID device_calling_convention, llvm::CallingConv::ID kernel_calling_convention);
 
 public:
+    /// Tuning of the LLVM pipeline which @p optimize runs; each backend may adjust it further - see @p tune.
+    struct Pipeline {
+        bool vectorize_loops  = true;
+        bool vectorize_slp    = true;
+        bool interleave_loops = true;
+        bool unroll_loops     = true;
+    };
+
     virtual ~CodeGen() {}
 
     World& world() const { return world_; }
+    Pipeline& pipeline() { return pipeline_; }
+    const std::unique_ptr<llvm::Module>& module() const { return module_; }
     std::unique_ptr<llvm::Module>& emit(int opt, bool debug);
     virtual void emit(std::ostream& stream, int opt, bool debug);
+    /// Emits an object file to @p stream; if @p cache already has the object for this module, optimization and code generation are skipped.
+    void emit_object(std::ostream& stream, int opt, bool debug, ObjectCache* cache = nullptr);
+
+    /**
+     * Partitions the top-level scopes of @p world into @p num_partitions groups of roughly the same size.
+     * Each group is emitted by its own @p CodeGen - created via @p make - into its own @c llvm::Module; the caller emits one object per @p CodeGen.
+     * Emitting is sequential as @p World isn't thread-safe; optimizing, which dominates, runs concurrently as each @p CodeGen owns its @c llvm::LLVMContext.
+     * Functions are emitted with hidden visibility instead of internal linkage and declared in the other partitions which call them.
+     */
+    static std::vector<std::unique_ptr<CodeGen>> emit_partitioned(World& world, size_t num_partitions, int opt, bool debug,
+                                                                  const std::function<std::unique_ptr<CodeGen>(World&)>& make);
 
 protected:
+    void emit_module(int opt, bool debug);
+    /// Runs LLVM's default pipeline for @p opt - @c 1 to @c 3 or @c -1 to optimize for size; @c 0 does nothing.
     virtual void optimize(int opt);
+    virtual Pipeline tune(Pipeline pipeline) const { return pipeline; }
 
     //unsigned compute_variant_bits(const VariantType*);
     //unsigned compute_variant_op_bits(const Def*);
+    /// Small @p Arr%s of byte-sized integers or floats become LLVM vectors - see @p vector_type.
     llvm::Type* convert(const Def*);
+    /// Like @p convert but small @p Arr%s stay LLVM arrays: vectors would change the layout of memory and aggregates.
+    llvm::Type* convert_in_memory(const Def*);
     llvm::Value* emit(const Def*);
     llvm::Value* lookup(const Def*);
+    /// Dense number of a @p Def within the current scope - see @p values_.
+    u32 number(const Def*);
     llvm::AllocaInst* emit_alloca(llvm::Type*, const std::string&);
+    /// An alloca for a temporary which dies before the next @p Def is emitted - all temporaries of the same type in a function share it.
+    llvm::AllocaInst* emit_tmp_alloca(llvm::Type*);
+    /// Marks the start or end of the lifetime of @p alloca.
+    void emit_lifetime(bool start, llvm::AllocaInst* alloca);
     llvm::Value* emit_alloc(const Def* type);
     llvm::Function* emit_function_decl(Lam*);
+    /// Marks all pointer params of @p f @c noalias - for kernels whose pointers point to distinct allocations.
+    void emit_noalias(llvm::Function* f);
     virtual unsigned convert_addr_space(u64);
     virtual void emit_function_decl_hook(Lam*, llvm::Function*) {}
     virtual llvm::Value* map_var(llvm::Function*, llvm::Argument* a, const Def*) { return a; }
@@ -57,22 +98,66 @@ protected:
     Lam* emit_reserve_shared(Lam*, bool=false);
 
 private:
+    /// A launch which @p outline_kernels replaced by the call of a stub.
+    struct Launch {
+        Acc acc;
+        Lam* lam;           ///< Calls the stub ...
+        const Def* body;    ///< ... instead of this @c Acc.
+    };
+
+    /**
+     * Moves the kernel of each @c Acc::parallel in @p world into a closed @p Lam which receives the free @p Def%s of the kernel as additional params.
+     * The launch becomes a call of a stub without body - <tt>stub(mem, n, kernel, ret, args...)</tt> - which @p emit_intrinsic lowers.
+     * A launch on a GPU becomes <tt>stub(mem, n, ret, args...)</tt> as its kernel is emitted by another backend - see @p LaunchArgs.
+     * @p restore_kernels undoes this once the @p World is emitted as other @p CodeGen%s may emit it again.
+     */
+    static LamMap<Launch> outline_kernels(World& world);
+    static void restore_kernels(const LamMap<Launch>& launches);
     Lam* emit_peinfo(Lam*);
+    /// Lowers the call of a stub of @p outline_kernels in the body of @p lam and returns the continuation - or @c nullptr if this is the return of the function.
     Lam* emit_intrinsic(Lam*);
     Lam* emit_hls(Lam*);
     Lam* emit_parallel(Lam*);
     Lam* emit_spawn(Lam*);
     Lam* emit_sync(Lam*);
+    llvm::Value* emit_graph(const App*);
     Lam* emit_vectorize_lam(Lam*);
     Lam* emit_atomic(Lam*);
     Lam* emit_cmpxchg(Lam*);
     llvm::Value* emit_bitcast(const Def*, const Def*);
+    llvm::Value* emit_binop(const App*, llvm::Value*, llvm::Value*, const std::string&);
+    llvm::Value* emit_conv(const App*, llvm::Value*, llvm::Type*, const std::string&);
+    llvm::Value* emit_fma(nat_t, llvm::Value*, llvm::Value*, llvm::Value*, const std::string&);
+    llvm::Value* emit_lift(const App*);
+    llvm::Value* emit_lifted_app(const Def*, Array<llvm::Value*>, u64);
+    llvm::Value* emit_lifted(const Def*, DefMap<llvm::Value*>&, u64);
+    llvm::Value* emit_shuffle(const Tuple*);
     virtual Lam* emit_reserve(Lam*);
     void emit_result_phi(const Def*, llvm::Value*);
     void emit_vectorize(u32, llvm::Function*, llvm::CallInst*);
+    void emit_param_attrs(llvm::Argument*, Lam*, size_t);
+    LamMap<llvm::MDNode*> emit_loop_hints(const Scope&);
+    void color_slots(const Schedule&);
+    llvm::Value* emit_slot(const App*);
+    /// The node of @p type in the TBAA type tree - scalars hang below "omnipotent char" and structural @p Sigma%s list their fields.
+    llvm::MDNode* tbaa_type(const Def* type);
+    /// The TBAA access tag of a load or store through @p ptr - or @c nullptr if it accesses an aggregate.
+    llvm::MDNode* tbaa_tag(const Def* ptr);
 
 protected:
+    /// Maximal number of lanes for which we emit LLVM vectors.
+    static constexpr u64 max_vector_lanes = 16;
+
+    /// The vector type which replaces the LLVM array @p type in registers or @c nullptr if @p type stays an array.
+    static llvm::Type* vector_type(llvm::Type* type);
+
     llvm::Value* i1toi32(llvm::Value*);
+    llvm::Value* array2vector(llvm::Value*);
+    llvm::Value* vector2array(llvm::Value*, llvm::Type*);
+    /// @c insertvalue / @c extractvalue which convert between the vector in a register and the array within the aggregate.
+    llvm::Value* insert_value(llvm::Value* agg, llvm::Value* val, unsigned i);
+    llvm::Value* extract_value(llvm::Value* agg, unsigned i);
+    llvm::Value* vector_ptr(llvm::Value* ptr, llvm::Type* vector_type);
     void create_loop(llvm::Value*, llvm::Value*, llvm::Value*, llvm::Function*, std::function<void(llvm::Value*)>);
     llvm::Value* create_tmp_alloca(llvm::Type*, std::function<llvm::Value* (llvm::AllocaInst*)>);
 
@@ -85,17 +170,38 @@ protected:
     llvm::CallingConv::ID function_calling_convention_;
     llvm::CallingConv::ID device_calling_convention_;
     llvm::CallingConv::ID kernel_calling_convention_;
-    DefMap<llvm::Value*> vars_;
-    DefMap<llvm::PHINode*> phis_;
-    DefMap<llvm::Value*> defs_;
+    /**
+     * Each scope numbers its @p Def%s once: the @p Var%s of its basic blocks first, then the @p Def%s of its @p Schedule.
+     * The LLVM value of a @p Def lives at its number in @p values_; @p Def%s which aren't scheduled - like constants - are numbered on their first @p lookup.
+     */
+    DefMap<u32> numbers_;
+    std::vector<std::optional<llvm::Value*>> values_;
+    u32 num_vars_ = 0;                      ///< Numbers below this one belong to @p Var%s - either arguments of the entry or phis.
     LamMap<llvm::Function*> fcts_;
     DefMap<llvm::Type*> types_;
+    DefMap<llvm::MDNode*> tbaa_types_;
+    llvm::MDNode* tbaa_char_ = nullptr;
+    DefSet punned_;                         ///< Types which are also accessed through pointers of other types - see @p tbaa_type.
+    /// Storage which @c slot%s with disjoint lifetimes share - see @p color_slots.
+    struct SlotColor {
+        u64 size = 0;
+        u64 align = 1;
+        size_t num_slots = 0;
+        llvm::AllocaInst* storage = nullptr;
+    };
+    std::vector<SlotColor> slot_colors_;
+    DefMap<size_t> slot2color_;
+    DefMap<DefVec> lifetime_ends_;          ///< The @c slot%s whose lifetime ends right after the key is emitted.
+    llvm::DenseMap<llvm::Type*, llvm::AllocaInst*> tmp_allocas_;
 #if THORIN_ENABLE_RV
     std::vector<std::tuple<u32, llvm::Function*, llvm::CallInst*>> vec_todo_;
 #endif
 
     std::unique_ptr<Runtime> runtime_;
+    Pipeline pipeline_;
     Lam* entry_ = nullptr;
+    LamMap<Launch> launches_;               ///< The stubs of @p outline_kernels.
+    const LamSet* partition_ = nullptr;     ///< If set, only these top-level scopes are emitted - see @p emit_partitioned.
 
     friend class Runtime;
 };
@@ -105,14 +211,28 @@ protected:
 template<class T>
 llvm::ArrayRef<T> llvm_ref(const Array<T>& array) { return llvm::ArrayRef<T>(array.begin(), array.end()); }
 
+/**
+ * Splits a @p World into the parts for each backend:
+ * The kernels of @c Acc::cuda, @c Acc::nvvm, @c Acc::opencl and @c Acc::amdgpu are imported into a @p World of their own; everything else stays on the @p CPU.
+ * There is no @c Acc for @p HLS yet, so its @p World stays empty.
+ * With @p emulate_gpu, all kernels run on the @p CPU instead - see @p emulate_grid.
+ */
 struct Backends {
     enum { CPU, CUDA, NVVM, OpenCL, AMDGPU, HLS, Num_Backends };
 
-    explicit Backends(World& world);
+    explicit Backends(World& world, bool emulate_gpu = false);
+
+    /**
+     * Emits each backend with a @p CodeGen to its stream in @p streams - if not @c nullptr.
+     * The backends run concurrently as each of them owns its @p World and @c llvm::LLVMContext.
+     */
+    void emit(const std::array<std::ostream*, Num_Backends>& streams, int opt, bool debug);
 
     Cont2Config kernel_config;
     std::vector<Lam*> kernels;
+    LamMap<DefVec> kernel_args;         ///< Free @p Def%s of each kernel which the host passes as additional arguments - in this order; see @p kernels.
 
+    std::array<std::unique_ptr<World>, Num_Backends> worlds;    ///< Target @p World%s - except for the @p CPU which uses the original one.
     std::array<Rewriter, Num_Backends> rewriters;
     std::array<std::unique_ptr<CodeGen>,  Num_Backends> codegens;
 };
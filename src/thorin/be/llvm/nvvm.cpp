@@ -49,7 +49,7 @@ static u64 resolve_addr_space(const Def* def) {
 llvm::FunctionType* NVVMCodeGen::convert_fn_type(Lam* lam) {
     // skip non-global address-space parameters
     DefVec types;
-    for (auto type : lam->type()->ops()) {
+    for (auto type : lam->doms()) {
         if (auto ptr = isa<Tag::Ptr>(type))
             if (as_lit<nat_t>(ptr->arg(1)) == AddrSpace::Texture)
                 continue;
@@ -85,6 +85,7 @@ void NVVMCodeGen::emit_function_decl_hook(Lam* lam, llvm::Function* f) {
             append_metadata(f, "maxntidy", std::get<1>(block));
             append_metadata(f, "maxntidz", std::get<2>(block));
         }
+        if (config->second->as<GPUKernelConfig>()->has_restrict()) emit_noalias(f);
     }
 
     // check signature for texturing memory
@@ -131,7 +132,7 @@ void NVVMCodeGen::emit_function_start(llvm::BasicBlock*, Lam* lam) {
             assert(md != metadata_.end());
             // require specific handle to be mapped to a var
             llvm::Value* args[] = { llvm::MetadataAsValue::get(context_, md->second), global };
-            vars_[var] = irbuilder_.CreateCall(texture_handle, args);
+            values_[number(var)] = irbuilder_.CreateCall(texture_handle, args);
         }
     }
 }
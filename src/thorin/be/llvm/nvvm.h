@@ -14,6 +14,11 @@ public:
 protected:
     // NVVM-specific optimizations are run in the runtime
     virtual void optimize(int opt) override { if (opt > 0) CodeGen::optimize(1); }
+    // each thread is scalar - vectorizing within a thread only adds register pressure
+    virtual Pipeline tune(Pipeline pipeline) const override {
+        pipeline.vectorize_loops = pipeline.vectorize_slp = pipeline.interleave_loops = false;
+        return pipeline;
+    }
 
     virtual void emit_function_decl_hook(Lam*, llvm::Function*) override;
     virtual llvm::FunctionType* convert_fn_type(Lam*) override;
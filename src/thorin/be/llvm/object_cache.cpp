@@ -0,0 +1,96 @@
+#include "thorin/be/llvm/object_cache.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/Process.h>
+#include <llvm/Support/SHA1.h>
+#include <llvm/Support/raw_ostream.h>
+
+namespace fs = std::filesystem;
+
+namespace thorin {
+
+ObjectCache::ObjectCache(const std::string& dir, uint64_t max_size)
+    : dir_(dir)
+    , max_size_(max_size)
+{
+    fs::create_directories(dir_);
+}
+
+std::string ObjectCache::key(const llvm::Module& module, llvm::StringRef config) {
+    llvm::SmallVector<char, 0> bitcode;
+    llvm::raw_svector_ostream os(bitcode);
+    llvm::WriteBitcodeToFile(module, os);
+
+    llvm::SHA1 sha1;
+    sha1.update(llvm::StringRef(bitcode.data(), bitcode.size()));
+    sha1.update(config);
+    return llvm::toHex(sha1.final(), true);
+}
+
+std::unique_ptr<llvm::MemoryBuffer> ObjectCache::load(const std::string& key) {
+    auto path = fs::path(dir_) / (key + ".o");
+    auto buffer = llvm::MemoryBuffer::getFile(path.string());
+    if (!buffer) return nullptr;
+
+    // touch the object as eviction goes by the time of the last write
+    std::error_code error;
+    fs::last_write_time(path, fs::file_time_type::clock::now(), error);
+    return std::move(*buffer);
+}
+
+void ObjectCache::store(const std::string& key, llvm::StringRef object) {
+    auto path = fs::path(dir_) / (key + ".o");
+    auto tmp  = path;
+    tmp += ".tmp" + std::to_string(llvm::sys::Process::getProcessId()) + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    {
+        std::ofstream ofs(tmp, std::ios::binary);
+        ofs.write(object.data(), object.size());
+        if (!ofs) return; // caching is merely an optimization
+    }
+
+    std::error_code error;
+    fs::rename(tmp, path, error);
+    if (error) fs::remove(tmp, error);
+
+    evict();
+}
+
+void ObjectCache::evict() {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    struct Entry {
+        fs::path path;
+        fs::file_time_type time;
+        uint64_t size;
+    };
+    std::vector<Entry> entries;
+    uint64_t total = 0;
+    std::error_code error;
+    for (const auto& file : fs::directory_iterator(dir_, error)) {
+        if (file.path().extension() != ".o") continue;
+        auto size = file.file_size(error);
+        auto time = file.last_write_time(error);
+        if (error) continue; // another process might have evicted it
+        entries.emplace_back(Entry{file.path(), time, size});
+        total += size;
+    }
+    if (total <= max_size_) return;
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.time < b.time; });
+    for (const auto& entry : entries) {
+        if (total <= max_size_) break;
+        fs::remove(entry.path, error);
+        total -= entry.size;
+    }
+}
+
+}
@@ -0,0 +1,41 @@
+#ifndef THORIN_BE_LLVM_OBJECT_CACHE_H
+#define THORIN_BE_LLVM_OBJECT_CACHE_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+namespace llvm { class Module; }
+
+namespace thorin {
+
+/**
+ * Object files in a local directory which are looked up by a @p key of the module they were compiled from.
+ * Once the directory grows beyond its maximal size, the least recently used objects are evicted.
+ * Several processes may share a directory: objects are written to a temporary file first which is then renamed.
+ */
+class ObjectCache {
+public:
+    ObjectCache(const std::string& dir, uint64_t max_size = uint64_t(1) << 30);
+
+    /// SHA1 of @p module's bitcode and @p config which describes everything else that determines the object file - like target and options.
+    static std::string key(const llvm::Module& module, llvm::StringRef config);
+    /// Returns @c nullptr on a miss.
+    std::unique_ptr<llvm::MemoryBuffer> load(const std::string& key);
+    void store(const std::string& key, llvm::StringRef object);
+
+private:
+    void evict();
+
+    std::string dir_;
+    uint64_t max_size_;
+    std::mutex mutex_;
+};
+
+}
+
+#endif
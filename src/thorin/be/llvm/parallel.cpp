@@ -1,41 +1,55 @@
 #include "thorin/be/llvm/llvm.h"
 
+#include "thorin/analyses/looptree.h"
+#include "thorin/analyses/scope.h"
+
 namespace thorin {
 
 enum {
     PAR_ARG_MEM,
-    PAR_ARG_NUMTHREADS,
-    PAR_ARG_LOWER,
-    PAR_ARG_UPPER,
+    PAR_ARG_NUM,
     PAR_ARG_BODY,
     PAR_ARG_RETURN,
     PAR_NUM_ARGS
 };
 
+/**
+ * Estimates how many iterations of @p kernel amortize the scheduling overhead of the runtime: a chunk should execute roughly @c ops_per_chunk operations.
+ * Kernels containing loops are assumed to do enough work per iteration.
+ */
+static u32 grain_size(Lam* kernel) {
+    static constexpr size_t ops_per_chunk = 1024;
+
+    Scope scope(kernel);
+    const auto& looptree = scope.f_cfg().looptree();
+    for (const auto& child : looptree.root()->children()) {
+        if (child->isa<LoopTree<true>::Head>()) return 1;
+    }
+
+    size_t num_ops = 0;
+    for (auto def : scope.bound()) num_ops += def->isa<App>() && !def->type()->isa<Pi>() ? 1 : 0;
+    return u32(std::clamp(ops_per_chunk / std::max(num_ops, size_t(1)), size_t(1), ops_per_chunk));
+}
+
+/**
+ * Lowers the stub of an @c Acc::parallel - see @p outline_kernels.
+ * Calls @c anydsl_parallel_for_grain with a wrapper that runs the outlined kernel for each index of a chunk; the free @p Def%s of the kernel are passed in a closure.
+ */
 Lam* CodeGen::emit_parallel(Lam* lam) {
     // arguments
     assert(lam->body()->as<App>()->num_args() >= PAR_NUM_ARGS && "required arguments are missing");
-    auto num_threads = lookup(lam->body()->as<App>()->arg(PAR_ARG_NUMTHREADS));
-    auto lower = lookup(lam->body()->as<App>()->arg(PAR_ARG_LOWER));
-    auto upper = lookup(lam->body()->as<App>()->arg(PAR_ARG_UPPER));
-    auto kernel = lam->body()->as<App>()->arg(PAR_ARG_BODY)->as<Global>()->init()->as_nom<Lam>();
+    auto num = irbuilder_.CreateTrunc(lookup(lam->body()->as<App>()->arg(PAR_ARG_NUM)), irbuilder_.getInt32Ty());
+    auto kernel = lam->body()->as<App>()->arg(PAR_ARG_BODY)->as_nom<Lam>();
+    auto kernel_fct = emit_function_decl(kernel);
 
     const size_t num_kernel_args = lam->body()->as<App>()->num_args() - PAR_NUM_ARGS;
 
-    // build parallel-function signature
-    Array<llvm::Type*> par_args(num_kernel_args + 1);
-    par_args[0] = irbuilder_.getInt32Ty(); // loop index
-    for (size_t i = 0; i < num_kernel_args; ++i) {
-        auto type = lam->body()->as<App>()->arg(i + PAR_NUM_ARGS)->type();
-        par_args[i + 1] = convert(type);
-    }
-
     // fetch values and create a unified struct which contains all values (closure)
     auto closure_type = convert(world_.sigma(lam->body()->as<App>()->arg()->type()->as<Sigma>()->ops().skip_front(PAR_NUM_ARGS)));
     llvm::Value* closure = llvm::UndefValue::get(closure_type);
     if (num_kernel_args != 1) {
         for (size_t i = 0; i < num_kernel_args; ++i)
-            closure = irbuilder_.CreateInsertValue(closure, lookup(lam->body()->as<App>()->arg(i + PAR_NUM_ARGS)), unsigned(i));
+            closure = insert_value(closure, lookup(lam->body()->as<App>()->arg(i + PAR_NUM_ARGS)), unsigned(i));
     } else {
         closure = lookup(lam->body()->as<App>()->arg(PAR_NUM_ARGS));
     }
@@ -50,7 +64,8 @@ Lam* CodeGen::emit_parallel(Lam* lam) {
     auto wrapper_ft = llvm::FunctionType::get(irbuilder_.getVoidTy(), wrapper_arg_types, false);
     auto wrapper_name = kernel->unique_name() + "_parallel_for";
     auto wrapper = (llvm::Function*)module_->getOrInsertFunction(wrapper_name, wrapper_ft).getCallee()->stripPointerCasts();
-    runtime_->parallel_for(num_threads, lower, upper, ptr, wrapper);
+    wrapper->setLinkage(llvm::Function::InternalLinkage);
+    runtime_->parallel_for(irbuilder_.getInt32(0), irbuilder_.getInt32(0), num, irbuilder_.getInt32(grain_size(kernel)), ptr, wrapper);
 
     // set insert point to the wrapper function
     auto old_bb = irbuilder_.GetInsertBlock();
@@ -60,11 +75,11 @@ Lam* CodeGen::emit_parallel(Lam* lam) {
     // extract all arguments from the closure
     auto wrapper_args = wrapper->arg_begin();
     auto load_ptr = irbuilder_.CreateBitCast(&*wrapper_args, llvm::PointerType::get(closure_type, 0));
-    auto val = irbuilder_.CreateLoad(load_ptr);
+    auto val = irbuilder_.CreateLoad(closure_type, load_ptr);
     std::vector<llvm::Value*> target_args(num_kernel_args + 1);
     if (num_kernel_args != 1) {
         for (size_t i = 0; i < num_kernel_args; ++i)
-            target_args[i + 1] = irbuilder_.CreateExtractValue(val, { unsigned(i) });
+            target_args[i + 1] = extract_value(val, unsigned(i));
     } else {
         target_args[1] = val;
     }
@@ -74,19 +89,19 @@ Lam* CodeGen::emit_parallel(Lam* lam) {
     //   body(i, <closure_elems>);
     auto wrapper_lower = &*(++wrapper_args);
     auto wrapper_upper = &*(++wrapper_args);
+    auto index_type = kernel_fct->getFunctionType()->getParamType(0);
     create_loop(wrapper_lower, wrapper_upper, irbuilder_.getInt32(1), wrapper, [&](llvm::Value* counter) {
         // call kernel body
-        target_args[0] = counter; // loop index
-        auto par_type = llvm::FunctionType::get(irbuilder_.getVoidTy(), llvm_ref(par_args), false);
-        auto kernel_par_func = (llvm::Function*)module_->getOrInsertFunction(kernel->unique_name(), par_type).getCallee()->stripPointerCasts();
-        irbuilder_.CreateCall(kernel_par_func, target_args);
+        target_args[0] = irbuilder_.CreateZExtOrTrunc(counter, index_type); // loop index
+        auto call = irbuilder_.CreateCall(kernel_fct, target_args);
+        call->setCallingConv(kernel_fct->getCallingConv());
     });
     irbuilder_.CreateRetVoid();
 
     // restore old insert point
     irbuilder_.SetInsertPoint(old_bb);
 
-    return lam->body()->as<App>()->arg(PAR_ARG_RETURN)->as_nom<Lam>();
+    return lam->body()->as<App>()->arg(PAR_ARG_RETURN)->isa_nom<Lam>();
 }
 
 enum {
@@ -112,7 +127,7 @@ Lam* CodeGen::emit_spawn(Lam* lam) {
     auto closure_type = convert(world_.sigma(lam->body()->as<App>()->arg()->type()->as<Sigma>()->ops().skip_front(SPAWN_NUM_ARGS)));
     llvm::Value* closure = llvm::UndefValue::get(closure_type);
     for (size_t i = 0; i < num_kernel_args; ++i)
-        closure = irbuilder_.CreateInsertValue(closure, lookup(lam->body()->as<App>()->arg(i + SPAWN_NUM_ARGS)), unsigned(i));
+        closure = insert_value(closure, lookup(lam->body()->as<App>()->arg(i + SPAWN_NUM_ARGS)), unsigned(i));
 
     // allocate closure object and write values into it
     auto ptr = irbuilder_.CreateAlloca(closure_type, nullptr);
@@ -134,10 +149,10 @@ Lam* CodeGen::emit_spawn(Lam* lam) {
     // extract all arguments from the closure
     auto wrapper_args = wrapper->arg_begin();
     auto load_ptr = irbuilder_.CreateBitCast(&*wrapper_args, llvm::PointerType::get(closure_type, 0));
-    auto val = irbuilder_.CreateLoad(load_ptr);
+    auto val = irbuilder_.CreateLoad(closure_type, load_ptr);
     std::vector<llvm::Value*> target_args(num_kernel_args);
     for (size_t i = 0; i < num_kernel_args; ++i)
-        target_args[i] = irbuilder_.CreateExtractValue(val, { unsigned(i) });
+        target_args[i] = extract_value(val, unsigned(i));
 
     // call kernel body
     auto par_type = llvm::FunctionType::get(irbuilder_.getVoidTy(), llvm_ref(par_args), false);
@@ -168,5 +183,73 @@ Lam* CodeGen::emit_sync(Lam* lam) {
     return lam->body()->as<App>()->arg(SYNC_ARG_RETURN)->as_nom<Lam>();
 }
 
+/**
+ * Task graphs are built and executed via the runtime.
+ * The environment of a task lives on the heap - tasks are often created in loops where @c alloca%s would pile up on the stack.
+ * The task releases it once it has run; hence, each task of a graph built by generated code runs at most once.
+ */
+llvm::Value* CodeGen::emit_graph(const App* app) {
+    switch (isa<Tag::Graph>(app).flags()) {
+        case Graph::create: return runtime_->create_graph();
+        case Graph::edge: {
+            auto [mem, from, to] = app->args<3>();
+            return runtime_->create_edge(lookup(from), lookup(to));
+        }
+        case Graph::exec: {
+            auto [mem, graph, root] = app->args<3>();
+            return runtime_->execute_graph(lookup(graph), lookup(root));
+        }
+        case Graph::task: break;
+        default: THORIN_UNREACHABLE;
+    }
+
+    auto [mem, graph, body, env] = app->args<4>();
+    auto kernel = body->as_nom<Lam>();
+    auto kernel_fct = emit_function_decl(kernel);
+    bool has_env = !is_unit(env);
+
+    // store the environment and pass its address as payload
+    llvm::Value* payload = irbuilder_.getInt64(0);
+    auto env_type = has_env ? convert(env->type()) : nullptr;
+    if (has_env) {
+        auto size = irbuilder_.getInt64(module_->getDataLayout().getTypeAllocSize(env_type));
+        auto mem = irbuilder_.CreateCall(runtime_->get("anydsl_alloc"), { irbuilder_.getInt32(0), size });
+        auto ptr = irbuilder_.CreatePointerCast(mem, llvm::PointerType::get(env_type, 0), "task_env");
+        irbuilder_.CreateStore(lookup(env), ptr, false);
+        payload = irbuilder_.CreatePtrToInt(ptr, irbuilder_.getInt64Ty());
+    }
+
+    // wrapper(i64 payload)
+    auto wrapper_ft = llvm::FunctionType::get(irbuilder_.getVoidTy(), { irbuilder_.getInt64Ty() }, false);
+    auto wrapper_name = kernel->unique_name() + "_task";
+    auto wrapper = (llvm::Function*)module_->getOrInsertFunction(wrapper_name, wrapper_ft).getCallee()->stripPointerCasts();
+    wrapper->setLinkage(llvm::Function::InternalLinkage);
+
+    auto closure_type = llvm::StructType::get(context_, { irbuilder_.getInt8PtrTy(), irbuilder_.getInt64Ty() });
+    llvm::Value* closure = llvm::UndefValue::get(closure_type);
+    closure = irbuilder_.CreateInsertValue(closure, irbuilder_.CreatePointerCast(wrapper, irbuilder_.getInt8PtrTy()), 0);
+    closure = irbuilder_.CreateInsertValue(closure, payload, 1);
+    auto task = runtime_->create_task(lookup(graph), closure);
+
+    if (wrapper->empty()) {
+        auto old_bb = irbuilder_.GetInsertBlock();
+        irbuilder_.SetInsertPoint(llvm::BasicBlock::Create(context_, wrapper_name, wrapper));
+
+        std::vector<llvm::Value*> args;
+        if (has_env) {
+            auto ptr = irbuilder_.CreateIntToPtr(&*wrapper->arg_begin(), llvm::PointerType::get(env_type, 0));
+            args.emplace_back(irbuilder_.CreateLoad(env_type, ptr));
+            irbuilder_.CreateCall(runtime_->get("anydsl_release"), { irbuilder_.getInt32(0), irbuilder_.CreatePointerCast(ptr, irbuilder_.getInt8PtrTy()) });
+        }
+        auto call = irbuilder_.CreateCall(kernel_fct, args);
+        call->setCallingConv(kernel_fct->getCallingConv());
+        irbuilder_.CreateRetVoid();
+
+        irbuilder_.SetInsertPoint(old_bb);
+    }
+
+    return task;
+}
+
 }
 
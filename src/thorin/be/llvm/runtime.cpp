@@ -52,36 +52,34 @@ static bool contains_ptrtype(const Def* type) {
     }
 }
 
-Lam* Runtime::emit_host_code(CodeGen& code_gen, Platform platform, const std::string& ext, Lam* lam) {
+Lam* Runtime::emit_host_code(CodeGen& code_gen, Platform platform, const std::string& ext, Lam* lam, const Lam* kernel) {
     auto& world = lam->world();
 
-    // to-target is the desired kernel call
-    // target(mem, device, (dim.x, dim.y, dim.z), (block.x, block.y, block.z), body, return, free_vars)
-    //auto target = lam->body()->as<App>()->callee()->as_nom<Lam>();
-    assert(lam->body()->as<App>()->num_args() >= LaunchArgs::Num && "required arguments are missing");
+    // the stub of the launch is called as
+    // stub(mem, n, return, args...)
+    auto stub = lam->body()->as<App>();
+    assert(stub->num_args() >= LaunchArgs::Num && "required arguments are missing");
 
     // arguments
-    auto target_device_id = code_gen.lookup(lam->body()->as<App>()->arg(LaunchArgs::Device));
-    auto target_platform = builder_.getInt32(platform);
-    auto target_device = builder_.CreateOr(target_platform, builder_.CreateShl(target_device_id, builder_.getInt32(4)));
-    auto it_space = lam->body()->as<App>()->arg(LaunchArgs::Space)->as<Tuple>();
-    auto it_config = lam->body()->as<App>()->arg(LaunchArgs::Config)->as<Tuple>();
-    auto kernel = lam->body()->as<App>()->arg(LaunchArgs::Body)->as<Global>()->init()->as<Lam>();
-
-    auto kernel_name = builder_.CreateGlobalStringPtr(kernel->debug().name);
-    auto file_name = builder_.CreateGlobalStringPtr(lam->world().name() + ext);
-    const size_t num_kernel_args = lam->body()->as<App>()->num_args() - LaunchArgs::Num;
+    auto target_device = builder_.getInt32(platform); // device 0 of this platform
+    auto kernel_name = builder_.CreateGlobalStringPtr(kernel->unique_name());
+    auto file_name = builder_.CreateGlobalStringPtr(world.name() + ext);
+    const size_t num_kernel_args = stub->num_args() - LaunchArgs::Num;
 
     // allocate argument pointers, sizes, and types
-    llvm::Value* args   = code_gen.emit_alloca(llvm::ArrayType::get(builder_.getInt8PtrTy(), num_kernel_args), "args");
-    llvm::Value* sizes  = code_gen.emit_alloca(llvm::ArrayType::get(builder_.getInt32Ty(),   num_kernel_args), "sizes");
-    llvm::Value* aligns = code_gen.emit_alloca(llvm::ArrayType::get(builder_.getInt32Ty(),   num_kernel_args), "aligns");
-    llvm::Value* types  = code_gen.emit_alloca(llvm::ArrayType::get(builder_.getInt8Ty(),    num_kernel_args), "types");
+    auto args   = code_gen.emit_alloca(llvm::ArrayType::get(builder_.getInt8PtrTy(), num_kernel_args), "args");
+    auto sizes  = code_gen.emit_alloca(llvm::ArrayType::get(builder_.getInt32Ty(),   num_kernel_args), "sizes");
+    auto aligns = code_gen.emit_alloca(llvm::ArrayType::get(builder_.getInt32Ty(),   num_kernel_args), "aligns");
+    auto types  = code_gen.emit_alloca(llvm::ArrayType::get(builder_.getInt8Ty(),    num_kernel_args), "types");
+    auto elem = [&](llvm::AllocaInst* array, size_t i) {
+        return builder_.CreateInBoundsGEP(array->getAllocatedType(), array, {builder_.getInt32(0), builder_.getInt32(i)});
+    };
 
     // fill array of arguments
     for (size_t i = 0; i < num_kernel_args; ++i) {
-        auto target_arg = lam->body()->as<App>()->arg(i + LaunchArgs::Num);
-        const auto target_val = code_gen.lookup(target_arg);
+        auto target_arg = stub->arg(i + LaunchArgs::Num);
+        // small arrays are passed as arrays - not as the vectors we hold them in
+        const auto target_val = code_gen.vector2array(code_gen.lookup(target_arg), code_gen.convert_in_memory(target_arg->type()));
 
         KernelArgType arg_type;
         llvm::Value*  void_ptr;
@@ -115,10 +113,10 @@ Lam* Runtime::emit_host_code(CodeGen& code_gen, Platform platform, const std::st
             arg_type = KernelArgType::Val;
         }
 
-        auto arg_ptr   = builder_.CreateInBoundsGEP(args,   llvm::ArrayRef<llvm::Value*>{builder_.getInt32(0), builder_.getInt32(i)});
-        auto size_ptr  = builder_.CreateInBoundsGEP(sizes,  llvm::ArrayRef<llvm::Value*>{builder_.getInt32(0), builder_.getInt32(i)});
-        auto align_ptr = builder_.CreateInBoundsGEP(aligns, llvm::ArrayRef<llvm::Value*>{builder_.getInt32(0), builder_.getInt32(i)});
-        auto type_ptr  = builder_.CreateInBoundsGEP(types,  llvm::ArrayRef<llvm::Value*>{builder_.getInt32(0), builder_.getInt32(i)});
+        auto arg_ptr   = elem(args,   i);
+        auto size_ptr  = elem(sizes,  i);
+        auto align_ptr = elem(aligns, i);
+        auto type_ptr  = elem(types,  i);
 
         auto size = layout_.getTypeStoreSize(target_val->getType()).getFixedSize();
         if (auto struct_type = llvm::dyn_cast<llvm::StructType>(target_val->getType())) {
@@ -135,37 +133,26 @@ Lam* Runtime::emit_host_code(CodeGen& code_gen, Platform platform, const std::st
     }
 
     // allocate arrays for the grid and block size
-    const auto get_u32 = [&](const Def* def) { return builder_.CreateSExt(code_gen.lookup(def), builder_.getInt32Ty()); };
+    auto num = builder_.CreateZExtOrTrunc(code_gen.lookup(stub->arg(LaunchArgs::Threads)), builder_.getInt32Ty());
 
     llvm::Value* grid_array  = llvm::UndefValue::get(llvm::ArrayType::get(builder_.getInt32Ty(), 3));
-    grid_array = builder_.CreateInsertValue(grid_array, get_u32(it_space->op(0)), 0);
-    grid_array = builder_.CreateInsertValue(grid_array, get_u32(it_space->op(1)), 1);
-    grid_array = builder_.CreateInsertValue(grid_array, get_u32(it_space->op(2)), 2);
-    llvm::Value* grid_size = code_gen.emit_alloca(grid_array->getType(), "");
+    grid_array = builder_.CreateInsertValue(grid_array, num, 0);
+    grid_array = builder_.CreateInsertValue(grid_array, builder_.getInt32(1), 1);
+    grid_array = builder_.CreateInsertValue(grid_array, builder_.getInt32(1), 2);
+    auto grid_size = code_gen.emit_alloca(grid_array->getType(), "");
     builder_.CreateStore(grid_array, grid_size);
 
-    llvm::Value* block_array = llvm::UndefValue::get(llvm::ArrayType::get(builder_.getInt32Ty(), 3));
-    block_array = builder_.CreateInsertValue(block_array, get_u32(it_config->op(0)), 0);
-    block_array = builder_.CreateInsertValue(block_array, get_u32(it_config->op(1)), 1);
-    block_array = builder_.CreateInsertValue(block_array, get_u32(it_config->op(2)), 2);
-    llvm::Value* block_size = code_gen.emit_alloca(block_array->getType(), "");
+    auto block_array = llvm::ConstantArray::get(llvm::ArrayType::get(builder_.getInt32Ty(), 3), {builder_.getInt32(1), builder_.getInt32(1), builder_.getInt32(1)});
+    auto block_size = code_gen.emit_alloca(block_array->getType(), "");
     builder_.CreateStore(block_array, block_size);
 
-    std::vector<llvm::Value*> gep_first_elem{builder_.getInt32(0), builder_.getInt32(0)};
-    grid_size  = builder_.CreateInBoundsGEP(grid_size,  gep_first_elem);
-    block_size = builder_.CreateInBoundsGEP(block_size, gep_first_elem);
-    args       = builder_.CreateInBoundsGEP(args,       gep_first_elem);
-    sizes      = builder_.CreateInBoundsGEP(sizes,      gep_first_elem);
-    aligns     = builder_.CreateInBoundsGEP(aligns,     gep_first_elem);
-    types      = builder_.CreateInBoundsGEP(types,      gep_first_elem);
-
     launch_kernel(target_device,
                   file_name, kernel_name,
-                  grid_size, block_size,
-                  args, sizes, aligns, types,
+                  elem(grid_size, 0), elem(block_size, 0),
+                  elem(args, 0), elem(sizes, 0), elem(aligns, 0), elem(types, 0),
                   builder_.getInt32(num_kernel_args));
 
-    return lam->body()->as<App>()->arg(LaunchArgs::Return)->as_nom<Lam>();
+    return stub->arg(LaunchArgs::Return)->isa_nom<Lam>();
 }
 
 llvm::Value* Runtime::launch_kernel(llvm::Value* device,
@@ -177,14 +164,14 @@ llvm::Value* Runtime::launch_kernel(llvm::Value* device,
     return builder_.CreateCall(get("anydsl_launch_kernel"), launch_args);
 }
 
-llvm::Value* Runtime::parallel_for(llvm::Value* num_threads, llvm::Value* lower, llvm::Value* upper,
+llvm::Value* Runtime::parallel_for(llvm::Value* num_threads, llvm::Value* lower, llvm::Value* upper, llvm::Value* grain,
                                    llvm::Value* closure_ptr, llvm::Value* fun_ptr) {
     llvm::Value* parallel_args[] = {
-        num_threads, lower, upper,
+        num_threads, lower, upper, grain,
         builder_.CreatePointerCast(closure_ptr, builder_.getInt8PtrTy()),
         builder_.CreatePointerCast(fun_ptr, builder_.getInt8PtrTy())
     };
-    return builder_.CreateCall(get("anydsl_parallel_for"), parallel_args);
+    return builder_.CreateCall(get("anydsl_parallel_for_grain"), parallel_args);
 }
 
 llvm::Value* Runtime::spawn_thread(llvm::Value* closure_ptr, llvm::Value* fun_ptr) {
@@ -199,4 +186,23 @@ llvm::Value* Runtime::sync_thread(llvm::Value* id) {
     return builder_.CreateCall(get("anydsl_sync_thread"), id);
 }
 
+llvm::Value* Runtime::create_graph() {
+    return builder_.CreateCall(get("anydsl_create_graph"));
+}
+
+llvm::Value* Runtime::create_task(llvm::Value* graph, llvm::Value* closure) {
+    llvm::Value* task_args[] = { graph, closure };
+    return builder_.CreateCall(get("anydsl_create_task"), task_args);
+}
+
+llvm::Value* Runtime::create_edge(llvm::Value* from, llvm::Value* to) {
+    llvm::Value* edge_args[] = { from, to };
+    return builder_.CreateCall(get("anydsl_create_edge"), edge_args);
+}
+
+llvm::Value* Runtime::execute_graph(llvm::Value* graph, llvm::Value* root) {
+    llvm::Value* exec_args[] = { graph, root };
+    return builder_.CreateCall(get("anydsl_execute_graph"), exec_args);
+}
+
 }
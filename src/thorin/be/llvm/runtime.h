@@ -12,13 +12,11 @@ namespace thorin {
 
 class CodeGen;
 
+/// The args of the stub which @p CodeGen::outline_kernels calls instead of a launch on a GPU; the kernel's args follow.
 struct LaunchArgs {
     enum {
         Mem = 0,
-        Device,
-        Space,
-        Config,
-        Body,
+        Threads,
         Return,
         Num
     };
@@ -44,18 +42,36 @@ public:
                                llvm::Value* args, llvm::Value* sizes, llvm::Value* aligns, llvm::Value* types,
                                llvm::Value* num_args);
 
-    /// Emits a call to anydsl_parallel_for.
-    llvm::Value* parallel_for(llvm::Value* num_threads, llvm::Value* lower, llvm::Value* upper,
+    /// Emits a call to anydsl_parallel_for_grain; the runtime won't schedule chunks of less than @p grain iterations.
+    llvm::Value* parallel_for(llvm::Value* num_threads, llvm::Value* lower, llvm::Value* upper, llvm::Value* grain,
                               llvm::Value* closure_ptr, llvm::Value* fun_ptr);
     /// Emits a call to anydsl_spawn_thread.
     llvm::Value* spawn_thread(llvm::Value* closure_ptr, llvm::Value* fun_ptr);
     /// Emits a call to anydsl_sync_thread.
     llvm::Value* sync_thread(llvm::Value* id);
 
+    /// @name task graphs
+    //@{
+    /// Emits a call to anydsl_create_graph.
+    llvm::Value* create_graph();
+    /// Emits a call to anydsl_create_task; @p closure is a <tt>{ i8*, i64 }</tt> holding a <tt>void(i64)</tt> function and its argument.
+    llvm::Value* create_task(llvm::Value* graph, llvm::Value* closure);
+    /// Emits a call to anydsl_create_edge.
+    llvm::Value* create_edge(llvm::Value* from, llvm::Value* to);
+    /// Emits a call to anydsl_execute_graph.
+    llvm::Value* execute_graph(llvm::Value* graph, llvm::Value* root);
+    //@}
+
+    /**
+     * Emits a call to anydsl_launch_kernel for the stub of a launch of @p kernel which the body of @p lam calls - see @p LaunchArgs.
+     * The kernel runs in the file @c "<world name><ext>" on device 0 of @p platform; each of its @c n threads is a block of its own.
+     * Returns the continuation - or @c nullptr if this is the return of the function.
+     */
     Lam* emit_host_code(CodeGen& code_gen,
-                                 Platform platform,
-                                 const std::string& ext,
-                                 Lam* lam);
+                        Platform platform,
+                        const std::string& ext,
+                        Lam* lam,
+                        const Lam* kernel);
 
     llvm::Function* get(const char* name);
 
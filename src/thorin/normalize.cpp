@@ -177,6 +177,8 @@ template<RCmp cmp, nat_t w> struct Fold<RCmp, cmp, w> {
     }
 };
 
+template<nat_t w> struct FoldFMA { static Res run(u64 a, u64 b, u64 c) { using T = w2r<w>; return T(fused_mul_add(get<T>(a), get<T>(b), get<T>(c))); } };
+
 template<Conv op, nat_t, nat_t> struct FoldConv {};
 template<nat_t dw, nat_t sw> struct FoldConv<Conv::s2s, dw, sw> { static Res run(u64 src) { return w2s<dw>(get<w2s<sw>>(src)); } };
 template<nat_t dw, nat_t sw> struct FoldConv<Conv::u2u, dw, sw> { static Res run(u64 src) { return w2u<dw>(get<w2u<sw>>(src)); } };
@@ -501,7 +503,7 @@ const Def* normalize_Shr(const Def* type, const Def* c, const Def* arg, const De
             }
         }
 
-        if (lb->get() > *w) return world.bot(type, dbg);
+        if (auto width = w ? mod2width(*w) : std::nullopt; width && lb->get() >= *width) return world.bot(type, dbg);
     }
 
     return world.raw_app(callee, {a, b}, dbg);
@@ -846,6 +848,16 @@ const Def* normalize_Acc(const Def* type, const Def* callee, const Def* arg, con
     return type->world().raw_app(callee, arg, dbg);
 }
 
+template<Hint op>
+const Def* normalize_Hint(const Def* type, const Def* callee, const Def* arg, const Def* dbg) {
+    auto& world = type->world();
+
+    if (arg->isa<Lit>()) return arg; // nothing left to hint at
+    if (auto inner = isa<Tag::Hint>(op, arg)) return world.raw_app(callee, inner->arg(), dbg); // the outer hint overrides the inner one
+
+    return world.raw_app(callee, arg, dbg);
+}
+
 const Def* normalize_bitcast(const Def* dst_type, const Def* callee, const Def* src, const Def* dbg) {
     auto& world = dst_type->world();
 
@@ -863,6 +875,44 @@ const Def* normalize_bitcast(const Def* dst_type, const Def* callee, const Def*
     return world.raw_app(callee, src, dbg);
 }
 
+const Def* normalize_fma(const Def* type, const Def* c, const Def* arg, const Def* dbg) {
+    auto& world = type->world();
+    auto callee = c->as<App>();
+    auto [a, b, acc] = arg->projs<3>();
+    auto [m, w] = callee->args<2>(isa_lit<nat_t>); // mode and width
+    auto mode = callee->arg(0);
+
+    if (a->isa<Bot>() || b->isa<Bot>() || acc->isa<Bot>()) return world.bot(type, dbg);
+
+    commute(ROp::mul, a, b);
+    auto la = a->isa<Lit>(), lb = b->isa<Lit>(), lc = acc->isa<Lit>();
+
+    if (la && lb && lc) {
+        Res res;
+        switch (*w) {
+#define CODE(i) case i: res = FoldFMA<i>::run(la->get(), lb->get(), lc->get()); break;
+            THORIN_16_32_64(CODE)
+#undef CODE
+            default: THORIN_UNREACHABLE;
+        }
+        return world.lit(type, *res, dbg);
+    }
+
+    if (w) {
+        if (la == world.lit_real(*w, 1.0)) return world.op(ROp::add, mode, b, acc, dbg);    // 1 * b + c -> b + c
+        if (lc == world.lit_real(*w, -0.0)) return world.op(ROp::mul, mode, a, b, dbg);     // a * b - 0 -> a * b
+
+        if (m) {
+            // contraction is merely permitted - so we may also round a * b separately
+            if (la && lb && has(*m, RMode::contract)) return world.op(ROp::add, mode, world.op(ROp::mul, mode, a, b), acc, dbg);
+            if (lc == world.lit_real(*w, 0.0) && has(*m, RMode::nsz)) return world.op(ROp::mul, mode, a, b, dbg); // a * b + 0 -> a * b
+            if (la == world.lit_real(*w, 0.0) && has(*m, RMode::finite | RMode::nsz)) return acc;                 // 0 * b + c -> c
+        }
+    }
+
+    return world.raw_app(callee, {a, b, acc}, dbg);
+}
+
 const Def* normalize_lea(const Def* type, const Def* callee, const Def* arg, const Def* dbg) {
     auto& world = type->world();
     auto [ptr, index] = arg->projs<2>();
@@ -956,6 +1006,26 @@ const Def* normalize_tangent(const Def*, const Def* callee, const Def* arg, cons
     return arg->world().raw_app(callee, arg, dbg);
 }
 
+/// Is @p f a partially applied binary axiom like <tt>%ROp_add (m, w)</tt> whose operands commute?
+static bool is_commutative_fn(const Def* f) {
+    auto [axiom, currying_depth] = get_axiom(f);
+    if (axiom == nullptr || currying_depth != 1) return false;
+
+    switch (axiom->tag()) {
+        case Tag::Bit:  return is_commutative(Bit (axiom->flags()));
+        case Tag::Wrap: return is_commutative(Wrap(axiom->flags()));
+        case Tag::ROp:  return is_commutative(ROp (axiom->flags()));
+        case Tag::ICmp: return is_commutative(ICmp(axiom->flags()));
+        case Tag::RCmp: return is_commutative(RCmp(axiom->flags()));
+        default:        return false;
+    }
+}
+
+/// Builds <tt>lift (r, s) (n_i, Is, n_o, Os, f)</tt>.
+static const Def* lift_fn(World& w, const Def* r, const Def* s, const Def* is_os) {
+    return w.app(w.app(w.ax_lift(), {r, s}), is_os);
+}
+
 const Def* normalize_lift(const Def* type, const Def* c, const Def* arg, const Def* dbg) {
     auto& w = type->world();
     auto callee = c->as<App>();
@@ -964,31 +1034,52 @@ const Def* normalize_lift(const Def* type, const Def* c, const Def* arg, const D
     auto [r, s] = callee->decurry()->args<2>();
     auto lr = isa_lit(r);
     auto ls = isa_lit(s);
+    auto l_in  = isa_lit(n_i);
+    auto l_out = isa_lit(n_o);
 
-    // TODO commute
-    // TODO reassociate
-    // TODO more than one Os
     // TODO select which Is/Os to lift
 
     if (lr && ls && *lr == 1 && *ls == 1) return w.app(f, arg, dbg);
+    if (!lr || !l_in) return w.raw_app(callee, arg, dbg);
 
-    if (auto l_in = isa_lit(n_i)) {
-        auto args = arg->projs((size_t)*l_in);
-
-        if (lr && std::all_of(args.begin(), args.end(), [&](const Def* arg) { return is_tuple_or_pack(arg); })) {
-            auto shapes = s->projs((size_t)*lr);
-            auto s_n = isa_lit(shapes.front());
-
-            if (s_n) {
-                DefArray elems(*s_n, [&, f = f](size_t s_i) {
-                    DefArray inner_args(args.size(), [&](size_t i) { return args[i]->proj(*s_n, s_i); });
-                    if (*lr == 1)
-                        return w.app(f, inner_args);
-                    else
-                        return w.app(w.app(w.app(w.ax_lift(), {w.lit_nat(*lr - 1), w.tuple(shapes.skip_front())}), is_os), inner_args);
-                });
-                return w.tuple(elems);
-            }
+    auto args   = arg->projs(*l_in);
+    auto shapes = s->projs(*lr);
+
+    // lift (r-1, s') f, i.e. the function applied to each element of the outermost dimension
+    auto inner_fn = [&, f = f]() {
+        return *lr == 1 ? f : lift_fn(w, w.lit_nat(*lr - 1), w.tuple(shapes.skip_front()), is_os);
+    };
+
+    // lift f («s; a», «s; b») -> «s; f (a, b)»; this also works for a symbolic shape
+    if (std::all_of(args.begin(), args.end(), [&](const Def* arg) { return arg->isa<Pack>(); })) {
+        DefArray bodies(args.size(), [&](size_t i) { return args[i]->as<Pack>()->body(); });
+        auto res = w.app(inner_fn(), bodies);
+        if (l_out && *l_out == 1) return w.pack(shapes.front(), res, dbg);
+        if (l_out) return w.tuple(DefArray(*l_out, [&](size_t o) { return w.pack(shapes.front(), res->proj(*l_out, o)); }), dbg);
+    }
+
+    // lift f ((a0, a1), (b0, b1)) -> (f (a0, b0), f (a1, b1)) and transpose in the case of several outputs
+    if (l_out && std::all_of(args.begin(), args.end(), [&](const Def* arg) { return is_tuple_or_pack(arg); })) {
+        if (auto s_n = isa_lit(shapes.front())) {
+            auto fn = inner_fn();
+            DefArray elems(*s_n, [&](size_t s_i) {
+                DefArray inner_args(args.size(), [&](size_t i) { return args[i]->proj(*s_n, s_i); });
+                return w.app(fn, inner_args);
+            });
+
+            if (*l_out == 1) return w.tuple(elems, dbg);
+            return w.tuple(DefArray(*l_out, [&](size_t o) {
+                return w.tuple(DefArray(*s_n, [&](size_t s_i) { return elems[s_i]->proj(*l_out, o); }));
+            }), dbg);
+        }
+    }
+
+    // a + b -> b + a, if this matches the order used by commute
+    if (*l_in == 2 && is_commutative_fn(f)) {
+        auto a = args[0], b = args[1];
+        if ((b->isa<Pack>() && !a->isa<Pack>()) || (a->gid() > b->gid() && !a->isa<Pack>() && !b->isa<Pack>())) {
+            std::swap(args[0], args[1]);
+            return w.app(callee, w.tuple(args), dbg);
         }
     }
 
@@ -1011,6 +1102,7 @@ THORIN_TRAIT(CODE)
 THORIN_CONV (CODE)
 THORIN_PE   (CODE)
 THORIN_ACC  (CODE)
+THORIN_HINT (CODE)
 #undef CODE
 
 }
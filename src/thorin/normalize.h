@@ -7,6 +7,7 @@ class Def;
 
 const Def* normalize_bit    (const Def*, const Def*, const Def*, const Def*);
 const Def* normalize_bitcast(const Def*, const Def*, const Def*, const Def*);
+const Def* normalize_fma    (const Def*, const Def*, const Def*, const Def*);
 const Def* normalize_lea    (const Def*, const Def*, const Def*, const Def*);
 const Def* normalize_load   (const Def*, const Def*, const Def*, const Def*);
 const Def* normalize_remem  (const Def*, const Def*, const Def*, const Def*);
@@ -25,6 +26,7 @@ template<Trait> const Def* normalize_Trait(const Def*, const Def*, const Def*, c
 template<Conv > const Def* normalize_Conv (const Def*, const Def*, const Def*, const Def*);
 template<PE   > const Def* normalize_PE   (const Def*, const Def*, const Def*, const Def*);
 template<Acc  > const Def* normalize_Acc  (const Def*, const Def*, const Def*, const Def*);
+template<Hint > const Def* normalize_Hint (const Def*, const Def*, const Def*, const Def*);
 
 }
 
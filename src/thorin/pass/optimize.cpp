@@ -6,13 +6,21 @@
 #include "thorin/pass/fp/ssa_constr.h"
 #include "thorin/pass/rw/auto_diff.h"
 #include "thorin/pass/rw/bound_elim.h"
+#include "thorin/pass/rw/fma_contract.h"
+#include "thorin/pass/rw/lift_fusion.h"
 #include "thorin/pass/rw/partial_eval.h"
 #include "thorin/pass/rw/ret_wrap.h"
 #include "thorin/pass/rw/scalarize.h"
+#include "thorin/pass/rw/slp.h"
+#include "thorin/pass/rw/tree_height_red.h"
 
 // old stuff
 #include "thorin/transform/cleanup_world.h"
+#include "thorin/transform/loop_fusion.h"
+#include "thorin/transform/parallel_reduction.h"
 #include "thorin/transform/partial_evaluation.h"
+#include "thorin/transform/strength_reduction.h"
+#include "thorin/transform/vectorize.h"
 
 
 namespace thorin {
@@ -40,11 +48,23 @@ void optimize(World& world) {
         cleanup_world(world);
     partial_evaluation(world, true);
         cleanup_world(world);
+    if (loop_fusion(world))
+        cleanup_world(world);
+    if (parallel_reduction(world))
+        cleanup_world(world);
+    if (vectorize(world))
+        cleanup_world(world);
+    if (strength_reduction(world))
+        cleanup_world(world);
 
     printf("Finished Cleanup\n");
 
     PassMan codgen_prepare(world);
     codgen_prepare.add<RetWrap>();
+    codgen_prepare.add<TreeHeightRed>();
+    codgen_prepare.add<FMAContract>();
+    codgen_prepare.add<SLP>();
+    codgen_prepare.add<LiftFusion>();
     codgen_prepare.run();
 }
 
@@ -11,6 +11,25 @@ RWPassBase::RWPassBase(PassMan& man, const std::string& name)
     , proxy_id_(man.passes().size())
 {}
 
+size_t RWPassBase::num_live_uses(const Def* def, const Def* root) const {
+    DefMap<bool> live;
+    std::function<bool(const Def*)> is_live = [&](const Def* def) {
+        if (def == root || def->isa_nom()) return true;
+        if (auto new_def = man_.lookup(def); new_def && *new_def != def) return false;
+        if (auto i = live.find(def); i != live.end()) return i->second;
+
+        bool res = false;
+        for (auto use : def->uses()) {
+            if ((res = is_live(use.def()))) break;
+        }
+        return live[def] = res;
+    };
+
+    size_t n = 0;
+    for (auto use : def->uses()) n += is_live(use.def());
+    return n;
+}
+
 FPPassBase::FPPassBase(PassMan& man, const std::string& name)
     : RWPassBase(man, name)
     , index_(man.fp_passes().size())
@@ -29,6 +29,11 @@ public:
     World& world();
     //@}
 
+    /// Number of uses of @p def which survive the rewrite of @p PassMan::curr_nom.
+    /// @p Def%s the @p PassMan has already replaced and dead @p Def%s - like the tuple of operands before the normalizer commuted them - don't count.
+    /// @p root - usually the @p Def being rewritten - counts as alive although nothing uses it yet.
+    size_t num_live_uses(const Def* def, const Def* root) const;
+
     /// @name hooks for the PassMan
     //@{
     virtual bool inspect() const = 0;
@@ -200,6 +205,7 @@ private:
     bool proxy_ = false;
 
     template<class P, class N> friend class FPPass;
+    friend class RWPassBase;
 };
 
 template<class N = Def>
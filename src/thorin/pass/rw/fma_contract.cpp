@@ -0,0 +1,45 @@
+#include "thorin/pass/rw/fma_contract.h"
+
+namespace thorin {
+
+/// Yields the mode of @p def if it is an @p ROp @p op that permits @p RMode::contract.
+static std::optional<nat_t> isa_contractable(ROp op, const Def* def) {
+    if (auto rop = isa<Tag::ROp>(op, def)) {
+        if (auto mode = isa_lit(rop->decurry()->arg(0)); mode && has(*mode, RMode::contract)) return mode;
+    }
+    return {};
+}
+
+const Def* FMAContract::rewrite(const Def* def) {
+    auto rop = isa<Tag::ROp>(def);
+    if (!rop || (rop.flags() != ROp::add && rop.flags() != ROp::sub)) return def;
+
+    auto mode = isa_contractable(rop.flags(), def);
+    if (!mode) return def;
+
+    auto [a, b] = rop->args<2>();
+    auto is_mul = [&](const Def* def) { return num_live_uses(def, rop) == 1 && isa_contractable(ROp::mul, def); };
+    bool sub = rop.flags() == ROp::sub;
+
+    const Def* mul = nullptr;
+    const Def* acc = nullptr;
+    if (is_mul(a)) {
+        mul = a;
+        acc = sub ? world().op_rminus(*mode, b) : b;   // a * b - c -> fma(a, b, -c)
+    } else if (is_mul(b)) {
+        mul = b;
+        acc = a;
+    } else {
+        return def;
+    }
+
+    auto [x, y] = mul->as<App>()->args<2>();
+    if (sub && mul == b) x = world().op_rminus(*mode, x); // c - a * b -> fma(-a, b, c)
+
+    // least upper bound of both modes
+    auto res = world().op_fma(*mode & *isa_contractable(ROp::mul, mul), x, y, acc, def->dbg());
+    world().DLOG("fma contraction: {} -> {}", def, res);
+    return res;
+}
+
+}
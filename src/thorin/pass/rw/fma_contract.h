@@ -0,0 +1,22 @@
+#ifndef THORIN_PASS_RW_FMA_CONTRACT_H
+#define THORIN_PASS_RW_FMA_CONTRACT_H
+
+#include "thorin/pass/pass.h"
+
+namespace thorin {
+
+/// Contracts <code>a * b + c</code>, <code>c + a * b</code>, <code>a * b - c</code>, and <code>c - a * b</code> into a single @c fma.
+/// Both the @p ROp%s for the addition and the multiplication must permit @p RMode::contract.
+/// The multiplication is only absorbed if it has no other use - otherwise we would compute the product twice.
+class FMAContract : public RWPass<Lam> {
+public:
+    FMAContract(PassMan& man)
+        : RWPass(man, "fma_contract")
+    {}
+
+    const Def* rewrite(const Def*) override;
+};
+
+}
+
+#endif
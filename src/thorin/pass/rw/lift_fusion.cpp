@@ -0,0 +1,63 @@
+#include "thorin/pass/rw/lift_fusion.h"
+
+namespace thorin {
+
+const Def* LiftFusion::rewrite(const Def* def) {
+    auto lift = isa<Tag::Lift>(def);
+    if (!lift) return def;
+
+    auto& w = world();
+    auto [r, s] = lift->decurry()->decurry()->args<2>();
+    auto [n_i, Is, n_o, Os, f] = lift->decurry()->args<5>();
+    auto l_in = isa_lit(n_i);
+    auto f_pi = f->type()->isa<Pi>();
+    if (!l_in || !f_pi || f_pi->isa_nom()) return def;
+
+    auto args = lift->arg()->projs(*l_in);
+    // with several inputs, the intermediate is used via the tuple of arguments which must not be used elsewhere either
+    if (*l_in != 1 && num_live_uses(lift->arg(), def) != 1) return def;
+
+    for (size_t j = 0, e = args.size(); j != e; ++j) {
+        auto prod = isa<Tag::Lift>(args[j]);
+        if (!prod || num_live_uses(prod, def) != 1) continue;
+
+        auto [g_r, g_s] = prod->decurry()->decurry()->args<2>();
+        auto [g_n_i, g_Is, g_n_o, g_Os, g] = prod->decurry()->args<5>();
+        auto g_l_in  = isa_lit(g_n_i);
+        auto g_pi = g->type()->isa<Pi>();
+        if (g_r != r || g_s != s || !g_l_in || isa_lit(g_n_o) != 1 || !g_pi || g_pi->isa_nom()) continue;
+
+        auto g_args = prod->arg()->projs(*g_l_in);
+        auto f_Is   = Is->projs(*l_in);
+        auto g_Is_  = g_Is->projs(*g_l_in);
+
+        // inputs: f's inputs without the j-th one followed by g's inputs
+        auto num = *l_in - 1 + *g_l_in;
+        DefArray new_args(num), new_Is(num);
+        for (size_t i = 0, k = 0; i != *l_in; ++i) {
+            if (i == j) continue;
+            new_args[k] = args[i];
+            new_Is  [k] = f_Is[i];
+            ++k;
+        }
+        for (size_t i = 0; i != *g_l_in; ++i) {
+            new_args[*l_in - 1 + i] = g_args[i];
+            new_Is  [*l_in - 1 + i] = g_Is_[i];
+        }
+
+        auto fg = w.nom_lam(w.pi(w.sigma(new_Is), f_pi->codom()), w.dbg("lift_fuse"));
+        auto g_res = w.app(g, DefArray(*g_l_in, [&](size_t i) { return fg->var(num, *l_in - 1 + i); }));
+        DefArray f_args(*l_in, [&](size_t i) { return i == j ? g_res : fg->var(num, i < j ? i : i - 1); });
+        fg->set_filter(true);
+        fg->set_body(w.app(f, f_args));
+
+        auto fused = w.app(w.app(w.ax_lift(), {r, s}), {w.lit_nat(num), w.tuple(new_Is), n_o, Os, fg});
+        auto res = w.app(fused, new_args, lift->dbg());
+        w.DLOG("lift fusion: {} -> {}", def, res);
+        return res;
+    }
+
+    return def;
+}
+
+}
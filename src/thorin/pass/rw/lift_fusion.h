@@ -0,0 +1,22 @@
+#ifndef THORIN_PASS_RW_LIFT_FUSION_H
+#define THORIN_PASS_RW_LIFT_FUSION_H
+
+#include "thorin/pass/pass.h"
+
+namespace thorin {
+
+/// Fuses <code>lift f (..., lift g x, ...)</code> into <code>lift (f ∘ g) (..., x)</code> so the intermediate array is never materialized.
+/// Both @c lift%s must range over the same rank and shape and @c g must have a single output.
+/// The intermediate @c lift is only absorbed if it has no other use - otherwise we would compute it twice.
+class LiftFusion : public RWPass<Lam> {
+public:
+    LiftFusion(PassMan& man)
+        : RWPass(man, "lift_fusion")
+    {}
+
+    const Def* rewrite(const Def*) override;
+};
+
+}
+
+#endif
@@ -0,0 +1,100 @@
+#include "thorin/pass/rw/slp.h"
+
+namespace thorin {
+
+/// Is @p def an op we can apply lane-wise via @c lift?
+static const App* isa_vectorizable(const Def* def) {
+    auto [axiom, currying_depth] = get_axiom(def);
+    if (axiom == nullptr || currying_depth != 0) return nullptr;
+
+    switch (axiom->tag()) {
+        case Tag::Bit:
+        case Tag::Shr:
+        case Tag::Wrap:
+        case Tag::ROp:
+        case Tag::ICmp:
+        case Tag::RCmp:
+        case Tag::FMA: return def->as<App>();
+        default:       return nullptr;
+    }
+}
+
+/// Can we swap the first two operands of @p app?
+static bool is_commutative(const App* app) {
+    switch (app->axiom()->tag()) {
+        case Tag::Wrap: return app->axiom()->flags() == flags_t(Wrap::add) || app->axiom()->flags() == flags_t(Wrap::mul);
+        case Tag::ROp:  return app->axiom()->flags() == flags_t(ROp ::add) || app->axiom()->flags() == flags_t(ROp ::mul);
+        case Tag::FMA:  return true; // a * b + c
+        default:        return false;
+    }
+}
+
+/// The array @p def is taken from - if @p def is an @p Extract with a literal index.
+static std::pair<const Def*, std::optional<nat_t>> source(const Def* def) {
+    if (auto extract = def->isa<Extract>()) return {extract->tuple(), isa_lit(extract->index())};
+    return {def, {}};
+}
+
+/// Packs @p lanes into a single value of type <tt>«n; T»</tt>.
+static const Def* pack(World& world, Defs lanes) {
+    auto n = lanes.size();
+    auto first = lanes.front();
+
+    // ‹n; x›
+    if (std::all_of(lanes.begin(), lanes.end(), [&](const Def* lane) { return lane == first; })) return world.pack(n, first);
+
+    // (a#0, a#1, ..., a#n-1) -> a
+    if (auto [arr, _] = source(first); arr != first && isa_lit(arr->arity()) == n) {
+        bool consecutive = true;
+        for (size_t i = 0; i != n && consecutive; ++i) {
+            auto [a, index] = source(lanes[i]);
+            consecutive = a == arr && index == i;
+        }
+        if (consecutive) return arr;
+    }
+
+    // (f (a0, b0), f (a1, b1), ...) -> lift f ((a0, a1, ...), (b0, b1, ...))
+    if (auto app = isa_vectorizable(first)) {
+        auto fn = app->callee();
+        if (std::all_of(lanes.begin(), lanes.end(), [&](const Def* lane) { return lane->isa<App>() && lane->as<App>()->callee() == fn; })) {
+            auto num = app->num_args();
+            Array<DefArray> ops(n, [&](size_t l) { return lanes[l]->as<App>()->args(num); });
+
+            // the normalizer orders commutative operands by gid - align them with lane 0 by their source arrays instead
+            if (is_commutative(app)) {
+                auto src = source(ops[0][0]).first;
+                for (size_t l = 1; l != n; ++l) {
+                    if (source(ops[l][0]).first != src && source(ops[l][1]).first == src) std::swap(ops[l][0], ops[l][1]);
+                }
+            }
+
+            DefArray args(num), Is(num);
+            for (size_t i = 0; i != num; ++i) {
+                args[i] = pack(world, DefArray(n, [&](size_t l) { return ops[l][i]; }));
+                Is[i]   = ops[0][i]->type();
+            }
+
+            auto lift = world.app(world.ax_lift(), {world.lit_nat_1(), world.lit_nat(n)});
+            lift = world.app(lift, {world.lit_nat(num), world.tuple(Is), world.lit_nat_1(), app->type(), fn});
+            return world.app(lift, args);
+        }
+    }
+
+    return world.tuple(lanes);
+}
+
+const Def* SLP::rewrite(const Def* def) {
+    auto tuple = def->isa<Tuple>();
+    if (tuple == nullptr || !tuple->type()->isa<Arr>()) return def;
+
+    auto n = tuple->num_ops();
+    if (n < 2 || n > max_lanes || !isa_vectorizable(tuple->op(0))) return def;
+
+    auto res = pack(world(), tuple->ops());
+    if (!isa<Tag::Lift>(res)) return def;
+
+    world().DLOG("slp: {} -> {}", def, res);
+    return res;
+}
+
+}
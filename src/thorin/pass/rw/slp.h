@@ -0,0 +1,26 @@
+#ifndef THORIN_PASS_RW_SLP_H
+#define THORIN_PASS_RW_SLP_H
+
+#include "thorin/pass/pass.h"
+
+namespace thorin {
+
+/// Superword-level parallelism: Packs isomorphic scalar trees within a @p Tuple into @c lift%s over homogeneous @p Arr%s:
+/// <code>(a#0 * b#0 + c, a#1 * b#1 + c)</code> becomes <code>lift (+) (lift (*) (a, b), ‹2; c›)</code>.
+/// The normalizer splits such a @c lift again if none of its arguments is an actual array value, so we only keep the result if it still is a @c lift.
+/// @p CodeGen lowers these to LLVM vector instructions.
+class SLP : public RWPass<Lam> {
+public:
+    SLP(PassMan& man)
+        : RWPass(man, "slp")
+    {}
+
+    const Def* rewrite(const Def*) override;
+
+    /// Maximal number of lanes; matches @p CodeGen::max_vector_lanes.
+    static constexpr nat_t max_lanes = 16;
+};
+
+}
+
+#endif
@@ -0,0 +1,110 @@
+#include "thorin/pass/rw/tree_height_red.h"
+
+namespace thorin {
+
+namespace {
+
+/// Collects the leaves of a chain of the same associative op.
+class Chain {
+public:
+    Chain(const RWPassBase& pass, const App* root)
+        : pass_(pass)
+        , root_(root)
+        , axiom_(root->axiom())
+        , width_(root->decurry()->arg(1))
+        , rmode_(RMode::bot)
+    {}
+
+    /// Returns the height of the tree rooted at @p def or @c -1 if this is not a valid chain.
+    int collect(const Def* def, bool is_root) {
+        auto app = def->isa<App>();
+        if (!is_root && (app == nullptr || pass_.num_live_uses(def, root_) != 1 || !matches(app))) {
+            leaves_.emplace_back(def);
+            return 0;
+        }
+
+        if (axiom_->tag() == Tag::ROp) {
+            auto mode = isa_lit(app->decurry()->arg(0));
+            if (!mode || !has(*mode, RMode::reassoc)) {
+                if (is_root) return -1;
+                leaves_.emplace_back(def);
+                return 0;
+            }
+            rmode_ &= *mode; // least upper bound
+        }
+
+        auto [a, b] = app->args<2>();
+        auto ha = collect(a, false);
+        auto hb = collect(b, false);
+        if (ha < 0 || hb < 0) return -1;
+        return 1 + std::max(ha, hb);
+    }
+
+    const Def* rebuild(World& world, const Def* dbg) const {
+        std::vector<const Def*> lits, rest;
+        for (auto leaf : leaves_) (leaf->isa<Lit>() ? lits : rest).emplace_back(leaf);
+
+        // pair up neighbors until only one is left
+        while (rest.size() > 1) {
+            std::vector<const Def*> next;
+            for (size_t i = 0, e = rest.size(); i + 1 < e; i += 2) next.emplace_back(make_op(world, rest[i], rest[i + 1], {}));
+            if (rest.size() % 2 != 0) next.emplace_back(rest.back());
+            rest.swap(next);
+        }
+
+        // put all literals on top - otherwise reassociate would pull them up again while serializing the tree
+        if (lits.empty()) return rest.front();
+
+        auto lit = lits.front();
+        for (size_t i = 1, e = lits.size(); i != e; ++i) lit = make_op(world, lit, lits[i], {});
+        return rest.empty() ? lit : make_op(world, lit, rest.front(), dbg);
+    }
+
+    /// Height of the tree built by @p rebuild.
+    int min_height() const {
+        size_t num_lits = std::count_if(leaves_.begin(), leaves_.end(), [](const Def* leaf) { return leaf->isa<Lit>(); });
+        size_t num_rest = leaves_.size() - num_lits;
+        int height = 0;
+        for (size_t n = 1; n < num_rest; n *= 2) ++height;
+        return height + (num_lits != 0 ? 1 : 0);
+    }
+
+    size_t num_leaves() const { return leaves_.size(); }
+
+private:
+    bool matches(const App* app) const {
+        return app->axiom() == axiom_ && app->currying_depth() == 0 && app->decurry()->arg(1) == width_;
+    }
+
+    const Def* make_op(World& world, const Def* a, const Def* b, const Def* dbg) const {
+        if (axiom_->tag() == Tag::ROp) return world.op(ROp(axiom_->flags()), rmode_, a, b, dbg);
+        // if we reassociate Wraps, we have to forget about nsw/nuw
+        return world.op(Wrap(axiom_->flags()), WMode::none, a, b, dbg);
+    }
+
+    const RWPassBase& pass_;
+    const App* root_;
+    const Axiom* axiom_;
+    const Def* width_;
+    nat_t rmode_;
+    std::vector<const Def*> leaves_;
+};
+
+}
+
+const Def* TreeHeightRed::rewrite(const Def* def) {
+    auto rop  = isa<Tag::ROp >(def);
+    auto wrap = isa<Tag::Wrap>(def);
+    if (!(rop  && (rop .flags() == ROp ::add || rop .flags() == ROp ::mul))
+     && !(wrap && (wrap.flags() == Wrap::add || wrap.flags() == Wrap::mul))) return def;
+
+    Chain chain(*this, def->as<App>());
+    auto height = chain.collect(def, true);
+    if (height < 0 || chain.num_leaves() < 4 || height <= chain.min_height()) return def;
+
+    auto res = chain.rebuild(world(), def->dbg());
+    world().DLOG("tree height reduction: {} (height {}) -> {} (height {})", def, height, res, chain.min_height());
+    return res;
+}
+
+}
@@ -0,0 +1,23 @@
+#ifndef THORIN_PASS_RW_TREE_HEIGHT_RED_H
+#define THORIN_PASS_RW_TREE_HEIGHT_RED_H
+
+#include "thorin/pass/pass.h"
+
+namespace thorin {
+
+/// Rebalances chains of associative ops like <code>((a + b) + c) + d</code> into trees like <code>(a + b) + (c + d)</code>.
+/// This shortens the critical path of such chains from @c n-1 to @c log(n) ops.
+/// Only considers @p ROp%s that permit @p RMode::reassoc and @p Wrap%s whose @p WMode is dropped as in @c reassociate.
+/// Inner ops are only pulled into a chain if they have no other use.
+class TreeHeightRed : public RWPass<Lam> {
+public:
+    TreeHeightRed(PassMan& man)
+        : RWPass(man, "tree_height_red")
+    {}
+
+    const Def* rewrite(const Def*) override;
+};
+
+}
+
+#endif
@@ -8,6 +8,7 @@ namespace thorin {
 const Def* Rewriter::rewrite(const Def* old_def) {
     if (auto new_def = old2new.lookup(old_def)) return *new_def;
     if (scope != nullptr && !scope->bound(old_def)) return old_def;
+    if (&old_world == &new_world && old_def->no_dep()) return old_def; // e.g. an Axiom would be rebuilt as a new one
 
     auto new_type = rewrite(old_def->type());
     auto new_dbg = old_def->dbg() ? rewrite(old_def->dbg()) : nullptr;
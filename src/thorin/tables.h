@@ -28,13 +28,13 @@ using nat_t    = u64;
 
 #define THORIN_TAG(m)                                                           \
     m(Mem, mem) m(Int, int) m(Real, real) m(Ptr, ptr)                           \
-    m(Bit, bit) m(Shr, shr) m(Wrap, wrap) m(Div, div) m(ROp, rop)               \
+    m(Bit, bit) m(Shr, shr) m(Wrap, wrap) m(Div, div) m(ROp, rop) m(FMA, fma)   \
     m(ICmp, icmp) m(RCmp, rcmp)                                                 \
     m(Trait, trait) m(Conv, conv) m(PE, pe) m(Acc, acc)                         \
     m(Bitcast, bitcast) m(LEA, lea)                                             \
     m(Alloc, alloc) m(Slot, slot) m(Load, load) m(Remem, remem) m(Store, store) \
-    m(Atomic, atomic)                                                           \
-    m(Lift, lift)                                                               \
+    m(Atomic, atomic) m(Graph, graph)                                           \
+    m(Lift, lift) m(Hint, hint)                                                 \
     m(RevDiff, rev_diff) m(TangentVector, tangent_vector)
 
 namespace WMode {
@@ -79,6 +79,10 @@ enum RMode : nat_t {
 #define THORIN_PE(m) m(PE, hlt) m(PE, known) m(PE, run)
 /// Accelerators
 #define THORIN_ACC(m) m(Acc, vecotrize) m(Acc, parallel) m(Acc, opencl) m(Acc, cuda) m(Acc, nvvm) m (Acc, amdgpu)
+/// Task graphs
+#define THORIN_GRAPH(m) m(Graph, create) m(Graph, task) m(Graph, edge) m(Graph, exec)
+/// Hints for the backends on a branch condition: the weights of both targets or - on the exit branch of a loop - how to vectorize, interleave and unroll it
+#define THORIN_HINT(m) m(Hint, branch) m(Hint, loop)
 
 /**
  * The 5 relations are disjoint and are organized as follows:
@@ -201,6 +205,8 @@ enum class Trait  : flags_t { THORIN_TRAIT(CODE) };
 enum class Conv   : flags_t { THORIN_CONV (CODE) };
 enum class PE     : flags_t { THORIN_PE   (CODE) };
 enum class Acc    : flags_t { THORIN_ACC  (CODE) };
+enum class Graph  : flags_t { THORIN_GRAPH(CODE) };
+enum class Hint   : flags_t { THORIN_HINT (CODE) };
 #undef CODE
 
 constexpr ICmp operator|(ICmp a, ICmp b) { return ICmp(flags_t(a) | flags_t(b)); }
@@ -223,6 +229,8 @@ constexpr const char* op2str(Trait o) { switch (o) { THORIN_TRAIT(CODE) default:
 constexpr const char* op2str(Conv  o) { switch (o) { THORIN_CONV (CODE) default: THORIN_UNREACHABLE; } }
 constexpr const char* op2str(PE    o) { switch (o) { THORIN_PE   (CODE) default: THORIN_UNREACHABLE; } }
 constexpr const char* op2str(Acc   o) { switch (o) { THORIN_ACC  (CODE) default: THORIN_UNREACHABLE; } }
+constexpr const char* op2str(Graph o) { switch (o) { THORIN_GRAPH(CODE) default: THORIN_UNREACHABLE; } }
+constexpr const char* op2str(Hint  o) { switch (o) { THORIN_HINT (CODE) default: THORIN_UNREACHABLE; } }
 #undef CODE
 
 namespace AddrSpace {
@@ -252,6 +260,8 @@ template<> inline constexpr size_t Num<Trait> = 0_s THORIN_TRAIT(CODE);
 template<> inline constexpr size_t Num<Conv > = 0_s THORIN_CONV (CODE);
 template<> inline constexpr size_t Num<PE   > = 0_s THORIN_PE   (CODE);
 template<> inline constexpr size_t Num<Acc  > = 0_s THORIN_ACC  (CODE);
+template<> inline constexpr size_t Num<Graph> = 0_s THORIN_GRAPH(CODE);
+template<> inline constexpr size_t Num<Hint > = 0_s THORIN_HINT (CODE);
 #undef CODE
 
 template<tag_t tag> struct Tag2Enum_    { using type = tag_t; };
@@ -266,6 +276,8 @@ template<> struct Tag2Enum_<Tag::Trait> { using type = Trait; };
 template<> struct Tag2Enum_<Tag::Conv > { using type = Conv;  };
 template<> struct Tag2Enum_<Tag::PE   > { using type = PE;    };
 template<> struct Tag2Enum_<Tag::Acc  > { using type = Acc;   };
+template<> struct Tag2Enum_<Tag::Graph> { using type = Graph; };
+template<> struct Tag2Enum_<Tag::Hint > { using type = Hint;  };
 template<tag_t tag> using Tag2Enum = typename Tag2Enum_<tag>::type;
 
 }
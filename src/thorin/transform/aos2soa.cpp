@@ -0,0 +1,180 @@
+#include "thorin/transform/aos2soa.h"
+
+#include "thorin/world.h"
+#include "thorin/analyses/scope.h"
+
+namespace thorin {
+
+namespace {
+
+/// Don't split homogeneous structures like <tt>«1024; «1024; f32»»</tt> into a zillion allocations.
+static constexpr nat_t max_fields = 16;
+
+/// An @c alloc or @c slot of <tt>«n; [T_0, ..., T_m]»</tt> together with the element addresses derived from its pointer.
+struct Candidate {
+    const App* alloc;
+    const Arr* arr;
+    DefArray fields;                ///< <tt>T_0, ..., T_m</tt>
+    std::vector<const App*> elems;  ///< All <tt>lea(ptr, i)</tt>.
+};
+
+}
+
+/// Iterates over all users of @p def while looking through the @p Tuple%s that bundle arguments; skips dead ones.
+template<class F>
+static bool all_users(const Def* def, F f) {
+    for (auto use : def->uses()) {
+        if (auto tuple = use->isa<Tuple>()) {
+            for (auto tuple_use : tuple->uses()) {
+                if (tuple_use->num_uses() != 0 && !f(tuple_use.def())) return false;
+            }
+        } else if (use->num_uses() != 0 && !f(use.def())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static std::optional<Candidate> isa_candidate(const Def* def) {
+    auto alloc = isa<Tag::Alloc>(def) ? def->as<App>() : isa<Tag::Slot>(def) ? def->as<App>() : nullptr;
+    if (alloc == nullptr) return {};
+
+    auto arr = alloc->decurry()->arg(0)->isa<Arr>();
+    if (arr == nullptr || arr->isa_nom()) return {};
+
+    // homogeneous structures have already been normalized to an Arr themselves
+    DefArray fields;
+    if (auto sigma = arr->body()->isa<Sigma>(); sigma && !sigma->isa_nom()) {
+        fields = sigma->ops();
+    } else if (auto inner = arr->body()->isa<Arr>(); inner && !inner->isa_nom()) {
+        if (auto n = isa_lit(inner->shape()); n && *n <= max_fields) fields = DefArray(*n, inner->body());
+    }
+    if (fields.size() < 2) return {};
+
+    Candidate c{alloc, arr, std::move(fields), {}};
+    auto ptr = alloc->proj(2_u64, 1_u64);
+
+    // the alloc itself is only projected
+    for (auto use : alloc->uses()) {
+        if (use->num_uses() != 0 && !use->isa<Extract>()) return {};
+    }
+
+    // ptr -> lea(ptr, i) -> lea(lea(ptr, i), k) / load / store
+    bool local = all_users(ptr, [&](const Def* user) {
+        auto elem = isa<Tag::LEA>(user);
+        if (!elem || elem->arg(0) != ptr) return false;
+        c.elems.emplace_back(elem);
+
+        return all_users(elem, [&](const Def* user) {
+            if (auto field = isa<Tag::LEA>(user)) return field->arg(0) == elem && isa_lit(field->arg(1));
+            if (auto load  = isa<Tag::Load >(user)) return load->arg(1) == elem;
+            if (auto store = isa<Tag::Store>(user)) return store->arg(1) == elem && store->arg(2) != elem;
+            return false;
+        });
+    });
+
+    return local ? std::optional<Candidate>(std::move(c)) : std::nullopt;
+}
+
+static void convert(World& world, const Candidate& c, Def2Def& repl) {
+    auto [_, addr_space] = c.alloc->decurry()->args<2>();
+    auto is_slot = isa<Tag::Slot>(c.alloc) != nullptr;
+    auto n = c.fields.size();
+
+    // one alloc per field - threaded through the original mem
+    auto mem = is_slot ? c.alloc->arg(2_u64, 0_u64) : c.alloc->arg();
+    DefArray ptrs(n);
+    for (size_t k = 0; k != n; ++k) {
+        auto field = world.arr(c.arr->shape(), c.fields[k]);
+        auto alloc = is_slot
+                   ? world.app(world.app(world.ax_slot (), {field, addr_space}), {mem, world.lit_nat(world.curr_gid())}, c.alloc->dbg())
+                   : world.app(world.app(world.ax_alloc(), {field, addr_space}), mem,                                    c.alloc->dbg());
+        mem     = alloc->proj(2_u64, 0_u64);
+        ptrs[k] = alloc->proj(2_u64, 1_u64);
+    }
+    repl[c.alloc->proj(2_u64, 0_u64)] = mem;
+
+    for (auto elem : c.elems) {
+        auto i = elem->arg(1);
+        all_users(elem, [&](const Def* user) {
+            if (auto field = isa<Tag::LEA>(user)) {
+                repl[user] = world.op_lea(ptrs[as_lit(field->arg(1))], i, user->dbg());
+            } else if (auto load = isa<Tag::Load>(user)) {
+                auto m = load->arg(0);
+                DefArray vals(n, [&](size_t k) {
+                    auto l = world.op_load(m, world.op_lea(ptrs[k], i), load->dbg());
+                    m = l->proj(2_u64, 0_u64);
+                    return l->proj(2_u64, 1_u64);
+                });
+                repl[user] = world.tuple({m, world.tuple(vals)}, load->dbg());
+            } else if (auto store = isa<Tag::Store>(user)) {
+                auto m = store->arg(0);
+                auto val = store->arg(2);
+                for (size_t k = 0; k != n; ++k)
+                    m = world.op_store(m, world.op_lea(ptrs[k], i), world.extract(val, n, k), store->dbg());
+                repl[user] = m;
+            }
+            return true;
+        });
+    }
+}
+
+/// Substitutes according to @p repl within a @p Lam's body; doesn't look into other noms.
+static const Def* substitute(World& world, const Def* def, const Def2Def& repl, Def2Def& done) {
+    if (auto res = done.lookup(def)) return *res;
+
+    auto res = def;
+    if (auto r = repl.lookup(def)) {
+        res = substitute(world, *r, repl, done);
+    } else if (!def->isa_nom() && !def->isa<Var>() && !def->no_dep()) {
+        bool changed = false;
+        DefArray ops(def->num_ops(), [&](size_t i) {
+            auto op = substitute(world, def->op(i), repl, done);
+            changed |= op != def->op(i);
+            return op;
+        });
+        if (changed) res = def->rebuild(world, def->type(), ops, def->dbg());
+    }
+
+    return done[def] = res;
+}
+
+size_t aos2soa(World& world) {
+    size_t num = 0;
+
+    // collect all top-level scopes first as converting rebuilds their lams
+    std::vector<Lam*> entries;
+    world.visit([&](const Scope& scope) {
+        if (auto lam = scope.entry()->isa_nom<Lam>()) entries.emplace_back(lam);
+    });
+
+    for (auto entry : entries) {
+        if (!entry->is_set()) continue;
+
+        Scope scope(entry);
+        std::vector<Lam*> lams = {entry};
+        std::vector<Candidate> candidates;
+        for (auto def : scope.bound()) {
+            if (auto lam = def->isa_nom<Lam>(); lam && lam->is_set()) lams.emplace_back(lam);
+            if (auto c = isa_candidate(def)) candidates.emplace_back(std::move(*c));
+        }
+        if (candidates.empty()) continue;
+        std::sort(candidates.begin(), candidates.end(), [](const auto& c1, const auto& c2) { return c1.alloc->gid() < c2.alloc->gid(); });
+
+        Def2Def repl;
+        for (const auto& c : candidates) {
+            world.idef(c.alloc, "converting {} of type {} from AoS to SoA", c.alloc, c.arr);
+            convert(world, c, repl);
+        }
+
+        Def2Def done;
+        for (auto lam : lams)
+            lam->set(DefArray(lam->num_ops(), [&](size_t i) { return substitute(world, lam->op(i), repl, done); }));
+
+        num += candidates.size();
+    }
+
+    return num;
+}
+
+}
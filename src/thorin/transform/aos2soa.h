@@ -0,0 +1,23 @@
+#ifndef THORIN_TRANSFORM_AOS2SOA_H
+#define THORIN_TRANSFORM_AOS2SOA_H
+
+#include <cstddef>
+
+namespace thorin {
+
+class World;
+
+/**
+ * Converts each @c alloc/@c slot of an array of structures <tt>«n; [T_0, ..., T_m]»</tt> into one @c alloc/@c slot per field <tt>«n; T_k»</tt> if the pointer doesn't escape, i.e. if
+ * * the pointer is only used as <tt>e = lea(p, i)</tt>, and
+ * * each such element address @c e is only used as <tt>lea(e, k)</tt> with a literal @c k or as the address of a @c load or @c store.
+ * Field addresses become <tt>lea(p_k, i)</tt>; @c load%s and @c store%s of a whole element are split into one per field.
+ * This is @em not part of the default pipeline as it only pays off if most accesses touch only a few fields.
+ * Each converted allocation is reported via @p World::idef.
+ * Returns the number of converted allocations.
+ */
+size_t aos2soa(World&);
+
+}
+
+#endif
@@ -0,0 +1,74 @@
+#include "thorin/transform/grid_emulation.h"
+
+#include "thorin/world.h"
+
+namespace thorin {
+
+/// Number of threads per emulated block - enough work to amortize scheduling a block on the runtime.
+static constexpr nat_t block_size = 256;
+static constexpr nat_t log_block_size = 8;
+static_assert(block_size == 1 << log_block_size);
+
+static bool is_gpu(Acc acc) { return acc == Acc::opencl || acc == Acc::cuda || acc == Acc::nvvm || acc == Acc::amdgpu; }
+
+static bool emulate(Lam* lam) {
+    auto& world = lam->world();
+    auto acc = isa<Tag::Acc>(lam->body());
+    if (!acc || !is_gpu(acc.flags())) return false;
+
+    auto n = acc->decurry()->arg();
+    auto [mem, body, ret] = acc->args<3>();
+    world.DLOG("emulating {} kernel {} on the CPU", op2str(acc.flags()), body);
+
+    auto M   = world.type_mem();
+    auto i64 = world.type_int_width(64);
+    auto one = world.lit_int_width(64, 1);
+    auto N   = world.op_bitcast(i64, n);
+
+    // caller(m, lo, hi, k) with: for (j = lo; j < hi; ++j) body(j)
+    auto threads = [&](Lam* caller, const Def* m, const Def* lo, const Def* hi, const Def* k) {
+        auto head = world.nom_lam(world.cn({M, i64}), world.dbg("grid_head"));
+        auto iter = world.nom_lam(world.cn(M), world.dbg("grid_iter"));
+        auto next = world.nom_lam(world.cn(M), world.dbg("grid_next"));
+        auto exit = world.nom_lam(world.cn(M), world.dbg("grid_exit"));
+
+        auto [hm, j] = head->vars<2>();
+        caller->app(head, {m, lo});
+        head->branch(world.op(ICmp::ul, j, hi), iter, exit, hm);
+        iter->app(body, {iter->var(), world.op(Conv::u2u, world.type_int(n), j), next});
+        next->app(head, {next->var(), world.op(Wrap::add, WMode::nuw, j, one)});
+        exit->app(k, exit->var());
+    };
+
+    auto l = isa_lit(n);
+    if (l && *l <= block_size) {
+        threads(lam, mem, world.lit_int_width(64, 0), N, ret);
+        return true;
+    }
+
+    // blocks(m, b, k) runs the threads [b * block_size, min((b + 1) * block_size, n))
+    auto B   = world.lit_int_width(64, block_size);
+    auto num = l ? world.lit_nat((*l + block_size - 1) / block_size)
+                 : world.op_bitcast(world.type_nat(), world.op(Shr::lshr, world.op(Wrap::add, WMode::nuw, N, world.lit_int_width(64, block_size - 1)), world.lit_int_width(64, log_block_size)));
+
+    auto blocks = world.nom_lam(world.cn({M, world.type_int(num), world.cn(M)}), world.dbg("grid_blocks"));
+    auto [bm, b, bk] = blocks->vars<3>();
+    auto first = world.op(Wrap::mul, WMode::nuw, world.op(Conv::u2u, i64, b), B);
+    auto last  = world.op(Wrap::add, WMode::nuw, first, B);
+    threads(blocks, bm, first, world.select(N, last, world.op(ICmp::ug, last, N)), bk);
+
+    lam->set_body(world.op(Acc::parallel, num, mem, blocks, ret, lam->body()->dbg()));
+    return true;
+}
+
+bool emulate_grid(World& world) {
+    bool todo = false;
+
+    for (auto lam : world.copy_lams()) {
+        if (lam->is_set()) todo |= emulate(lam);
+    }
+
+    return todo;
+}
+
+}
@@ -0,0 +1,18 @@
+#ifndef THORIN_TRANSFORM_GRID_EMULATION_H
+#define THORIN_TRANSFORM_GRID_EMULATION_H
+
+namespace thorin {
+
+class World;
+
+/**
+ * Runs the kernels of @c Acc::opencl, @c Acc::cuda, @c Acc::nvvm and @c Acc::amdgpu on the CPU for machines without a GPU - see @p Backends.
+ * The threads are grouped into blocks of 256 consecutive threads which become the iterations of an @c Acc::parallel.
+ * Each block runs its threads in a sequential loop; a launch of at most one block is just this loop.
+ * Returns whether something has changed.
+ */
+bool emulate_grid(World&);
+
+}
+
+#endif
@@ -0,0 +1,432 @@
+#include "thorin/transform/loop_fusion.h"
+
+#include <stack>
+
+#include "thorin/rewrite.h"
+#include "thorin/world.h"
+#include "thorin/analyses/cfg.h"
+#include "thorin/analyses/domtree.h"
+#include "thorin/analyses/induction.h"
+#include "thorin/analyses/scope.h"
+#include "thorin/util/container.h"
+
+namespace thorin {
+
+namespace {
+
+using Basic = InductionVars::Basic;
+
+/// A @c load or @c store of <tt>lea(base, i)</tt> within a loop.
+struct Access {
+    Lam* lam;           ///< The @p Lam whose body contains @p app.
+    const App* app;
+    const Def* base;
+    bool is_store;
+};
+
+/**
+ * A loop of this shape:
+ * @code
+ * entry(...)              = header(..., init, ...)
+ * header(..., i, ..., m)  = (exit, body)#(i cmp bound) m
+ * latch(...)              = header(..., i + step, ...)
+ * @endcode
+ */
+struct Loop {
+    Lam* header;
+    const Basic* iv;
+    size_t mem;         ///< Index of @p header's @p Var of type @c mem.
+    const App* cmp;
+    Lam* body;
+    Lam* exit;
+    Lam* entry;
+    Lam* latch;
+    std::vector<Access> accesses;
+};
+
+}
+
+static std::optional<size_t> mem_index(Lam* lam) {
+    std::optional<size_t> res;
+    for (size_t i = 0, e = lam->num_doms(); i != e; ++i) {
+        if (isa<Tag::Mem>(lam->dom(i))) {
+            if (res) return {};
+            res = i;
+        }
+    }
+    return res;
+}
+
+/// Is @p index the induction variable @p iv - possibly converted to the index type of a @c lea as done by @p World::op_lea_unsafe?
+static bool is_index(const Def* index, const Def* iv) {
+    if (auto conv = isa<Tag::Conv>(index); conv && (conv.flags() == Conv::u2u || conv.flags() == Conv::s2s)) index = conv->arg();
+    return index == iv;
+}
+
+/// Collects all memory accesses in @p lam's body; fails on anything else with side effects.
+/// Doesn't look at anything that is not within the @p loop_scope as this has been computed before entering the loop.
+static bool collect_accesses(const InductionVars& ivs, const Scope& loop_scope, Loop& loop, Lam* lam) {
+    std::stack<const Def*> stack;
+    DefSet done;
+
+    auto push = [&](const Def* def) {
+        if (!def->isa_nom() && !def->isa<Var>() && loop_scope.bound(def) && done.emplace(def).second) stack.push(def);
+    };
+
+    // the jump itself is checked by the caller
+    for (auto op : lam->body()->ops()) push(op);
+
+    while (!stack.empty()) {
+        auto def = pop(stack);
+
+        if (auto app = def->isa<App>()) {
+            auto [axiom, currying_depth] = get_axiom(app);
+            if (axiom == nullptr) return false; // a call
+
+            if (currying_depth == 0) {
+                switch (axiom->tag()) {
+                    case Tag::Load:
+                    case Tag::Store: {
+                        auto lea = isa<Tag::LEA>(app->arg(1));
+                        if (!lea) return false;
+                        auto [base, index] = lea->args<2>();
+                        if (!is_index(index, loop.iv->var) || !ivs.is_invariant(loop.header, base)) return false;
+                        loop.accesses.emplace_back(Access{lam, app, base, axiom->tag() == Tag::Store});
+                        break;
+                    }
+                    case Tag::Alloc:
+                    case Tag::Slot:
+                    case Tag::Atomic:
+                    case Tag::Acc:
+                    case Tag::Graph:
+                    case Tag::PE: return false;
+                    default: break;
+                }
+            }
+        }
+
+        for (auto op : def->ops()) push(op);
+    }
+
+    return true;
+}
+
+static bool isa_loop(const InductionVars& ivs, Lam* header, Loop& loop) {
+    if (header->is_external() || !header->is_basicblock() || !header->is_set()) return false;
+
+    loop.header = header;
+    loop.entry = loop.latch = nullptr;
+    for (auto pred : ivs.scope().f_cfg().preds(header)) {
+        auto lam = pred->nom()->as_nom<Lam>();
+        auto& slot = ivs.in_loop(header, lam) ? loop.latch : loop.entry;
+        if (slot != nullptr) return false;
+        slot = lam;
+    }
+    if (loop.entry == nullptr || loop.latch == nullptr) return false;
+
+    auto mem = mem_index(header);
+    if (!mem) return false;
+    loop.mem = *mem;
+
+    // header(..., m) = (exit, body)#(i cmp bound) m
+    auto n = header->num_vars();
+    auto app     = header->body()->isa<App>();
+    auto select  = app     ? app->callee()->isa<Extract>()  : nullptr;
+    auto targets = select  ? select->tuple()->isa<Tuple>()  : nullptr;
+    if (targets == nullptr || targets->num_ops() != 2 || app->arg() != header->var(n, loop.mem)) return false;
+
+    loop.exit = targets->op(0)->isa_nom<Lam>();
+    loop.body = targets->op(1)->isa_nom<Lam>();
+    auto cmp  = isa<Tag::ICmp>(select->index());
+    if (!loop.exit || !loop.body || !cmp || loop.exit->num_doms() != 1 || loop.body->num_doms() != 1 || ivs.in_loop(header, loop.exit) || !ivs.in_loop(header, loop.body)) return false;
+
+    auto [i, bound] = cmp->args<2>();
+    loop.cmp = cmp;
+    loop.iv  = ivs.basic(i);
+    if (loop.iv == nullptr || loop.iv->header != header || loop.iv->init == nullptr || !ivs.is_invariant(header, bound)) return false;
+
+    Scope loop_scope(header);
+    for (auto nom : ivs.body(header)) {
+        if (nom == header) continue;
+        auto lam = nom->isa_nom<Lam>();
+        if (lam == nullptr || !lam->is_set()) return false;
+
+        // control may only stay within the loop
+        auto jump = lam->body()->isa<App>();
+        if (jump == nullptr) return false;
+        DefArray callees{jump->callee()};
+        if (auto select = jump->callee()->isa<Extract>(); select && select->tuple()->isa<Tuple>()) callees = select->tuple()->ops();
+        for (auto callee : callees) {
+            auto target = callee->isa_nom<Lam>();
+            if (target == nullptr || !ivs.in_loop(header, target)) return false;
+        }
+
+        if (!collect_accesses(ivs, loop_scope, loop, lam)) return false;
+    }
+
+    return true;
+}
+
+/// Iterates over all users of @p def while looking through the @p Tuple%s that bundle arguments; skips dead ones.
+template<class F>
+static bool all_users(const Def* def, F f) {
+    for (auto use : def->uses()) {
+        if (auto tuple = use->isa<Tuple>()) {
+            for (auto tuple_use : tuple->uses()) {
+                if (tuple_use->num_uses() != 0 && !f(tuple_use.def())) return false;
+            }
+        } else if (use->num_uses() != 0 && !f(use.def())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * If @p base is a fresh @c alloc or @c slot that is only accessed via <tt>lea(base, i)</tt> for one of the induction variables of @p l1 or @p l2,
+ * returns the number of @c load%s and @c store%s of it.
+ */
+static std::optional<size_t> num_local_accesses(const Def* base, const Loop& l1, const Loop& l2) {
+    auto extract = base->isa<Extract>();
+    if (!extract || !(isa<Tag::Alloc>(extract->tuple()) || isa<Tag::Slot>(extract->tuple()))) return {};
+
+    size_t num = 0;
+    bool local = all_users(base, [&](const Def* user) {
+        auto lea = isa<Tag::LEA>(user);
+        if (!lea || lea->arg(0) != base || (!is_index(lea->arg(1), l1.iv->var) && !is_index(lea->arg(1), l2.iv->var))) return false;
+
+        // the address itself must not escape
+        return all_users(lea, [&](const Def* user) {
+            auto load  = isa<Tag::Load >(user);
+            auto store = isa<Tag::Store>(user);
+            if (!(load && load->arg(1) == lea) && !(store && store->arg(1) == lea && store->arg(2) != lea)) return false;
+            ++num;
+            return true;
+        });
+    });
+
+    return local ? std::optional<size_t>(num) : std::nullopt;
+}
+
+static bool dominates(const F_CFG& cfg, Lam* dom, Lam* lam) {
+    const auto& domtree = cfg.domtree();
+    for (auto n = cfg[lam]; ; n = domtree.idom(n)) {
+        if (n == cfg[dom]) return true;
+        if (n == domtree.root()) return false;
+    }
+}
+
+/// Substitutes according to @p repl within a @p Lam's body; doesn't look into other noms.
+static const Def* substitute(World& world, const Def* def, const Def2Def& repl, Def2Def& done) {
+    if (auto res = done.lookup(def)) return *res;
+
+    auto res = def;
+    if (auto r = repl.lookup(def)) {
+        res = substitute(world, *r, repl, done);
+    } else if (!def->isa_nom() && !def->isa<Var>() && !def->no_dep()) {
+        bool changed = false;
+        DefArray ops(def->num_ops(), [&](size_t i) {
+            auto op = substitute(world, def->op(i), repl, done);
+            changed |= op != def->op(i);
+            return op;
+        });
+        if (changed) res = def->rebuild(world, def->type(), ops, def->dbg());
+    }
+
+    return done[def] = res;
+}
+
+/// Does a nom of the loop headed by @p header use a @p Var of @p nom?
+static bool uses_var(const InductionVars& ivs, Lam* header, Def* nom) {
+    std::stack<const Def*> stack;
+    DefSet done;
+
+    auto push = [&](const Def* def) {
+        if (!def->isa_nom() && ivs.scope().bound(def) && done.emplace(def).second) stack.push(def);
+    };
+
+    for (auto lam : ivs.body(header)) {
+        for (auto op : lam->ops()) push(op);
+    }
+
+    while (!stack.empty()) {
+        auto def = pop(stack);
+        if (def == nom->var()) return true;
+        for (auto op : def->ops()) push(op);
+    }
+
+    return false;
+}
+
+static bool fuse(const InductionVars& ivs, const Loop& l1, const Loop& l2) {
+    auto& world = l1.header->world();
+    auto h1 = l1.header, h2 = l2.header;
+    auto n1 = h1->num_doms(), n2 = h2->num_doms();
+
+    // same iteration space
+    if (l1.exit != l2.entry || ivs.scope().f_cfg().num_preds(l1.exit) != 1) return false;
+    if (l1.iv->init != l2.iv->init || l1.iv->step != l2.iv->step) return false;
+    if (l1.cmp->axiom() != l2.cmp->axiom() || l1.cmp->arg(1) != l2.cmp->arg(1)) return false;
+
+    // the consumer sees the final values of the producer's loop-carried vars - in the fused loop, these would be the ones of the current iteration
+    if (uses_var(ivs, h2, h1)) return false;
+
+    // the consumer's remaining initial values must already be available before the producer runs
+    auto jump = l1.exit->body()->as<App>();
+    if (jump->arg(n2, l2.mem) != l1.exit->var()) return false;
+    std::vector<size_t> extras;
+    Scope exit_scope(l1.exit);
+    for (size_t k = 0; k != n2; ++k) {
+        if (k == l2.iv->index || k == l2.mem) continue;
+        auto init = jump->arg(n2, k);
+        if (!ivs.is_invariant(h1, init) || exit_scope.bound(init)) return false;
+        extras.emplace_back(k);
+    }
+
+    // dependences: the consumer may only see the producer's writes of the same iteration and vice versa
+    for (const auto& a1 : l1.accesses) {
+        for (const auto& a2 : l2.accesses) {
+            if (!a1.is_store && !a2.is_store) continue;
+            if (a1.base == a2.base) continue;
+            if (num_local_accesses(a1.base, l1, l2) || num_local_accesses(a2.base, l1, l2)) continue;
+            return false;
+        }
+    }
+
+    // intermediate arrays that are stored exactly once per iteration by the producer and only loaded by the consumer
+    std::vector<std::pair<const Access*, std::vector<const Access*>>> contractions;
+    DefSet bases;
+    for (const auto& a1 : l1.accesses) {
+        if (!a1.is_store || !bases.emplace(a1.base).second) continue;
+
+        auto num = num_local_accesses(a1.base, l1, l2);
+        if (!num || !dominates(ivs.scope().f_cfg(), a1.lam, l1.latch)) continue;
+
+        bool ok = std::none_of(l1.accesses.begin(), l1.accesses.end(), [&](const Access& a) { return a.base == a1.base && &a != &a1; });
+        std::vector<const Access*> loads;
+        for (const auto& a2 : l2.accesses) {
+            if (a2.base != a1.base) continue;
+            ok &= !a2.is_store;
+            loads.emplace_back(&a2);
+        }
+
+        // there must be no other access - e.g. after the loops
+        if (ok && 1 + loads.size() == *num) contractions.emplace_back(&a1, std::move(loads));
+    }
+
+    world.DLOG("fusing loops {} and {}", h1, h2);
+
+    // new header: h1's vars followed by h2's vars except its induction variable and its mem
+    auto num = n1 + extras.size();
+    DefVec doms;
+    for (auto dom : h1->doms()) doms.emplace_back(dom);
+    for (auto k : extras) doms.emplace_back(h2->dom(k));
+    auto header = h1->stub(world, world.cn(doms), h1->dbg());
+
+    DefArray vars2(n2);
+    vars2[l2.iv->index] = header->var(num, l1.iv->index);
+    vars2[l2.mem]       = header->var(num, l1.mem);
+    for (size_t x = 0, e = extras.size(); x != e; ++x) vars2[extras[x]] = header->var(num, n1 + x);
+
+    Rewriter rewriter(world, &ivs.scope());
+    rewriter.old2new[h1] = h1;
+    rewriter.old2new[h2] = h2;
+    rewriter.old2new[l1.entry] = l1.entry; // in case both loops are nested in another one
+    rewriter.old2new[h1->var()] = world.tuple(h1->dom(), DefArray(n1, [&](size_t i) { return header->var(num, i); }));
+    rewriter.old2new[h2->var()] = world.tuple(h2->dom(), vars2);
+
+    // leaving the fused loop means leaving the consumer
+    rewriter.old2new[l1.exit] = rewriter.rewrite(l2.exit);
+    header->set(DefArray(h1->num_ops(), [&](size_t i) { return rewriter.rewrite(h1->op(i)); }));
+    auto body2 = rewriter.rewrite(l2.body)->as_nom<Lam>();
+
+    // latch1 -> body2 ... latch2 -> header
+    auto latch1 = rewriter.old2new[l1.latch]->as_nom<Lam>();
+    auto latch2 = rewriter.old2new[l2.latch]->as_nom<Lam>();
+    auto jump1 = latch1->body()->as<App>();
+    auto jump2 = latch2->body()->as<App>();
+    assert(jump1->callee() == h1 && jump2->callee() == h2);
+
+    auto args = DefArray(num, [&](size_t i) -> const Def* {
+        if (i == l1.mem) return jump2->arg(n2, l2.mem);
+        if (i < n1)      return jump1->arg(n1, i);
+        return jump2->arg(n2, extras[i - n1]);
+    });
+    latch1->set_body(world.app(body2, jump1->arg(n1, l1.mem), jump1->dbg()));
+    latch2->set_body(world.app(header, args, jump2->dbg()));
+
+    auto entry_jump = l1.entry->body()->as<App>();
+    auto init = DefArray(num, [&](size_t i) { return i < n1 ? entry_jump->arg(n1, i) : jump->arg(n2, extras[i - n1]); });
+    l1.entry->set_body(world.app(header, init, entry_jump->dbg()));
+
+    if (contractions.empty()) return true;
+
+    // contract: drop the store and forward the stored value to the loads
+    Def2Def repl;
+    for (const auto& [store, loads] : contractions) {
+        world.DLOG("contracting intermediate array {}", store->base);
+        auto new_store = rewriter.old2new[store->app];
+        auto val = new_store->as<App>()->arg(2);
+        repl[new_store] = new_store->as<App>()->arg(0);
+        for (auto load : loads) {
+            auto new_load = rewriter.old2new[load->app];
+            repl[new_load] = world.tuple({new_load->as<App>()->arg(0), val});
+        }
+    }
+
+    Def2Def done;
+    for (const auto& loop : {&l1, &l2}) {
+        for (auto nom : ivs.body(loop->header)) {
+            if (nom == loop->header) continue;
+            auto lam = rewriter.old2new[nom]->as_nom<Lam>();
+            lam->set(DefArray(lam->num_ops(), [&](size_t i) { return substitute(world, lam->op(i), repl, done); }));
+        }
+    }
+
+    return true;
+}
+
+bool loop_fusion(World& world) {
+    bool todo = false;
+
+    // collect all top-level scopes first as fusing rebuilds their loops
+    std::vector<Lam*> lams;
+    world.visit([&](const Scope& scope) {
+        if (auto lam = scope.entry()->isa_nom<Lam>()) lams.emplace_back(lam);
+    });
+
+    for (auto lam : lams) {
+        if (!lam->is_set()) continue;
+
+        // each round fuses two loops into one, so this terminates
+        for (bool changed = true; changed;) {
+            changed = false;
+            Scope scope(lam);
+            InductionVars ivs(scope);
+
+            std::vector<Lam*> headers;
+            for (const auto& [_, basic] : ivs.basics()) headers.emplace_back(basic.header);
+            std::sort(headers.begin(), headers.end(), [](Lam* h1, Lam* h2) { return h1->gid() < h2->gid(); });
+            headers.erase(std::unique(headers.begin(), headers.end()), headers.end());
+
+            std::deque<Loop> loops;
+            for (auto header : headers) {
+                if (!isa_loop(ivs, header, loops.emplace_back())) loops.pop_back();
+            }
+
+            for (const auto& l1 : loops) {
+                for (const auto& l2 : loops) {
+                    if (&l1 != &l2 && l1.exit == l2.entry && fuse(ivs, l1, l2)) {
+                        changed = todo = true;
+                        break; // ivs are stale now
+                    }
+                }
+                if (changed) break;
+            }
+        }
+    }
+
+    return todo;
+}
+
+}
@@ -0,0 +1,22 @@
+#ifndef THORIN_TRANSFORM_LOOP_FUSION_H
+#define THORIN_TRANSFORM_LOOP_FUSION_H
+
+namespace thorin {
+
+class World;
+
+/**
+ * Fuses two adjacent loops - the exit of the producer directly jumps into the header of the consumer - if
+ * * both iterate over the same space, i.e. their basic induction variables agree in @c init, @c step and the exit condition,
+ * * the consumer doesn't use any loop-carried value of the producer - like a sum the producer computed,
+ * * all memory accesses within both loops are @c load%s/@c store%s to <tt>lea(p, i)</tt> with a loop-invariant @c p, and
+ * * no access of the consumer can observe a different iteration of the producer: Either both access the very same @c p or one of them is a non-escaping @c alloc/@c slot.
+ * The fused loop executes the producer's body followed by the consumer's body in each iteration.
+ * If an intermediate array is only written once per iteration by the producer and only read by the consumer, it is contracted to the stored scalar.
+ * Returns whether something has changed.
+ */
+bool loop_fusion(World&);
+
+}
+
+#endif
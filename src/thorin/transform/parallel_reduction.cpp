@@ -0,0 +1,233 @@
+#include "thorin/transform/parallel_reduction.h"
+
+#include "thorin/rewrite.h"
+#include "thorin/world.h"
+#include "thorin/analyses/scope.h"
+
+namespace thorin {
+
+/// Maximal number of blocks and, hence, partial accumulators - the runtime balances the blocks across its threads.
+static constexpr nat_t max_partials = 64;
+
+namespace {
+
+/// <tt>*ptr = *ptr op x</tt> within the body of an @c Acc::parallel.
+struct Reduction {
+    const Def* ptr;
+    const App* load;
+    const App* store;
+    const App* op;
+    const Def* partials = nullptr;  ///< Pointer to <tt>«T; type»</tt> with one partial accumulator per block.
+};
+
+}
+
+/// Iterates over all users of @p def while looking through the @p Tuple%s that bundle arguments; skips dead ones.
+template<class F>
+static bool all_users(const Def* def, F f) {
+    for (auto use : def->uses()) {
+        if (auto tuple = use->isa<Tuple>()) {
+            for (auto tuple_use : tuple->uses()) {
+                if (tuple_use->num_uses() != 0 && !f(tuple_use.def())) return false;
+            }
+        } else if (use->num_uses() != 0 && !f(use.def())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Is @p op associative and commutative such that the iterations may be regrouped?
+static bool is_reduction_op(const App* op) {
+    if (auto wrap = isa<Tag::Wrap>(op)) return wrap.flags() == Wrap::add || wrap.flags() == Wrap::mul;
+    if (auto bit  = isa<Tag::Bit >(op)) return bit.flags() == Bit::_and || bit.flags() == Bit::_or || bit.flags() == Bit::_xor;
+    if (auto rop  = isa<Tag::ROp >(op); rop && (rop.flags() == ROp::add || rop.flags() == ROp::mul)) {
+        auto mode = isa_lit(rop->decurry()->arg(0));
+        return mode && has(*mode, RMode::reassoc);
+    }
+    return false;
+}
+
+/// Rebuilds @p op for @p a and @p b - without @c nsw/@c nuw as a partial result may overflow even if the total doesn't.
+static const Def* rebuild(const App* op, const Def* a, const Def* b) {
+    auto& world = op->world();
+    if (auto wrap = isa<Tag::Wrap>(op)) return world.op(wrap.flags(), WMode::none, a, b, op->dbg());
+    if (auto bit  = isa<Tag::Bit >(op)) return world.op(bit.flags(), a, b, op->dbg());
+    auto rop = isa<Tag::ROp>(op);
+    return world.op(rop.flags(), rop->decurry()->arg(0), a, b, op->dbg());
+}
+
+static const Def* identity(const App* op) {
+    auto& world = op->world();
+    auto size = as_lit(isa_sized_type(op->type()));
+    if (auto wrap = isa<Tag::Wrap>(op)) return world.lit_int(op->type(), wrap.flags() == Wrap::add ? 0 : 1);
+    if (auto bit  = isa<Tag::Bit >(op)) return world.lit_int(op->type(), bit.flags() == Bit::_and ? (size == 0 ? u64(-1) : size - 1) : 0);
+    return world.lit_real(size, isa<Tag::ROp>(op).flags() == ROp::add ? -0.0 : 1.0);
+}
+
+static std::optional<Reduction> isa_reduction(const Scope& scope, const Def* ptr) {
+    // only a local variable can't be accessed via another pointer
+    auto local = ptr->isa<Extract>();
+    if (!local || !(isa<Tag::Alloc>(local->tuple()) || isa<Tag::Slot>(local->tuple()))) return {};
+
+    Reduction red{ptr, nullptr, nullptr, nullptr};
+    std::vector<const Def*> outside;
+    bool ok = all_users(ptr, [&](const Def* user) {
+        auto load  = isa<Tag::Load >(user);
+        auto store = isa<Tag::Store>(user);
+        if (!(load && load->arg(1) == ptr) && !(store && store->arg(1) == ptr && store->arg(2) != ptr)) return false;
+
+        if (!scope.bound(user)) {
+            outside.emplace_back(user);
+            return true;
+        }
+
+        auto& slot = load ? red.load : red.store;
+        if (slot != nullptr) return false;
+        slot = user->as<App>();
+        return true;
+    });
+    if (!ok || red.load == nullptr || red.store == nullptr) return {};
+
+    // store(m, ptr, load(m', ptr)#1 op x)
+    red.op = red.store->arg(2)->isa<App>();
+    if (red.op == nullptr || !is_reduction_op(red.op)) return {};
+    auto val = red.load->proj(2_u64, 1_u64);
+    auto [a, b] = red.op->args<2>();
+    if ((a == val) == (b == val)) return {};
+    if (!all_users(val, [&](const Def* user) { return user == red.op; })) return {};
+    // the partial result of an iteration may not be observed either - e.g. by out[0] = *p + i
+    if (!all_users(red.op, [&](const Def* user) { return user == red.store; })) return {};
+
+    // no other function that is invoked by an iteration may access ptr
+    for (auto def : scope.bound()) {
+        for (auto op : def->ops()) {
+            auto lam = op->isa_nom<Lam>();
+            if (lam == nullptr || lam == scope.entry() || scope.bound(lam)) continue;
+            Scope callee(lam);
+            if (std::any_of(outside.begin(), outside.end(), [&](const Def* user) { return callee.bound(user); })) return {};
+        }
+    }
+
+    return red;
+}
+
+static bool reduce(Lam* lam) {
+    auto& world = lam->world();
+    auto par = isa<Tag::Acc>(lam->body());
+    if (!par || par.flags() != Acc::parallel) return false;
+
+    auto n = par->decurry()->arg();
+    auto [mem, body_def, ret] = par->args<3>();
+    auto body = body_def->isa_nom<Lam>();
+    if (body == nullptr || !body->is_set()) return false;
+
+    nat_t num = max_partials;
+    if (auto l = isa_lit(n)) {
+        if (*l <= 1) return false;
+        num = std::min(*l, max_partials);
+    }
+
+    Scope scope(body);
+    std::vector<Reduction> reds;
+    DefSet ptrs;
+    for (auto def : scope.bound()) {
+        if (auto load = isa<Tag::Load>(def); load && !scope.bound(load->arg(1)) && ptrs.emplace(load->arg(1)).second) {
+            if (auto red = isa_reduction(scope, load->arg(1))) reds.emplace_back(*red);
+        }
+    }
+    if (reds.empty()) return false;
+    std::sort(reds.begin(), reds.end(), [](const Reduction& r1, const Reduction& r2) { return r1.load->gid() < r2.load->gid(); });
+
+    for (const auto& red : reds) world.DLOG("parallel reduction of {} via {} in {}", red.ptr, red.op, body);
+
+    auto M   = world.type_mem();
+    auto i64 = world.type_int_width(64);
+    auto one = world.lit_int_width(64, 1);
+
+    // the partial accumulators live on the stack of the caller of the parallel loop
+    auto m = mem;
+    for (auto& red : reds) {
+        auto slot = world.op_slot(world.arr(num, red.op->type()), m, red.ptr->dbg());
+        m = slot->proj(2_u64, 0_u64);
+        red.partials = slot->proj(2_u64, 1_u64);
+    }
+
+    auto blocks  = world.nom_lam(world.cn({M, world.type_int(num), world.cn(M)}), world.dbg("par_blocks"));
+    auto combine = world.nom_lam(world.cn(M), world.dbg("par_combine"));
+    lam->set_body(world.op(Acc::parallel, world.lit_nat(num), m, blocks, combine, lam->body()->dbg()));
+
+    // blocks(m, t, k): partial[t] = id; for j in [t*n/T, (t+1)*n/T) body'(m, j)
+    auto [bm, t, k] = blocks->vars<3>();
+    m = bm;
+    for (const auto& red : reds) m = world.op_store(m, world.op_lea(red.partials, t), identity(red.op));
+
+    auto N = world.op_bitcast(i64, n);
+    auto T = world.lit_int_width(64, num);
+    auto t64 = world.op(Conv::u2u, i64, t);
+    auto lo = world.op(Div::udiv, m, world.op(Wrap::mul, WMode::nuw, t64, N), T);
+    m = lo->proj(2_u64, 0_u64);
+    auto hi = world.op(Div::udiv, m, world.op(Wrap::mul, WMode::nuw, world.op(Wrap::add, WMode::nuw, t64, one), N), T);
+    m = hi->proj(2_u64, 0_u64);
+
+    auto head = world.nom_lam(world.cn({M, i64}), world.dbg("par_head"));
+    auto iter = world.nom_lam(world.cn(M), world.dbg("par_iter"));
+    auto next = world.nom_lam(world.cn(M), world.dbg("par_next"));
+    auto exit = world.nom_lam(world.cn(M), world.dbg("par_exit"));
+    blocks->app(head, {m, lo->proj(2_u64, 1_u64)});
+
+    auto [hm, j] = head->vars<2>();
+    head->branch(world.op(ICmp::ul, j, hi->proj(2_u64, 1_u64)), iter, exit, hm);
+
+    // the original body with each accumulator replaced by the partial one of its block
+    Rewriter rewriter(world, &scope);
+    auto body_red = body->stub(world, body->type(), body->dbg());
+    rewriter.old2new[body] = body_red;
+    rewriter.old2new[body->var()] = body_red->var();
+    for (const auto& red : reds) rewriter.old2new[red.ptr] = world.op_lea(red.partials, t);
+    for (const auto& red : reds) {
+        auto [a, b] = red.op->args<2>();
+        rewriter.old2new[red.op] = rebuild(red.op, rewriter.rewrite(a), rewriter.rewrite(b));
+    }
+    body_red->set(DefArray(body->num_ops(), [&](size_t i) { return rewriter.rewrite(body->op(i)); }));
+
+    iter->app(body_red, {iter->var(), world.op(Conv::u2u, world.type_int(n), j), next});
+    next->app(head, {next->var(), world.op(Wrap::add, WMode::nuw, j, one)});
+    exit->app(k, exit->var());
+
+    // combine(m): *ptr = *ptr op ((partial[0] op partial[1]) op (partial[2] op partial[3])) ...
+    m = combine->var();
+    for (const auto& red : reds) {
+        DefVec vals;
+        for (nat_t i = 0; i != num; ++i) {
+            auto load = world.op_load(m, world.op_lea(red.partials, world.lit_int(num, i)));
+            m = load->proj(2_u64, 0_u64);
+            vals.emplace_back(load->proj(2_u64, 1_u64));
+        }
+
+        while (vals.size() > 1) {
+            DefVec level;
+            for (size_t i = 0; i + 1 < vals.size(); i += 2) level.emplace_back(rebuild(red.op, vals[i], vals[i + 1]));
+            if (vals.size() % 2 != 0) level.emplace_back(vals.back());
+            vals.swap(level);
+        }
+
+        auto init = world.op_load(m, red.ptr);
+        m = world.op_store(init->proj(2_u64, 0_u64), red.ptr, rebuild(red.op, init->proj(2_u64, 1_u64), vals.front()), red.store->dbg());
+    }
+    combine->app(ret, m);
+
+    return true;
+}
+
+bool parallel_reduction(World& world) {
+    bool todo = false;
+
+    for (auto lam : world.copy_lams()) {
+        if (lam->is_set()) todo |= reduce(lam);
+    }
+
+    return todo;
+}
+
+}
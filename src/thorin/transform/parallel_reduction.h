@@ -0,0 +1,21 @@
+#ifndef THORIN_TRANSFORM_PARALLEL_REDUCTION_H
+#define THORIN_TRANSFORM_PARALLEL_REDUCTION_H
+
+namespace thorin {
+
+class World;
+
+/**
+ * Recognizes reductions <tt>*p = *p op x</tt> within the body of an @c Acc::parallel where
+ * * @p p is a local @c alloc/@c slot which is only loaded once and stored once per iteration,
+ * * the loaded value only flows into the update, and
+ * * @c op is an integer @c add/@c mul/@c and/@c or/@c xor or a floating-point @c add/@c mul with @p RMode::reassoc.
+ * The iterations are split into blocks which run in parallel and accumulate into one partial accumulator per block.
+ * Once all blocks have finished, the partial results are combined in a tree and folded into @c *p.
+ * Returns whether something has changed.
+ */
+bool parallel_reduction(World&);
+
+}
+
+#endif
@@ -0,0 +1,242 @@
+#include "thorin/transform/strength_reduction.h"
+
+#include <stack>
+
+#include "thorin/rewrite.h"
+#include "thorin/world.h"
+#include "thorin/analyses/cfg.h"
+#include "thorin/analyses/induction.h"
+#include "thorin/analyses/scope.h"
+#include "thorin/util/container.h"
+
+namespace thorin {
+
+using Basic   = InductionVars::Basic;
+using Derived = InductionVars::Derived;
+
+/// Does @p def transitively depend on @p target within @p scope?
+static bool depends_on(const Scope& scope, const Def* def, const Def* target) {
+    std::stack<const Def*> stack;
+    DefSet done;
+
+    auto push = [&](const Def* def) {
+        if (def != nullptr && done.emplace(def).second) stack.push(def);
+    };
+
+    push(def);
+    while (!stack.empty()) {
+        auto def = pop(stack);
+        if (def == target) return true;
+        if (!scope.bound(def)) continue;
+        for (auto op : def->ops()) push(op);
+    }
+
+    return false;
+}
+
+/// The @p Def%s which the noms of the loop headed by @p header use - without looking into other noms.
+static DefSet used_in_loop(const InductionVars& ivs, Lam* header) {
+    std::stack<const Def*> stack;
+    DefSet done;
+
+    auto push = [&](const Def* def) {
+        if (!def->isa_nom() && done.emplace(def).second) stack.push(def);
+    };
+
+    for (auto nom : ivs.body(header)) {
+        for (auto op : nom->ops()) push(op);
+    }
+
+    while (!stack.empty()) {
+        auto def = pop(stack);
+        if (ivs.scope().bound(def)) {
+            for (auto op : def->ops()) push(op);
+        }
+    }
+
+    return done;
+}
+
+/**
+ * If @p basic's header branches via <tt>i != bound</tt> or <tt>i <u bound</tt> out of the loop,
+ * returns the exit @p Lam together with the value of @c i when leaving the loop - which is @c bound.
+ */
+static std::pair<Lam*, const Def*> exit_value(const InductionVars& ivs, const Basic& basic) {
+    auto header = basic.header;
+    auto app     = header->body()->isa<App>();
+    auto select  = app     ? app->callee()->isa<Extract>()      : nullptr;
+    auto targets = select  ? select->tuple()->isa<Tuple>()      : nullptr;
+    auto exit    = targets && targets->num_ops() == 2 ? targets->op(0)->isa_nom<Lam>() : nullptr; // false branch
+    if (exit == nullptr || ivs.in_loop(header, exit) || ivs.scope().f_cfg().num_preds(exit) != 1) return {nullptr, nullptr};
+
+    if (auto icmp = isa<Tag::ICmp>(select->index())) {
+        auto [a, bound] = icmp->args<2>();
+        if (icmp.flags() == ICmp::ne && bound == basic.var) std::swap(a, bound); // the normalizer may put the bound first
+        if (a != basic.var || !ivs.is_invariant(header, bound)) return {nullptr, nullptr};
+
+        switch (icmp.flags()) {
+            // the loop only terminates if i hits bound exactly
+            case ICmp::ne: return {exit, bound};
+            // i = init, init + 1, ... leaves the loop with i == bound if init <= bound
+            case ICmp::ul: {
+                auto step = isa_lit(basic.step);
+                auto init = basic.init ? isa_lit(basic.init) : std::nullopt;
+                if (!step || *step != 1 || !init) break;
+                if (*init == 0) return {exit, bound};
+                if (auto l_bound = isa_lit(bound); l_bound && *init <= *l_bound) return {exit, bound};
+                break;
+            }
+            default: break;
+        }
+    }
+
+    return {nullptr, nullptr};
+}
+
+/// Multiplies @p i by @p derived's loop-invariant operand without any @p WMode as we can't guarantee the flags for other operands.
+static const Def* scale(const Derived& derived, const Def* i) {
+    auto& world = i->world();
+    auto op = isa<Tag::Wrap>(derived.def).flags();
+    return world.op(op, WMode::none, i, derived.other);
+}
+
+/**
+ * Rebuilds the loop headed by @p header:
+ * Each derived <tt>i * c</tt> used within the loop becomes a new @p Var @c j of @p header with <tt>j = init * c</tt> on entry and <tt>j + step * c</tt> on the back edges;
+ * a derived only used after the loop would just be a dead loop-carried @p Var.
+ * Furthermore, the loop's exit gets the closed-form value of a basic induction variable if we know it.
+ */
+static bool reduce(const InductionVars& ivs, Lam* header) {
+    auto& world = header->world();
+    if (header->is_external() || !header->is_basicblock()) return false;
+
+    Scope scope(header);
+    std::vector<Lam*> entries, latches;
+    for (auto pred : ivs.scope().f_cfg().preds(header)) {
+        auto lam = pred->nom()->as_nom<Lam>();
+        if (ivs.in_loop(header, lam)) {
+            if (!scope.bound(lam)) return false;
+            latches.emplace_back(lam);
+        } else {
+            entries.emplace_back(lam);
+        }
+    }
+
+    auto used = used_in_loop(ivs, header);
+    std::vector<const Derived*> deriveds;
+    for (const auto& [_, derived] : ivs.deriveds()) {
+        auto basic = ivs.basic(derived.basic);
+        if (basic->header != header || basic->init == nullptr || !used.contains(derived.def)) continue;
+        if (isa<Tag::Wrap>(Wrap::mul, derived.def) || isa<Tag::Wrap>(Wrap::shl, derived.def))
+            deriveds.emplace_back(&derived);
+    }
+    std::sort(deriveds.begin(), deriveds.end(), [](auto d1, auto d2) { return d1->def->gid() < d2->def->gid(); });
+
+    const Basic* exit_basic = nullptr;
+    Lam* exit = nullptr;
+    const Def* exit_val = nullptr;
+    for (const auto& [_, basic] : ivs.basics()) {
+        if (basic.header != header) continue;
+        if (auto [x, val] = exit_value(ivs, basic); x != nullptr && depends_on(scope, x, basic.var)) {
+            exit_basic = &basic;
+            exit = x;
+            exit_val = val;
+            break;
+        }
+    }
+
+    if (deriveds.empty() && exit == nullptr) return false;
+
+    auto n = header->num_doms();
+    auto m = deriveds.size();
+    auto num = n + m;
+    DefVec new_doms;
+    for (auto dom : header->doms()) new_doms.emplace_back(dom);
+    for (auto derived : deriveds) new_doms.emplace_back(derived->def->type());
+
+    auto new_header = header->stub(world, world.cn(new_doms), header->dbg());
+    auto new_vars = DefArray(n, [&](size_t i) { return new_header->var(num, i); });
+
+    Rewriter rewriter(world, &scope);
+    rewriter.old2new[header->var()] = world.tuple(header->dom(), new_vars);
+    for (size_t l = 0; l != m; ++l) {
+        world.DLOG("strength reduction of {} in {}", deriveds[l]->def, header);
+        rewriter.old2new[deriveds[l]->def] = new_header->var(num, n + l);
+    }
+
+    if (exit != nullptr) {
+        world.DLOG("exit value of {} in {}: {}", exit_basic->var, exit, exit_val);
+        auto exit_vars = new_vars;
+        exit_vars[exit_basic->index] = exit_val;
+        Rewriter exit_rewriter(world, &scope);
+        exit_rewriter.old2new[header->var()] = world.tuple(header->dom(), exit_vars);
+        rewriter.old2new[exit] = exit_rewriter.rewrite(exit);
+    }
+
+    new_header->set(DefArray(header->num_ops(), [&](size_t i) { return rewriter.rewrite(header->op(i)); }));
+
+    for (auto latch : latches) {
+        auto new_latch = rewriter.old2new[latch]->as_nom<Lam>();
+        auto jump = new_latch->body()->as<App>();
+        assert(jump->callee() == header);
+
+        auto args = DefArray(num, [&](size_t i) -> const Def* {
+            if (i < n) return jump->arg(n, i);
+            auto derived = deriveds[i - n];
+            auto step = scale(*derived, ivs.basic(derived->basic)->step);
+            return world.op(Wrap::add, WMode::none, new_header->var(num, i), step);
+        });
+        new_latch->set_body(world.app(new_header, args, jump->dbg()));
+    }
+
+    for (auto entry : entries) {
+        auto jump = entry->body()->as<App>();
+        auto args = DefArray(num, [&](size_t i) -> const Def* {
+            if (i < n) return jump->arg(n, i);
+            auto derived = deriveds[i - n];
+            return scale(*derived, ivs.basic(derived->basic)->init);
+        });
+        entry->set_body(world.app(new_header, args, jump->dbg()));
+    }
+
+    return true;
+}
+
+bool strength_reduction(World& world) {
+    bool todo = false;
+
+    // collect all top-level scopes first as reducing rebuilds their loops
+    std::vector<Lam*> lams;
+    world.visit([&](const Scope& scope) {
+        if (auto lam = scope.entry()->isa_nom<Lam>()) lams.emplace_back(lam);
+    });
+
+    for (auto lam : lams) {
+        // each round gets rid of at least one derived induction variable or the use of a basic one in an exit
+        for (size_t round = 0, max_rounds = 1; round != max_rounds; ++round) {
+            Scope scope(lam);
+            InductionVars ivs(scope);
+            if (round == 0) max_rounds = 1 + ivs.basics().size() + ivs.deriveds().size();
+
+            std::vector<Lam*> headers;
+            for (const auto& [_, basic] : ivs.basics()) headers.emplace_back(basic.header);
+            std::sort(headers.begin(), headers.end(), [](Lam* h1, Lam* h2) { return h1->gid() < h2->gid(); });
+            headers.erase(std::unique(headers.begin(), headers.end()), headers.end());
+
+            bool changed = false;
+            for (auto header : headers) {
+                if (reduce(ivs, header)) {
+                    changed = true;
+                    break; // ivs are stale now
+                }
+            }
+
+            if (!changed) break;
+            todo = true;
+        }
+    }
+
+    return todo;
+}
+
+}
@@ -0,0 +1,18 @@
+#ifndef THORIN_TRANSFORM_STRENGTH_REDUCTION_H
+#define THORIN_TRANSFORM_STRENGTH_REDUCTION_H
+
+namespace thorin {
+
+class World;
+
+/**
+ * Uses @p InductionVars to
+ * * replace <tt>i * c</tt> and <tt>i << c</tt> within a loop by a new loop-carried @p Var that is incremented by <tt>step * c</tt> and <tt>step << c</tt>, respectively,
+ * * replace a basic induction variable by its closed-form value within the exit of its loop.
+ * Returns whether something has changed.
+ */
+bool strength_reduction(World&);
+
+}
+
+#endif
@@ -0,0 +1,484 @@
+#include "thorin/transform/vectorize.h"
+
+#include "thorin/world.h"
+#include "thorin/analyses/cfg.h"
+#include "thorin/analyses/domtree.h"
+#include "thorin/analyses/scope.h"
+#include "thorin/util/bit.h"
+
+namespace thorin {
+
+/// Width of the vector registers we aim for; LLVM splits wider vectors for smaller targets.
+static constexpr nat_t vector_bits = 256;
+/// Matches @p CodeGen::max_vector_lanes.
+static constexpr nat_t max_lanes = 16;
+
+namespace {
+
+/// A value of the vectorized body - either one scalar for all lanes or an array with one element per lane.
+struct Value {
+    const Def* def;
+    bool varying;
+};
+
+class Vectorizer {
+public:
+    Vectorizer(const Scope& scope, nat_t lanes)
+        : world_(scope.entry()->world())
+        , scope_(scope)
+        , body_(scope.entry()->as_nom<Lam>())
+        , lanes_(lanes)
+    {}
+
+    World& world() { return world_; }
+    /// Emits the lanes <tt>[i0, i0 + lanes)</tt> of the body after @p mem and returns the resulting @c mem - or @c nullptr if this is not possible.
+    const Def* emit(const Def* mem, const Def* i0);
+
+private:
+    struct Edge {
+        const Def* mask;            ///< @c nullptr means all lanes.
+        std::vector<Value> args;
+    };
+
+    bool analyze();
+    Lam* block_of(const Def* mem);
+    const Def* first_lane(const Def* index);
+    std::optional<Value> vec(const Def*);
+    std::optional<Value> vec_uniform(const Def*);
+    std::optional<Value> vec_app(const App*);
+    std::optional<Value> vec_access(const App*);
+    std::optional<Value> vec_extract(const Extract*);
+    std::optional<Value> join(Lam* block, size_t i);
+
+    const Def* widen(Value v) { return v.varying ? v.def : world().pack(lanes_, v.def); }
+    const Def* lift(const Def* fn, Defs Is, const Def* O, Defs args);
+    const Def* select(const Def* T, const Def* mask, Value t, Value f);
+    const Def* mask_and(const Def* a, const Def* b) { return a == nullptr ? b : lift(world().fn(Bit::_and, 2), {bool_, bool_}, bool_, {a, b}); }
+    const Def* mask_or (const Def* a, const Def* b) { return lift(world().fn(Bit::_or, 2), {bool_, bool_}, bool_, {a, b}); }
+    const Def* mask_not(const Def* a) { return lift(world().fn(Bit::_xor, 2), {bool_, bool_}, bool_, {a, world().pack(lanes_, world().lit_true())}); }
+
+    World& world_;
+    const Scope& scope_;
+    Lam* body_;
+    nat_t lanes_;
+    const Def* bool_ = world_.type_bool();
+    const Def* index_ = body_->var(3_u64, 1_u64);
+    const Def* ret_ = body_->var(3_u64, 2_u64);
+    const Def* i0_ = nullptr;
+    std::vector<Lam*> blocks_;              ///< In reverse post-order.
+    LamMap<size_t> rpo_;
+    LamSet unconditional_;                  ///< Blocks executed by all lanes.
+    DefSet safe_;                           ///< Addresses accessed by all lanes.
+    LamMap<const Def*> masks_;
+    LamMap<std::vector<Edge>> edges_;       ///< Incoming.
+    DefMap<Value> old2new_;
+    DefMap<Lam*> selects_;
+};
+
+}
+
+/*
+ * analysis
+ */
+
+bool Vectorizer::analyze() {
+    const auto& cfg = scope_.f_cfg();
+    for (auto n : cfg.reverse_post_order()) {
+        if (n == cfg.exit()) continue;
+        auto lam = n->nom()->isa<Lam>();
+        if (lam == nullptr || !lam->is_set() || (lam != body_ && !lam->is_basicblock())) return false;
+        if (lam->num_vars() == 0 || !isa<Tag::Mem>(lam->var(lam->num_vars(), 0_u64)->type())) return false;
+        rpo_[lam] = blocks_.size();
+        blocks_.emplace_back(lam);
+    }
+
+    // all other noms are closures or loops
+    for (auto def : scope_.bound()) {
+        if (auto nom = def->isa_nom(); nom && !(nom->isa<Lam>() && rpo_.contains(nom->as<Lam>()))) return false;
+    }
+
+    // the blocks which post-dominate the entry are executed by all lanes
+    const auto& pdom = scope_.b_cfg().domtree();
+    for (auto n = scope_.cfa()[body_]; n != pdom.root(); n = pdom.idom(n)) {
+        if (auto lam = n->nom()->isa<Lam>()) unconditional_.emplace(lam);
+    }
+
+    for (auto def : scope_.bound()) {
+        auto load  = isa<Tag::Load >(def);
+        auto store = isa<Tag::Store>(def);
+        if (!load && !store) continue;
+        auto app = def->as<App>();
+        auto block = block_of(app->arg(0));
+        if (block == nullptr) return false;
+        if (unconditional_.contains(block)) safe_.emplace(app->arg(1));
+    }
+
+    return true;
+}
+
+/// The block in which @p mem is produced.
+Lam* Vectorizer::block_of(const Def* mem) {
+    while (true) {
+        if (auto var = mem->isa<Var>()) return var->nom()->isa<Lam>();
+        if (auto extract = mem->isa<Extract>()) {
+            if (auto var = extract->tuple()->isa<Var>()) return var->nom()->isa<Lam>();
+            mem = extract->tuple();
+        }
+        if (!is_memop(mem)) return nullptr;
+        mem = mem->as<App>()->arg(0);
+    }
+}
+
+/// If @p index is the index of the iteration - possibly widened as by @p World::op_lea_unsafe -, returns it for the first lane.
+const Def* Vectorizer::first_lane(const Def* index) {
+    if (index == index_) return i0_;
+    if (auto conv = isa<Tag::Conv>(index); conv && conv->arg() == index_ && (conv.flags() == Conv::u2u || conv.flags() == Conv::s2s)) {
+        auto dst = isa_lit(isa_sized_type(conv->type()));
+        auto src = isa_lit(isa_sized_type(index_->type()));
+        // the lanes are consecutive as long as the conversion doesn't wrap
+        if (dst && src && (*dst == 0 || (*src != 0 && *src <= *dst))) return world().app(conv->callee(), i0_);
+    }
+    return nullptr;
+}
+
+/*
+ * helpers
+ */
+
+/// <tt>lift fn args</tt> for a scalar @p fn of type <tt>Is -> O</tt>.
+const Def* Vectorizer::lift(const Def* fn, Defs Is, const Def* O, Defs args) {
+    auto& w = world();
+    auto n = Is.size();
+    auto lift = w.app(w.ax_lift(), {w.lit_nat_1(), w.lit_nat(lanes_)});
+    lift = w.app(lift, {w.lit_nat(n), w.tuple(Is), w.lit_nat_1(), O, fn});
+    return w.app(lift, args);
+}
+
+/// Lane-wise <tt>mask ? t : f</tt> for values of scalar type @p T.
+const Def* Vectorizer::select(const Def* T, const Def* mask, Value t, Value f) {
+    auto& w = world();
+
+    auto& fn = selects_[T];
+    if (fn == nullptr) {
+        fn = w.nom_lam(w.pi({bool_, T, T}, T), w.dbg("select"));
+        auto [c, a, b] = fn->vars<3>();
+        fn->set_filter(true);
+        fn->set_body(w.select(a, b, c));
+    }
+
+    return lift(fn, {bool_, T, T}, T, {mask, widen(t), widen(f)});
+}
+
+/*
+ * rewriting
+ */
+
+std::optional<Value> Vectorizer::vec(const Def* def) {
+    if (auto v = old2new_.lookup(def)) return *v;
+    if (!scope_.bound(def)) return Value{def, false};
+    if (def->isa_nom()) return {}; // blocks only occur as callees
+
+    std::optional<Value> res;
+    if (auto app = def->isa<App>())
+        res = vec_app(app);
+    else if (auto extract = def->isa<Extract>())
+        res = vec_extract(extract);
+    else
+        res = vec_uniform(def);
+
+    if (res) old2new_[def] = *res;
+    return res;
+}
+
+/// Rebuilds @p def from its rewritten ops - provided that none of them is varying.
+std::optional<Value> Vectorizer::vec_uniform(const Def* def) {
+    DefArray ops(def->num_ops());
+    for (size_t i = 0, e = def->num_ops(); i != e; ++i) {
+        auto op = vec(def->op(i));
+        if (!op || op->varying) return {};
+        ops[i] = op->def;
+    }
+    return Value{def->rebuild(world(), def->type(), ops, def->dbg()), false};
+}
+
+std::optional<Value> Vectorizer::vec_app(const App* app) {
+    auto [axiom, currying_depth] = get_axiom(app);
+    if (axiom == nullptr || currying_depth != 0) return vec_uniform(app);
+
+    switch (axiom->tag()) {
+        case Tag::Load:
+        case Tag::Store: return vec_access(app);
+        case Tag::Bit:
+        case Tag::Shr:
+        case Tag::Wrap:
+        case Tag::ROp:
+        case Tag::ICmp:
+        case Tag::RCmp:
+        case Tag::FMA:
+        case Tag::Conv: {
+            auto n = app->num_args();
+            DefArray args(n), Is(n);
+            bool varying = false;
+            for (size_t i = 0; i != n; ++i) {
+                auto arg = vec(app->arg(n, i));
+                if (!arg) return {};
+                varying |= arg->varying;
+                args[i] = widen(*arg);
+                Is[i] = app->arg(n, i)->type();
+            }
+            if (!varying) return vec_uniform(app);
+
+            auto fn = vec(app->callee());
+            if (!fn || fn->varying) return {};
+            return Value{lift(fn->def, Is, app->type(), args), true};
+        }
+        case Tag::Div: return vec_uniform(app); // dividing once for all lanes is fine while a varying divisor may be 0 in an inactive lane
+        default:
+            // any other side effect would happen once instead of once per lane
+            if (is_memop(app)) return {};
+            return vec_uniform(app);
+    }
+}
+
+std::optional<Value> Vectorizer::vec_access(const App* app) {
+    auto& w = world();
+    auto load = isa<Tag::Load>(app);
+    auto ptr = app->arg(1);
+    auto mem = vec(app->arg(0));
+    if (!mem) return {};
+
+    auto block = block_of(app->arg(0));
+    auto mask = masks_[block];
+    if (mask != nullptr && !safe_.contains(ptr)) return {}; // inactive lanes might access invalid memory
+
+    if (auto lea = isa<Tag::LEA>(ptr)) {
+        auto [base, index] = lea->args<2>();
+        if (auto first = first_lane(index)) {
+            // p[i], ..., p[i + lanes - 1] -> *(«lanes; T»*) &p[i]
+            auto b = vec(base);
+            if (!b || b->varying) return {};
+            auto [T, addr_space] = as<Tag::Ptr>(ptr->type())->args<2>();
+            if (!isa<Tag::Int>(T) && !isa<Tag::Real>(T)) return {};
+            auto vptr = w.op_bitcast(w.type_ptr(w.arr(lanes_, T), addr_space), w.op_lea(b->def, first));
+
+            if (load) return Value{w.op_load(mem->def, vptr, app->dbg()), true};
+
+            auto val = vec(app->arg(2));
+            if (!val) return {};
+            if (mask == nullptr) return Value{w.op_store(mem->def, vptr, widen(*val), app->dbg()), false};
+
+            // blend: the inactive lanes store what is already there
+            auto old = w.op_load(mem->def, vptr);
+            auto blend = select(T, mask, *val, Value{old->proj(2_u64, 1_u64), true});
+            return Value{w.op_store(old->proj(2_u64, 0_u64), vptr, blend, app->dbg()), false};
+        }
+    }
+
+    // a uniform address which all lanes would store to is a conflict
+    if (!load) return {};
+    return vec_uniform(app);
+}
+
+std::optional<Value> Vectorizer::vec_extract(const Extract* extract) {
+    auto& w = world();
+    auto tuple = extract->tuple();
+
+    if (is_memop(tuple)) {
+        auto t = vec(tuple);
+        auto index = isa_lit(extract->index());
+        if (!t || !index) return {};
+        return Value{w.extract(t->def, extract->index(), extract->dbg()), t->varying && *index != 0};
+    }
+
+    // (f, t)#cond
+    if (auto tup = tuple->isa<Tuple>(); tup && tup->num_ops() == 2 && extract->index()->type() == bool_ && extract->type()->order() == 0) {
+        auto f = vec(tup->op(0)), t = vec(tup->op(1)), c = vec(extract->index());
+        if (!f || !t || !c) return {};
+        if (f->varying || t->varying || c->varying) return Value{select(extract->type(), widen(*c), *t, *f), true};
+    }
+
+    return vec_uniform(extract);
+}
+
+/// The @p i'th @c var of @p block: each lane receives the argument of the edge it has taken.
+std::optional<Value> Vectorizer::join(Lam* block, size_t i) {
+    const auto& edges = edges_[block];
+    auto res = edges.front().args[i];
+    for (size_t e = 1, n = edges.size(); e != n; ++e) {
+        const auto& edge = edges[e];
+        auto arg = edge.args[i];
+        if (edge.mask == nullptr) {
+            res = arg;
+        } else if (arg.def != res.def) {
+            res = Value{select(block->var(block->num_vars(), i)->type(), edge.mask, arg, res), true};
+        }
+    }
+    return res;
+}
+
+const Def* Vectorizer::emit(const Def* mem, const Def* i0) {
+    auto& w = world();
+    if (!analyze()) return nullptr;
+
+    i0_ = i0;
+    auto T = index_->type();
+    old2new_[body_->var(3_u64, 0_u64)] = Value{mem, false};
+    old2new_[index_] = Value{w.tuple(DefArray(lanes_, [&](size_t l) { return l == 0 ? i0 : w.op(Wrap::add, WMode::none, i0, w.lit_int(T, l)); })), true};
+
+    for (auto block : blocks_) {
+        auto n = block->num_vars();
+        if (block != body_) {
+            const auto& edges = edges_[block];
+            if (edges.empty()) return nullptr;
+
+            const Def* mask = nullptr;
+            if (!unconditional_.contains(block)) {
+                if (std::any_of(edges.begin(), edges.end(), [](const Edge& e) { return e.mask == nullptr; })) return nullptr;
+                mask = edges.front().mask;
+                for (size_t e = 1, num = edges.size(); e != num; ++e) mask = mask_or(mask, edges[e].mask);
+            }
+            masks_[block] = mask;
+
+            old2new_[block->var(n, 0_u64)] = Value{mem, false};
+            for (size_t i = 1; i != n; ++i) {
+                auto var = join(block, i);
+                if (!var) return nullptr;
+                old2new_[block->var(n, i)] = *var;
+            }
+        }
+
+        auto app = block->body()->isa<App>();
+        if (app == nullptr) return nullptr;
+        auto mask = masks_[block];
+        auto callee = app->callee();
+
+        if (callee == ret_) {
+            auto m = vec(app->arg());
+            if (!m) return nullptr;
+            mem = m->def;
+        } else if (auto succ = callee->isa_nom<Lam>()) {
+            if (!rpo_.contains(succ) || rpo_[succ] <= rpo_[block]) return nullptr;
+
+            Edge edge{mask, {}};
+            for (size_t i = 0, e = app->num_args(); i != e; ++i) {
+                auto arg = vec(app->arg(i));
+                if (!arg) return nullptr;
+                edge.args.emplace_back(*arg);
+            }
+            mem = edge.args.front().def;
+            edges_[succ].emplace_back(std::move(edge));
+        } else if (auto branch = callee->isa<Extract>()) {
+            auto targets = branch->tuple()->isa<Tuple>();
+            if (targets == nullptr || targets->num_ops() != 2) return nullptr;
+
+            auto c = vec(branch->index());
+            auto m = vec(app->arg());
+            if (!c || !m) return nullptr;
+            mem = m->def;
+
+            auto cond = widen(*c);
+            const Def* masks[2] = {mask_and(mask, mask_not(cond)), mask_and(mask, cond)};
+            for (size_t i = 0; i != 2; ++i) {
+                auto succ = targets->op(i)->isa_nom<Lam>();
+                if (succ == nullptr || !rpo_.contains(succ) || rpo_[succ] <= rpo_[block] || succ->num_vars() != 1) return nullptr;
+                edges_[succ].emplace_back(Edge{masks[i], {*m}});
+            }
+        } else {
+            return nullptr;
+        }
+    }
+
+    return mem;
+}
+
+/*
+ * lowering
+ */
+
+/// Number of lanes such that the widest element that is loaded or stored fills @p vector_bits - rounded down to a power of two.
+static nat_t num_lanes(const Scope& scope) {
+    nat_t width = 8;
+    for (auto def : scope.bound()) {
+        if (!isa<Tag::Load>(def) && !isa<Tag::Store>(def)) continue;
+        auto T = as<Tag::Ptr>(def->as<App>()->arg(1)->type())->arg(0);
+        if (auto int_ = isa<Tag::Int>(T)) {
+            auto mod = isa_lit(int_->arg());
+            auto w = mod ? mod2width(*mod) : std::nullopt;
+            width = std::max(width, w ? *w : nat_t(64));
+        } else if (auto real = isa<Tag::Real>(T)) {
+            auto w = isa_lit(real->arg());
+            width = std::max(width, w ? *w : nat_t(64));
+        }
+    }
+    // the vector loop ends at N & ~(lanes - 1) - see @p lower
+    return nat_t(1) << log2(std::clamp(vector_bits / width, nat_t(2), max_lanes));
+}
+
+static bool lower(Lam* lam) {
+    auto& w = lam->world();
+    auto vec = isa<Tag::Acc>(lam->body());
+    if (!vec || vec.flags() != Acc::vecotrize) return false;
+
+    auto n = vec->decurry()->arg();
+    auto [mem, body_def, ret] = vec->args<3>();
+    auto body = body_def->isa_nom<Lam>();
+    if (body == nullptr || !body->is_set()) return false;
+
+    auto M   = w.type_mem();
+    auto i64 = w.type_int_width(64);
+    auto N   = w.op_bitcast(i64, n);
+    auto index = [&](const Def* i) { return w.op(Conv::u2u, w.type_int(n), i); };
+
+    // scalar loop: for (j = start; j < N; ++j) body(j)
+    auto rem_head = w.nom_lam(w.cn({M, i64}), w.dbg("vec_rem_head"));
+    auto rem_iter = w.nom_lam(w.cn(M), w.dbg("vec_rem_iter"));
+    auto rem_next = w.nom_lam(w.cn(M), w.dbg("vec_rem_next"));
+    auto exit     = w.nom_lam(w.cn(M), w.dbg("vec_exit"));
+    auto [rm, j] = rem_head->vars<2>();
+    rem_head->branch(w.op(ICmp::ul, j, N), rem_iter, exit, rm);
+    rem_iter->app(body, {rem_iter->var(), index(j), rem_next});
+    rem_next->app(rem_head, {rem_next->var(), w.op(Wrap::add, WMode::nuw, j, w.lit_int_width(64, 1))});
+    exit->app(ret, exit->var());
+
+    Scope scope(body);
+    auto lanes = num_lanes(scope);
+    auto zero  = w.lit_int_width(64, 0);
+    if (auto l = isa_lit(n); l && *l < lanes) {
+        lam->app(rem_head, {mem, zero});
+        return true;
+    }
+
+    // vector loop: for (i = 0; i < N & ~(lanes - 1); i += lanes) body(i), ..., body(i + lanes - 1)
+    auto vec_head = w.nom_lam(w.cn({M, i64}), w.dbg("vec_head"));
+    auto vec_iter = w.nom_lam(w.cn(M), w.dbg("vec_iter"));
+    auto vec_done = w.nom_lam(w.cn(M), w.dbg("vec_done"));
+    auto [vm, i] = vec_head->vars<2>();
+
+    Vectorizer vectorizer(scope, lanes);
+    if (auto m = vectorizer.emit(vec_iter->var(), index(i))) {
+        w.DLOG("vectorized {} with {} lanes", body, lanes);
+        assert(is_power_of_2(lanes));
+        auto end = w.op(Bit::_and, N, w.lit_int_width(64, ~(lanes - 1)));
+        lam->app(vec_head, {mem, zero});
+        vec_head->branch(w.op(ICmp::ul, i, end), vec_iter, vec_done, vm);
+        vec_iter->app(vec_head, {m, w.op(Wrap::add, WMode::nuw, i, w.lit_int_width(64, lanes))});
+        vec_done->app(rem_head, {vec_done->var(), i});
+    } else {
+        w.wdef(body, "cannot vectorize '{}'; falling back to a scalar loop", body);
+        lam->app(rem_head, {mem, zero});
+    }
+
+    return true;
+}
+
+bool vectorize(World& world) {
+    bool todo = false;
+
+    for (auto lam : world.copy_lams()) {
+        if (lam->is_set()) todo |= lower(lam);
+    }
+
+    return todo;
+}
+
+}
@@ -0,0 +1,25 @@
+#ifndef THORIN_TRANSFORM_VECTORIZE_H
+#define THORIN_TRANSFORM_VECTORIZE_H
+
+namespace thorin {
+
+class World;
+
+/**
+ * Lowers each @c Acc::vecotrize to a loop over its body.
+ * If possible, a vector loop handles as many iterations as possible - several lanes at once - and a scalar loop runs the remainder.
+ * The vector loop executes the body once for all lanes:
+ * * Values that depend on the iteration are @em varying and become arrays with one element per lane; ops on them become @c lift%s.
+ *   All other values are @em uniform and stay scalar.
+ * * Loads and stores must either access @c lea(p,i) with a uniform @c p and the index @c i of the iteration or a uniform address.
+ *   The former become vector loads and stores; a uniform address may only be loaded.
+ * * Divergent control flow within the body must be acyclic.
+ *   It is linearized: each basic block is guarded by a mask of the lanes taking it and @c var%s at joins select among the incoming values.
+ *   Stores in guarded blocks blend the new with the old values; all accesses in guarded blocks must also occur unguarded.
+ * Returns whether something has changed.
+ */
+bool vectorize(World&);
+
+}
+
+#endif
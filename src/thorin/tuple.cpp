@@ -63,7 +63,7 @@ bool is_unit(const Def* def) {
 }
 
 bool is_tuple_arg_of_app(const Def* def) {
-    if (!def->isa<Tuple>()) return false;
+    if (!def->isa<Tuple>() && !def->isa<Pack>()) return false;
     for (auto& use : def->uses()) {
         if (use.index() == 1 && use->isa<App>())
             continue;
@@ -67,6 +67,11 @@ inline float       rem(float       a, float       b) { return std::fmod(a, b); }
 inline double      rem(double      a, double      b) { return std::fmod(a, b); }
 inline long double rem(long double a, long double b) { return std::fmod(a, b); }
 
+inline half        fused_mul_add(half        a, half        b, half        c) { return      fma(a, b, c); }
+inline float       fused_mul_add(float       a, float       b, float       c) { return std::fma(a, b, c); }
+inline double      fused_mul_add(double      a, double      b, double      c) { return std::fma(a, b, c); }
+inline long double fused_mul_add(long double a, long double b, long double c) { return std::fma(a, b, c); }
+
 #define CODE(i) \
     template<> struct w2r_<i> { typedef r ## i type; };
 THORIN_16_32_64(CODE)
@@ -26,7 +26,7 @@ namespace thorin {
  */
 
 #ifndef NDEBUG
-bool World::Arena::Lock::guard_ = false;
+thread_local bool World::Arena::Lock::guard_ = false;
 #endif
 
 World::World(const std::string& name)
@@ -101,11 +101,12 @@ World::World(const std::string& name)
     } { // trait: T: * -> nat
         auto type = pi(kind(), nat);
         THORIN_TRAIT(CODE)
-    } { // acc: n: nat -> cn[M, cn[M, int w n, cn[M, []]]]
+    } { // acc: n: nat -> cn[M, body: cn[M, int n, cn M], cn M]
         // TODO this is more a proof of concept
         auto type = nom_pi(kind())->set_dom(nat);
         auto n = type->var(0, dbg("n"));
-        type->set_codom(cn_mem_ret(type_int(n), sigma()));
+        auto M = type_mem();
+        type->set_codom(cn({M, cn({M, type_int(n), cn(M)}), cn(M)}));
         THORIN_ACC(CODE)
     }
 #undef CODE
@@ -131,11 +132,34 @@ World::World(const std::string& name)
         auto T = type->var(dbg("T"));
         type->set_codom(pi(T, type_bool()));
         data_.PE_[size_t(PE::known)] = axiom(normalize_PE<PE::known>, type, Tag::PE, flags_t(PE::known), dbg(op2str(PE::known)));
+    } { // graph_create: M -> [M, I32]
+        auto I32 = type_int_width(32);
+        data_.Graph_[size_t(Graph::create)] = axiom(nullptr, pi(mem, sigma({mem, I32})), Tag::Graph, flags_t(Graph::create), dbg(op2str(Graph::create)));
+        // graph_task: T: * -> [M, graph: I32, body: cn[M, T, cn M], env: T] -> [M, I32]
+        auto type = nom_pi(kind())->set_dom(kind());
+        auto T = type->var(dbg("T"));
+        type->set_codom(pi({mem, I32, cn({mem, T, cn(mem)}), T}, sigma({mem, I32})));
+        data_.Graph_[size_t(Graph::task)] = axiom(nullptr, type, Tag::Graph, flags_t(Graph::task), dbg(op2str(Graph::task)));
+        // graph_edge: [M, from: I32, to: I32] -> M
+        data_.Graph_[size_t(Graph::edge)] = axiom(nullptr, pi({mem, I32, I32}, mem), Tag::Graph, flags_t(Graph::edge), dbg(op2str(Graph::edge)));
+        // graph_exec: [M, graph: I32, root: I32] -> M
+        data_.Graph_[size_t(Graph::exec)] = axiom(nullptr, pi({mem, I32, I32}, mem), Tag::Graph, flags_t(Graph::exec), dbg(op2str(Graph::exec)));
+    } { // hint_branch: [t: nat, f: nat] -> bool -> bool
+        auto B = type_bool();
+        data_.Hint_[size_t(Hint::branch)] = axiom(normalize_Hint<Hint::branch>, pi({nat, nat},      pi(B, B)), Tag::Hint, flags_t(Hint::branch), dbg(op2str(Hint::branch)));
+        // hint_loop: [vectorize: nat, interleave: nat, unroll: nat] -> bool -> bool
+        data_.Hint_[size_t(Hint::loop  )] = axiom(normalize_Hint<Hint::loop  >, pi({nat, nat, nat}, pi(B, B)), Tag::Hint, flags_t(Hint::loop  ), dbg(op2str(Hint::loop  )));
     } { // bitcast: [D: *, S: *] -> S -> D
         auto type = nom_pi(kind())->set_dom({kind(), kind()});
         auto [D, S] = type->vars<2>({dbg("D"), dbg("S")});
         type->set_codom(pi(S, D));
         data_.bitcast_ = axiom(normalize_bitcast, type, Tag::Bitcast, 0, dbg("bitcast"));
+    } { // fma: [m: nat, w: nat] -> [real w, real w, real w] -> real w
+        auto type = nom_pi(kind())->set_dom({nat, nat});
+        auto [m, w] = type->vars<2>({dbg("m"), dbg("w")});
+        auto real_w = type_real(w);
+        type->set_codom(pi({real_w, real_w, real_w}, real_w));
+        data_.fma_ = axiom(normalize_fma, type, Tag::FMA, 0, dbg("fma"));
     } { // lea:, [n: nat, Ts: «n; *», as: nat] -> [ptr(«j: n; Ts#j», as), i: int n] -> ptr(Ts#i, as)
         auto dom = nom_sigma(space(), 3);
         dom->set(0, nat);
@@ -65,12 +65,15 @@ public:
     World& operator=(const World&) = delete;
 
     explicit World(const std::string& name = {});
-    /// Inherits the @p state_ of the @p other @p World but does @em not perform a copy.
+    /**
+     * Inherits the @p state_ of the @p other @p World but does @em not perform a copy.
+     * It logs to the same @c std::ostream via a @p Stream of its own, so the @p World%s can be used by different threads.
+     */
     explicit World(const World& other)
         : World(other.name())
     {
-        stream_ = other.stream_;
-        state_  = other.state_;
+        if (other.stream_) stream_ = std::make_shared<Stream>(other.stream_->ostream(), other.stream_->tab(), other.stream_->level());
+        state_ = other.state_;
     }
     ~World();
 
@@ -314,6 +317,8 @@ public:
     const Axiom* ax(Bit   o)  const { return data_.Bit_  [size_t(o)]; }
     const Axiom* ax(Conv  o)  const { return data_.Conv_ [size_t(o)]; }
     const Axiom* ax(Div   o)  const { return data_.Div_  [size_t(o)]; }
+    const Axiom* ax(Graph o)  const { return data_.Graph_[size_t(o)]; }
+    const Axiom* ax(Hint  o)  const { return data_.Hint_ [size_t(o)]; }
     const Axiom* ax(ICmp  o)  const { return data_.ICmp_ [size_t(o)]; }
     const Axiom* ax(PE    o)  const { return data_.PE_   [size_t(o)]; }
     const Axiom* ax(RCmp  o)  const { return data_.RCmp_ [size_t(o)]; }
@@ -324,6 +329,7 @@ public:
     const Axiom* ax_alloc()   const { return data_.alloc_;   }
     const Axiom* ax_atomic()  const { return data_.atomic_;  }
     const Axiom* ax_bitcast() const { return data_.bitcast_; }
+    const Axiom* ax_fma()     const { return data_.fma_;     }
     const Axiom* ax_lea()     const { return data_.lea_;     }
     const Axiom* ax_lift()    const { return data_.lift_;    }
     const Axiom* ax_load()    const { return data_.load_;    }
@@ -346,6 +352,7 @@ public:
     template<class O> const Def* fn(O o, nat_t      other, nat_t      size, const Def* dbg = {}) { return fn(o, lit_nat(other), lit_nat(size), dbg); }
     const Def* fn_atomic(const Def* fn, const Def* dbg = {}) { return app(ax_atomic(), fn, dbg); }
     const Def* fn_bitcast(const Def* dst_t, const Def* src_t, const Def* dbg = {}) { return app(ax_bitcast(), {dst_t, src_t}, dbg); }
+    const Def* fn_fma(const Def* rmode, const Def* width, const Def* dbg = {}) { return app(ax_fma(), {rmode, width}, dbg); }
     //@}
 
     /// @name op - these guys @em build the final function @em application for the various operations
@@ -361,9 +368,28 @@ public:
     const Def* op(Conv  o, const Def* dst_type, const Def* src, const Def* dbg = {}) { auto d = dst_type->as<App>()->arg(); auto s = src->type()->as<App>()->arg(); return app(fn(o, d, s), src, dbg); }
     const Def* op(Trait o, const Def* type, const Def* dbg = {}) { return app(ax(o), type, dbg); }
     const Def* op(PE    o, const Def* def, const Def* dbg = {}) { return app(app(ax(o), def->type()), def, dbg); }
-    const Def* op(Acc   o, const Def* a, const Def* b, const Def* body, const Def* dbg = {}) { return app(ax(o), {a, b, body}, dbg); }
+    const Def* op(Acc   o, const Def* n, const Def* mem, const Def* body, const Def* ret, const Def* dbg = {}) { return app(app(ax(o), n), {mem, body, ret}, dbg); }
     const Def* op_atomic(const Def* fn, Defs args, const Def* dbg = {}) { return app(fn_atomic(fn), args, dbg); }
+    /// Task graphs: @p body of a task is invoked with @p env once all predecessors of the task have finished - at most once per task.
+    const Def* op_graph_create(const Def* mem, const Def* dbg = {}) { return app(ax(Graph::create), mem, dbg); }
+    const Def* op_graph_task(const Def* mem, const Def* graph, const Def* body, const Def* env, const Def* dbg = {}) { return app(app(ax(Graph::task), env->type()), {mem, graph, body, env}, dbg); }
+    const Def* op_graph_edge(const Def* mem, const Def* from, const Def* to, const Def* dbg = {}) { return app(ax(Graph::edge), {mem, from, to}, dbg); }
+    const Def* op_graph_exec(const Def* mem, const Def* graph, const Def* root, const Def* dbg = {}) { return app(ax(Graph::exec), {mem, graph, root}, dbg); }
     const Def* op_bitcast(const Def* dst_type, const Def* src, const Def* dbg = {}) { return app(fn_bitcast(dst_type, src->type()), src, dbg); }
+    /// The branch on @p cond takes its @c true target @p t times and its @c false target @p f times out of <tt>t + f</tt>.
+    const Def* op_hint_branch(nat_t t, nat_t f, const Def* cond, const Def* dbg = {}) { return app(app(ax(Hint::branch), {lit_nat(t), lit_nat(f)}), cond, dbg); }
+    const Def* op_likely  (const Def* cond, const Def* dbg = {}) { return op_hint_branch(2000, 1, cond, dbg); }
+    const Def* op_unlikely(const Def* cond, const Def* dbg = {}) { return op_hint_branch(1, 2000, cond, dbg); }
+    /**
+     * The loop which exits depending on @p cond is vectorized with @p vectorize lanes, interleaved @p interleave times and unrolled @p unroll times.
+     * @c 0 leaves the choice to the backend; @c 1 disables the transformation.
+     */
+    const Def* op_hint_loop(nat_t vectorize, nat_t interleave, nat_t unroll, const Def* cond, const Def* dbg = {}) {
+        return app(app(ax(Hint::loop), {lit_nat(vectorize), lit_nat(interleave), lit_nat(unroll)}), cond, dbg);
+    }
+    /// Fused multiply-add: <tt>a * b + c</tt> with a single rounding.
+    const Def* op_fma(const Def* rmode, const Def* a, const Def* b, const Def* c, const Def* dbg = {}) { return app(fn_fma(rmode, infer(a)), {a, b, c}, dbg); }
+    const Def* op_fma(nat_t      rmode, const Def* a, const Def* b, const Def* c, const Def* dbg = {}) { return op_fma(lit_nat(rmode), a, b, c, dbg); }
     const Def* op_lea(const Def* ptr, const Def* index, const Def* dbg = {});
     const Def* op_lea_unsafe(const Def* ptr, u64 i, const Def* dbg = {}) { return op_lea_unsafe(ptr, lit_int(i), dbg); }
     const Def* op_lea_unsafe(const Def* ptr, const Def* i, const Def* dbg = {}) { auto safe_int = type_int(as<Tag::Ptr>(ptr->type())->arg(0)->arity()); return op_lea(ptr, op(Conv::u2u, safe_int, i), dbg); }
@@ -546,7 +572,7 @@ private:
         struct Lock {
             Lock() { assert((guard_ = !guard_) && "you are not allowed to recursively invoke allocate"); }
             ~Lock() { guard_ = !guard_; }
-            static bool guard_;
+            static thread_local bool guard_; ///< Per thread as the @p World%s of different backends are emitted concurrently.
         };
 #else
         struct Lock { ~Lock() {} };
@@ -631,6 +657,8 @@ private:
         std::array<const Axiom*, Num<Conv >> Conv_;
         std::array<const Axiom*, Num<PE   >> PE_;
         std::array<const Axiom*, Num<Acc  >> Acc_;
+        std::array<const Axiom*, Num<Graph>> Graph_;
+        std::array<const Axiom*, Num<Hint >> Hint_;
         const Lit* lit_nat_0_;
         const Lit* lit_nat_1_;
         const Lit* lit_nat_max_;
@@ -638,6 +666,7 @@ private:
         const Axiom* atomic_;
         const Axiom* lift_;
         const Axiom* bitcast_;
+        const Axiom* fma_;
         const Axiom* lea_;
         const Axiom* load_;
         const Axiom* remem_;